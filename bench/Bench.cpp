@@ -0,0 +1,639 @@
+/**
+ * @file        Bench.cpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Driver code for the benchmark suite, which times the parsing
+ * stages and whole passes over a synthetic cluster log and reports them as
+ * JSON
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+// C++ headers
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+// Boost headers
+#include <boost/filesystem.hpp>
+// My headers
+#include <Frame.hpp>
+#include <ClusterLogParser.hpp>
+#include <ClusterTokenizer.hpp>
+#include <ClusterLogGenerator.hpp>
+#include <TextFileReader.hpp>
+#include <FramePipeline.hpp>
+#include <CalibrationConsumer.hpp>
+#include <TableEntryGen.hpp>
+#include <ByteScanner.hpp>
+#include <FastNumber.hpp>
+
+// The layout of the dataset written for the whole passes, as the readers take
+// the detector and settings from the directories above the log
+static const char BENCH_DETECTOR[] = "BenchDetector";
+static const char BENCH_SETTINGS[] = "Synthetic";
+static const char BENCH_LOG[] = "ClusterLogAll.txt";
+
+// Keeps the results of the timed work alive, so none of it is optimized away
+static volatile unsigned long long sink = 0;
+
+
+/**
+ * @brief The options the benchmarks were run with
+ */
+struct BenchOptions {
+    GeneratorSettings settings; // The shape of the synthetic log
+    unsigned int repeats; // The number of times each benchmark is timed
+    unsigned int threads; // The number of threads for the parallel passes
+    std::string directory; // The directory to write the dataset under (a temporary one if empty)
+    std::string outputPath; // The file to write the JSON report to (standard output if empty)
+    std::string generatePath; // The file to only write the synthetic log to, if any
+};
+
+
+/**
+ * @brief The timings of one benchmark
+ */
+struct BenchResult {
+    std::string name; // The name of the benchmark
+    std::vector<double> seconds; // The time taken by each repeat
+    unsigned long long items; // The number of items (frames, lines...) handled by each repeat
+    std::string unit; // What the items are
+    unsigned long long bytes; // The number of bytes handled by each repeat (0 if not meaningful)
+};
+
+
+/**
+ * @brief         Times a piece of work a number of times
+ * @param name    The name of the benchmark
+ * @param unit    What the items the work handles are
+ * @param items   The number of items the work handles each time
+ * @param bytes   The number of bytes the work handles each time
+ * @param repeats The number of times to time the work
+ * @param work    A callable doing the work once, returning a checksum of its
+ * results
+ * @return        The timings
+ */
+template <class Work>
+BenchResult const measure(std::string const& name,
+                          std::string const& unit,
+                          unsigned long long const items,
+                          unsigned long long const bytes,
+                          unsigned int const repeats,
+                          Work work)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    BenchResult result;
+    result.name = name;
+    result.unit = unit;
+    result.items = items;
+    result.bytes = bytes;
+
+    for (unsigned int i = 0; i < repeats; ++i) {
+        Clock::time_point const start = Clock::now();
+        sink += work();
+        result.seconds.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+    }
+
+    return result;
+}
+
+
+/**
+ * @brief      Writes a string as a JSON string literal
+ * @param text The string
+ * @param out  The stream to write to
+ * @return     Nothing
+ */
+void writeJsonString(std::string const& text, std::ostream& out)
+{
+    static const char HEX[] = "0123456789abcdef";
+
+    out << '"';
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        unsigned char const c = static_cast<unsigned char>(text[i]);
+        if (c == '"' || c == '\\') {
+            out << '\\' << text[i];
+        } else if (c < 0x20) {
+            out << "\\u00" << HEX[c >> 4] << HEX[c & 0xf];
+        } else {
+            out << text[i];
+        }
+    }
+    out << '"';
+}
+
+
+/**
+ * @brief        Writes the timings of a benchmark as a JSON object
+ * @param result The timings
+ * @param indent The indentation of the object's fields
+ * @param out    The stream to write to
+ * @return       Nothing
+ */
+void writeJsonResult(BenchResult const& result, std::string const& indent, std::ostream& out)
+{
+    std::vector<double> sorted(result.seconds);
+    std::sort(sorted.begin(), sorted.end());
+    double const best = sorted.empty() ? 0.0 : sorted.front();
+    double const median = sorted.empty() ? 0.0 : sorted[sorted.size() / 2];
+
+    out << indent << "{\n"
+        << indent << "  \"name\": ";
+    writeJsonString(result.name, out);
+    out << ",\n"
+        << indent << "  \"repeats\": " << result.seconds.size() << ",\n"
+        << indent << "  \"best_seconds\": " << best << ",\n"
+        << indent << "  \"median_seconds\": " << median << ",\n"
+        << indent << "  \"items\": " << result.items << ",\n"
+        << indent << "  \"unit\": ";
+    writeJsonString(result.unit, out);
+    out << ",\n"
+        << indent << "  \"items_per_second\": " << (best > 0.0 ? result.items / best : 0.0) << ",\n"
+        << indent << "  \"bytes\": " << result.bytes << ",\n"
+        << indent << "  \"megabytes_per_second\": " << (best > 0.0 ? result.bytes / best / 1e6 : 0.0) << "\n"
+        << indent << "}";
+}
+
+
+/**
+ * @brief         Writes a list of timings as a JSON array
+ * @param results The timings
+ * @param out     The stream to write to
+ * @return        Nothing
+ */
+void writeJsonResults(std::vector<BenchResult> const& results, std::ostream& out)
+{
+    out << "[\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        writeJsonResult(results[i], "    ", out);
+        out << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]";
+}
+
+
+/**
+ * @brief      Computes the 64-bit FNV-1a hash of a string, which identifies
+ * the synthetic log generated
+ * @param text The string
+ * @return     The hash
+ */
+std::uint64_t fnv1a(std::string const& text)
+{
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        hash = (hash ^ static_cast<unsigned char>(text[i])) * 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+
+/**
+ * @brief Splits a cluster log into the inputs of the parsing benchmarks
+ */
+struct BenchInputs {
+    std::string metadata; // Every frame's meta-data line, each as an empty frame
+    std::string clusters; // Every cluster line of the log, as one frame
+    std::vector<int> triples; // Every pixel's x, y and ToT in file order
+    std::vector<unsigned int> clusterSizes; // The number of pixels in each cluster
+    std::vector<unsigned int> frameSizes; // The number of clusters in each frame
+    unsigned long long numberOfLines; // The number of lines of the log
+    unsigned long long numberOfFrames; // The number of frames of the log
+    unsigned long long numberOfClusterLines; // The number of cluster lines of the log
+};
+
+
+/**
+ * @brief        Splits a cluster log into the inputs of the parsing
+ * benchmarks
+ * @param log    The text of the log
+ * @param inputs The inputs to fill
+ * @return       Nothing, throws std::ifstream::failure on malformed data
+ */
+void splitLog(std::string const& log, BenchInputs& inputs)
+{
+    char const* begin = log.data();
+    char const* end = begin + log.size();
+
+    ScanResult const scan = ByteScanner::scan(begin, end);
+    inputs.numberOfLines = scan.lines;
+    inputs.numberOfFrames = scan.frames;
+    inputs.numberOfClusterLines = 0;
+
+    // Sort the lines by their kind
+    inputs.clusters = "Frame 1 (0.0 s, 0.1 s)\n";
+    for (char const* line = begin; line < end;) {
+        char const* newline = static_cast<char const*>(std::memchr(line, '\n', end - line));
+        char const* next = newline ? newline + 1 : end;
+        if (*line == 'F') {
+            inputs.metadata.append(line, next);
+            inputs.metadata += '\n';
+        } else if (*line == '[') {
+            inputs.clusters.append(line, next);
+            inputs.numberOfClusterLines++;
+        }
+        line = next;
+    }
+    inputs.clusters += '\n';
+
+    // Decode the pixels once, for building frames from
+    ClusterLogParser<int> parser(begin, end);
+    Frame<int> frame;
+    while (!parser.atEnd()) {
+        frame.clear();
+        parser.parseFrame(frame);
+        inputs.frameSizes.push_back(static_cast<unsigned int>(frame.numberOfClusters()));
+        for (std::size_t i = 0; i < frame.numberOfClusters(); ++i) {
+            inputs.clusterSizes.push_back(static_cast<unsigned int>(frame.clusterEnd(i) - frame.clusterBegin(i)));
+            for (std::size_t j = frame.clusterBegin(i); j < frame.clusterEnd(i); ++j) {
+                inputs.triples.push_back(frame.x(j));
+                inputs.triples.push_back(frame.y(j));
+                inputs.triples.push_back(frame.c(j));
+            }
+        }
+    }
+}
+
+
+/**
+ * @brief         Times the parsing stages on their own, in memory
+ * @param inputs  The split cluster log
+ * @param options The options the benchmarks were run with
+ * @return        The timings
+ */
+std::vector<BenchResult> const runMicroBenchmarks(BenchInputs const& inputs, BenchOptions const& options)
+{
+    std::vector<BenchResult> results;
+
+    // The meta-data lines, parsed as a log of empty frames
+    results.push_back(measure("metadata_parsing", "lines", inputs.numberOfFrames, inputs.metadata.size(),
+                              options.repeats, [&]() -> unsigned long long {
+        ClusterLogParser<int> parser(inputs.metadata.data(), inputs.metadata.data() + inputs.metadata.size());
+        Frame<int> frame;
+        double total = 0.0;
+        while (!parser.atEnd()) {
+            parser.parseFrame(frame);
+            total += frame.getTime();
+        }
+        return static_cast<unsigned long long>(total);
+    }));
+
+    // The cluster lines, parsed into a single (reused) frame
+    Frame<int> clusterFrame;
+    results.push_back(measure("cluster_line_parsing", "lines", inputs.numberOfClusterLines, inputs.clusters.size(),
+                              options.repeats, [&]() -> unsigned long long {
+        ClusterLogParser<int> parser(inputs.clusters.data(), inputs.clusters.data() + inputs.clusters.size());
+        clusterFrame.clear();
+        parser.parseFrame(clusterFrame);
+        return static_cast<unsigned long long>(clusterFrame.size());
+    }));
+
+    // The tokenizer on its own, decoding each cluster line into a cluster of
+    // its own as the parser does, with the lines found up front so only the
+    // decoding is timed
+    std::vector<std::pair<std::size_t, std::size_t> > lines;
+    for (std::size_t line = inputs.clusters.find('\n') + 1; line < inputs.clusters.size();) {
+        std::size_t const newline = inputs.clusters.find('\n', line);
+        std::size_t const next = newline == std::string::npos ? inputs.clusters.size() : newline + 1;
+        if (inputs.clusters[line] == '[') {
+            lines.push_back(std::make_pair(line, next));
+        }
+        line = next;
+    }
+    unsigned long long lineBytes = 0;
+    for (std::size_t i = 0; i < lines.size(); ++i) {
+        lineBytes += lines[i].second - lines[i].first;
+    }
+    results.push_back(measure("cluster_tokenizing", "triples", inputs.triples.size() / 3, lineBytes,
+                              options.repeats, [&]() -> unsigned long long {
+        char const* const text = inputs.clusters.data();
+        std::size_t rejected = 0;
+        clusterFrame.clear();
+        for (std::size_t i = 0; i < lines.size(); ++i) {
+            clusterFrame.beginCluster();
+            ClusterTokenizer<int>::decode(text + lines[i].first, text + lines[i].second, clusterFrame, rejected);
+        }
+        return static_cast<unsigned long long>(clusterFrame.numberOfClusters() + clusterFrame.size() + rejected);
+    }));
+
+    // The frames built pixel by pixel from decoded triples, as the parsers
+    // build them
+    results.push_back(measure("frame_construction", "frames", inputs.frameSizes.size(), 0,
+                              options.repeats, [&]() -> unsigned long long {
+        Frame<int> frame;
+        unsigned long long total = 0;
+        std::size_t cluster = 0;
+        std::size_t triple = 0;
+        for (std::size_t i = 0; i < inputs.frameSizes.size(); ++i) {
+            frame.clear();
+            for (unsigned int j = 0; j < inputs.frameSizes[i]; ++j, ++cluster) {
+                frame.beginCluster();
+                for (unsigned int k = 0; k < inputs.clusterSizes[cluster]; ++k, triple += 3) {
+                    frame.addPixel(inputs.triples[triple], inputs.triples[triple + 1], inputs.triples[triple + 2]);
+                }
+            }
+            total += frame.size();
+        }
+        return total;
+    }));
+
+    // The Wiki table entries of many datasets
+    static const unsigned int ENTRIES = 100000;
+    results.push_back(measure("table_generation", "entries", ENTRIES, 0, options.repeats, [&]() -> unsigned long long {
+        unsigned long long total = 0;
+        for (unsigned int i = 0; i < ENTRIES; ++i) {
+            TableEntryGen entry(BENCH_DETECTOR, inputs.clusters.size() + i, inputs.numberOfLines,
+                                inputs.numberOfFrames, BENCH_SETTINGS);
+            total += entry.generateEntry().size();
+        }
+        return total;
+    }));
+
+    return results;
+}
+
+
+/**
+ * @brief         Times whole passes over the cluster log on disk, from
+ * opening it to the last frame
+ * @param path    The path of the cluster log
+ * @param options The options the benchmarks were run with
+ * @return        The timings
+ */
+std::vector<BenchResult> const runEndToEndBenchmarks(std::string const& path, BenchOptions const& options)
+{
+    std::vector<BenchResult> results;
+
+    unsigned long long size = 0;
+    unsigned long long frames = 0;
+    {
+        TextFileReader<int> input(path);
+        size = input.size();
+        frames = input.numberOfFrames();
+    }
+
+    results.push_back(measure("scan", "frames", frames, size, options.repeats, [&]() -> unsigned long long {
+        TextFileReader<int> input(path);
+        return input.numberOfLines() + input.numberOfFrames();
+    }));
+
+    results.push_back(measure("read_serial", "frames", frames, size, options.repeats, [&]() -> unsigned long long {
+        TextFileReader<int> input(path);
+        Frame<int> frame;
+        unsigned long long total = 0;
+        while (!input.endOfStream()) {
+            input.getFrame(frame);
+            total += frame.size();
+        }
+        return total;
+    }));
+
+    std::ostringstream parallel;
+    parallel << "read_parallel_" << options.threads;
+    results.push_back(measure(parallel.str(), "frames", frames, size, options.repeats, [&]() -> unsigned long long {
+        TextFileReader<int> input(path);
+        unsigned long long total = 0;
+        input.forEachFrame(options.threads, [&](Frame<int> const& frame, unsigned int const frameNumber) {
+            total += frame.size();
+        });
+        return total;
+    }));
+
+    results.push_back(measure("read_pipelined", "frames", frames, size, options.repeats, [&]() -> unsigned long long {
+        TextFileReader<int> input(path);
+        unsigned long long total = 0;
+        input.forEachFramePipelined([&](Frame<int> const& frame, unsigned int const frameNumber) {
+            total += frame.size();
+        });
+        return total;
+    }));
+
+    // The calibration histograms, as the 'c' mode builds them
+    std::ostringstream calibrate;
+    calibrate << "calibrate_" << options.threads;
+    results.push_back(measure(calibrate.str(), "frames", frames, size, options.repeats, [&]() -> unsigned long long {
+        TextFileReader<int> input(path);
+        FramePipeline<int> pipeline;
+        std::shared_ptr<CalibrationConsumer<int> > calibration = std::make_shared<CalibrationConsumer<int> >(
+                options.threads, 128, 2, false);
+        pipeline.addConsumer(calibration);
+        return pipeline.run(input, options.threads);
+    }));
+
+    return results;
+}
+
+
+/**
+ * @brief Parses the benchmarks' arguments, which take the form <br>
+ * [options]
+ * @param argc The number of arguments given to the program when run
+ * @param argv An array of strings which are the arguments given
+ * @param options The options to fill in
+ * @return Whether the arguments were valid
+ */
+bool parseArguments(int argc, char **argv, BenchOptions& options)
+{
+    options.settings.numberOfFrames = 20000;
+    options.repeats = 5;
+    options.threads = std::thread::hardware_concurrency();
+    if (options.threads == 0) {
+        options.threads = 1;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        bool const hasValue = i + 1 < argc;
+        char const* pos = hasValue ? argv[i + 1] : 0;
+        char const* last = hasValue ? pos + std::strlen(pos) : 0;
+
+        if (option == "--frames" && hasValue) {
+            options.settings.numberOfFrames = std::strtoull(argv[++i], 0, 10);
+            if (options.settings.numberOfFrames == 0) {
+                return false;
+            }
+        } else if (option == "--occupancy" && hasValue) {
+            ++i;
+            if (!FastNumber::parseDecimal(pos, last, options.settings.occupancy) || pos != last
+                    || options.settings.occupancy < 0.0 || options.settings.occupancy > 1.0) {
+                return false;
+            }
+        } else if (option == "--cluster-sizes" && hasValue) {
+            // Comma separated weights of clusters of 1, 2, 3... pixels
+            ++i;
+            options.settings.clusterSizes.clear();
+            for (;;) {
+                double weight = 0.0;
+                if (!FastNumber::parseDecimal(pos, last, weight) || weight < 0.0) {
+                    return false;
+                }
+                options.settings.clusterSizes.push_back(weight);
+                if (pos == last) {
+                    break;
+                }
+                if (*pos++ != ',') {
+                    return false;
+                }
+            }
+        } else if (option == "--tot" && hasValue) {
+            ++i;
+            if (!FastNumber::parseDecimal(pos, last, options.settings.meanToT) || pos != last
+                    || options.settings.meanToT < 0.0) {
+                return false;
+            }
+        } else if (option == "--seed" && hasValue) {
+            options.settings.seed = std::strtoull(argv[++i], 0, 10);
+        } else if (option == "--repeats" && hasValue) {
+            options.repeats = std::strtoul(argv[++i], 0, 10);
+            if (options.repeats == 0) {
+                return false;
+            }
+        } else if (option == "-j" && hasValue) {
+            options.threads = std::strtoul(argv[++i], 0, 10);
+            if (options.threads == 0) {
+                return false;
+            }
+        } else if (option == "--dir" && hasValue) {
+            options.directory = argv[++i];
+        } else if (option == "--output" && hasValue) {
+            options.outputPath = argv[++i];
+        } else if (option == "--generate" && hasValue) {
+            options.generatePath = argv[++i];
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief       Main function which drives the benchmarks <br>
+ * Handles:<br>
+ * (1) Generating the synthetic cluster log <br>
+ * (2) Timing the parsing stages in memory <br>
+ * (3) Timing whole passes over the log on disk <br>
+ * (4) Reporting the timings as JSON
+ * @param argc  The number of arguments given to the program when run
+ * @param argv  An array of strings which are the arguments given
+ * @return      Returns the classic K&R integer (as one would expect)
+ */
+int main(int argc, char **argv)
+{
+    BenchOptions options;
+    if (!parseArguments(argc, argv, options)) {
+        std::cerr << "Incorrect arguments!\n"
+                  << "USAGE: " << argv[0] << " [options]\n"
+                  << "Options:\n"
+                  << "  --frames n           Generates n frames (20000 by default)\n"
+                  << "  --occupancy f        Hits a mean fraction f of the pixels in each frame\n"
+                  << "  --cluster-sizes w,.. Weighs clusters of 1, 2, 3... pixels by w, ...\n"
+                  << "  --tot t              Gives the hits a mean ToT of t\n"
+                  << "  --seed s             Seeds the synthetic log with s\n"
+                  << "  --repeats n          Times each benchmark n times (5 by default)\n"
+                  << "  -j n                 Runs the parallel passes on n threads\n"
+                  << "  --dir path           Writes the dataset under path and keeps it\n"
+                  << "  --output file        Writes the JSON report to file\n"
+                  << "  --generate file      Only writes the synthetic cluster log to file\n";
+        return 1;
+    }
+
+    try {
+        ClusterLogGenerator<> generator(options.settings);
+
+        if (!options.generatePath.empty()) {
+            generator.write(options.generatePath);
+            return 0;
+        }
+
+        std::string const log = generator.generate();
+        BenchInputs inputs;
+        splitLog(log, inputs);
+
+        // Lay the log out as a dataset for the readers
+        bool const isTemporary = options.directory.empty();
+        boost::filesystem::path root = isTemporary
+                ? boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("lolcat_bench-%%%%-%%%%")
+                : boost::filesystem::path(options.directory);
+        boost::filesystem::path const dataset = root / BENCH_DETECTOR / "Data" / BENCH_SETTINGS;
+        boost::filesystem::create_directories(dataset);
+        std::string const path = (dataset / BENCH_LOG).string();
+        {
+            std::ofstream out(path.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+            if (!out.write(log.data(), log.size())) {
+                throw std::ifstream::failure("Could not write the synthetic cluster log: " + path);
+            }
+        }
+
+        std::vector<BenchResult> const micro = runMicroBenchmarks(inputs, options);
+        std::vector<BenchResult> const endToEnd = runEndToEndBenchmarks(path, options);
+
+        if (isTemporary) {
+            boost::filesystem::remove_all(root);
+        }
+
+        std::ofstream file;
+        if (!options.outputPath.empty()) {
+            file.open(options.outputPath.c_str());
+            if (!file) {
+                throw std::ifstream::failure("Could not write the report: " + options.outputPath);
+            }
+        }
+        std::ostream& out = options.outputPath.empty() ? std::cout : file;
+        out.precision(10);
+
+        std::ostringstream sizes;
+        for (std::size_t i = 0; i < options.settings.clusterSizes.size(); ++i) {
+            sizes << (i ? ", " : "") << options.settings.clusterSizes[i];
+        }
+        std::ostringstream checksum;
+        checksum << std::hex << fnv1a(log);
+
+        out << "{\n"
+            << "  \"settings\": {\n"
+            << "    \"frames\": " << options.settings.numberOfFrames << ",\n"
+            << "    \"occupancy\": " << options.settings.occupancy << ",\n"
+            << "    \"cluster_sizes\": [" << sizes.str() << "],\n"
+            << "    \"mean_tot\": " << options.settings.meanToT << ",\n"
+            << "    \"seed\": " << options.settings.seed << ",\n"
+            << "    \"repeats\": " << options.repeats << ",\n"
+            << "    \"threads\": " << options.threads << "\n"
+            << "  },\n"
+            << "  \"dataset\": {\n"
+            << "    \"bytes\": " << log.size() << ",\n"
+            << "    \"lines\": " << inputs.numberOfLines << ",\n"
+            << "    \"frames\": " << inputs.numberOfFrames << ",\n"
+            << "    \"clusters\": " << inputs.clusterSizes.size() << ",\n"
+            << "    \"hits\": " << inputs.triples.size() / 3 << ",\n"
+            << "    \"checksum\": \"" << checksum.str() << "\"\n"
+            << "  },\n"
+            << "  \"micro\": ";
+        writeJsonResults(micro, out);
+        out << ",\n"
+            << "  \"end_to_end\": ";
+        writeJsonResults(endToEnd, out);
+        out << "\n}\n";
+    } catch (std::exception const& e) {
+        std::cerr << "The benchmarks failed!\n" << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,190 @@
+/**
+ * @file        AlignedBuffer.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines a fixed size, zero initialized array of plain values
+ * starting on a cache line boundary (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef ALIGNEDBUFFER_HPP
+#define ALIGNEDBUFFER_HPP
+
+// C++ headers
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <memory>
+#include <utility>
+
+// The size of a cache line, which the buffers are aligned to
+static const std::size_t CACHE_LINE_SIZE = 64;
+
+
+/**
+ * @brief This class owns a flat array of plain values (integers, doubles or
+ * plain structs) whose first value starts on a cache line, so that buffers
+ * owned by different threads never share a line (class is non-copyable)
+ */
+template <class T>
+class AlignedBuffer {
+public:
+
+    /**
+     * @brief   An empty constructor for the AlignedBuffer class
+     * @return  A newly constructed AlignedBuffer object holding nothing
+     */
+    AlignedBuffer()
+        : data_(0), size_(0)
+    {
+    }
+
+
+    /**
+     * @brief      A constructor for the AlignedBuffer class
+     * @param size The number of values to hold, all zeroed
+     * @return     A newly constructed AlignedBuffer object
+     */
+    explicit AlignedBuffer(std::size_t const size)
+        : data_(0), size_(0)
+    {
+        resize(size);
+    }
+
+
+    /**
+     * @brief   The destructor for the AlignedBuffer class
+     * @return  Nothing
+     */
+    ~AlignedBuffer()
+    {
+    }
+
+
+    /**
+     * @brief      Replaces the contents with the given number of zeroed values
+     * @param size The number of values to hold
+     * @return     Nothing
+     */
+    void resize(std::size_t const size)
+    {
+        // Over-allocate by a line, rounded up to whole lines, so the values
+        // can start on a line boundary and the last line is never shared
+        std::size_t const bytes = (size * sizeof(T) + CACHE_LINE_SIZE - 1)
+                                  / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+        storage_.reset(new char[bytes + CACHE_LINE_SIZE]);
+
+        std::uintptr_t const address = reinterpret_cast<std::uintptr_t>(storage_.get());
+        std::uintptr_t const aligned = (address + CACHE_LINE_SIZE - 1) & ~(std::uintptr_t(CACHE_LINE_SIZE) - 1);
+        data_ = reinterpret_cast<T*>(aligned);
+        size_ = size;
+
+        clear();
+    }
+
+
+    /**
+     * @brief   Zeroes every value
+     * @return  Nothing
+     */
+    void clear()
+    {
+        if (size_) {
+            std::memset(data_, 0, size_ * sizeof(T));
+        }
+    }
+
+
+    /**
+     * @brief       Retrieves the value at the given position
+     * @param index The position of the value
+     * @return      A reference to the value
+     */
+    T& operator[](std::size_t const index)
+    {
+        assert(index < size_);
+
+        return data_[index];
+    }
+
+
+    /**
+     * @brief       Retrieves the value at the given position
+     * @param index The position of the value
+     * @return      A reference to the value
+     */
+    T const& operator[](std::size_t const index) const
+    {
+        assert(index < size_);
+
+        return data_[index];
+    }
+
+
+    /**
+     * @brief   Retrieves the first value
+     * @return  A pointer to the first value, on a cache line boundary
+     */
+    T* data()
+    {
+        return data_;
+    }
+
+
+    /**
+     * @brief   Retrieves the first value
+     * @return  A pointer to the first value, on a cache line boundary
+     */
+    T const* data() const
+    {
+        return data_;
+    }
+
+
+    /**
+     * @brief   Retrieves the number of values held
+     * @return  The number of values
+     */
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+
+    /**
+     * @brief        Swaps the contents of two buffers without copying them
+     * @param first  The first buffer
+     * @param second The second buffer
+     * @return       Nothing
+     */
+    friend void swap(AlignedBuffer<T>& first, AlignedBuffer<T>& second)
+    {
+        using std::swap;
+        swap(first.storage_, second.storage_);
+        swap(first.data_, second.data_);
+        swap(first.size_, second.size_);
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    AlignedBuffer(AlignedBuffer const& other);
+
+
+    // Assignment operator
+    AlignedBuffer& operator=(AlignedBuffer const& other);
+
+    std::unique_ptr<char[]> storage_; // The allocation holding the values
+    T* data_; // The first value, on a cache line boundary
+    std::size_t size_; // The number of values held
+};
+
+
+#endif  /* ALIGNEDBUFFER_HPP */
@@ -0,0 +1,395 @@
+/**
+ * @file        AsyncLog.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the asynchronous log, whose records are formatted into
+ * per-thread buffers and written in large batches by a background thread
+ * (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef ASYNCLOG_HPP
+#define ASYNCLOG_HPP
+
+// C++ headers
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+// My headers
+#include <SpscRing.hpp>
+
+/**
+ * @brief This class is a log file written by a background thread <br>
+ * Each thread logging into it takes its own Producer, and formats its records
+ * straight into the producer's current chunk; full chunks are handed to the
+ * writer thread through a lock-free ring and come back through another once
+ * written, so logging never takes a lock, allocates or flushes per record.
+ * A record never straddles two chunks, so the records of different producers
+ * interleave only whole (class is non-copyable)
+ */
+class AsyncLog {
+public:
+
+    /**
+     * @brief This class is the handle one thread logs through (class is
+     * non-copyable)
+     */
+    class Producer {
+    public:
+
+        /**
+         * @brief       Retrieves room for a record in the current chunk,
+         * handing the chunk to the writer and starting another if it is too
+         * full
+         * @param size  The largest number of bytes the record can take, which
+         * must leave room for the prologue within a chunk
+         * @return      Where to format the record, then committed with commit()
+         */
+        char* reserve(std::size_t const size)
+        {
+            if (!chunk_ || chunk_->size + size > chunkSize_) {
+                nextChunk();
+            }
+
+            return &chunk_->data[chunk_->size];
+        }
+
+
+        /**
+         * @brief       Completes the record formatted at the last reserve()
+         * @param size  The number of bytes the record took
+         * @return      Nothing
+         */
+        void commit(std::size_t const size)
+        {
+            chunk_->size += size;
+        }
+
+
+        /**
+         * @brief       Appends a record
+         * @param data  The record
+         * @param size  The number of bytes in the record
+         * @return      Nothing
+         */
+        void append(void const* data, std::size_t const size)
+        {
+            std::memcpy(reserve(size), data, size);
+            commit(size);
+        }
+
+
+        /**
+         * @brief   Retrieves the largest record a chunk has room for
+         * @return  The number of bytes
+         */
+        std::size_t capacity() const
+        {
+            return chunkSize_ - prologue_.size();
+        }
+
+
+        /**
+         * @brief   Hands the partly filled chunk to the writer and retires the
+         * producer, which mustn't be used afterwards
+         * @return  Nothing
+         */
+        void close()
+        {
+            // Once closed the writer may drain and delete the producer at any
+            // moment, so nothing of it may be touched after the store
+            AsyncLog& log = log_;
+            if (chunk_ && chunk_->size > prologue_.size()) {
+                full_.push(chunk_);
+                chunk_ = 0;
+            }
+            isClosed_.store(true, std::memory_order_release);
+            log.wake();
+        }
+
+    private:
+        friend class AsyncLog;
+
+        /**
+         * @brief A block of formatted records
+         */
+        struct Chunk {
+            std::unique_ptr<char[]> data; // The records
+            std::size_t size; // The number of bytes of records
+        };
+
+
+        Producer(AsyncLog& log, std::size_t const chunkSize,
+                 std::size_t const maximumChunks, std::string const& prologue)
+            : log_(log), chunkSize_(chunkSize), maximumChunks_(maximumChunks),
+            prologue_(prologue), chunk_(0), full_(maximumChunks), free_(maximumChunks),
+            isClosed_(false)
+        {
+        }
+
+
+        // Non-copyable
+        // Copy constructor
+        Producer(Producer const& other);
+
+
+        // Assignment operator
+        Producer& operator=(Producer const& other);
+
+
+        void nextChunk()
+        {
+            // Hand over the current chunk, then reuse a written one, or make
+            // another while under the limit, or wait for the writer
+            if (chunk_) {
+                full_.push(chunk_);
+                log_.wake();
+            }
+
+            if (!free_.tryPop(chunk_)) {
+                if (chunks_.size() < maximumChunks_) {
+                    chunks_.push_back(std::unique_ptr<Chunk>(new Chunk()));
+                    chunk_ = chunks_.back().get();
+                    chunk_->data.reset(new char[chunkSize_]);
+                } else {
+                    chunk_ = free_.pop();
+                }
+            }
+
+            // Every chunk starts with the prologue, so it can be read alone
+            std::memcpy(&chunk_->data[0], prologue_.data(), prologue_.size());
+            chunk_->size = prologue_.size();
+        }
+
+        AsyncLog& log_; // The log being written
+        std::size_t chunkSize_; // The size of each chunk in bytes
+        std::size_t maximumChunks_; // The most chunks the producer may own
+        std::string prologue_; // The record starting every chunk
+        std::vector<std::unique_ptr<Chunk> > chunks_; // Every chunk the producer owns
+        Chunk* chunk_; // The chunk being filled
+        SpscRing<Chunk*> full_; // The chunks waiting to be written
+        SpscRing<Chunk*> free_; // The chunks written, ready for reuse
+        std::atomic<bool> isClosed_; // Whether the producer was retired
+    };
+
+
+    /**
+     * @brief               A constructor for the AsyncLog class, which starts
+     * its writer thread
+     * @param path          The path of the log file, which is truncated
+     * @param header        The bytes to start the file with
+     * @param chunkSize     The size of each producer's chunks in bytes
+     * @param maximumChunks The most chunks each producer may have in flight
+     * before it waits for the writer
+     * @return              A newly constructed AsyncLog object, throws
+     * std::ifstream::failure if the file can't be created
+     */
+    AsyncLog(std::string const& path,
+             std::string const& header = std::string(),
+             std::size_t const chunkSize = 1 << 20,
+             std::size_t const maximumChunks = 8)
+        : path_(path), chunkSize_(chunkSize), maximumChunks_(maximumChunks),
+        isStopping_(false), isFailed_(false), bytesWritten_(0)
+    {
+        try {
+            out_.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            out_.open(path.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+            out_.write(header.data(), header.size());
+            bytesWritten_ = header.size();
+        } catch (std::ofstream::failure const&) {
+            throw std::ifstream::failure("Could not create the log: " + path);
+        }
+
+        writer_ = std::thread(&AsyncLog::write, this);
+    }
+
+
+    /**
+     * @brief   The destructor for the AsyncLog class, which writes whatever the
+     * closed producers left and stops the writer thread
+     * @return  Nothing
+     */
+    ~AsyncLog()
+    {
+        stop();
+    }
+
+
+    /**
+     * @brief          Adds a producer for the calling thread to log through
+     * @param prologue The record to start each of the producer's chunks with
+     * (such as the name of what it logs), so the records stay attributable
+     * once interleaved with other producers'
+     * @return         The producer, owned by the log, which the thread must
+     * close() once it is done
+     */
+    Producer& addProducer(std::string const& prologue = std::string())
+    {
+        std::unique_ptr<Producer> producer(new Producer(*this, chunkSize_, maximumChunks_, prologue));
+        Producer& added = *producer;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        producers_.push_back(std::move(producer));
+
+        return added;
+    }
+
+
+    /**
+     * @brief   Writes everything the producers handed over and closes the file
+     * (every producer must have been closed)
+     * @return  The number of bytes written, throws std::ifstream::failure if
+     * any write failed
+     */
+    unsigned long long close()
+    {
+        stop();
+
+        if (isFailed_) {
+            throw std::ifstream::failure("Could not write the log: " + path_);
+        }
+
+        return bytesWritten_;
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    AsyncLog(AsyncLog const& other);
+
+
+    // Assignment operator
+    AsyncLog& operator=(AsyncLog const& other);
+
+
+    // Utility Functions
+    void wake()
+    {
+        wakeup_.notify_one();
+    }
+
+
+    void stop()
+    {
+        if (writer_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                isStopping_ = true;
+            }
+            wakeup_.notify_one();
+            writer_.join();
+
+            if (out_.is_open()) {
+                try {
+                    out_.close();
+                } catch (std::ofstream::failure const&) {
+                    isFailed_ = true;
+                }
+            }
+        }
+    }
+
+
+    void write()
+    {
+        // The writer thread, draining the producers' full chunks in turn and
+        // dropping the producers once they are closed and drained
+        std::vector<Producer*> producers;
+        for (;;) {
+            bool isStopping;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                isStopping = isStopping_;
+                producers.clear();
+                for (std::size_t i = 0; i < producers_.size(); ++i) {
+                    producers.push_back(producers_[i].get());
+                }
+            }
+
+            bool isIdle = true;
+            std::vector<Producer*> drained;
+            for (std::size_t i = 0; i < producers.size(); ++i) {
+                Producer& producer = *producers[i];
+                bool const isClosed = producer.isClosed_.load(std::memory_order_acquire);
+
+                Producer::Chunk* chunk;
+                while (producer.full_.tryPop(chunk)) {
+                    writeChunk(*chunk);
+                    producer.free_.push(chunk);
+                    isIdle = false;
+                }
+                if (isClosed) {
+                    drained.push_back(&producer);
+                }
+            }
+
+            if (!drained.empty()) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (std::size_t i = 0; i < drained.size(); ++i) {
+                    for (std::size_t j = 0; j < producers_.size(); ++j) {
+                        if (producers_[j].get() == drained[i]) {
+                            producers_.erase(producers_.begin() + j);
+                            break;
+                        }
+                    }
+                }
+            }
+
+            if (isStopping) {
+                break;
+            }
+            if (isIdle) {
+                // A producer wakes the writer as it hands over a chunk, so the
+                // timeout is only a backstop
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (!isStopping_) {
+                    wakeup_.wait_for(lock, std::chrono::milliseconds(50));
+                }
+            }
+        }
+    }
+
+
+    void writeChunk(Producer::Chunk const& chunk)
+    {
+        if (isFailed_) {
+            return;
+        }
+
+        try {
+            out_.write(&chunk.data[0], chunk.size);
+            bytesWritten_ += chunk.size;
+        } catch (std::ofstream::failure const&) {
+            isFailed_ = true;
+        }
+    }
+
+    std::string path_; // The path of the log file
+    std::size_t chunkSize_; // The size of each producer's chunks in bytes
+    std::size_t maximumChunks_; // The most chunks each producer may own
+    std::ofstream out_; // The log file, written only by the writer thread
+    std::mutex mutex_; // Guards the producers and the stop flag
+    std::condition_variable wakeup_; // Wakes the writer when there is work
+    std::vector<std::unique_ptr<Producer> > producers_; // The producers not yet drained
+    bool isStopping_; // Whether the writer should drain and finish
+    bool isFailed_; // Whether a write failed
+    unsigned long long bytesWritten_; // The number of bytes written so far
+    std::thread writer_; // The writer thread
+};
+
+
+#endif  /* ASYNCLOG_HPP */
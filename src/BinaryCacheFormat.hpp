@@ -0,0 +1,67 @@
+/**
+ * @file        BinaryCacheFormat.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the layout of the binary '.lolc' cache written next to
+ * a cluster log
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef BINARYCACHEFORMAT_HPP
+#define BINARYCACHEFORMAT_HPP
+
+// C++ headers
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief The header at the start of a '.lolc' cache file <br>
+ * The cache holds, in native byte order: <br>
+ * (1) this header <br>
+ * (2) one record per frame: the frame's number of pixels and of clusters
+ * (uint32 each), its packed hits (uint32 each, the pixel index in the low
+ * indexBits bits and the ToT above) and its cluster offsets (uint32, one more
+ * than the number of clusters), padded to 8 bytes <br>
+ * (3) the frame index at indexOffset: the times and running times (double),
+ * the byte offsets of the frame headers in the cluster log (uint64) and the
+ * byte offsets of the records (uint64, one more than the number of frames)
+ */
+struct CacheHeader {
+    char magic[4]; // Always "LOLC"
+    std::uint32_t byteOrder; // Always CACHE_BYTE_ORDER, written in native order
+    std::uint32_t version; // The version of the layout, CACHE_VERSION
+    std::uint32_t indexBits; // The bits of a hit holding its pixel index
+    std::uint64_t sourceSize; // The size of the cluster log the cache was built from
+    std::int64_t sourceModified; // The modification time of the cluster log
+    std::uint64_t numberOfLines; // The number of lines in the cluster log
+    std::uint64_t numberOfFrames; // The number of frames in the cluster log
+    std::uint64_t numberOfClusters; // The total number of clusters
+    std::uint64_t numberOfPixels; // The total number of pixels
+    std::uint64_t indexOffset; // The byte offset of the frame index
+};
+
+// The byte order marker, which reads differently on a foreign-endian machine
+static const std::uint32_t CACHE_BYTE_ORDER = 0x01020304u;
+// The current version of the cache layout
+static const std::uint32_t CACHE_VERSION = 2;
+// The suffix appended to the cluster log's path to name its cache
+static const char CACHE_SUFFIX[] = ".lolc";
+
+
+/**
+ * @brief           Retrieves the path of the cache for a cluster log
+ * @param sourcePath The path of the cluster log
+ * @return          The path of its cache
+ */
+inline std::string const cachePath(std::string const& sourcePath)
+{
+    return sourcePath + CACHE_SUFFIX;
+}
+
+
+#endif  /* BINARYCACHEFORMAT_HPP */
@@ -0,0 +1,299 @@
+/**
+ * @file        BinaryCacheReader.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the class reading frames back out of a memory mapped
+ * binary '.lolc' cache (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef BINARYCACHEREADER_HPP
+#define BINARYCACHEREADER_HPP
+
+// C++ headers
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/exceptions.hpp>
+// My headers
+#include <Frame.hpp>
+#include <MappedFile.hpp>
+#include <BinaryCacheFormat.hpp>
+#include <PixelMask.hpp>
+
+/**
+ * @brief This class maps a '.lolc' cache and rebuilds frames straight from its
+ * packed hits, without any text parsing (class is non-copyable)
+ */
+template <class T, class Geometry = TimepixGeometry>
+class BinaryCacheReader {
+public:
+
+    /**
+     * @brief   An empty constructor for the BinaryCacheReader class
+     * @return  A newly constructed BinaryCacheReader object with no cache open
+     */
+    BinaryCacheReader()
+        : header_(0), times_(0), runningTimes_(0), textOffsets_(0), recordOffsets_(0)
+    {
+    }
+
+
+    /**
+     * @brief                Opens the cache of a cluster log if there is one
+     * and it is still fresh
+     * @param sourcePath     The path of the cluster log
+     * @param sourceSize     The current size of the cluster log in bytes
+     * @param sourceModified The current modification time of the cluster log
+     * @return               Whether a fresh cache was opened
+     */
+    bool open(std::string const& sourcePath,
+              unsigned long long const sourceSize,
+              long long const sourceModified)
+    {
+        close();
+
+        std::string const path = cachePath(sourcePath);
+        boost::system::error_code error;
+        if (!boost::filesystem::is_regular_file(path, error)
+                || boost::filesystem::file_size(path, error) < sizeof(CacheHeader)) {
+            return false;
+        }
+
+        try {
+            file_.open(path);
+        } catch (boost::interprocess::interprocess_exception const&) {
+            return false;
+        }
+
+        header_ = reinterpret_cast<CacheHeader const*>(file_.begin());
+        if (std::memcmp(header_->magic, "LOLC", 4) != 0
+                || header_->byteOrder != CACHE_BYTE_ORDER
+                || header_->version != CACHE_VERSION
+                || header_->indexBits != Geometry::INDEX_BITS
+                || header_->sourceSize != sourceSize
+                || header_->sourceModified != sourceModified
+                || !hasIndex()) {
+            close();
+            return false;
+        }
+
+        std::uint64_t const frames = header_->numberOfFrames;
+        char const* index = file_.begin() + header_->indexOffset;
+        times_ = reinterpret_cast<double const*>(index);
+        runningTimes_ = times_ + frames;
+        textOffsets_ = reinterpret_cast<std::uint64_t const*>(runningTimes_ + frames);
+        recordOffsets_ = textOffsets_ + frames;
+        if (!hasValidRecords()) {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /**
+     * @brief   Closes the cache
+     * @return  Nothing
+     */
+    void close()
+    {
+        file_.close();
+        header_ = 0;
+        times_ = runningTimes_ = 0;
+        textOffsets_ = recordOffsets_ = 0;
+    }
+
+
+    /**
+     * @brief   Checks whether a cache is open
+     * @return  Whether a cache is open
+     */
+    bool isOpen() const
+    {
+        return header_ != 0;
+    }
+
+
+    /**
+     * @brief   A getter for the number of frames in the cache
+     * @return  The number of frames
+     */
+    unsigned long long numberOfFrames() const
+    {
+        assert(isOpen());
+
+        return header_->numberOfFrames;
+    }
+
+
+    /**
+     * @brief   A getter for the number of lines in the cached cluster log
+     * @return  The number of lines
+     */
+    unsigned long long numberOfLines() const
+    {
+        assert(isOpen());
+
+        return header_->numberOfLines;
+    }
+
+
+    /**
+     * @brief       A getter for a frame's time, without decoding the frame
+     * @param index The position of the frame, counted from 0
+     * @return      The frame's time in seconds
+     */
+    double time(unsigned long long const index) const
+    {
+        assert(index < numberOfFrames());
+
+        return times_[index];
+    }
+
+
+    /**
+     * @brief       A getter for the byte offset of a frame's header in the
+     * cached cluster log
+     * @param index The position of the frame, counted from 0
+     * @return      The byte offset of the frame's header
+     */
+    unsigned long long textOffset(unsigned long long const index) const
+    {
+        assert(index < numberOfFrames());
+
+        return textOffsets_[index];
+    }
+
+
+    /**
+     * @brief       Rebuilds a frame from the cache
+     * @param index The position of the frame, counted from 0
+     * @param frame The frame to fill, which is cleared first
+     * @param mask  The mask of pixels whose hits are dropped, or null to keep
+     * every hit
+     * @return      Nothing
+     */
+    void readFrame(unsigned long long const index, Frame<T, Geometry>& frame,
+                   PixelMask<Geometry> const* mask = 0) const
+    {
+        assert(index < numberOfFrames());
+
+        std::uint32_t const* counts = reinterpret_cast<std::uint32_t const*>(
+                file_.begin() + recordOffsets_[index]);
+        std::uint32_t const pixels = counts[0];
+        std::uint32_t const clusters = counts[1];
+
+        std::uint32_t const* hits = counts + 2;
+        std::uint32_t const* offsets = hits + pixels;
+
+        frame.clear();
+        frame.setTime(times_[index]);
+        frame.setRunningTime(runningTimes_[index]);
+
+        frame.reserve(pixels);
+        if (mask && mask->numberOfMasked()) {
+            // The cache mirrors the text, so the mask is applied as the hits
+            // are copied out, a bounded block at a time
+            std::uint32_t held[MASK_BLOCK_HITS];
+            for (std::uint32_t cluster = 0; cluster < clusters; ++cluster) {
+                frame.beginCluster();
+                for (std::uint32_t i = offsets[cluster]; i < offsets[cluster + 1]; i += MASK_BLOCK_HITS) {
+                    std::uint32_t const left = offsets[cluster + 1] - i;
+                    std::uint32_t const count = left < MASK_BLOCK_HITS ? left : MASK_BLOCK_HITS;
+                    std::memcpy(held, hits + i, count * sizeof(std::uint32_t));
+                    frame.addHits(held, mask->filter(held, count));
+                }
+            }
+            frame.dropEmptyCluster();
+            return;
+        }
+
+        for (std::uint32_t cluster = 0; cluster < clusters; ++cluster) {
+            frame.beginCluster();
+            for (std::uint32_t i = offsets[cluster]; i < offsets[cluster + 1]; ++i) {
+                frame.addHit(hits[i]);
+            }
+        }
+    }
+
+private:
+
+    // The most hits tested against a mask at once
+    static const std::uint32_t MASK_BLOCK_HITS = 64;
+
+
+    // Non-copyable
+    // Copy constructor
+    BinaryCacheReader(BinaryCacheReader const& other);
+
+
+    // Assignment operator
+    BinaryCacheReader& operator=(BinaryCacheReader const& other);
+
+
+    bool hasIndex() const
+    {
+        // Checks that the frame index lies within the file
+
+        std::uint64_t const indexSize = header_->numberOfFrames * (3 * 8) + (header_->numberOfFrames + 1) * 8;
+
+        return header_->indexOffset >= sizeof(CacheHeader)
+            && header_->indexOffset % 8 == 0
+            && header_->indexOffset + indexSize == file_.size();
+    }
+
+
+    bool hasValidRecords() const
+    {
+        // Checks that every frame's record lies within the records, and that
+        // its cluster offsets climb through its hits, so a damaged cache whose
+        // size and time still match is never read out of bounds
+
+        std::uint64_t const end = header_->indexOffset;
+        for (std::uint64_t i = 0; i < header_->numberOfFrames; ++i) {
+            std::uint64_t const record = recordOffsets_[i];
+            if (record < sizeof(CacheHeader) || record % 4 != 0 || record > end || end - record < 8) {
+                return false;
+            }
+
+            std::uint32_t const* counts = reinterpret_cast<std::uint32_t const*>(file_.begin() + record);
+            std::uint64_t const pixels = counts[0];
+            std::uint64_t const clusters = counts[1];
+            if (8 + 4 * (pixels + clusters + 1) > end - record) {
+                return false;
+            }
+
+            std::uint32_t const* offsets = counts + 2 + pixels;
+            for (std::uint64_t cluster = 0; cluster < clusters; ++cluster) {
+                if (offsets[cluster] > offsets[cluster + 1]) {
+                    return false;
+                }
+            }
+            if (offsets[clusters] != pixels) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+
+    MappedFile file_; // The mapped cache
+    CacheHeader const* header_; // The cache's header
+    double const* times_; // The index of frame times
+    double const* runningTimes_; // The index of frame running times
+    std::uint64_t const* textOffsets_; // The index of frame header offsets
+    std::uint64_t const* recordOffsets_; // The index of record offsets
+};
+
+
+#endif  /* BINARYCACHEREADER_HPP */
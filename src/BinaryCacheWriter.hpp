@@ -0,0 +1,194 @@
+/**
+ * @file        BinaryCacheWriter.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the class writing a binary '.lolc' cache of a cluster
+ * log one frame at a time (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef BINARYCACHEWRITER_HPP
+#define BINARYCACHEWRITER_HPP
+
+// C++ headers
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <boost/filesystem.hpp>
+// My headers
+#include <Frame.hpp>
+#include <BinaryCacheFormat.hpp>
+
+/**
+ * @brief This class streams frames into a '.lolc' cache file, keeping only
+ * the small frame index in memory, and moves the file into place once it is
+ * complete so a half written cache is never picked up (class is non-copyable)
+ */
+template <class T, class Geometry = TimepixGeometry>
+class BinaryCacheWriter {
+public:
+
+    /**
+     * @brief                A constructor for the BinaryCacheWriter class
+     * @param sourcePath     The path of the cluster log being cached
+     * @param sourceSize     The size of the cluster log in bytes
+     * @param sourceModified The modification time of the cluster log
+     * @return               A newly constructed BinaryCacheWriter object,
+     * throws std::ifstream::failure if the cache can't be created
+     */
+    BinaryCacheWriter(std::string const& sourcePath,
+                      unsigned long long const sourceSize,
+                      long long const sourceModified)
+        : path_(cachePath(sourcePath)), temporaryPath_(cachePath(sourcePath) + ".tmp"),
+        buffer_(1 << 20), offset_(0)
+    {
+        std::memset(&header_, 0, sizeof(header_));
+        std::memcpy(header_.magic, "LOLC", 4);
+        header_.byteOrder = CACHE_BYTE_ORDER;
+        header_.version = CACHE_VERSION;
+        header_.indexBits = Geometry::INDEX_BITS;
+        header_.sourceSize = sourceSize;
+        header_.sourceModified = sourceModified;
+
+        out_.rdbuf()->pubsetbuf(&buffer_[0], buffer_.size());
+        out_.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+        out_.open(temporaryPath_.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+
+        // The header is rewritten once the totals are known
+        write(&header_, sizeof(header_));
+    }
+
+
+    /**
+     * @brief   The destructor for the BinaryCacheWriter class, which throws
+     * away an unfinished cache
+     * @return  Nothing
+     */
+    ~BinaryCacheWriter()
+    {
+        if (out_.is_open()) {
+            out_.exceptions(std::ofstream::goodbit);
+            out_.close();
+            boost::system::error_code error;
+            boost::filesystem::remove(temporaryPath_, error);
+        }
+    }
+
+
+    /**
+     * @brief            Appends a frame to the cache
+     * @param frame      The frame
+     * @param textOffset The byte offset of the frame's header in the cluster log
+     * @return           Nothing
+     */
+    void writeFrame(Frame<T, Geometry> const& frame, unsigned long long const textOffset)
+    {
+        times_.push_back(frame.getTime());
+        runningTimes_.push_back(frame.getRunningTime());
+        textOffsets_.push_back(textOffset);
+        recordOffsets_.push_back(offset_);
+
+        std::uint32_t const counts[2] = {
+            static_cast<std::uint32_t>(frame.size()),
+            static_cast<std::uint32_t>(frame.numberOfClusters())
+        };
+        write(counts, sizeof(counts));
+        Span<std::uint32_t const> const hits = frame.hits();
+        if (!hits.empty()) {
+            write(hits.begin(), hits.size() * sizeof(std::uint32_t));
+        }
+
+        Span<unsigned int const> offsets = frame.clusterOffsets();
+        clusterOffsets_.assign(offsets.begin(), offsets.end());
+        writeArray(clusterOffsets_);
+        pad();
+
+        header_.numberOfFrames++;
+        header_.numberOfClusters += frame.numberOfClusters();
+        header_.numberOfPixels += frame.size();
+    }
+
+
+    /**
+     * @brief               Writes the frame index and header and moves the
+     * cache into place
+     * @param numberOfLines The number of lines in the cluster log
+     * @return              Nothing
+     */
+    void finish(unsigned long long const numberOfLines)
+    {
+        recordOffsets_.push_back(offset_);
+
+        header_.numberOfLines = numberOfLines;
+        header_.indexOffset = offset_;
+        writeArray(times_);
+        writeArray(runningTimes_);
+        writeArray(textOffsets_);
+        writeArray(recordOffsets_);
+
+        out_.seekp(0);
+        out_.write(reinterpret_cast<char const*>(&header_), sizeof(header_));
+        out_.close();
+
+        boost::filesystem::rename(temporaryPath_, path_);
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    BinaryCacheWriter(BinaryCacheWriter const& other);
+
+
+    // Assignment operator
+    BinaryCacheWriter& operator=(BinaryCacheWriter const& other);
+
+
+    void write(void const* data, std::size_t const size)
+    {
+        out_.write(static_cast<char const*>(data), size);
+        offset_ += size;
+    }
+
+
+    void pad()
+    {
+        // Keeps every record 8 byte aligned
+
+        static char const zeros[8] = { 0 };
+        if (offset_ % 8) {
+            write(zeros, 8 - offset_ % 8);
+        }
+    }
+
+
+    template <class U>
+    void writeArray(std::vector<U> const& values)
+    {
+        if (!values.empty()) {
+            write(&values[0], values.size() * sizeof(U));
+        }
+    }
+
+    std::string path_; // The path of the finished cache
+    std::string temporaryPath_; // The path the cache is written to
+    std::vector<char> buffer_; // The output buffer
+    std::ofstream out_; // The cache being written
+    CacheHeader header_; // The header, completed as frames are written
+    unsigned long long offset_; // The number of bytes written so far
+    std::vector<std::uint32_t> clusterOffsets_; // The staging area for cluster offsets
+    std::vector<double> times_; // The index of frame times
+    std::vector<double> runningTimes_; // The index of frame running times
+    std::vector<std::uint64_t> textOffsets_; // The index of frame header offsets
+    std::vector<std::uint64_t> recordOffsets_; // The index of record offsets
+};
+
+
+#endif  /* BINARYCACHEWRITER_HPP */
@@ -0,0 +1,200 @@
+/**
+ * @file        ByteScanner.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines vectorized byte scanning routines for gathering the
+ * line and frame counts of a cluster log without parsing it
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef BYTESCANNER_HPP
+#define BYTESCANNER_HPP
+
+// C++ headers
+#include <cstring>
+#include <cstdint>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief The result of scanning a cluster log's bytes
+ */
+struct ScanResult {
+    unsigned long long lines; // The number of lines (as a getline loop would count them)
+    unsigned long long frames; // The number of lines starting with a "Frame " header
+};
+
+
+/**
+ * @brief This class scans raw cluster log bytes for newlines and frame headers
+ * a whole vector register at a time, falling back to memchr where no vector
+ * instruction set is available
+ */
+class ByteScanner {
+public:
+
+    /**
+     * @brief       Counts the lines and frame headers in a range of bytes
+     * @param begin The first byte of the range
+     * @param end   One past the last byte of the range
+     * @return      The line and frame counts of the range
+     */
+    static ScanResult scan(char const* begin, char const* end)
+    {
+        return scan(begin, end, IgnoreHeader());
+    }
+
+
+    /**
+     * @brief          Counts the lines and frame headers in a range of bytes,
+     * handing the position of every frame header to a callback
+     * @param begin    The first byte of the range
+     * @param end      One past the last byte of the range
+     * @param onHeader A callable taking (char const* header), called in order
+     * @return         The line and frame counts of the range
+     */
+    template <class Callback>
+    static ScanResult scan(char const* begin, char const* end, Callback onHeader)
+    {
+        ScanResult result = { 0, 0 };
+        if (begin >= end) {
+            return result;
+        }
+
+        // A frame header can only start the range or directly follow a newline
+        bool atLineStart = true;
+        char const* pos = begin;
+
+#if defined(__AVX2__)
+        __m256i const newlines = _mm256_set1_epi8('\n');
+        __m256i const headers = _mm256_set1_epi8('F');
+        for (; end - pos >= 32; pos += 32) {
+            __m256i const block = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(pos));
+            std::uint32_t newlineMask = static_cast<std::uint32_t>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newlines)));
+            std::uint32_t headerMask = static_cast<std::uint32_t>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, headers)));
+
+            accumulate(result, pos, end, newlineMask, headerMask, 32, atLineStart, onHeader);
+        }
+#elif defined(__SSE2__)
+        __m128i const newlines = _mm_set1_epi8('\n');
+        __m128i const headers = _mm_set1_epi8('F');
+        for (; end - pos >= 16; pos += 16) {
+            __m128i const block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pos));
+            std::uint32_t newlineMask = static_cast<std::uint32_t>(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(block, newlines)));
+            std::uint32_t headerMask = static_cast<std::uint32_t>(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(block, headers)));
+
+            accumulate(result, pos, end, newlineMask, headerMask, 16, atLineStart, onHeader);
+        }
+#endif
+
+        // Scalar tail (or the whole range without a vector instruction set)
+        while (pos < end) {
+            if (atLineStart && isHeader(pos, end)) {
+                result.frames++;
+                onHeader(pos);
+            }
+
+            char const* newline = static_cast<char const*>(std::memchr(pos, '\n', end - pos));
+            if (!newline) {
+                atLineStart = false;
+                break;
+            }
+            result.lines++;
+            atLineStart = true;
+            pos = newline + 1;
+        }
+
+        // A final line without a trailing newline still counts as a line
+        if (*(end - 1) != '\n') {
+            result.lines++;
+        }
+
+        return result;
+    }
+
+private:
+
+    struct IgnoreHeader {
+        void operator()(char const*) const {}
+    };
+
+
+    static bool isHeader(char const* pos, char const* end)
+    {
+        // Checks whether a "Frame " header starts at pos
+
+        return end - pos >= 6 && std::memcmp(pos, "Frame ", 6) == 0;
+    }
+
+
+    template <class Callback>
+    static void accumulate(ScanResult& result,
+                           char const* block,
+                           char const* end,
+                           std::uint32_t const newlineMask,
+                           std::uint32_t const headerMask,
+                           unsigned int const width,
+                           bool& atLineStart,
+                           Callback& onHeader)
+    {
+        // Folds the comparison masks of one block into the counts
+        // Candidate headers are 'F's at the start of a line; only those are
+        // verified byte by byte
+
+        result.lines += popcount(newlineMask);
+
+        std::uint32_t lineStarts = (newlineMask << 1) | (atLineStart ? 1u : 0u);
+        std::uint32_t candidates = headerMask & lineStarts;
+        while (candidates) {
+            unsigned int const bit = countTrailingZeros(candidates);
+            if (isHeader(block + bit, end)) {
+                result.frames++;
+                onHeader(block + bit);
+            }
+            candidates &= candidates - 1;
+        }
+
+        atLineStart = (newlineMask >> (width - 1)) & 1u;
+    }
+
+
+    static unsigned int popcount(std::uint32_t const value)
+    {
+#if defined(__GNUC__)
+        return static_cast<unsigned int>(__builtin_popcount(value));
+#else
+        std::uint32_t v = value - ((value >> 1) & 0x55555555u);
+        v = (v & 0x33333333u) + ((v >> 2) & 0x33333333u);
+        return static_cast<unsigned int>((((v + (v >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+#endif
+    }
+
+
+    static unsigned int countTrailingZeros(std::uint32_t const value)
+    {
+#if defined(__GNUC__)
+        return static_cast<unsigned int>(__builtin_ctz(value));
+#else
+        unsigned int bit = 0;
+        while (!((value >> bit) & 1u)) {
+            bit++;
+        }
+        return bit;
+#endif
+    }
+};
+
+
+#endif  /* BYTESCANNER_HPP */
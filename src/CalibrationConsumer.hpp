@@ -0,0 +1,281 @@
+/**
+ * @file        CalibrationConsumer.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the consumer building the per-pixel ToT histograms a
+ * detector is calibrated from (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef CALIBRATIONCONSUMER_HPP
+#define CALIBRATIONCONSUMER_HPP
+
+// C++ headers
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <string>
+#include <cstdint>
+// My headers
+#include <DetectorGeometry.hpp>
+#include <Frame.hpp>
+#include <FrameConsumer.hpp>
+#include <ToTHistogram.hpp>
+
+/**
+ * @brief This class histograms the ToT of every hit of every frame per pixel
+ * <br>
+ * The packed hits of the frames are copied into large batches which a pool of
+ * workers bin into their own private histograms, so the histogramming keeps
+ * up with a parser running on every core; the private histograms are merged
+ * once the dataset is finished, and the result is saved as the dataset's
+ * '.lolh' summary (class is non-copyable)
+ */
+template <class T>
+class CalibrationConsumer : public FrameConsumer<T> {
+public:
+
+    /**
+     * @brief          A constructor for the CalibrationConsumer class
+     * @param threads  The number of threads to histogram with (each keeps a
+     * histogram of its own, so at most MAXIMUM_WORKERS are started)
+     * @param bins     The number of bins per pixel
+     * @param binWidth The ToT range covered by each bin
+     * @param save     Whether to save the histograms next to the dataset once
+     * it is finished
+     * @return         A newly constructed CalibrationConsumer object
+     */
+    CalibrationConsumer(unsigned int const threads,
+                        unsigned int const bins = 128,
+                        unsigned int const binWidth = 2,
+                        bool const save = true)
+        : histogram_(bins, binWidth), current_(0), workerCount_(threads < MAXIMUM_WORKERS ? threads : MAXIMUM_WORKERS),
+        frames_(0), isStopping_(false), save_(save)
+    {
+        if (workerCount_ > 1) {
+            // Two batches per worker, so one can fill while the other is binned
+            batches_.resize(workerCount_ * 2 + 1);
+            for (std::size_t i = 0; i < batches_.size(); ++i) {
+                batches_[i].reserve(BATCH_SIZE);
+            }
+            for (std::size_t i = 1; i < batches_.size(); ++i) {
+                free_.push_back(i);
+            }
+            full_.reserve(batches_.size());
+        }
+    }
+
+
+    /**
+     * @brief   The destructor for the CalibrationConsumer class, which stops
+     * any workers still running
+     * @return  Nothing
+     */
+    virtual ~CalibrationConsumer()
+    {
+        stop();
+    }
+
+
+    /**
+     * @brief             Histograms the hits of a frame
+     * @param frame       The frame
+     * @param frameNumber The number of the frame
+     * @return            Nothing
+     */
+    virtual void consume(Frame<T> const& frame, unsigned int const frameNumber)
+    {
+        frames_++;
+
+        // The frame's hits are already packed words on the matrix, so they
+        // are binned or batched as they stand
+        Span<std::uint32_t const> const hits = frame.hits();
+
+        if (workerCount_ <= 1) {
+            for (std::size_t i = 0; i < hits.size(); ++i) {
+                histogram_.fill(TimepixGeometry::indexOf(hits[i]), TimepixGeometry::totOf(hits[i]));
+            }
+            return;
+        }
+
+        std::size_t copied = 0;
+        while (copied < hits.size()) {
+            std::vector<std::uint32_t>& batch = batches_[current_];
+            std::size_t const room = BATCH_SIZE - batch.size();
+            std::size_t const count = hits.size() - copied < room ? hits.size() - copied : room;
+            batch.insert(batch.end(), hits.begin() + copied, hits.begin() + copied + count);
+            copied += count;
+            if (batch.size() == BATCH_SIZE) {
+                submit();
+            }
+        }
+    }
+
+
+    /**
+     * @brief         Merges the workers' histograms and saves the result
+     * @param summary The details of the whole dataset
+     * @return        Nothing, throws std::ifstream::failure if the summary
+     * can't be written
+     */
+    virtual void finish(DatasetSummary const& summary)
+    {
+        if (workers_.empty()) {
+            // Too few hits to have started the workers
+            if (!batches_.empty()) {
+                bin(batches_[current_], histogram_);
+            }
+        } else {
+            if (!batches_[current_].empty()) {
+                submit();
+            }
+            stop();
+
+            for (std::size_t i = 0; i < histograms_.size(); ++i) {
+                histogram_.merge(*histograms_[i]);
+            }
+            histograms_.clear();
+        }
+
+        histogram_.addFrames(frames_);
+        frames_ = 0;
+
+        if (save_) {
+            histogram_.save(histogramPath(summary.path), summary.size, summary.modified);
+        }
+    }
+
+
+    /**
+     * @brief   A getter for the histograms, complete once the dataset has been
+     * finished
+     * @return  The per-pixel ToT histograms
+     */
+    ToTHistogram const& histogram() const
+    {
+        return histogram_;
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    CalibrationConsumer(CalibrationConsumer const& other);
+
+
+    // Assignment operator
+    CalibrationConsumer& operator=(CalibrationConsumer const& other);
+
+
+    // The number of hits handed to a worker at once
+    static const std::size_t BATCH_SIZE = 1 << 16;
+    // The most workers started, as each one keeps a whole set of histograms
+    static const unsigned int MAXIMUM_WORKERS = 8;
+
+
+    // Utility Functions
+    static void bin(std::vector<std::uint32_t>& batch, ToTHistogram& histogram)
+    {
+        std::uint32_t const* hits = batch.data();
+        std::size_t const size = batch.size();
+        for (std::size_t i = 0; i < size; ++i) {
+            histogram.fill(TimepixGeometry::indexOf(hits[i]), TimepixGeometry::totOf(hits[i]));
+        }
+        batch.clear();
+    }
+
+
+    void submit()
+    {
+        // Queues the current batch for the workers and takes a free one to
+        // carry on filling, waiting for the workers to free one if need be
+        // The workers are only started by the first full batch, so small
+        // datasets never pay for their histograms
+
+        if (workers_.empty()) {
+            histograms_.resize(workerCount_);
+            for (unsigned int i = 0; i < workerCount_; ++i) {
+                workers_.push_back(std::thread(&CalibrationConsumer<T>::work, this, i));
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        full_.push_back(current_);
+        work_.notify_one();
+
+        while (free_.empty()) {
+            freed_.wait(lock);
+        }
+        current_ = free_.back();
+        free_.pop_back();
+    }
+
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            isStopping_ = true;
+            work_.notify_all();
+        }
+
+        for (std::size_t i = 0; i < workers_.size(); ++i) {
+            workers_[i].join();
+        }
+        workers_.clear();
+    }
+
+
+    void work(unsigned int const worker)
+    {
+        // Each worker allocates (and so first touches) its own histograms
+        histograms_[worker].reset(new ToTHistogram(histogram_.bins(), histogram_.binWidth()));
+        ToTHistogram& histogram = *histograms_[worker];
+
+        for (;;) {
+            std::size_t index = 0;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while (full_.empty() && !isStopping_) {
+                    work_.wait(lock);
+                }
+                if (full_.empty()) {
+                    return;
+                }
+                index = full_.back();
+                full_.pop_back();
+            }
+
+            bin(batches_[index], histogram);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            free_.push_back(index);
+            freed_.notify_one();
+        }
+    }
+
+    ToTHistogram histogram_; // The histograms of the whole dataset
+    std::vector<std::unique_ptr<ToTHistogram> > histograms_; // Each worker's private histograms
+    std::vector<std::vector<std::uint32_t> > batches_; // The batches of packed hits
+    std::vector<std::size_t> free_; // The batches free to be filled
+    std::vector<std::size_t> full_; // The batches waiting to be binned
+    std::size_t current_; // The batch being filled
+    unsigned int workerCount_; // The number of workers to bin with
+    std::vector<std::thread> workers_; // The workers binning the batches
+    std::mutex mutex_; // Guards the batch queues and the stop flag
+    std::condition_variable work_; // Signalled when a batch is queued or on stop
+    std::condition_variable freed_; // Signalled when a batch is freed
+    unsigned long long frames_; // The number of frames consumed
+    bool isStopping_; // Whether the workers should exit once the queue is empty
+    bool save_; // Whether to save the histograms once the dataset is finished
+};
+
+
+#endif  /* CALIBRATIONCONSUMER_HPP */
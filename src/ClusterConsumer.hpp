@@ -0,0 +1,122 @@
+/**
+ * @file        ClusterConsumer.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the consumer measuring and classifying every cluster of
+ * a dataset
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef CLUSTERCONSUMER_HPP
+#define CLUSTERCONSUMER_HPP
+
+// C++ headers
+#include <string>
+#include <sstream>
+// My headers
+#include <FrameConsumer.hpp>
+#include <ClusterEngine.hpp>
+
+/**
+ * @brief This class measures the clusters of every frame with a ClusterEngine
+ * and tallies them by the kind of particle they look like
+ */
+template <class T>
+class ClusterConsumer : public FrameConsumer<T> {
+public:
+
+    /**
+     * @brief         A constructor for the ClusterConsumer class
+     * @param relabel Whether to regroup the pixels into 8-connected clusters
+     * rather than take the clusters as the file groups them
+     * @return        A newly constructed ClusterConsumer object
+     */
+    explicit ClusterConsumer(bool const relabel = false)
+        : relabel_(relabel), clusters_(0), pixels_(0), largest_(0)
+    {
+        for (unsigned int i = 0; i < CLUSTER_TYPES; ++i) {
+            types_[i] = 0;
+        }
+    }
+
+
+    /**
+     * @brief             Measures and classifies the clusters of a frame
+     * @param frame       The frame
+     * @param frameNumber The number of the frame
+     * @return            Nothing
+     */
+    virtual void consume(Frame<T> const& frame, unsigned int const frameNumber)
+    {
+        Span<ClusterFeatures const> const features = relabel_ ? engine_.label(frame) : engine_.measure(frame);
+
+        for (std::size_t i = 0; i < features.size(); ++i) {
+            if (features[i].size == 0) {
+                continue;
+            }
+            types_[ClusterEngine<T>::classify(features[i])]++;
+            pixels_ += features[i].size;
+            if (features[i].size > largest_) {
+                largest_ = features[i].size;
+            }
+            clusters_++;
+        }
+    }
+
+
+    /**
+     * @brief   A getter for the number of clusters measured
+     * @return  The number of clusters
+     */
+    unsigned long long numberOfClusters() const
+    {
+        return clusters_;
+    }
+
+
+    /**
+     * @brief      A getter for the number of clusters of a kind
+     * @param type The kind of cluster
+     * @return     The number of clusters of that kind
+     */
+    unsigned long long numberOfClusters(ClusterType const type) const
+    {
+        return types_[type];
+    }
+
+
+    /**
+     * @brief   Summarises the clusters measured
+     * @return  The number of clusters of each kind, their mean size and the
+     * size of the largest
+     */
+    std::string const report() const
+    {
+        std::ostringstream report;
+        report << clusters_ << " clusters";
+        for (unsigned int i = 0; i < CLUSTER_TYPES; ++i) {
+            report << (i ? ", " : " (") << types_[i] << " "
+                   << ClusterEngine<T>::typeName(static_cast<ClusterType>(i));
+        }
+        report << "), mean size " << (clusters_ ? static_cast<double>(pixels_) / clusters_ : 0.0)
+               << ", largest " << largest_;
+
+        return report.str();
+    }
+
+private:
+    ClusterEngine<T> engine_; // The engine measuring the clusters
+    bool relabel_; // Whether the clusters are rebuilt by labelling
+    unsigned long long types_[CLUSTER_TYPES]; // The number of clusters of each kind
+    unsigned long long clusters_; // The number of clusters measured
+    unsigned long long pixels_; // The number of pixels in those clusters
+    unsigned int largest_; // The size of the largest cluster
+};
+
+
+#endif  /* CLUSTERCONSUMER_HPP */
@@ -0,0 +1,367 @@
+/**
+ * @file        ClusterEngine.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the engine grouping a frame's pixels into clusters and
+ * measuring each cluster's features (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef CLUSTERENGINE_HPP
+#define CLUSTERENGINE_HPP
+
+// C++ headers
+#include <vector>
+#include <cstdint>
+#include <cmath>
+// My headers
+#include <Frame.hpp>
+#include <Span.hpp>
+#include <AlignedBuffer.hpp>
+#include <DetectorGeometry.hpp>
+
+/**
+ * @brief The kinds of particle a cluster's shape points to
+ */
+enum ClusterType {
+    CLUSTER_DOT = 0, // One or two pixels (low energy photons and electrons)
+    CLUSTER_SMALL_BLOB = 1, // A few pixels, roughly round
+    CLUSTER_HEAVY_BLOB = 2, // A large, filled, round cluster (alpha particles)
+    CLUSTER_STRAIGHT_TRACK = 3, // A long, thin, faint cluster (minimum ionising particles)
+    CLUSTER_HEAVY_TRACK = 4, // A long, thin, bright cluster (protons and ions)
+    CLUSTER_CURLY_TRACK = 5, // A large, sparse, winding cluster (electrons)
+    CLUSTER_TYPES = 6 // The number of kinds
+};
+
+
+/**
+ * @brief The features measured for one cluster
+ */
+struct ClusterFeatures {
+    unsigned int size; // The number of pixels
+    unsigned long long totalToT; // The sum of the pixels' ToT values
+    double centroidX; // The ToT weighted mean x position
+    double centroidY; // The ToT weighted mean y position
+    int minX, maxX; // The horizontal extent of the bounding box (inclusive)
+    int minY, maxY; // The vertical extent of the bounding box (inclusive)
+    double elongation; // The ratio of the long axis to the short axis (1 when round)
+};
+
+
+/**
+ * @brief This class measures the clusters of a frame <br>
+ * Clusters are either taken as the file groups them (one line per cluster),
+ * or rebuilt from scratch by 8-connected labelling, where every pixel is
+ * joined to its touching neighbours with a union-find over a label buffer
+ * covering the detector, indexed by the pixels' packed indices <br>
+ * The label buffer is only ever cleared where the frame touched it, and every
+ * other buffer is kept between frames, so no frame allocates once the buffers
+ * have grown to the largest frame seen (class is non-copyable)
+ */
+template <class T, class Geometry = TimepixGeometry>
+class ClusterEngine {
+public:
+
+    /**
+     * @brief   An empty constructor for the ClusterEngine class
+     * @return  A newly constructed ClusterEngine object
+     */
+    ClusterEngine()
+        : labels_(Geometry::PIXELS)
+    {
+        for (unsigned int i = 0; i < Geometry::PIXELS; ++i) {
+            labels_[i] = NO_PIXEL;
+        }
+    }
+
+
+    /**
+     * @brief   The destructor for the ClusterEngine class
+     * @return  Nothing
+     */
+    ~ClusterEngine()
+    {
+    }
+
+
+    /**
+     * @brief       Measures the clusters of a frame as the file grouped them
+     * @param frame The frame
+     * @return      The features of each cluster, valid until the next frame
+     */
+    Span<ClusterFeatures const> measure(Frame<T, Geometry> const& frame)
+    {
+        Span<std::uint32_t const> const hits = frame.hits();
+
+        features_.resize(frame.numberOfClusters());
+        for (std::size_t i = 0; i < frame.numberOfClusters(); ++i) {
+            Moments moments;
+            begin(moments);
+            for (std::size_t j = frame.clusterBegin(i); j < frame.clusterEnd(i); ++j) {
+                add(moments, hits[j]);
+            }
+            end(moments, features_[i]);
+        }
+
+        return Span<ClusterFeatures const>(features_.data(), features_.size());
+    }
+
+
+    /**
+     * @brief       Regroups the pixels of a frame into 8-connected clusters
+     * (so clusters the file split are joined and touching ones are merged)
+     * and measures them
+     * @param frame The frame
+     * @return      The features of each cluster, valid until the next frame,
+     * in the order of each cluster's first pixel
+     */
+    Span<ClusterFeatures const> label(Frame<T, Geometry> const& frame)
+    {
+        Span<std::uint32_t const> const hits = frame.hits();
+        std::size_t const size = frame.size();
+
+        parents_.resize(size);
+        clusters_.resize(size);
+
+        // Place every pixel on the matrix, joining it to the neighbours
+        // already placed (so every touching pair is joined exactly once)
+        for (std::size_t i = 0; i < size; ++i) {
+            parents_[i] = static_cast<std::uint32_t>(i);
+
+            std::uint32_t const index = Geometry::indexOf(hits[i]);
+            int const x = static_cast<int>(Geometry::x(index));
+            int const y = static_cast<int>(Geometry::y(index));
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    if (!Geometry::contains(x + dx, y + dy)) {
+                        continue;
+                    }
+                    std::uint32_t const neighbour = labels_[Geometry::index(x + dx, y + dy)];
+                    if (neighbour != NO_PIXEL) {
+                        join(static_cast<std::uint32_t>(i), neighbour);
+                    }
+                }
+            }
+            labels_[index] = static_cast<std::uint32_t>(i);
+        }
+
+        // Number the clusters by their roots and gather their moments
+        moments_.clear();
+        for (std::size_t i = 0; i < size; ++i) {
+            std::uint32_t const root = find(static_cast<std::uint32_t>(i));
+            if (root == i) {
+                clusters_[i] = static_cast<std::uint32_t>(moments_.size());
+                moments_.push_back(Moments());
+                begin(moments_.back());
+            }
+            add(moments_[clusters_[root]], hits[i]);
+        }
+
+        features_.resize(moments_.size());
+        for (std::size_t i = 0; i < moments_.size(); ++i) {
+            end(moments_[i], features_[i]);
+        }
+
+        // Clear only the labels the frame set
+        for (std::size_t i = 0; i < size; ++i) {
+            labels_[Geometry::indexOf(hits[i])] = NO_PIXEL;
+        }
+
+        return Span<ClusterFeatures const>(features_.data(), features_.size());
+    }
+
+
+    /**
+     * @brief          Classifies a cluster by its shape and brightness
+     * @param features The features of the cluster
+     * @return         The kind of particle the cluster looks like
+     */
+    static ClusterType classify(ClusterFeatures const& features)
+    {
+        // The elongation past which a cluster counts as a track
+        static const double TRACK_ELONGATION = 3.0;
+        // The mean ToT per pixel past which a track counts as heavy
+        static const double HEAVY_TOT = 200.0;
+        // The size from which a round cluster counts as a large one
+        static const unsigned int LARGE_SIZE = 8;
+        // The fraction of its bounding box a large cluster fills to be a blob
+        static const double BLOB_FILL = 0.5;
+
+        if (features.size <= 2) {
+            return CLUSTER_DOT;
+        }
+
+        if (features.elongation >= TRACK_ELONGATION) {
+            double const meanToT = static_cast<double>(features.totalToT) / features.size;
+            return meanToT >= HEAVY_TOT ? CLUSTER_HEAVY_TRACK : CLUSTER_STRAIGHT_TRACK;
+        }
+
+        if (features.size >= LARGE_SIZE) {
+            double const area = static_cast<double>(features.maxX - features.minX + 1)
+                                * (features.maxY - features.minY + 1);
+            return features.size >= BLOB_FILL * area ? CLUSTER_HEAVY_BLOB : CLUSTER_CURLY_TRACK;
+        }
+
+        return CLUSTER_SMALL_BLOB;
+    }
+
+
+    /**
+     * @brief      Names a kind of cluster
+     * @param type The kind of cluster
+     * @return     The name of the kind
+     */
+    static char const* typeName(ClusterType const type)
+    {
+        static char const* const names[CLUSTER_TYPES] = {
+            "dot", "small blob", "heavy blob", "straight track", "heavy track", "curly track"
+        };
+
+        return names[type];
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    ClusterEngine(ClusterEngine const& other);
+
+
+    // Assignment operator
+    ClusterEngine& operator=(ClusterEngine const& other);
+
+
+    // The label of a matrix position no pixel of the frame is on
+    static const std::uint32_t NO_PIXEL = 0xFFFFFFFFu;
+
+
+    struct Moments {
+        unsigned int size; // The number of pixels
+        unsigned long long totalToT; // The sum of the ToT values
+        double sumCX, sumCY; // The ToT weighted sums of the positions
+        double sumX, sumY; // The sums of the positions
+        double sumXX, sumYY, sumXY; // The sums of the products of the positions
+        int minX, maxX, minY, maxY; // The bounding box
+    };
+
+
+    // Utility Functions
+    std::uint32_t find(std::uint32_t pixel)
+    {
+        // Finds the root of a pixel's set, halving the path as it goes
+
+        while (parents_[pixel] != pixel) {
+            parents_[pixel] = parents_[parents_[pixel]];
+            pixel = parents_[pixel];
+        }
+
+        return pixel;
+    }
+
+
+    void join(std::uint32_t const first, std::uint32_t const second)
+    {
+        // Joins two sets, keeping the earlier pixel as the root so clusters
+        // come out in the order of their first pixel
+
+        std::uint32_t const a = find(first);
+        std::uint32_t const b = find(second);
+        if (a < b) {
+            parents_[b] = a;
+        } else if (b < a) {
+            parents_[a] = b;
+        }
+    }
+
+
+    static void begin(Moments& moments)
+    {
+        moments.size = 0;
+        moments.totalToT = 0;
+        moments.sumCX = moments.sumCY = 0.0;
+        moments.sumX = moments.sumY = 0.0;
+        moments.sumXX = moments.sumYY = moments.sumXY = 0.0;
+        moments.minX = moments.minY = 0x7FFFFFFF;
+        moments.maxX = moments.maxY = -0x7FFFFFFF;
+    }
+
+
+    static void add(Moments& moments, std::uint32_t const hit)
+    {
+        std::uint32_t const index = Geometry::indexOf(hit);
+        std::uint32_t const c = Geometry::totOf(hit);
+        int const ix = static_cast<int>(Geometry::x(index));
+        int const iy = static_cast<int>(Geometry::y(index));
+        double const fx = static_cast<double>(ix);
+        double const fy = static_cast<double>(iy);
+        double const fc = static_cast<double>(c);
+
+        moments.size++;
+        moments.totalToT += c;
+        moments.sumCX += fc * fx;
+        moments.sumCY += fc * fy;
+        moments.sumX += fx;
+        moments.sumY += fy;
+        moments.sumXX += fx * fx;
+        moments.sumYY += fy * fy;
+        moments.sumXY += fx * fy;
+        moments.minX = ix < moments.minX ? ix : moments.minX;
+        moments.maxX = ix > moments.maxX ? ix : moments.maxX;
+        moments.minY = iy < moments.minY ? iy : moments.minY;
+        moments.maxY = iy > moments.maxY ? iy : moments.maxY;
+    }
+
+
+    static void end(Moments const& moments, ClusterFeatures& features)
+    {
+        // Turns a cluster's sums into its features <br>
+        // The elongation is taken from the eigenvalues of the positions'
+        // covariance, each widened by the 1/12 variance of a single pixel so
+        // small clusters stay finite
+
+        double const n = moments.size;
+        features.size = moments.size;
+        features.totalToT = moments.totalToT;
+        features.minX = moments.minX;
+        features.maxX = moments.maxX;
+        features.minY = moments.minY;
+        features.maxY = moments.maxY;
+
+        double const meanX = moments.sumX / n;
+        double const meanY = moments.sumY / n;
+        if (moments.totalToT) {
+            features.centroidX = moments.sumCX / moments.totalToT;
+            features.centroidY = moments.sumCY / moments.totalToT;
+        } else {
+            features.centroidX = meanX;
+            features.centroidY = meanY;
+        }
+
+        double const varianceX = moments.sumXX / n - meanX * meanX;
+        double const varianceY = moments.sumYY / n - meanY * meanY;
+        double const covariance = moments.sumXY / n - meanX * meanY;
+        double const half = 0.5 * (varianceX + varianceY);
+        double const spread = std::sqrt(0.25 * (varianceX - varianceY) * (varianceX - varianceY)
+                                        + covariance * covariance);
+        double const longAxis = half + spread + 1.0 / 12.0;
+        double shortAxis = half - spread + 1.0 / 12.0;
+        if (shortAxis < 1.0 / 12.0) {
+            shortAxis = 1.0 / 12.0; // Rounding can leave a line slightly below a pixel's width
+        }
+        features.elongation = std::sqrt(longAxis / shortAxis);
+    }
+
+    AlignedBuffer<std::uint32_t> labels_; // The pixel on each matrix position, or NO_PIXEL
+    std::vector<std::uint32_t> parents_; // The union-find parent of each pixel
+    std::vector<std::uint32_t> clusters_; // The cluster number of each root pixel
+    std::vector<Moments> moments_; // The sums gathered for each cluster
+    std::vector<ClusterFeatures> features_; // The features of each cluster
+};
+
+
+#endif  /* CLUSTERENGINE_HPP */
@@ -0,0 +1,431 @@
+/**
+ * @file        ClusterLogGenerator.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the generator of deterministic synthetic cluster logs,
+ * for benchmarking the readers and parsers
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef CLUSTERLOGGENERATOR_HPP
+#define CLUSTERLOGGENERATOR_HPP
+
+// C++ headers
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+// My headers
+#include <DetectorGeometry.hpp>
+
+/**
+ * @brief The shape of the synthetic data a ClusterLogGenerator writes
+ */
+struct GeneratorSettings {
+    unsigned long long numberOfFrames; // The number of frames to write
+    double occupancy; // The mean fraction of the pixels hit in a frame
+    std::vector<double> clusterSizes; // The relative frequency of clusters of 1, 2, 3... pixels
+    double meanToT; // The mean ToT of a hit
+    double startTime; // The C-time of the first frame, in seconds
+    double framePeriod; // The seconds between the starts of consecutive frames
+    double exposure; // The acquisition time of every frame, in seconds
+    std::uint64_t seed; // The seed the whole log follows from
+
+    /**
+     * @brief   A constructor for the GeneratorSettings struct, defaulting to
+     * frames shaped like those of the test detector's 55 Fe dataset
+     * @return  A newly constructed GeneratorSettings object
+     */
+    GeneratorSettings()
+        : numberOfFrames(10000), occupancy(0.0012), meanToT(60.0), startTime(1335967757.0),
+        framePeriod(0.14), exposure(0.1), seed(1)
+    {
+        static const double SIZES[] = { 0.913, 0.078, 0.007, 0.002 };
+        clusterSizes.assign(SIZES, SIZES + sizeof(SIZES) / sizeof(SIZES[0]));
+    }
+};
+
+
+/**
+ * @brief This class writes synthetic cluster logs in the format the readers
+ * parse <br>
+ * Each frame holds a Poisson number of clusters, sized to give the requested
+ * mean occupancy, each grown as a random 8-connected walk from a seed pixel
+ * with no pixel hit twice in a frame <br>
+ * Every frame is drawn from its own generator seeded by the settings' seed
+ * and the frame number, so a log is the same on every machine and any frame
+ * can be generated on its own
+ */
+template <class Geometry = TimepixGeometry>
+class ClusterLogGenerator {
+public:
+
+    /**
+     * @brief          A constructor for the ClusterLogGenerator class
+     * @param settings The shape of the data to generate
+     * @return         A newly constructed ClusterLogGenerator object
+     */
+    explicit ClusterLogGenerator(GeneratorSettings const& settings)
+        : settings_(settings), isHit_(Geometry::PIXELS, false), meanClusterSize_(1.0)
+    {
+        // The cumulative distribution of the cluster sizes
+        double total = 0.0;
+        double weighted = 0.0;
+        for (std::size_t i = 0; i < settings_.clusterSizes.size(); ++i) {
+            double const weight = settings_.clusterSizes[i] > 0.0 ? settings_.clusterSizes[i] : 0.0;
+            total += weight;
+            weighted += weight * (i + 1);
+            cumulative_.push_back(total);
+        }
+        if (total > 0.0) {
+            for (std::size_t i = 0; i < cumulative_.size(); ++i) {
+                cumulative_[i] /= total;
+            }
+            meanClusterSize_ = weighted / total;
+        } else {
+            cumulative_.assign(1, 1.0);
+        }
+    }
+
+
+    /**
+     * @brief   The destructor for the ClusterLogGenerator class
+     * @return  Nothing
+     */
+    ~ClusterLogGenerator()
+    {
+    }
+
+
+    /**
+     * @brief   Retrieves the mean size of the clusters generated
+     * @return  The mean number of pixels in a cluster
+     */
+    double meanClusterSize() const
+    {
+        return meanClusterSize_;
+    }
+
+
+    /**
+     * @brief   Retrieves the mean number of clusters in a frame
+     * @return  The mean number of clusters
+     */
+    double meanClusters() const
+    {
+        return settings_.occupancy * Geometry::PIXELS / meanClusterSize_;
+    }
+
+
+    /**
+     * @brief             Appends a frame of the log to a string
+     * @param frameNumber The number of the frame, from 1
+     * @param out         The string to append the frame's lines to
+     * @return            Nothing
+     */
+    void appendFrame(unsigned long long const frameNumber, std::string& out)
+    {
+        Random random(settings_.seed ^ (frameNumber * 0x9e3779b97f4a7c15ull));
+
+        // Grow the clusters, each held as its pixels' indices and ToTs
+        unsigned long long const clusters = random.poisson(meanClusters());
+        hits_.clear();
+        clusters_.clear();
+        for (unsigned long long i = 0; i < clusters; ++i) {
+            std::size_t const begin = hits_.size();
+            growCluster(drawClusterSize(random), random);
+            if (hits_.size() > begin) {
+                clusters_.push_back(ClusterRange(begin, hits_.size()));
+            }
+        }
+
+        // The logs list the pixels of a cluster, and the clusters, by row
+        for (std::size_t i = 0; i < clusters_.size(); ++i) {
+            std::sort(hits_.begin() + clusters_[i].first, hits_.begin() + clusters_[i].second);
+        }
+        std::sort(clusters_.begin(), clusters_.end(), FirstHitOrder(hits_));
+
+        char line[96];
+        double const time = settings_.startTime + (frameNumber - 1) * settings_.framePeriod;
+        int length = std::snprintf(line, sizeof(line), "Frame %llu (%.7f s, %g s)\n",
+                                   frameNumber, time, settings_.exposure);
+        out.append(line, length);
+
+        for (std::size_t i = 0; i < clusters_.size(); ++i) {
+            for (std::size_t j = clusters_[i].first; j < clusters_[i].second; ++j) {
+                std::uint32_t const index = hits_[j].first;
+                appendTriple(Geometry::x(index), Geometry::y(index), hits_[j].second, out);
+            }
+            out += '\n';
+        }
+        out += '\n';
+
+        // Leave the matrix clear for the next frame
+        for (std::size_t i = 0; i < hits_.size(); ++i) {
+            isHit_[hits_[i].first] = false;
+        }
+    }
+
+
+    /**
+     * @brief   Generates the whole log in memory
+     * @return  The text of the log
+     */
+    std::string const generate()
+    {
+        std::string out;
+        for (unsigned long long i = 1; i <= settings_.numberOfFrames; ++i) {
+            appendFrame(i, out);
+        }
+
+        return out;
+    }
+
+
+    /**
+     * @brief      Writes the whole log to a file, a few megabytes at a time
+     * @param path The path of the file to write
+     * @return     The size of the file in bytes, throws std::ifstream::failure
+     * if the file can't be written
+     */
+    unsigned long long write(std::string const& path)
+    {
+        unsigned long long size = 0;
+        try {
+            std::ofstream out;
+            out.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            out.open(path.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+
+            std::string buffer;
+            buffer.reserve(WRITE_SIZE + (WRITE_SIZE >> 2));
+            for (unsigned long long i = 1; i <= settings_.numberOfFrames; ++i) {
+                appendFrame(i, buffer);
+                if (buffer.size() >= WRITE_SIZE || i == settings_.numberOfFrames) {
+                    out.write(buffer.data(), buffer.size());
+                    size += buffer.size();
+                    buffer.clear();
+                }
+            }
+            out.close();
+        } catch (std::ofstream::failure const&) {
+            throw std::ifstream::failure("Could not write the synthetic cluster log: " + path);
+        }
+
+        return size;
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    ClusterLogGenerator(ClusterLogGenerator const& other);
+
+
+    // Assignment operator
+    ClusterLogGenerator& operator=(ClusterLogGenerator const& other);
+
+
+    // The bytes of log gathered before each write
+    static const std::size_t WRITE_SIZE = 4 << 20;
+
+
+    // A small, fast generator of the same sequence on every platform
+    // (xorshift64* seeded through splitmix64, so nearby seeds diverge)
+    class Random {
+    public:
+        explicit Random(std::uint64_t seed)
+        {
+            seed += 0x9e3779b97f4a7c15ull;
+            seed = (seed ^ (seed >> 30)) * 0xbf58476d1ce4e5b9ull;
+            seed = (seed ^ (seed >> 27)) * 0x94d049bb133111ebull;
+            state_ = (seed ^ (seed >> 31)) | 1;
+        }
+
+        std::uint64_t next()
+        {
+            state_ ^= state_ >> 12;
+            state_ ^= state_ << 25;
+            state_ ^= state_ >> 27;
+
+            return state_ * 0x2545f4914f6cdd1dull;
+        }
+
+        double uniform()
+        {
+            // In [0, 1), from the top 53 bits
+            return (next() >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        unsigned int below(unsigned int const n)
+        {
+            return static_cast<unsigned int>((next() >> 32) * n >> 32);
+        }
+
+        unsigned long long poisson(double mean)
+        {
+            // Knuth's method, in slices small enough for exp() not to
+            // underflow
+
+            unsigned long long count = 0;
+            while (mean > 0.0) {
+                double const slice = mean < 32.0 ? mean : 32.0;
+                mean -= slice;
+                double const limit = std::exp(-slice);
+                for (double product = uniform(); product >= limit; product *= uniform()) {
+                    count++;
+                }
+            }
+
+            return count;
+        }
+
+    private:
+        std::uint64_t state_;
+    };
+
+
+    typedef std::pair<std::uint32_t, std::uint32_t> Hit; // A pixel's index and ToT
+    typedef std::pair<std::size_t, std::size_t> ClusterRange; // A cluster's hits
+
+
+    // Orders the clusters by their first (lowest) pixel
+    class FirstHitOrder {
+    public:
+        explicit FirstHitOrder(std::vector<Hit> const& hits)
+            : hits_(&hits)
+        {
+        }
+
+        bool operator()(ClusterRange const& a, ClusterRange const& b) const
+        {
+            return (*hits_)[a.first].first < (*hits_)[b.first].first;
+        }
+
+    private:
+        std::vector<Hit> const* hits_;
+    };
+
+
+    // Utility Functions
+    unsigned int drawClusterSize(Random& random) const
+    {
+        double const u = random.uniform();
+        std::size_t size = 0;
+        while (size + 1 < cumulative_.size() && u >= cumulative_[size]) {
+            size++;
+        }
+
+        return static_cast<unsigned int>(size + 1);
+    }
+
+
+    std::uint32_t drawToT(Random& random) const
+    {
+        // Exponentially distributed about the mean, never 0
+        double const tot = 1.0 - settings_.meanToT * std::log(1.0 - random.uniform());
+
+        return tot < Geometry::MAXIMUM_TOT ? static_cast<std::uint32_t>(tot) : Geometry::MAXIMUM_TOT;
+    }
+
+
+    void growCluster(unsigned int const size, Random& random)
+    {
+        // Seeds the cluster on a free pixel, then repeatedly hits a free
+        // neighbour of one of its pixels, giving up on a boxed-in cluster
+        // (or a full matrix) rather than looping forever
+
+        std::size_t const begin = hits_.size();
+        unsigned int attempts = 16 * size + 16;
+
+        while (hits_.size() == begin && attempts--) {
+            std::uint32_t const seed = random.below(Geometry::PIXELS);
+            if (!isHit_[seed]) {
+                isHit_[seed] = true;
+                hits_.push_back(Hit(seed, drawToT(random)));
+            }
+        }
+
+        while (hits_.size() > begin && hits_.size() - begin < size && attempts--) {
+            std::uint32_t const from = hits_[begin + random.below(static_cast<unsigned int>(hits_.size() - begin))].first;
+            unsigned int const direction = random.below(8);
+            long long const x = static_cast<long long>(Geometry::x(from)) + DX[direction];
+            long long const y = static_cast<long long>(Geometry::y(from)) + DY[direction];
+            if (!Geometry::contains(x, y)) {
+                continue;
+            }
+            std::uint32_t const index = Geometry::index(static_cast<unsigned int>(x), static_cast<unsigned int>(y));
+            if (!isHit_[index]) {
+                isHit_[index] = true;
+                hits_.push_back(Hit(index, drawToT(random)));
+            }
+        }
+    }
+
+
+    static void appendTriple(unsigned int const x, unsigned int const y, unsigned int const c, std::string& out)
+    {
+        // Appends '[x, y, c] ' without going through a stream
+
+        char text[40];
+        char* pos = text;
+        *pos++ = '[';
+        pos = appendUnsigned(x, pos);
+        *pos++ = ',';
+        *pos++ = ' ';
+        pos = appendUnsigned(y, pos);
+        *pos++ = ',';
+        *pos++ = ' ';
+        pos = appendUnsigned(c, pos);
+        *pos++ = ']';
+        *pos++ = ' ';
+        out.append(text, pos);
+    }
+
+
+    static char* appendUnsigned(unsigned int value, char* pos)
+    {
+        char digits[10];
+        int count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value);
+        while (count) {
+            *pos++ = digits[--count];
+        }
+
+        return pos;
+    }
+
+    // The steps to the 8 neighbours of a pixel
+    static const int DX[8];
+    static const int DY[8];
+
+    GeneratorSettings settings_; // The shape of the data generated
+    std::vector<double> cumulative_; // The cumulative distribution of the cluster sizes
+    std::vector<bool> isHit_; // Whether each pixel is hit in the frame being generated
+    std::vector<Hit> hits_; // The hits of the frame being generated
+    std::vector<ClusterRange> clusters_; // The clusters of the frame being generated
+    double meanClusterSize_; // The mean number of pixels in a cluster
+};
+
+
+template <class Geometry>
+const std::size_t ClusterLogGenerator<Geometry>::WRITE_SIZE;
+
+template <class Geometry>
+const int ClusterLogGenerator<Geometry>::DX[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+
+template <class Geometry>
+const int ClusterLogGenerator<Geometry>::DY[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+
+
+#endif  /* CLUSTERLOGGENERATOR_HPP */
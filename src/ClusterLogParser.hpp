@@ -0,0 +1,291 @@
+/**
+ * @file        ClusterLogParser.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the class for parsing frames straight out of a range of
+ * cluster log bytes held in memory
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef CLUSTERLOGPARSER_HPP
+#define CLUSTERLOGPARSER_HPP
+
+// C++ headers
+#include <fstream>
+#include <sstream>
+#include <cstring>
+// My headers
+#include <Frame.hpp>
+#include <ClusterTokenizer.hpp>
+#include <PixelMask.hpp>
+#include <RejectedHits.hpp>
+#include <FastNumber.hpp>
+
+/**
+ * @brief This class parses frames from a character range containing cluster
+ * log text, without copying lines out of the range <br>
+ * Pixels are placed on the detector described by the Geometry, and a hit
+ * lying off it is dropped and counted, or reported as malformed data if the
+ * tally of dropped hits is strict <br>
+ * Given a pixel mask, the hits on masked pixels are dropped as the lines are
+ * decoded, along with any cluster left without pixels
+ */
+template <class T, class Geometry = TimepixGeometry>
+class ClusterLogParser {
+public:
+
+    /**
+     * @brief   An empty constructor for the ClusterLogParser class
+     * @return  A newly constructed ClusterLogParser object with an empty range
+     */
+    ClusterLogParser()
+        : cursor_(0), end_(0), lineNumber_(1), mask_(0), rejected_(0)
+    {
+    }
+
+
+    /**
+     * @brief             A constructor for the ClusterLogParser class
+     * @param begin       The first byte of the range to parse
+     * @param end         One past the last byte of the range to parse
+     * @param firstLine   The line number of the first line in the range
+     * @return            A newly constructed ClusterLogParser object
+     */
+    ClusterLogParser(char const* begin, char const* end, unsigned int const firstLine = 1)
+        : cursor_(begin), end_(end), lineNumber_(firstLine), mask_(0), rejected_(0)
+    {
+    }
+
+
+    /**
+     * @brief             Points the parser at a new range of bytes
+     * @param begin       The first byte of the range to parse
+     * @param end         One past the last byte of the range to parse
+     * @param firstLine   The line number of the first line in the range
+     * @return            Nothing
+     */
+    void reset(char const* begin, char const* end, unsigned int const firstLine = 1)
+    {
+        cursor_ = begin;
+        end_ = end;
+        lineNumber_ = firstLine;
+    }
+
+
+    /**
+     * @brief      Sets the mask of pixels whose hits are dropped
+     * @param mask The mask, which has to outlive the parser's use of it, or
+     * null to keep every hit
+     * @return     Nothing
+     */
+    void setMask(PixelMask<Geometry> const* mask)
+    {
+        mask_ = mask;
+    }
+
+
+    /**
+     * @brief          Sets the tally of the hits dropped for lying off the
+     * detector's matrix
+     * @param rejected The tally, which has to outlive the parser's use of it,
+     * or null to drop such hits uncounted
+     * @return         Nothing
+     */
+    void setRejectedHits(RejectedHits* rejected)
+    {
+        rejected_ = rejected;
+    }
+
+
+    /**
+     * @brief      Checks whether every byte of the range has been consumed
+     * @return     A boolean stating whether the range's end has been reached
+     */
+    bool atEnd() const
+    {
+        return cursor_ >= end_;
+    }
+
+
+    /**
+     * @brief       Parses the next frame out of the range
+     * @param frame The frame to fill with the parsed data
+     * @return      Nothing, throws std::ifstream::failure on malformed data
+     */
+    void parseFrame(Frame<T, Geometry>& frame)
+    {
+        // The first line of a frame has to be its meta-data string
+        if (!parseMetadataString(frame)) {
+            std::ostringstream o;
+            o << "Malformed data file: Missing meta-data string at line: "
+              << lineNumber_;
+            throw std::ifstream::failure(o.str());
+        }
+
+        // Read cluster lines until the (blank) line terminating the frame
+        while (!atEnd()) {
+            if (!parseClusterString(frame)) {
+                eatLine();
+                break;
+            }
+        }
+
+        // The last cluster may have lost every pixel to the mask, or to the
+        // edge of the matrix
+        frame.dropEmptyCluster();
+    }
+
+
+    /**
+     * @brief      A getter for the parser's current position in the range
+     * @return     A pointer to the next byte to be parsed
+     */
+    char const* position() const
+    {
+        return cursor_;
+    }
+
+
+    /**
+     * @brief      A getter for the current line number
+     * @return     The line number of the next line to be parsed
+     */
+    unsigned int lineNumber() const
+    {
+        return lineNumber_;
+    }
+
+private:
+
+    // Utility Functions
+    char const* lineEnd() const
+    {
+        // Finds the end of the current line (the newline, or the range's end)
+
+        char const* newline = static_cast<char const*>(std::memchr(cursor_, '\n', end_ - cursor_));
+
+        return newline ? newline : end_;
+    }
+
+
+    void nextLine(char const* lineEnd)
+    {
+        // Moves the cursor past the given line end and its newline
+
+        cursor_ = (lineEnd < end_) ? lineEnd + 1 : end_;
+        lineNumber_++;
+    }
+
+
+    void eatLine()
+    {
+        // Simply eats up the current line without doing anything
+
+        if (!atEnd()) {
+            nextLine(lineEnd());
+        }
+    }
+
+
+    // Parsing routines
+    bool parseMetadataString(Frame<T, Geometry>& frame)
+    {
+        // Attempts to parse and extract the fields into the frame object's data
+        // fields from a meta-data string of this format - e.g.
+        // 'Frame 1 (1335967757.2905033 s, 0.1 s)'
+        // Returns false if the string is not meta-data, and leaves the cursor
+        // on the line
+
+        if (atEnd()) {
+            return false;
+        }
+
+        char const* end = lineEnd();
+
+        // find the opening parenthesis position in the line
+        char const* pos = static_cast<char const*>(std::memchr(cursor_, '(', end - cursor_));
+        // If the opening parenthesis is not present, then this is not a
+        // meta-data string
+        if (!pos) {
+            return false;
+        }
+
+        // Move to the first digit of the C-time and grab the real time
+        pos++;
+        double time = 0.0;
+        FastNumber::parseDecimal(pos, end, time);
+        frame.setTime(time);
+
+        // Skip the " s, " separating the times
+        while (pos < end && !FastNumber::isDigit(*pos) && *pos != '-' && *pos != '.') {
+            pos++;
+        }
+
+        // Extract the running time
+        double runningTime = 0.0;
+        FastNumber::parseDecimal(pos, end, runningTime);
+        frame.setRunningTime(runningTime);
+
+        nextLine(end);
+
+        return true;
+    }
+
+
+    bool parseClusterString(Frame<T, Geometry>& frame)
+    {
+        // Attempts to parse and extract the fields into the frame object's data
+        // fields from a cluster string of this format - e.g.
+        // '[19, 0, 55]' where x = 19, y = 0, c = 55, or
+        // '[224, 5, 23] [224, 6, 43]' for a cluster of several pixels
+        // Returns false if the string is not a cluster string, and leaves the
+        // cursor on the line
+
+        if (atEnd()) {
+            return false;
+        }
+
+        char const* end = lineEnd();
+
+        // find the opening square bracket position in the line
+        char const* pos = static_cast<char const*>(std::memchr(cursor_, '[', end - cursor_));
+        // If the opening bracket is not present, then this is not a
+        // cluster data string
+        if (!pos) {
+            return false;
+        }
+
+        // Each line holds one cluster, so decode every triple on it into a
+        // new cluster
+        frame.beginCluster();
+        std::size_t rejected = 0;
+        ClusterTokenizer<T, Geometry>::decode(pos, end, frame, rejected, mask_);
+        if (rejected && rejected_) {
+            if (rejected_->isStrict()) {
+                std::ostringstream o;
+                o << "Malformed data file: Pixel outside the matrix at line: "
+                  << lineNumber_;
+                throw std::ifstream::failure(o.str());
+            }
+            rejected_->add(rejected);
+        }
+
+        nextLine(end);
+
+        return true;
+    }
+
+    char const* cursor_; // The next byte to be parsed
+    char const* end_; // One past the last byte of the range
+    unsigned int lineNumber_; // The current line number in the file
+    PixelMask<Geometry> const* mask_; // The mask of dropped pixels, or null
+    RejectedHits* rejected_; // The tally of hits dropped off the matrix, or null
+};
+
+
+#endif  /* CLUSTERLOGPARSER_HPP */
@@ -0,0 +1,222 @@
+/**
+ * @file        ClusterTokenizer.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the vectorized tokenizer decoding the '[x, y, c]' pixel
+ * triples of a cluster line
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef CLUSTERTOKENIZER_HPP
+#define CLUSTERTOKENIZER_HPP
+
+// C++ headers
+#include <cstddef>
+#include <cstdint>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+// My headers
+#include <Frame.hpp>
+#include <FastNumber.hpp>
+#include <PixelMask.hpp>
+
+/**
+ * @brief This class decodes every '[x, y, c]' triple of a cluster line <br>
+ * The digits of a whole vector register (AVX2 or SSE2, with a scalar fallback)
+ * are classified at once, and numbers are only decoded at the positions where
+ * a run of digits starts, so separators are skipped without branching on them
+ * <br>
+ * Given a pixel mask, the hits of a line are held back in a small buffer and
+ * tested against the mask a block at a time, so masked hits never reach the
+ * frame
+ */
+template <class T, class Geometry = TimepixGeometry>
+class ClusterTokenizer {
+public:
+
+    /**
+     * @brief       Decodes every triple of a cluster line into the frame's
+     * last cluster
+     * @param begin    The first byte of the line
+     * @param end      One past the last byte of the line
+     * @param frame    The frame to add the pixels to
+     * @param rejected Set to the number of triples lying off the detector,
+     * which are not added
+     * @param mask     The mask of pixels whose hits are dropped, or null to
+     * keep every hit
+     * @return         The number of pixels added
+     */
+    static std::size_t decode(char const* begin, char const* end, Frame<T, Geometry>& frame,
+                              std::size_t& rejected, PixelMask<Geometry> const* mask = 0)
+    {
+        // The held hits are left uninitialised, as they are only read once
+        // written
+        State state;
+        state.field = 0;
+        state.pixels = 0;
+        state.rejected = 0;
+        state.inNumber = false;
+        state.mask = mask;
+        state.heldCount = 0;
+        char const* pos = begin;
+
+#if defined(__AVX2__)
+        __m256i const below = _mm256_set1_epi8('0' - 1);
+        __m256i const above = _mm256_set1_epi8('9' + 1);
+        for (; end - pos >= 32; pos += 32) {
+            __m256i const block = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(pos));
+            __m256i const digits = _mm256_and_si256(_mm256_cmpgt_epi8(block, below),
+                                                    _mm256_cmpgt_epi8(above, block));
+            std::uint32_t const mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(digits));
+
+            consume(pos, end, mask, 32, state, frame);
+        }
+#elif defined(__SSE2__)
+        __m128i const below = _mm_set1_epi8('0' - 1);
+        __m128i const above = _mm_set1_epi8('9' + 1);
+        for (; end - pos >= 16; pos += 16) {
+            __m128i const block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pos));
+            __m128i const digits = _mm_and_si128(_mm_cmpgt_epi8(block, below),
+                                                 _mm_cmpgt_epi8(above, block));
+            std::uint32_t const mask = static_cast<std::uint32_t>(_mm_movemask_epi8(digits));
+
+            consume(pos, end, mask, 16, state, frame);
+        }
+#endif
+
+        // Scalar tail (or the whole line without a vector instruction set)
+        while (pos < end) {
+            unsigned int const width = (end - pos) < 32 ? static_cast<unsigned int>(end - pos) : 32;
+            std::uint32_t mask = 0;
+            for (unsigned int i = 0; i < width; ++i) {
+                if (FastNumber::isDigit(pos[i])) {
+                    mask |= 1u << i;
+                }
+            }
+
+            consume(pos, end, mask, width, state, frame);
+            pos += width;
+        }
+
+        flush(state, frame);
+        rejected = state.rejected;
+
+        return state.pixels;
+    }
+
+private:
+
+    // The most hits held back for the mask test at once
+    static const unsigned int HELD_HITS = 64;
+
+
+    struct State {
+        T values[3]; // The values of the triple being decoded
+        unsigned int field; // The number of values of the triple decoded so far
+        std::size_t pixels; // The number of pixels added so far
+        std::size_t rejected; // The number of triples off the detector so far
+        bool inNumber; // Whether the previous block ended inside a number
+        PixelMask<Geometry> const* mask; // The mask of dropped pixels, or null
+        std::uint32_t held[HELD_HITS]; // The packed hits awaiting the mask test
+        unsigned int heldCount; // The number of hits held
+    };
+
+
+    static void consume(char const* block,
+                        char const* end,
+                        std::uint32_t const digitMask,
+                        unsigned int const width,
+                        State& state,
+                        Frame<T, Geometry>& frame)
+    {
+        // Decodes the numbers starting in a block, given the mask of the
+        // block's digit bytes; a number running past the block is decoded in
+        // full here and its remaining digits are masked out of the next block
+
+        std::uint32_t starts = digitMask & ~((digitMask << 1) | (state.inNumber ? 1u : 0u));
+
+        while (starts) {
+            char const* pos = block + countTrailingZeros(starts);
+
+            T value = 0;
+            FastNumber::parseUnsigned(pos, end, value);
+
+            state.values[state.field++] = value;
+            if (state.field == 3) {
+                if (state.mask) {
+                    hold(state, frame);
+                } else if (frame.addPixel(state.values[0], state.values[1], state.values[2])) {
+                    state.pixels++;
+                } else {
+                    state.rejected++;
+                }
+                state.field = 0;
+            }
+
+            starts &= starts - 1;
+        }
+
+        state.inNumber = (digitMask >> (width - 1)) & 1u;
+    }
+
+
+    static void hold(State& state, Frame<T, Geometry>& frame)
+    {
+        // Packs the triple just decoded into the held hits, testing them
+        // against the mask once the buffer fills
+
+        T const x = state.values[0];
+        T const y = state.values[1];
+        if (!Geometry::contains(static_cast<long long>(x), static_cast<long long>(y))) {
+            state.rejected++;
+            return;
+        }
+
+        state.held[state.heldCount++] = Geometry::pack(
+                Geometry::index(static_cast<unsigned int>(x), static_cast<unsigned int>(y)),
+                Pixel<T, Geometry>::saturate(state.values[2]));
+        if (state.heldCount == HELD_HITS) {
+            flush(state, frame);
+        }
+    }
+
+
+    static void flush(State& state, Frame<T, Geometry>& frame)
+    {
+        // Adds the held hits which aren't masked to the frame
+
+        if (state.heldCount == 0) {
+            return;
+        }
+
+        std::size_t const kept = state.mask->filter(state.held, state.heldCount);
+        frame.addHits(state.held, kept);
+        state.pixels += kept;
+        state.heldCount = 0;
+    }
+
+
+    static unsigned int countTrailingZeros(std::uint32_t const value)
+    {
+#if defined(__GNUC__)
+        return static_cast<unsigned int>(__builtin_ctz(value));
+#else
+        unsigned int bit = 0;
+        while (!((value >> bit) & 1u)) {
+            bit++;
+        }
+        return bit;
+#endif
+    }
+};
+
+
+#endif  /* CLUSTERTOKENIZER_HPP */
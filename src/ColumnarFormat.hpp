@@ -0,0 +1,93 @@
+/**
+ * @file        ColumnarFormat.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the layout of the binary '.lolx' columnar exports
+ * written by the frame exporter
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef COLUMNARFORMAT_HPP
+#define COLUMNARFORMAT_HPP
+
+// C++ headers
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+/**
+ * @brief The header at the start of a '.lolx' columnar export <br>
+ * The export holds, in native byte order: <br>
+ * (1) this header <br>
+ * (2) a sequence of blocks, each starting with a ColumnarBlock and followed
+ * by its columns one after the other, every column padded to 8 bytes: <br>
+ * a hit block holds the frame number (uint32), cluster number within the
+ * frame (uint32, from 1), x (uint16), y (uint16) and ToT (uint16) of each
+ * hit, and a frame block holds the frame number (uint32), number of hits
+ * (uint32), number of clusters (uint32), time (double) and running time
+ * (double) of each frame <br>
+ * Hit and frame blocks interleave, each in frame order, so a reader can load
+ * every column of a kind by concatenating its blocks
+ */
+struct ColumnarHeader {
+    char magic[4]; // Always "LOLX"
+    std::uint32_t byteOrder; // Always COLUMNAR_BYTE_ORDER, written in native order
+    std::uint32_t version; // The version of the layout, COLUMNAR_VERSION
+    std::uint32_t reserved; // Always 0
+};
+
+
+/**
+ * @brief The start of every block in a columnar export
+ */
+struct ColumnarBlock {
+    std::uint32_t type; // The kind of block, COLUMNAR_HITS or COLUMNAR_FRAMES
+    std::uint32_t rows; // The number of values in each of the block's columns
+    std::uint64_t size; // The size of the whole block in bytes, padding included
+};
+
+// The byte order marker, which reads differently on a foreign-endian machine
+static const std::uint32_t COLUMNAR_BYTE_ORDER = 0x01020304u;
+// The current version of the columnar layout
+static const std::uint32_t COLUMNAR_VERSION = 1;
+// The type of the blocks holding hits
+static const std::uint32_t COLUMNAR_HITS = 1;
+// The type of the blocks holding frames
+static const std::uint32_t COLUMNAR_FRAMES = 2;
+
+
+/**
+ * @brief       Rounds a column size up to the 8 bytes every column is padded
+ * to
+ * @param size  The unpadded size in bytes
+ * @return      The padded size in bytes
+ */
+inline std::size_t columnarPadded(std::size_t const size)
+{
+    return (size + 7) & ~static_cast<std::size_t>(7);
+}
+
+
+/**
+ * @brief   Builds the header of a columnar export
+ * @return  The header's bytes
+ */
+inline std::string const columnarHeader()
+{
+    ColumnarHeader header;
+    std::memcpy(header.magic, "LOLX", 4);
+    header.byteOrder = COLUMNAR_BYTE_ORDER;
+    header.version = COLUMNAR_VERSION;
+    header.reserved = 0;
+
+    return std::string(reinterpret_cast<char const*>(&header), sizeof(header));
+}
+
+
+#endif  /* COLUMNARFORMAT_HPP */
@@ -0,0 +1,551 @@
+/**
+ * @file        CompressedStream.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the stream decompressing a gzip or zstd cluster log on
+ * background threads (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef COMPRESSEDSTREAM_HPP
+#define COMPRESSEDSTREAM_HPP
+
+// C++ headers
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(LOLCAT_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(LOLCAT_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+// My headers
+#include <SpscRing.hpp>
+
+/**
+ * @brief The compression formats a cluster log can be stored in
+ */
+enum Compression {
+    COMPRESSION_NONE, // Plain text
+    COMPRESSION_GZIP, // One or more gzip members
+    COMPRESSION_ZSTD  // One or more zstd frames
+};
+
+
+/**
+ * @brief       Recognises the compression of a file from its first bytes
+ * @param begin The first byte of the file
+ * @param end   One past the last byte of the file
+ * @return      The compression the file is stored in
+ */
+inline Compression detectCompression(char const* begin, char const* end)
+{
+    static unsigned char const gzip[] = { 0x1f, 0x8b };
+    static unsigned char const zstd[] = { 0x28, 0xb5, 0x2f, 0xfd };
+
+    if (end - begin >= 4 && std::memcmp(begin, zstd, 4) == 0) {
+        return COMPRESSION_ZSTD;
+    }
+    if (end - begin >= 2 && std::memcmp(begin, gzip, 2) == 0) {
+        return COMPRESSION_GZIP;
+    }
+
+    return COMPRESSION_NONE;
+}
+
+
+/**
+ * @brief             Retrieves the name of a compression format
+ * @param compression The compression format
+ * @return            Its name
+ */
+inline char const* compressionName(Compression const compression)
+{
+    switch (compression) {
+        case COMPRESSION_GZIP:
+            return "gzip";
+        case COMPRESSION_ZSTD:
+            return "zstd";
+        default:
+            return "none";
+    }
+}
+
+
+/**
+ * @brief This class decompresses a gzip or zstd file held in memory (as
+ * mapped by a MappedFile) into blocks of text on background threads, which
+ * are read back in order <br>
+ * A zstd file made of several independent frames with known sizes (as
+ * written by 'zstd -T' or 'pzstd') has its frames decompressed side by side,
+ * one frame per block, and is otherwise decompressed as a stream on one
+ * thread, as gzip always is. The blocks are handed over and recycled through
+ * lock-free rings, so the decompression overlaps with whatever reads the
+ * text (class is non-copyable)
+ */
+class CompressedStream {
+public:
+
+    /**
+     * @brief             A constructor for the CompressedStream class, which
+     * starts decompressing straight away
+     * @param begin       The first byte of the compressed file, which must
+     * stay valid for the stream's lifetime
+     * @param end         One past the last byte of the compressed file
+     * @param compression The compression of the file
+     * @param threads     The most threads to decompress independent zstd
+     * frames on
+     * @param blockSize   The size of the blocks a file is streamed in
+     * @param blocks      The number of blocks in flight per thread (at most
+     * two when the frames are decompressed side by side)
+     * @return            A newly constructed CompressedStream object, throws
+     * std::ifstream::failure if the format isn't supported by this build
+     */
+    CompressedStream(char const* begin,
+                     char const* end,
+                     Compression const compression,
+                     unsigned int const threads = 1,
+                     std::size_t const blockSize = 4 << 20,
+                     std::size_t const blocks = 4)
+        : begin_(begin), end_(end), compression_(compression), blockSize_(blockSize),
+        current_(0), currentWorker_(0), position_(0), nextBlock_(0),
+        isFinished_(false), isStopping_(false)
+    {
+        if (!isSupported(compression)) {
+            throw std::ifstream::failure(std::string("Support for ") + compressionName(compression)
+                                         + " compressed cluster logs wasn't built in");
+        }
+
+        unsigned int workers = 1;
+#if defined(LOLCAT_HAVE_ZSTD)
+        if (compression == COMPRESSION_ZSTD && threads > 1 && findFrames()) {
+            workers = static_cast<unsigned int>(std::min<std::size_t>(threads, frames_.size()));
+        }
+#endif
+
+        // A block holds a whole frame when they are decompressed side by
+        // side, so fewer are kept in flight
+        std::size_t const perWorker = workers > 1 ? std::min<std::size_t>(blocks, 2) : blocks;
+        for (unsigned int i = 0; i < workers; ++i) {
+            std::unique_ptr<Worker> worker(new Worker(perWorker));
+            for (std::size_t j = 0; j < perWorker; ++j) {
+                worker->blocks.push_back(std::unique_ptr<Block>(new Block()));
+                worker->empty.push(worker->blocks.back().get());
+            }
+            workers_.push_back(std::move(worker));
+        }
+        for (unsigned int i = 0; i < workers; ++i) {
+            workers_[i]->thread = std::thread(&CompressedStream::work, this, i);
+        }
+    }
+
+
+    /**
+     * @brief   The destructor for the CompressedStream class, which stops the
+     * decompression if it hasn't finished
+     * @return  Nothing
+     */
+    ~CompressedStream()
+    {
+        isStopping_ = true;
+        if (current_) {
+            currentWorker_->empty.push(current_);
+            current_ = 0;
+        }
+
+        // Hand back whatever the workers produce until each one has ended
+        for (std::size_t i = 0; i < workers_.size(); ++i) {
+            Worker& worker = *workers_[i];
+            if (!worker.isDrained) {
+                for (;;) {
+                    Block* block = worker.filled.pop();
+                    if (!block) {
+                        break;
+                    }
+                    worker.empty.push(block);
+                }
+            }
+            worker.thread.join();
+        }
+    }
+
+
+    /**
+     * @brief             Checks whether this build can decompress a format
+     * @param compression The compression format
+     * @return            Whether it is supported
+     */
+    static bool isSupported(Compression const compression)
+    {
+#if defined(LOLCAT_HAVE_ZLIB)
+        if (compression == COMPRESSION_GZIP) {
+            return true;
+        }
+#endif
+#if defined(LOLCAT_HAVE_ZSTD)
+        if (compression == COMPRESSION_ZSTD) {
+            return true;
+        }
+#endif
+
+        return false;
+    }
+
+
+    /**
+     * @brief       Reads the next bytes of text
+     * @param out   Where to copy the text
+     * @param size  The most bytes to read
+     * @return      The number of bytes read, less than size only at the end of
+     * the text, throws std::ifstream::failure if the file is corrupt or
+     * truncated
+     */
+    std::size_t read(char* out, std::size_t const size)
+    {
+        std::size_t copied = 0;
+        while (copied < size) {
+            if (!current_ && !nextBlock()) {
+                break;
+            }
+
+            std::size_t const count = std::min(size - copied, current_->size - position_);
+            std::memcpy(out + copied, &current_->data[position_], count);
+            copied += count;
+            position_ += count;
+
+            if (position_ == current_->size) {
+                currentWorker_->empty.push(current_);
+                current_ = 0;
+            }
+        }
+
+        return copied;
+    }
+
+
+    /**
+     * @brief   Retrieves the number of threads decompressing the file
+     * @return  The number of threads
+     */
+    unsigned int numberOfThreads() const
+    {
+        return static_cast<unsigned int>(workers_.size());
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    CompressedStream(CompressedStream const& other);
+
+
+    // Assignment operator
+    CompressedStream& operator=(CompressedStream const& other);
+
+
+    // A block of decompressed text
+    struct Block {
+        std::vector<char> data; // The text, only the first size bytes of which are used
+        std::size_t size; // The number of bytes of text
+    };
+
+
+    // A decompressing thread, handing its blocks over in order (a null block
+    // marks its end)
+    struct Worker {
+        explicit Worker(std::size_t const blocks)
+            : filled(blocks + 1), empty(blocks), isDrained(false)
+        {
+        }
+
+        std::vector<std::unique_ptr<Block> > blocks; // Every block the worker owns
+        SpscRing<Block*> filled; // The blocks handed to the reader
+        SpscRing<Block*> empty; // The blocks handed back for reuse
+        std::exception_ptr error; // The error the worker stopped on, if any
+        bool isDrained; // Whether the reader has taken the worker's end
+        std::thread thread; // The thread the worker runs on
+    };
+
+
+    // An independent zstd frame of the file
+    struct CompressedFrame {
+        std::size_t offset; // The byte offset of the frame in the file
+        std::size_t size; // The compressed size of the frame
+        std::size_t contentSize; // The decompressed size of the frame
+    };
+
+
+    // Utility Functions
+    bool nextBlock()
+    {
+        // Takes the next block, from each worker in turn (the frames were
+        // dealt out to them in the same order)
+
+        if (isFinished_) {
+            return false;
+        }
+
+        Worker& worker = *workers_[nextBlock_ % workers_.size()];
+        Block* block = worker.filled.pop();
+        if (!block) {
+            worker.isDrained = true;
+            isFinished_ = true;
+
+            // A worker stopped early by another's error ends early too, so
+            // every worker's error is checked
+            for (std::size_t i = 0; i < workers_.size(); ++i) {
+                if (workers_[i]->error) {
+                    std::rethrow_exception(workers_[i]->error);
+                }
+            }
+
+            return false;
+        }
+
+        nextBlock_++;
+        current_ = block;
+        currentWorker_ = &worker;
+        position_ = 0;
+
+        return true;
+    }
+
+
+    void work(unsigned int const index)
+    {
+        Worker& worker = *workers_[index];
+        try {
+#if defined(LOLCAT_HAVE_ZSTD)
+            if (compression_ == COMPRESSION_ZSTD) {
+                if (frames_.empty()) {
+                    streamZstd(worker);
+                } else {
+                    decompressFrames(worker, index);
+                }
+            }
+#endif
+#if defined(LOLCAT_HAVE_ZLIB)
+            if (compression_ == COMPRESSION_GZIP) {
+                streamGzip(worker);
+            }
+#endif
+        } catch (...) {
+            worker.error = std::current_exception();
+            isStopping_ = true;
+        }
+
+        worker.filled.push(0);
+    }
+
+
+    static void corrupt(char const* format, char const* reason)
+    {
+        throw std::ifstream::failure(std::string("The ") + format + " compressed cluster log is corrupt: " + reason);
+    }
+
+
+#if defined(LOLCAT_HAVE_ZLIB)
+    void streamGzip(Worker& worker)
+    {
+        // Inflates every gzip member of the file in turn; zlib takes its input
+        // in slices, as its counters are only 32 bits
+
+        static const std::size_t SLICE_SIZE = 1 << 30;
+
+        z_stream stream;
+        std::memset(&stream, 0, sizeof(stream));
+        if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+            corrupt("gzip", "couldn't start inflating");
+        }
+
+        char const* input = begin_;
+        bool isMemberEnded = false;
+        try {
+            while (!isStopping_) {
+                Block* block = worker.empty.pop();
+                block->data.resize(blockSize_);
+                stream.next_out = reinterpret_cast<Bytef*>(&block->data[0]);
+                stream.avail_out = static_cast<uInt>(blockSize_);
+
+                while (stream.avail_out > 0) {
+                    if (stream.avail_in == 0) {
+                        if (input == end_) {
+                            break;
+                        }
+                        std::size_t const slice = std::min<std::size_t>(end_ - input, SLICE_SIZE);
+                        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input));
+                        stream.avail_in = static_cast<uInt>(slice);
+                        input += slice;
+                    }
+
+                    int const result = inflate(&stream, Z_NO_FLUSH);
+                    if (result == Z_STREAM_END) {
+                        // Another member may follow this one
+                        isMemberEnded = true;
+                        if (stream.avail_in == 0 && input == end_) {
+                            break;
+                        }
+                        inflateReset(&stream);
+                    } else if (result == Z_OK) {
+                        isMemberEnded = false;
+                    } else if (result != Z_BUF_ERROR) {
+                        corrupt("gzip", stream.msg ? stream.msg : "inflate failed");
+                    }
+                }
+
+                block->size = blockSize_ - stream.avail_out;
+                if (block->size == 0) {
+                    worker.empty.push(block);
+                    break;
+                }
+                worker.filled.push(block);
+            }
+        } catch (...) {
+            inflateEnd(&stream);
+            throw;
+        }
+        inflateEnd(&stream);
+
+        if (!isStopping_ && !isMemberEnded) {
+            corrupt("gzip", "the file is truncated");
+        }
+    }
+#endif
+
+
+#if defined(LOLCAT_HAVE_ZSTD)
+    bool findFrames()
+    {
+        // Splits the file into its frames, which can only be decompressed
+        // independently when there are several and their sizes are known
+
+        std::size_t offset = 0;
+        std::size_t const size = end_ - begin_;
+        while (offset < size) {
+            std::size_t const frameSize = ZSTD_findFrameCompressedSize(begin_ + offset, size - offset);
+            if (ZSTD_isError(frameSize)) {
+                frames_.clear();
+                return false;
+            }
+
+            unsigned long long const contentSize = ZSTD_getFrameContentSize(begin_ + offset, size - offset);
+            if (contentSize == ZSTD_CONTENTSIZE_UNKNOWN || contentSize == ZSTD_CONTENTSIZE_ERROR) {
+                // Skippable frames hold no text
+                std::uint32_t magic = 0;
+                std::memcpy(&magic, begin_ + offset, sizeof(magic));
+                if ((magic & ZSTD_MAGIC_SKIPPABLE_MASK) != ZSTD_MAGIC_SKIPPABLE_START) {
+                    frames_.clear();
+                    return false;
+                }
+            } else {
+                CompressedFrame frame = { offset, frameSize, static_cast<std::size_t>(contentSize) };
+                frames_.push_back(frame);
+            }
+            offset += frameSize;
+        }
+
+        if (frames_.size() < 2) {
+            frames_.clear();
+        }
+
+        return !frames_.empty();
+    }
+
+
+    void decompressFrames(Worker& worker, unsigned int const index)
+    {
+        // Decompresses every frame dealt to this worker whole into a block
+
+        std::unique_ptr<ZSTD_DCtx, std::size_t (*)(ZSTD_DCtx*)> context(ZSTD_createDCtx(), ZSTD_freeDCtx);
+        if (!context) {
+            corrupt("zstd", "couldn't create a decompression context");
+        }
+
+        for (std::size_t i = index; i < frames_.size() && !isStopping_; i += workers_.size()) {
+            CompressedFrame const& frame = frames_[i];
+            Block* block = worker.empty.pop();
+            block->data.resize(std::max<std::size_t>(frame.contentSize, 1));
+
+            std::size_t const size = ZSTD_decompressDCtx(context.get(), &block->data[0], frame.contentSize,
+                                                         begin_ + frame.offset, frame.size);
+            if (ZSTD_isError(size)) {
+                worker.empty.push(block);
+                corrupt("zstd", ZSTD_getErrorName(size));
+            }
+            block->size = size;
+            worker.filled.push(block);
+        }
+    }
+
+
+    void streamZstd(Worker& worker)
+    {
+        // Decompresses the whole file as one stream, frame after frame
+
+        std::unique_ptr<ZSTD_DStream, std::size_t (*)(ZSTD_DStream*)> stream(ZSTD_createDStream(), ZSTD_freeDStream);
+        if (!stream) {
+            corrupt("zstd", "couldn't create a decompression stream");
+        }
+
+        ZSTD_inBuffer input = { begin_, static_cast<std::size_t>(end_ - begin_), 0 };
+        std::size_t hint = 0; // Non-zero while a frame is unfinished
+        bool isFlushing = false; // Whether output may be held back
+        while (!isStopping_) {
+            Block* block = worker.empty.pop();
+            block->data.resize(blockSize_);
+            ZSTD_outBuffer output = { &block->data[0], blockSize_, 0 };
+
+            while (output.pos < output.size && (input.pos < input.size || isFlushing)) {
+                hint = ZSTD_decompressStream(stream.get(), &output, &input);
+                if (ZSTD_isError(hint)) {
+                    worker.empty.push(block);
+                    corrupt("zstd", ZSTD_getErrorName(hint));
+                }
+                // A full output buffer may leave decompressed bytes behind
+                isFlushing = output.pos == output.size;
+            }
+
+            block->size = output.pos;
+            if (block->size == 0) {
+                worker.empty.push(block);
+                break;
+            }
+            worker.filled.push(block);
+        }
+
+        if (!isStopping_ && hint != 0) {
+            corrupt("zstd", "the file is truncated");
+        }
+    }
+#endif
+
+    char const* begin_; // The first byte of the compressed file
+    char const* end_; // One past the last byte of the compressed file
+    Compression compression_; // The compression of the file
+    std::size_t blockSize_; // The size of the blocks a file is streamed in
+    std::vector<CompressedFrame> frames_; // The independent frames, when decompressed side by side
+    std::vector<std::unique_ptr<Worker> > workers_; // The decompressing threads
+    Block* current_; // The block being read, or null
+    Worker* currentWorker_; // The worker the block being read came from
+    std::size_t position_; // The next byte of the block being read
+    std::size_t nextBlock_; // The number of blocks taken so far
+    bool isFinished_; // Whether the end of the text was reached
+    std::atomic<bool> isStopping_; // Whether the workers should stop early
+};
+
+
+#endif  /* COMPRESSEDSTREAM_HPP */
@@ -0,0 +1,311 @@
+/**
+ * @file        DatasetBatch.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the batch of every dataset found under a directory
+ * tree, processed in parallel (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef DATASETBATCH_HPP
+#define DATASETBATCH_HPP
+
+// C++ headers
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <boost/filesystem.hpp>
+
+// The name of the cluster log in each dataset's settings directory
+static const char CLUSTER_LOG_NAME[] = "ClusterLogAll.txt";
+// The suffixes the cluster log may be compressed under, in order of preference
+static const char* const CLUSTER_LOG_SUFFIXES[] = { "", ".zst", ".gz" };
+
+
+/**
+ * @brief A dataset of the batch
+ */
+struct BatchDataset {
+    std::string path; // The path of the cluster log
+    unsigned long long size; // The size of the cluster log in bytes
+};
+
+
+/**
+ * @brief What processing a dataset of the batch produced
+ */
+struct BatchResult {
+    bool isFailed; // Whether the dataset raised an error
+    std::string output; // The output of the dataset (its table entry etc.)
+    std::string log; // The log of the dataset
+    std::string error; // The error raised, if the dataset failed
+};
+
+
+/**
+ * @brief This class finds every cluster log under a directory tree laid out
+ * as 'data/Detector/Data/settings/ClusterLogAll.txt' (or a compressed
+ * 'ClusterLogAll.txt.zst' or 'ClusterLogAll.txt.gz', when there is no plain
+ * one beside it) and processes them on a pool of threads <br>
+ * The datasets are handed out largest first, so a large dataset never starts
+ * last and holds up the end of the batch, but their results are emitted in
+ * the order of their paths, as soon as every dataset before them is done, so
+ * the output is the same whatever the number of threads (class is
+ * non-copyable)
+ */
+class DatasetBatch {
+public:
+
+    /**
+     * @brief      A constructor for the DatasetBatch class, which walks the tree
+     * @param root The directory to search, such as 'data' or 'data/Detector'
+     * @return     A newly constructed DatasetBatch object, throws
+     * std::ifstream::failure if the root isn't a directory
+     */
+    explicit DatasetBatch(std::string const& root)
+    {
+        boost::system::error_code error;
+        if (!boost::filesystem::is_directory(root, error)) {
+            throw std::ifstream::failure("Batch root '" + root + "' isn't a directory");
+        }
+
+        boost::filesystem::recursive_directory_iterator it(root, error);
+        boost::filesystem::recursive_directory_iterator const end;
+        for (; !error && it != end; it.increment(error)) {
+            boost::filesystem::path const& path = it->path();
+            if (!isClusterLog(path) || !boost::filesystem::is_regular_file(it->status())) {
+                continue;
+            }
+
+            // Empty logs hold no dataset
+            BatchDataset dataset = { path.string(), boost::filesystem::file_size(path, error) };
+            if (!error && dataset.size) {
+                datasets_.push_back(dataset);
+            }
+            error.clear();
+        }
+        if (error) {
+            throw std::ifstream::failure("Couldn't walk '" + root + "': " + error.message());
+        }
+
+        std::sort(datasets_.begin(), datasets_.end(), isBefore);
+    }
+
+
+    /**
+     * @brief   The destructor for the DatasetBatch class
+     * @return  Nothing
+     */
+    ~DatasetBatch()
+    {
+    }
+
+
+    /**
+     * @brief   Retrieves the number of datasets found
+     * @return  The number of datasets
+     */
+    std::size_t size() const
+    {
+        return datasets_.size();
+    }
+
+
+    /**
+     * @brief       Retrieves a dataset
+     * @param index The position of the dataset, in path order
+     * @return      The dataset
+     */
+    BatchDataset const& dataset(std::size_t const index) const
+    {
+        return datasets_[index];
+    }
+
+
+    /**
+     * @brief         Processes every dataset
+     * @param threads The number of threads to use in all; the datasets are
+     * run side by side, and the threads left over are shared among them
+     * @param process A callable taking (BatchDataset const&, unsigned int
+     * threads, std::ostream& log) and returning the dataset's output as a
+     * std::string, run on a worker thread; an exception it throws fails only
+     * its own dataset
+     * @param emit    A callable taking (BatchDataset const&, BatchResult
+     * const&), run on the calling thread for each dataset in path order
+     * @return        The number of datasets which failed
+     */
+    template <class Process, class Emit>
+    unsigned int run(unsigned int const threads, Process process, Emit emit)
+    {
+        std::size_t const count = datasets_.size();
+        if (count == 0) {
+            return 0;
+        }
+
+        unsigned int const workerCount = threads < count ? (threads ? threads : 1) : static_cast<unsigned int>(count);
+        unsigned int const threadsPerDataset = threads > workerCount ? threads / workerCount : 1;
+
+        // The datasets are handed out largest first
+        std::vector<std::size_t> order(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), LargerThan(datasets_));
+
+        results_.assign(count, BatchResult());
+        isDone_.assign(count, false);
+        next_ = 0;
+
+        std::vector<std::thread> workers;
+        for (unsigned int i = 0; i < workerCount; ++i) {
+            workers.push_back(std::thread(&DatasetBatch::work<Process>, this,
+                                          std::cref(order), threadsPerDataset, process));
+        }
+
+        // Emit the results in path order as they come in
+        unsigned int failed = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while (!isDone_[i]) {
+                    done_.wait(lock);
+                }
+            }
+
+            if (results_[i].isFailed) {
+                failed++;
+            }
+            emit(datasets_[i], results_[i]);
+            results_[i] = BatchResult();
+        }
+
+        for (std::size_t i = 0; i < workers.size(); ++i) {
+            workers[i].join();
+        }
+
+        return failed;
+    }
+
+
+    /**
+     * @brief      Checks whether a file is the cluster log of its dataset
+     * @param path The path of the file
+     * @return     Whether the file is named as a cluster log, and no cluster
+     * log preferred to it sits beside it
+     */
+    static bool isClusterLog(boost::filesystem::path const& path)
+    {
+        std::string const name = path.filename().string();
+        std::size_t const suffixes = sizeof(CLUSTER_LOG_SUFFIXES) / sizeof(CLUSTER_LOG_SUFFIXES[0]);
+        for (std::size_t i = 0; i < suffixes; ++i) {
+            if (name == std::string(CLUSTER_LOG_NAME) + CLUSTER_LOG_SUFFIXES[i]) {
+                for (std::size_t j = 0; j < i; ++j) {
+                    boost::system::error_code error;
+                    boost::filesystem::path const preferred =
+                            path.parent_path() / (std::string(CLUSTER_LOG_NAME) + CLUSTER_LOG_SUFFIXES[j]);
+                    if (boost::filesystem::is_regular_file(preferred, error)) {
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    DatasetBatch(DatasetBatch const& other);
+
+
+    // Assignment operator
+    DatasetBatch& operator=(DatasetBatch const& other);
+
+
+    // Orders dataset positions by falling size
+    struct LargerThan {
+        explicit LargerThan(std::vector<BatchDataset> const& datasets)
+            : datasets_(datasets)
+        {
+        }
+
+        bool operator()(std::size_t const first, std::size_t const second) const
+        {
+            return datasets_[first].size > datasets_[second].size;
+        }
+
+        std::vector<BatchDataset> const& datasets_;
+    };
+
+
+    // Utility Functions
+    static bool isBefore(BatchDataset const& first, BatchDataset const& second)
+    {
+        return first.path < second.path;
+    }
+
+
+    template <class Process>
+    void work(std::vector<std::size_t> const& order,
+              unsigned int const threads,
+              Process process)
+    {
+        for (;;) {
+            std::size_t const claimed = next_++;
+            if (claimed >= order.size()) {
+                return;
+            }
+
+            std::size_t const index = order[claimed];
+            BatchResult result;
+            std::ostringstream log;
+            try {
+                result.output = process(datasets_[index], threads, static_cast<std::ostream&>(log));
+                result.isFailed = false;
+            } catch (std::exception const& e) {
+                result.isFailed = true;
+                result.error = e.what();
+            } catch (...) {
+                result.isFailed = true;
+                result.error = "An unforeseen error has occurred";
+            }
+            result.log = log.str();
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            results_[index].isFailed = result.isFailed;
+            results_[index].output.swap(result.output);
+            results_[index].log.swap(result.log);
+            results_[index].error.swap(result.error);
+            isDone_[index] = true;
+            done_.notify_one();
+        }
+    }
+
+    std::vector<BatchDataset> datasets_; // The datasets, in path order
+    std::vector<BatchResult> results_; // The result of each dataset
+    std::vector<bool> isDone_; // Whether each dataset has been processed
+    std::atomic<std::size_t> next_; // The next position of the size order to hand out
+    std::mutex mutex_; // Guards the results
+    std::condition_variable done_; // Signalled when a dataset is processed
+};
+
+
+#endif  /* DATASETBATCH_HPP */
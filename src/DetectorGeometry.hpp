@@ -0,0 +1,165 @@
+/**
+ * @file        DetectorGeometry.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the compile-time detector geometry policies, which fix
+ * the size of the pixel matrix and how a hit is packed into 32 bits
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef DETECTORGEOMETRY_HPP
+#define DETECTORGEOMETRY_HPP
+
+// C++ headers
+#include <cstdint>
+
+/**
+ * @brief       Counts the bits needed to hold a value
+ * @param value The value
+ * @return      The position of the value's highest set bit, plus one
+ */
+constexpr unsigned int bitsToHold(unsigned long long const value)
+{
+    return value ? 1 + bitsToHold(value >> 1) : 0;
+}
+
+
+/**
+ * @brief This class describes a Width x Height pixel matrix <br>
+ * A hit is packed into one 32-bit word, the pixel's linear index
+ * (y * WIDTH + x) in the low INDEX_BITS bits and its ToT in the TOT_BITS bits
+ * above them <br>
+ * Everything is fixed at compile time, so for the power-of-two widths every
+ * real chip has the divisions decoding an index fold into shifts and masks
+ */
+template <unsigned int Width, unsigned int Height>
+struct DetectorGeometry {
+    static const unsigned int WIDTH = Width; // The number of pixel columns
+    static const unsigned int HEIGHT = Height; // The number of pixel rows
+    static const unsigned int PIXELS = Width * Height; // The number of pixels
+    static const unsigned int INDEX_BITS = bitsToHold(PIXELS - 1); // The bits of a hit holding its index
+    static const unsigned int TOT_BITS = 14; // The bits of a hit holding its ToT (as the Timepix counter)
+    static const std::uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1; // The index bits of a hit
+    static const std::uint32_t MAXIMUM_TOT = (1u << TOT_BITS) - 1; // The largest ToT a hit holds
+    static const bool IS_POWER_OF_TWO = (Width & (Width - 1)) == 0; // Whether rows are found by a shift
+    static const unsigned int X_BITS = bitsToHold(Width - 1); // The bits of an index holding x (powers of two)
+
+    static_assert(Width > 0 && Height > 0, "A detector needs at least one pixel");
+    static_assert(INDEX_BITS + TOT_BITS <= 32, "A hit of this detector does not fit in 32 bits");
+
+
+    /**
+     * @brief   Checks whether a position lies on the matrix
+     * @param x The x position
+     * @param y The y position
+     * @return  Whether the position is a pixel of the matrix
+     */
+    static constexpr bool contains(long long const x, long long const y)
+    {
+        return x >= 0 && y >= 0 && x < static_cast<long long>(WIDTH) && y < static_cast<long long>(HEIGHT);
+    }
+
+
+    /**
+     * @brief   Retrieves the linear index of a pixel
+     * @param x The pixel's x position (on the matrix)
+     * @param y The pixel's y position (on the matrix)
+     * @return  The index, y * WIDTH + x
+     */
+    static constexpr std::uint32_t index(unsigned int const x, unsigned int const y)
+    {
+        return IS_POWER_OF_TWO ? (y << X_BITS) | x : y * WIDTH + x;
+    }
+
+
+    /**
+     * @brief       Retrieves the x position of a pixel index
+     * @param index The index
+     * @return      The x position
+     */
+    static constexpr unsigned int x(std::uint32_t const index)
+    {
+        return IS_POWER_OF_TWO ? index & (WIDTH - 1) : index % WIDTH;
+    }
+
+
+    /**
+     * @brief       Retrieves the y position of a pixel index
+     * @param index The index
+     * @return      The y position
+     */
+    static constexpr unsigned int y(std::uint32_t const index)
+    {
+        return IS_POWER_OF_TWO ? index >> X_BITS : index / WIDTH;
+    }
+
+
+    /**
+     * @brief       Packs a hit into a word
+     * @param index The pixel's index
+     * @param tot   The pixel's ToT, which must be at most MAXIMUM_TOT
+     * @return      The packed hit
+     */
+    static constexpr std::uint32_t pack(std::uint32_t const index, std::uint32_t const tot)
+    {
+        return (tot << INDEX_BITS) | index;
+    }
+
+
+    /**
+     * @brief     Retrieves the pixel index of a packed hit
+     * @param hit The packed hit
+     * @return    The index
+     */
+    static constexpr std::uint32_t indexOf(std::uint32_t const hit)
+    {
+        return hit & INDEX_MASK;
+    }
+
+
+    /**
+     * @brief     Retrieves the ToT of a packed hit
+     * @param hit The packed hit
+     * @return    The ToT
+     */
+    static constexpr std::uint32_t totOf(std::uint32_t const hit)
+    {
+        return (hit >> INDEX_BITS) & MAXIMUM_TOT;
+    }
+};
+
+
+// Out of class definitions, for when the constants are bound to references
+template <unsigned int Width, unsigned int Height>
+const unsigned int DetectorGeometry<Width, Height>::WIDTH;
+template <unsigned int Width, unsigned int Height>
+const unsigned int DetectorGeometry<Width, Height>::HEIGHT;
+template <unsigned int Width, unsigned int Height>
+const unsigned int DetectorGeometry<Width, Height>::PIXELS;
+template <unsigned int Width, unsigned int Height>
+const unsigned int DetectorGeometry<Width, Height>::INDEX_BITS;
+template <unsigned int Width, unsigned int Height>
+const unsigned int DetectorGeometry<Width, Height>::TOT_BITS;
+template <unsigned int Width, unsigned int Height>
+const std::uint32_t DetectorGeometry<Width, Height>::INDEX_MASK;
+template <unsigned int Width, unsigned int Height>
+const std::uint32_t DetectorGeometry<Width, Height>::MAXIMUM_TOT;
+template <unsigned int Width, unsigned int Height>
+const bool DetectorGeometry<Width, Height>::IS_POWER_OF_TWO;
+template <unsigned int Width, unsigned int Height>
+const unsigned int DetectorGeometry<Width, Height>::X_BITS;
+
+
+// A single Timepix chip, 256 x 256 (16 index bits and 14 ToT bits)
+typedef DetectorGeometry<256, 256> TimepixGeometry;
+
+// A 2 x 2 assembly of Timepix chips, 512 x 512 (18 index bits and 14 ToT bits)
+typedef DetectorGeometry<512, 512> QuadTimepixGeometry;
+
+
+#endif  /* DETECTORGEOMETRY_HPP */
@@ -0,0 +1,349 @@
+/**
+ * @file        FastNumber.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines allocation-free, locale-independent routines for
+ * converting numbers straight out of and into character ranges
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef FASTNUMBER_HPP
+#define FASTNUMBER_HPP
+
+// C++ headers
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cmath>
+#include <limits>
+#include <locale>
+#include <sstream>
+#include <string>
+
+/**
+ * @brief This class converts decimal text in a character range into numbers
+ * without copying it, and numbers back into decimal text in a caller's
+ * buffer, without regard to the C locale (a '.' is always the decimal point)
+ */
+class FastNumber {
+public:
+
+    /**
+     * @brief       Checks whether a character is a decimal digit
+     * @param c     The character to check
+     * @return      Whether the character is between '0' and '9'
+     */
+    static bool isDigit(char const c)
+    {
+        return static_cast<unsigned char>(c - '0') < 10;
+    }
+
+
+    /**
+     * @brief       Converts the run of digits at pos into an unsigned integer
+     * @param pos   The first digit, moved past the last digit converted
+     * @param end   One past the last byte of the range
+     * @param value The converted value (left untouched if there are no digits)
+     * @return      Whether any digits were converted
+     */
+    template <class T>
+    static bool parseUnsigned(char const*& pos, char const* end, T& value)
+    {
+        if (pos >= end || !isDigit(*pos)) {
+            return false;
+        }
+
+        T result = 0;
+        do {
+            result = static_cast<T> (result * 10 + (*pos - '0'));
+            pos++;
+        } while (pos < end && isDigit(*pos));
+
+        value = result;
+
+        return true;
+    }
+
+
+    /**
+     * @brief       Converts the decimal number at pos (an optional sign,
+     * digits, an optional fraction and an optional exponent) into the
+     * nearest double <br>
+     * Up to 19 significant digits are kept exactly; a mantissa of at most 53
+     * bits is scaled by an exact power of ten in one correctly rounded
+     * operation, and a longer one (such as that of the epoch timestamp
+     * '1335967757.2905033') in extended precision, which rounds correctly
+     * unless it lands on a halfway point between two doubles <br>
+     * The rare numbers none of these settle are converted by the C++ library
+     * in the classic locale, so the result is always correctly rounded
+     * @param pos   The first character, moved past the last one converted
+     * @param end   One past the last byte of the range
+     * @param value The converted value (left untouched if there is no number)
+     * @return      Whether a number was converted
+     */
+    static bool parseDecimal(char const*& pos, char const* end, double& value)
+    {
+        char const* p = pos;
+
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = (*p == '-');
+            p++;
+        }
+
+        std::uint64_t mantissa = 0;
+        int digits = 0; // The significant digits held in the mantissa
+        int exponent = 0; // The power of ten the mantissa is scaled by
+        bool anyDigits = false;
+        bool isTruncated = false; // Whether a non-zero digit didn't fit the mantissa
+
+        // The integer part
+        for (; p < end && isDigit(*p); ++p) {
+            anyDigits = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa) {
+                    digits++;
+                }
+            } else {
+                exponent++; // Digits beyond the mantissa only scale it
+                isTruncated = isTruncated || *p != '0';
+            }
+        }
+
+        // The fractional part
+        if (p < end && *p == '.') {
+            ++p;
+            for (; p < end && isDigit(*p); ++p) {
+                anyDigits = true;
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    if (mantissa) {
+                        digits++;
+                    }
+                    exponent--;
+                } else {
+                    isTruncated = isTruncated || *p != '0';
+                }
+            }
+        }
+
+        if (!anyDigits) {
+            return false;
+        }
+
+        // The exponent
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            char const* e = p + 1;
+            bool negativeExponent = false;
+            if (e < end && (*e == '-' || *e == '+')) {
+                negativeExponent = (*e == '-');
+                e++;
+            }
+            int explicitExponent = 0;
+            if (parseUnsigned(e, end, explicitExponent)) {
+                exponent += negativeExponent ? -explicitExponent : explicitExponent;
+                p = e;
+            }
+        }
+
+        double result = 0.0;
+        if (isTruncated || exponent < -22 || exponent > 22
+                || !scaleExactly(mantissa, exponent, result)) {
+            result = convertSlowly(pos, p);
+            negative = false; // The sign was converted along with the digits
+        }
+
+        value = negative ? -result : result;
+        pos = p;
+
+        return true;
+    }
+
+    /**
+     * @brief       Writes an unsigned integer as decimal digits
+     * @param out   Where to write, with room for at least 20 characters
+     * @param value The value to write
+     * @return      One past the last character written
+     */
+    static char* formatUnsigned(char* out, std::uint64_t value)
+    {
+        // Written backwards two digits at a time into a scratch buffer
+
+        static char const pairs[] =
+            "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+            "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+
+        char digits[20];
+        char* p = digits + sizeof(digits);
+        while (value >= 100) {
+            unsigned int const pair = static_cast<unsigned int>(value % 100) * 2;
+            value /= 100;
+            *--p = pairs[pair + 1];
+            *--p = pairs[pair];
+        }
+        if (value >= 10) {
+            unsigned int const pair = static_cast<unsigned int>(value) * 2;
+            *--p = pairs[pair + 1];
+            *--p = pairs[pair];
+        } else {
+            *--p = static_cast<char>('0' + value);
+        }
+
+        std::size_t const length = digits + sizeof(digits) - p;
+        for (std::size_t i = 0; i < length; ++i) {
+            out[i] = p[i];
+        }
+
+        return out + length;
+    }
+
+
+    /**
+     * @brief       Writes a signed integer as decimal digits
+     * @param out   Where to write, with room for at least 20 characters
+     * @param value The value to write
+     * @return      One past the last character written
+     */
+    static char* formatSigned(char* out, std::int64_t const value)
+    {
+        if (value < 0) {
+            *out++ = '-';
+            return formatUnsigned(out, 0 - static_cast<std::uint64_t>(value));
+        }
+
+        return formatUnsigned(out, static_cast<std::uint64_t>(value));
+    }
+
+
+    /**
+     * @brief          Writes a double with a fixed number of decimals,
+     * rounded to the nearest
+     * @param out      Where to write, with room for at least 32 characters
+     * @param value    The value to write
+     * @param decimals The number of decimals to write, at most 9
+     * @return         One past the last character written
+     */
+    static char* formatFixed(char* out, double value, unsigned int const decimals)
+    {
+        if (!(std::fabs(value) < 9.0e18)) {
+            // Too large (or not finite) to hold in an integer, so this rare
+            // case takes the C library's slower route
+            int const length = std::snprintf(out, 32, "%.*f", static_cast<int>(decimals), value);
+            return out + (length < 0 ? 0 : (length < 32 ? length : 31));
+        }
+
+        if (value < 0.0) {
+            value = -value;
+            *out++ = '-';
+        }
+
+        // The whole part is split off exactly before the fraction is scaled,
+        // so a time of a billion seconds keeps all of its decimals
+        double const whole = std::floor(value);
+        std::uint64_t const divisor = static_cast<std::uint64_t>(powerOfTen(static_cast<int>(decimals)));
+        std::uint64_t integer = static_cast<std::uint64_t>(whole);
+        std::uint64_t fraction = static_cast<std::uint64_t>((value - whole) * divisor + 0.5);
+        if (fraction >= divisor) {
+            integer++;
+            fraction -= divisor;
+        }
+        out = formatUnsigned(out, integer);
+        if (decimals) {
+            *out++ = '.';
+            for (unsigned int i = decimals; i > 0; --i) {
+                out[i - 1] = static_cast<char>('0' + fraction % 10);
+                fraction /= 10;
+            }
+            out += decimals;
+        }
+
+        return out;
+    }
+
+private:
+
+    // Utility Functions
+    static bool scaleExactly(std::uint64_t const mantissa, int const exponent, double& result)
+    {
+        // Scales the mantissa by the power of ten, with |exponent| <= 22 so
+        // the power is an exact double; returns false if the result can't be
+        // rounded correctly this way
+
+        // Clinger's fast path: both operands are exact doubles, so the one
+        // operation rounds correctly
+        if (mantissa <= (std::uint64_t(1) << 53)) {
+            result = static_cast<double>(mantissa);
+            if (exponent < 0) {
+                result /= powerOfTen(-exponent);
+            } else if (exponent > 0) {
+                result *= powerOfTen(exponent);
+            }
+
+            return true;
+        }
+
+        // A mantissa of up to 64 bits is exact in extended precision, where
+        // the operation rounds once; rounding that to a double again gives the
+        // correctly rounded result unless it lands on a halfway point between
+        // two doubles, as only then could the exact value have been on either
+        // side of it
+        if (std::numeric_limits<long double>::digits < 64) {
+            return false;
+        }
+        long double extended = static_cast<long double>(mantissa);
+        if (exponent < 0) {
+            extended /= static_cast<long double>(powerOfTen(-exponent));
+        } else if (exponent > 0) {
+            extended *= static_cast<long double>(powerOfTen(exponent));
+        }
+        result = static_cast<double>(extended);
+        double const lower = (static_cast<long double>(result) <= extended)
+            ? result : std::nextafter(result, 0.0);
+        double const upper = std::nextafter(lower, std::numeric_limits<double>::infinity());
+
+        return extended * 2 != static_cast<long double>(lower) + static_cast<long double>(upper);
+    }
+
+
+    static double convertSlowly(char const* begin, char const* end)
+    {
+        // Converts the number in the range with the C++ library, in the
+        // classic locale so a '.' is the decimal point; this is slow, but
+        // always correctly rounded
+
+        std::istringstream in(std::string(begin, end));
+        in.imbue(std::locale::classic());
+        double result = 0.0;
+        in >> result;
+
+        // An overflow is read as the largest double, rather than infinity
+        if (in.fail() && std::fabs(result) == std::numeric_limits<double>::max()) {
+            result = std::copysign(std::numeric_limits<double>::infinity(), result);
+        }
+
+        return result;
+    }
+
+
+    static double powerOfTen(int const exponent)
+    {
+        // The powers of ten which are exactly representable as doubles
+
+        static double const powers[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        return powers[exponent];
+    }
+};
+
+
+#endif  /* FASTNUMBER_HPP */
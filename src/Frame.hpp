@@ -17,39 +17,101 @@
 // C++ headers
 #include <ostream>
 #include <cassert>
-#include <map>
-// C++ headers
+#include <vector>
+#include <cstddef>
+#include <iterator>
+#include <cstdint>
+// My headers
+#include <DetectorGeometry.hpp>
 #include <Pixel.hpp>
+#include <Span.hpp>
 
 /**
  * @brief This class defines the frame data-type for storing every frame and
- * their data with some meta-data
+ * their data with some meta-data <br>
+ * Every pixel is stored as one 32-bit hit packed by the detector geometry
+ * (its linear index below its ToT), in a single contiguous array grouped into
+ * clusters by a table of offsets into it, so the frame can be walked without
+ * any pointer chasing and a hit costs 4 bytes rather than three T values
  */
-template <class T>
+template <class T, class Geometry = TimepixGeometry>
 class Frame {
 public:
 
+    /**
+     * @brief This class iterates over the pixels of a frame, yielding each
+     * one as a Pixel object
+     */
+    class const_iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Pixel<T, Geometry> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Pixel<T, Geometry> const* pointer;
+        typedef Pixel<T, Geometry> const reference;
+
+        const_iterator()
+            : frame_(0), index_(0)
+        {
+        }
+
+        const_iterator(Frame<T, Geometry> const* frame, std::size_t const index)
+            : frame_(frame), index_(index)
+        {
+        }
+
+        Pixel<T, Geometry> const operator*() const
+        {
+            return frame_->pixel(index_);
+        }
+
+        const_iterator& operator++()
+        {
+            index_++;
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator old(*this);
+            index_++;
+            return old;
+        }
+
+        bool operator==(const_iterator const& other) const
+        {
+            return frame_ == other.frame_ && index_ == other.index_;
+        }
+
+        bool operator!=(const_iterator const& other) const
+        {
+            return !(*this == other);
+        }
+
+    private:
+        Frame<T, Geometry> const* frame_; // The frame being iterated
+        std::size_t index_; // The index of the current pixel
+    };
+
+
     /**
      * @brief   An empty constructor for the Frame class
      * @return  A newly constructed Frame object defaulted to null values
      */
     Frame()
-    : pixels_(std::map<unsigned int, Pixel<T> >()), time_(0.0f), runningTime_(0.0f)
+    : clusterOffsets_(1, 0), time_(0.0), runningTime_(0.0)
     {
     }
 
     /**
      * @brief An normal constructor for the Frame class
-     * @param pixels The pixels data set to set the internal pixel map to
      * @param time The time in seconds to set the frame time to
      * @param runningTime The running time in seconds to set the frame's
      * running time to
-     * @return  A newly constructed Frame object set to the given value
+     * @return  A newly constructed Frame object with no pixels
      */
-    Frame(std::map<unsigned int, Pixel<T> > const& pixels,
-            float const time,
-            float const runningTime)
-    : pixels_(pixels), time_(time), runningTime_(runningTime)
+    Frame(double const time, double const runningTime)
+    : clusterOffsets_(1, 0), time_(time), runningTime_(runningTime)
     {
     }
 
@@ -58,10 +120,11 @@ public:
      * @param other The other pixel object to be copied from
      * @return      A new copy constructed Frame object
      */
-    Frame(Frame<T> const& other)
-    : pixels_(other.pixels_),
-    runningTime_(other.runningTime_),
-    time_(other.time_)
+    Frame(Frame<T, Geometry> const& other)
+    : hits_(other.hits_),
+    clusterOffsets_(other.clusterOffsets_),
+    time_(other.time_),
+    runningTime_(other.runningTime_)
     {
     }
 
@@ -78,7 +141,7 @@ public:
      * @param other The other pixel object to be assigned from
      * @return      A pointer to this object
      */
-    Frame<T>& operator=(Frame<T>& other)
+    Frame<T, Geometry>& operator=(Frame<T, Geometry> other)
     {
         swap(*this, other);
 
@@ -86,34 +149,158 @@ public:
     }
 
     /**
-     * @brief     Retrieves the pixel specified by the key
-     * @param key The pixel number to retrieve from the map
-     * @return    A pixel object of the pixel specified, returns a defaulted
-     * Pixel object if no appropriate pixel was found
+     * @brief       Retrieves the pixel at the given position in the frame
+     * @param index The position of the pixel, in the order it was added
+     * @return      A pixel object of the pixel specified
      */
-    Pixel<T> const getPixel(unsigned int const key) const
+    Pixel<T, Geometry> const pixel(std::size_t const index) const
     {
-        assert(!pixels_.empty());
+        assert(index < hits_.size());
 
-        typename std::map<int, Pixel<T> >::iterator iter = pixels_.find(key);
-        if (key != pixels_.end()) {
-            return *iter;
-        } else {
-            std::cerr << "Couldn't find pixel: " << key << std::endl;
+        return Pixel<T, Geometry>(hits_[index]);
+    }
 
-            return Pixel<T>();
-        }
+    /**
+     * @brief       Retrieves the x position of a pixel
+     * @param index The position of the pixel, in the order it was added
+     * @return      The pixel's x position
+     */
+    T const x(std::size_t const index) const
+    {
+        assert(index < hits_.size());
+
+        return static_cast<T>(Geometry::x(Geometry::indexOf(hits_[index])));
+    }
+
+    /**
+     * @brief       Retrieves the y position of a pixel
+     * @param index The position of the pixel, in the order it was added
+     * @return      The pixel's y position
+     */
+    T const y(std::size_t const index) const
+    {
+        assert(index < hits_.size());
+
+        return static_cast<T>(Geometry::y(Geometry::indexOf(hits_[index])));
+    }
+
+    /**
+     * @brief       Retrieves the count value of a pixel
+     * @param index The position of the pixel, in the order it was added
+     * @return      The pixel's count value
+     */
+    T const c(std::size_t const index) const
+    {
+        assert(index < hits_.size());
+
+        return static_cast<T>(Geometry::totOf(hits_[index]));
+    }
+
+    /**
+     * @brief          Retrieves the linear index of a pixel on the detector
+     * @param position The position of the pixel, in the order it was added
+     * @return         The pixel's index, y * Geometry::WIDTH + x
+     */
+    std::uint32_t index(std::size_t const position) const
+    {
+        assert(position < hits_.size());
+
+        return Geometry::indexOf(hits_[position]);
+    }
 
+    /**
+     * @brief     Retrieves the number of pixels in the frame
+     * @return    The number of pixels
+     */
+    std::size_t size() const
+    {
+
+        return hits_.size();
     }
 
     /**
-     * @brief     Returns the pixel map
-     * @return    A map of pixels
+     * @brief     Checks whether the frame holds any pixels
+     * @return    Whether the frame is empty
      */
-    std::map<unsigned int, Pixel<T> > const getPixels() const
+    bool empty() const
     {
 
-        return pixels_;
+        return hits_.empty();
+    }
+
+    /**
+     * @brief     Retrieves an iterator to the frame's first pixel
+     * @return    An iterator yielding Pixel objects
+     */
+    const_iterator begin() const
+    {
+
+        return const_iterator(this, 0);
+    }
+
+    /**
+     * @brief     Retrieves an iterator to one past the frame's last pixel
+     * @return    An iterator yielding Pixel objects
+     */
+    const_iterator end() const
+    {
+
+        return const_iterator(this, hits_.size());
+    }
+
+    /**
+     * @brief     Retrieves the packed hit of every pixel
+     * @return    A view of the contiguous hits, each decoded by the Geometry
+     */
+    Span<std::uint32_t const> const hits() const
+    {
+
+        return Span<std::uint32_t const>(hits_.empty() ? 0 : &hits_[0], hits_.size());
+    }
+
+    /**
+     * @brief     Retrieves the number of clusters in the frame
+     * @return    The number of clusters
+     */
+    std::size_t numberOfClusters() const
+    {
+
+        return clusterOffsets_.size() - 1;
+    }
+
+    /**
+     * @brief     Retrieves the cluster offsets, where cluster i spans the
+     * pixels [offsets[i], offsets[i + 1])
+     * @return    A view of the numberOfClusters() + 1 offsets
+     */
+    Span<unsigned int const> const clusterOffsets() const
+    {
+
+        return Span<unsigned int const>(&clusterOffsets_[0], clusterOffsets_.size());
+    }
+
+    /**
+     * @brief         Retrieves the index of a cluster's first pixel
+     * @param cluster The cluster's position in the frame
+     * @return        The index of the cluster's first pixel
+     */
+    std::size_t clusterBegin(std::size_t const cluster) const
+    {
+        assert(cluster < numberOfClusters());
+
+        return clusterOffsets_[cluster];
+    }
+
+    /**
+     * @brief         Retrieves the index one past a cluster's last pixel
+     * @param cluster The cluster's position in the frame
+     * @return        The index one past the cluster's last pixel
+     */
+    std::size_t clusterEnd(std::size_t const cluster) const
+    {
+        assert(cluster < numberOfClusters());
+
+        return clusterOffsets_[cluster + 1];
     }
 
     /**
@@ -137,16 +324,120 @@ public:
     }
 
     /**
-     * @brief       Sets the pixel specified by the key, and creates a new pixel
-     * with that key if it doesn't exist already
-     * @param key   The pixel number to set in the map
-     * @param pixel The pixel data to add to the map
+     * @brief       Adds a pixel to the frame's last cluster (starting the
+     * first cluster if there is none yet)
+     * @param pixel The pixel data to add to the frame
      * @return      Nothing
      */
-    void setPixel(unsigned int const key, Pixel<T> const& pixel)
+    void addPixel(Pixel<T, Geometry> const& pixel)
     {
+        addHit(pixel.hit());
+    }
+
+    /**
+     * @brief       Adds a pixel to the frame's last cluster (starting the
+     * first cluster if there is none yet)
+     * @param x     The pixel's x position
+     * @param y     The pixel's y position
+     * @param c     The pixel's count value (saturated into Geometry::TOT_BITS)
+     * @return      Whether the pixel was added, which it is not when it lies
+     * off the detector
+     */
+    bool addPixel(T const x, T const y, T const c)
+    {
+        if (!Geometry::contains(static_cast<long long>(x), static_cast<long long>(y))) {
+            return false;
+        }
+
+        addHit(Geometry::pack(Geometry::index(static_cast<unsigned int>(x), static_cast<unsigned int>(y)),
+                              Pixel<T, Geometry>::saturate(c)));
+
+        return true;
+    }
+
+    /**
+     * @brief       Adds an already packed hit to the frame's last cluster
+     * (starting the first cluster if there is none yet)
+     * @param hit   The hit, as packed by Geometry::pack()
+     * @return      Nothing
+     */
+    void addHit(std::uint32_t const hit)
+    {
+        if (clusterOffsets_.size() == 1) {
+            clusterOffsets_.push_back(0);
+        }
 
-        pixels_[key] = pixel;
+        hits_.push_back(hit);
+        clusterOffsets_.back() = static_cast<unsigned int>(hits_.size());
+    }
+
+    /**
+     * @brief       Adds several already packed hits to the frame's last
+     * cluster at once (starting the first cluster if there is none yet)
+     * @param hits  The hits, as packed by Geometry::pack()
+     * @param count The number of hits
+     * @return      Nothing
+     */
+    void addHits(std::uint32_t const* hits, std::size_t const count)
+    {
+        if (clusterOffsets_.size() == 1) {
+            clusterOffsets_.push_back(0);
+        }
+
+        hits_.insert(hits_.end(), hits, hits + count);
+        clusterOffsets_.back() = static_cast<unsigned int>(hits_.size());
+    }
+
+    /**
+     * @brief       Starts a new, empty cluster which following pixels are
+     * added to
+     * @return      Nothing
+     */
+    void beginCluster()
+    {
+        // Drop a previous cluster that never got any pixels
+        if (clusterOffsets_.size() > 1
+                && clusterOffsets_.back() == clusterOffsets_[clusterOffsets_.size() - 2]) {
+            return;
+        }
+
+        clusterOffsets_.push_back(static_cast<unsigned int>(hits_.size()));
+    }
+
+    /**
+     * @brief       Drops the last cluster if it never got any pixels (as when
+     * every pixel of it was masked)
+     * @return      Nothing
+     */
+    void dropEmptyCluster()
+    {
+        if (clusterOffsets_.size() > 1
+                && clusterOffsets_.back() == clusterOffsets_[clusterOffsets_.size() - 2]) {
+            clusterOffsets_.pop_back();
+        }
+    }
+
+    /**
+     * @brief        Reserves room for the given number of pixels
+     * @param pixels The number of pixels to make room for
+     * @return       Nothing
+     */
+    void reserve(std::size_t const pixels)
+    {
+        hits_.reserve(pixels);
+    }
+
+    /**
+     * @brief     Removes every pixel and cluster and resets the meta-data,
+     * keeping the storage for reuse
+     * @return    Nothing
+     */
+    void clear()
+    {
+        hits_.clear();
+        clusterOffsets_.resize(1);
+        time_ = 0.0;
+        runningTime_ = 0.0;
     }
 
     /**
@@ -154,7 +445,7 @@ public:
      * @param time The time in seconds to set the time meta-data to
      * @return     Nothing
      */
-    void setTime(float const time)
+    void setTime(double const time)
     {
 
         time_ = time;
@@ -165,20 +456,18 @@ public:
      * @param runningTime The time in seconds to set the running time meta-data to
      * @return            Nothing
      */
-    void setRunningTime(float const runningTime)
+    void setRunningTime(double const runningTime)
     {
 
         runningTime_ = runningTime;
     }
 
-    template<class T2>
-    friend void swap(Frame<T2>&, Frame<T2>&);
+    template<class T2, class Geometry2>
+    friend void swap(Frame<T2, Geometry2>&, Frame<T2, Geometry2>&);
 
 private:
-    template<class T2>
-    friend std::ostream& operator<<(std::ostream&, Frame <T2> const&);
-
-    std::map<unsigned int, Pixel<T> > pixels_; // A map of the pixels in this frame
+    std::vector<std::uint32_t> hits_; // The packed hits of the pixels in this frame
+    std::vector<unsigned int> clusterOffsets_; // Where each cluster's pixels start, plus the end
     double time_; // Stores the time since the 'Dawn of Time' in seconds
     double runningTime_; // Stores the time since the detector started running
 };
@@ -190,11 +479,12 @@ private:
  * @param second The second object to swap
  * @return       Nothing
  */
-template <class T>
-void swap(Frame<T>& first, Frame<T>& second) // nothrow
+template <class T, class Geometry>
+void swap(Frame<T, Geometry>& first, Frame<T, Geometry>& second) // nothrow
 {
     using std::swap;
-    swap(first.pixels_, second.pixels_);
+    swap(first.hits_, second.hits_);
+    swap(first.clusterOffsets_, second.clusterOffsets_);
     swap(first.runningTime_, second.runningTime_);
     swap(first.time_, second.time_);
 }
@@ -207,22 +497,19 @@ void swap(Frame<T>& first, Frame<T>& second) // nothrow
  * @param frame  The frame of which data is being output
  * @return       A reference to the output stream
  */
-template<class T>
-std::ostream& operator<<(std::ostream& stream, Frame <T> const& frame)
+template<class T, class Geometry>
+std::ostream& operator<<(std::ostream& stream, Frame <T, Geometry> const& frame)
 {
     // Print the meta-data
     stream << "C Time: " << frame.getTime() << std::endl
             << "Running Time: " << frame.getRunningTime() << std::endl;
 
     // Iterate over the pixels and print their data
-    typename std::map< unsigned int, Pixel<T> >::const_iterator iter;
-    for (iter = frame.pixels_.begin();
-            iter != frame.pixels_.end();
-            ++iter) {
+    for (std::size_t i = 0; i < frame.size(); ++i) {
         stream << "No. "
-                << iter->first
+                << (i + 1)
                 << " Pixel:\n"
-                << iter->second;
+                << frame.pixel(i);
     }
 
     return stream;
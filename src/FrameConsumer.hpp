@@ -0,0 +1,89 @@
+/**
+ * @file        FrameConsumer.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the interface of the per-frame consumers which a frame
+ * pipeline streams the frames of a dataset through
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef FRAMECONSUMER_HPP
+#define FRAMECONSUMER_HPP
+
+// C++ headers
+#include <string>
+// My headers
+#include <Frame.hpp>
+
+/**
+ * @brief The details of a whole dataset, handed to the consumers once every
+ * frame has been streamed through them
+ */
+struct DatasetSummary {
+    std::string path; // The path of the cluster log
+    std::string detectorName; // The name of the detector used to create the dataset
+    std::string settings; // The settings used when generating the data
+    unsigned long long size; // The size of the cluster log in bytes
+    long long modified; // The modification time of the cluster log
+    unsigned long long numberOfLines; // The number of lines in the cluster log
+    unsigned long long numberOfFrames; // The number of frames in the cluster log
+};
+
+
+/**
+ * @brief This class is the interface for anything which analyses a dataset one
+ * frame at a time <br>
+ * A consumer sees every frame exactly once, in file order, and must not hold
+ * on to the frame after consume() returns, so the whole dataset never has to
+ * be kept in memory
+ */
+template <class T>
+class FrameConsumer {
+public:
+
+    /**
+     * @brief   The destructor for the FrameConsumer class
+     * @return  Nothing
+     */
+    virtual ~FrameConsumer()
+    {
+    }
+
+
+    /**
+     * @brief   Says whether the consumer needs the frames themselves, or only
+     * the dataset summary (which can be gathered without parsing any frames)
+     * @return  Whether the frames have to be parsed for this consumer
+     */
+    virtual bool needsFrames() const
+    {
+        return true;
+    }
+
+
+    /**
+     * @brief             Handles the next frame of the dataset
+     * @param frame       The frame, only valid for the duration of the call
+     * @param frameNumber The number of the frame, counted from 1
+     * @return            Nothing
+     */
+    virtual void consume(Frame<T> const& frame, unsigned int const frameNumber) = 0;
+
+
+    /**
+     * @brief         Handles the end of the dataset
+     * @param summary The details of the whole dataset
+     * @return        Nothing
+     */
+    virtual void finish(DatasetSummary const& summary)
+    {
+    }
+};
+
+
+#endif  /* FRAMECONSUMER_HPP */
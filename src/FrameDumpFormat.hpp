@@ -0,0 +1,124 @@
+/**
+ * @file        FrameDumpFormat.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the layout of the binary '.lolf' frame dumps written
+ * by the frame logger
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef FRAMEDUMPFORMAT_HPP
+#define FRAMEDUMPFORMAT_HPP
+
+// C++ headers
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+/**
+ * @brief The header at the start of a '.lolf' frame dump <br>
+ * The dump holds, in native byte order: <br>
+ * (1) this header <br>
+ * (2) a sequence of records, each starting with a DumpRecord and padded to
+ * 8 bytes: a dataset record holds the path of the cluster log the frame
+ * records after it belong to, and a frame record holds a DumpFrame, the
+ * frame's packed hits (uint32 each, the pixel index in the low indexBits bits
+ * and the ToT above) and its cluster offsets (uint32, one more than the
+ * number of clusters) <br>
+ * The frames of several datasets may interleave, in blocks which each start
+ * with their dataset's record
+ */
+struct DumpHeader {
+    char magic[4]; // Always "LOLF"
+    std::uint32_t byteOrder; // Always DUMP_BYTE_ORDER, written in native order
+    std::uint32_t version; // The version of the layout, DUMP_VERSION
+    std::uint32_t indexBits; // The bits of a hit holding its pixel index
+};
+
+
+/**
+ * @brief The start of every record in a frame dump
+ */
+struct DumpRecord {
+    std::uint32_t type; // The kind of record, DUMP_DATASET or DUMP_FRAME
+    std::uint32_t size; // The size of the whole record in bytes, padding included
+};
+
+
+/**
+ * @brief The details of a frame, following the DumpRecord of a frame record
+ */
+struct DumpFrame {
+    std::uint32_t frameNumber; // The number of the frame, counted from 1
+    std::uint32_t numberOfPixels; // The number of hits which follow
+    std::uint32_t numberOfClusters; // The number of clusters
+    std::uint32_t reserved; // Always 0
+    double time; // The time of the frame in seconds
+    double runningTime; // The running time of the frame in seconds
+};
+
+// The byte order marker, which reads differently on a foreign-endian machine
+static const std::uint32_t DUMP_BYTE_ORDER = 0x01020304u;
+// The current version of the dump layout
+static const std::uint32_t DUMP_VERSION = 1;
+// The type of the records naming a dataset
+static const std::uint32_t DUMP_DATASET = 1;
+// The type of the records holding a frame
+static const std::uint32_t DUMP_FRAME = 2;
+
+
+/**
+ * @brief       Rounds a record size up to the 8 bytes every record is
+ * padded to
+ * @param size  The unpadded size in bytes
+ * @return      The padded size in bytes
+ */
+inline std::size_t dumpPadded(std::size_t const size)
+{
+    return (size + 7) & ~static_cast<std::size_t>(7);
+}
+
+
+/**
+ * @brief           Builds the header of a frame dump
+ * @param indexBits The bits of a hit holding its pixel index
+ * @return          The header's bytes
+ */
+inline std::string const dumpHeader(std::uint32_t const indexBits)
+{
+    DumpHeader header;
+    std::memcpy(header.magic, "LOLF", 4);
+    header.byteOrder = DUMP_BYTE_ORDER;
+    header.version = DUMP_VERSION;
+    header.indexBits = indexBits;
+
+    return std::string(reinterpret_cast<char const*>(&header), sizeof(header));
+}
+
+
+/**
+ * @brief       Builds the record naming the dataset of the frames after it
+ * @param path  The path of the dataset's cluster log
+ * @return      The record's bytes
+ */
+inline std::string const dumpDatasetRecord(std::string const& path)
+{
+    DumpRecord record;
+    record.type = DUMP_DATASET;
+    record.size = static_cast<std::uint32_t>(dumpPadded(sizeof(record) + path.size()));
+
+    std::string bytes(record.size, '\0');
+    std::memcpy(&bytes[0], &record, sizeof(record));
+    path.copy(&bytes[sizeof(record)], path.size());
+
+    return bytes;
+}
+
+
+#endif  /* FRAMEDUMPFORMAT_HPP */
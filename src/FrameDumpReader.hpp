@@ -0,0 +1,242 @@
+/**
+ * @file        FrameDumpReader.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the reader decoding the binary '.lolf' frame dumps
+ * offline (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef FRAMEDUMPREADER_HPP
+#define FRAMEDUMPREADER_HPP
+
+// C++ headers
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <vector>
+#include <boost/interprocess/exceptions.hpp>
+// My headers
+#include <Frame.hpp>
+#include <MappedFile.hpp>
+#include <FrameDumpFormat.hpp>
+#include <FrameLogger.hpp>
+
+/**
+ * @brief This class maps a '.lolf' frame dump and rebuilds its frames one
+ * record at a time, along with the dataset each belongs to (class is
+ * non-copyable)
+ */
+template <class T>
+class FrameDumpReader {
+public:
+
+    /**
+     * @brief   An empty constructor for the FrameDumpReader class
+     * @return  A newly constructed FrameDumpReader object with no dump open
+     */
+    FrameDumpReader()
+        : position_(0), end_(0)
+    {
+    }
+
+
+    /**
+     * @brief      Opens a frame dump
+     * @param path The path of the dump
+     * @return     Nothing, throws std::ifstream::failure if the dump can't be
+     * read or wasn't written by this build
+     */
+    void open(std::string const& path)
+    {
+        try {
+            file_.open(path);
+        } catch (boost::interprocess::interprocess_exception const&) {
+            throw std::ifstream::failure("Couldn't open the frame dump '" + path + "'");
+        }
+
+        DumpHeader header;
+        if (file_.size() < sizeof(header)) {
+            throw std::ifstream::failure("'" + path + "' isn't a frame dump");
+        }
+        std::memcpy(&header, file_.begin(), sizeof(header));
+        if (std::memcmp(header.magic, "LOLF", 4) != 0
+                || header.byteOrder != DUMP_BYTE_ORDER
+                || header.version != DUMP_VERSION
+                || header.indexBits != TimepixGeometry::INDEX_BITS) {
+            throw std::ifstream::failure("'" + path + "' isn't a frame dump this build can read");
+        }
+
+        path_ = path;
+        position_ = file_.begin() + sizeof(header);
+        end_ = file_.end();
+    }
+
+
+    /**
+     * @brief             Reads the next frame of the dump
+     * @param frame       Set to the frame
+     * @param frameNumber Set to the number of the frame
+     * @return            Whether there was another frame, throws
+     * std::ifstream::failure if the dump is malformed
+     */
+    bool next(Frame<T>& frame, unsigned int& frameNumber)
+    {
+        while (position_ < end_) {
+            DumpRecord record;
+            if (static_cast<std::size_t>(end_ - position_) < sizeof(record)) {
+                malformed();
+            }
+            std::memcpy(&record, position_, sizeof(record));
+            if (record.size < sizeof(record) || record.size % 8
+                    || record.size > static_cast<std::size_t>(end_ - position_)) {
+                malformed();
+            }
+            char const* const body = position_ + sizeof(record);
+            position_ += record.size;
+
+            if (record.type == DUMP_DATASET) {
+                char const* const last = position_;
+                char const* const nul = static_cast<char const*>(std::memchr(body, '\0', last - body));
+                dataset_.assign(body, nul ? nul : last);
+            } else if (record.type == DUMP_FRAME) {
+                readFrame(body, record.size - sizeof(record), frame, frameNumber);
+                return true;
+            }
+            // Records of other types are skipped
+        }
+
+        return false;
+    }
+
+
+    /**
+     * @brief   Retrieves the dataset the last frame read belongs to
+     * @return  The path of the dataset's cluster log
+     */
+    std::string const& dataset() const
+    {
+        return dataset_;
+    }
+
+
+    /**
+     * @brief        Decodes the whole dump as the text a text frame log holds
+     * @param output The stream to write the text to
+     * @return       The number of frames decoded, throws std::ifstream::failure
+     * if the dump is malformed
+     */
+    unsigned long long decode(std::ostream& output)
+    {
+        // The text is gathered into a large buffer and written in blocks
+        static const std::size_t BLOCK_SIZE = 1 << 20;
+
+        std::vector<char> buffer;
+        buffer.reserve(2 * BLOCK_SIZE);
+
+        Frame<T> frame;
+        unsigned int frameNumber = 0;
+        unsigned long long frames = 0;
+        std::string dataset;
+        while (next(frame, frameNumber)) {
+            if (dataset != dataset_) {
+                dataset = dataset_;
+                std::string const line = "Frames of: " + dataset + "\n";
+                buffer.insert(buffer.end(), line.begin(), line.end());
+            }
+
+            std::size_t const used = buffer.size();
+            buffer.resize(used + FrameLogger<T>::textHeaderSize()
+                          + frame.size() * FrameLogger<T>::textPixelSize() + 1);
+            char* out = FrameLogger<T>::formatHeader(&buffer[used], frame, frameNumber);
+            for (std::size_t i = 0; i < frame.size(); ++i) {
+                out = FrameLogger<T>::formatPixel(out, frame, i);
+            }
+            *out++ = '\n';
+            buffer.resize(out - &buffer[0]);
+            frames++;
+
+            if (buffer.size() >= BLOCK_SIZE) {
+                output.write(&buffer[0], buffer.size());
+                buffer.clear();
+            }
+        }
+        if (!buffer.empty()) {
+            output.write(&buffer[0], buffer.size());
+        }
+
+        return frames;
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    FrameDumpReader(FrameDumpReader const& other);
+
+
+    // Assignment operator
+    FrameDumpReader& operator=(FrameDumpReader const& other);
+
+
+    // Utility Functions
+    void malformed() const
+    {
+        throw std::ifstream::failure("The frame dump '" + path_ + "' is malformed");
+    }
+
+
+    void readFrame(char const* body, std::size_t const size, Frame<T>& frame, unsigned int& frameNumber)
+    {
+        DumpFrame details;
+        if (size < sizeof(details)) {
+            malformed();
+        }
+        std::memcpy(&details, body, sizeof(details));
+        std::size_t const hitBytes = std::size_t(details.numberOfPixels) * sizeof(std::uint32_t);
+        std::size_t const offsetBytes = (std::size_t(details.numberOfClusters) + 1) * sizeof(std::uint32_t);
+        if (size - sizeof(details) < hitBytes + offsetBytes) {
+            malformed();
+        }
+
+        hits_.resize(details.numberOfPixels);
+        offsets_.resize(details.numberOfClusters + 1);
+        if (hitBytes) {
+            std::memcpy(&hits_[0], body + sizeof(details), hitBytes);
+        }
+        std::memcpy(&offsets_[0], body + sizeof(details) + hitBytes, offsetBytes);
+
+        // The frame's storage is kept between records
+        frame.clear();
+        frame.setTime(details.time);
+        frame.setRunningTime(details.runningTime);
+        for (std::size_t i = 0; i < details.numberOfClusters; ++i) {
+            if (offsets_[i] > offsets_[i + 1] || offsets_[i + 1] > hits_.size()) {
+                malformed();
+            }
+            frame.beginCluster();
+            if (offsets_[i + 1] > offsets_[i]) {
+                frame.addHits(&hits_[offsets_[i]], offsets_[i + 1] - offsets_[i]);
+            }
+        }
+        frameNumber = details.frameNumber;
+    }
+
+    std::string path_; // The path of the dump
+    MappedFile file_; // The mapped dump
+    char const* position_; // The next record
+    char const* end_; // One past the last byte of the dump
+    std::string dataset_; // The dataset of the last frame read
+    std::vector<std::uint32_t> hits_; // The staging area for a frame's hits
+    std::vector<std::uint32_t> offsets_; // The staging area for a frame's cluster offsets
+};
+
+
+#endif  /* FRAMEDUMPREADER_HPP */
@@ -0,0 +1,501 @@
+/**
+ * @file        FrameExporter.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the frame consumer exporting the parsed hits and frames
+ * for other tools, as CSV, as a binary columnar file or as a filtered cluster
+ * log (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef FRAMEEXPORTER_HPP
+#define FRAMEEXPORTER_HPP
+
+// C++ headers
+#include <string>
+#include <sstream>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+// My headers
+#include <Frame.hpp>
+#include <FrameConsumer.hpp>
+#include <AsyncLog.hpp>
+#include <ColumnarFormat.hpp>
+#include <FastNumber.hpp>
+
+/**
+ * @brief The forms a FrameExporter can write
+ */
+enum ExportFormat {
+    EXPORT_HITS_CSV, // A CSV row per hit: frame,cluster,x,y,tot
+    EXPORT_FRAMES_CSV, // A CSV row per frame: frame,time,running_time,hits,clusters
+    EXPORT_COLUMNS, // A binary '.lolx' columnar file (see ColumnarFormat.hpp)
+    EXPORT_CLUSTER_LOG // A cluster log, in the format the readers parse
+};
+
+
+/**
+ * @brief This class exports every frame streamed through it, keeping only the
+ * clusters within a range of sizes <br>
+ * The hits a mask drops and the frames outside a time range never reach the
+ * consumer, so together with the pipeline's range and the parser's mask it
+ * re-emits a filtered dataset. The rows are formatted without allocating,
+ * straight into the chunks of an AsyncLog of its own whose thread writes
+ * them out several megabytes at a time; the columnar form gathers its
+ * columns into blocks of a fixed number of rows first (class is non-copyable)
+ */
+template <class T>
+class FrameExporter : public FrameConsumer<T> {
+public:
+
+    /**
+     * @brief                    A constructor for the FrameExporter class,
+     * which creates the export's file
+     * @param path               The path of the file to export to
+     * @param format             The form to export in
+     * @param minimumClusterSize The fewest pixels a cluster must have to be
+     * exported
+     * @param maximumClusterSize The most pixels a cluster may have to be
+     * exported
+     * @return                   A newly constructed FrameExporter object,
+     * throws std::ifstream::failure if the file can't be created
+     */
+    FrameExporter(std::string const& path,
+                  ExportFormat const format,
+                  unsigned int const minimumClusterSize = 1,
+                  unsigned int const maximumClusterSize = std::numeric_limits<unsigned int>::max())
+        : path_(path), format_(format),
+        minimumClusterSize_(minimumClusterSize ? minimumClusterSize : 1),
+        maximumClusterSize_(maximumClusterSize),
+        log_(new AsyncLog(path, header(format), CHUNK_SIZE, MAXIMUM_CHUNKS)),
+        producer_(&log_->addProducer()), isClosed_(false),
+        frames_(0), hits_(0), clusters_(0), bytes_(0)
+    {
+        if (format_ == EXPORT_COLUMNS) {
+            hitFrames_.reserve(HIT_BLOCK_ROWS);
+            hitClusters_.reserve(HIT_BLOCK_ROWS);
+            hitX_.reserve(HIT_BLOCK_ROWS);
+            hitY_.reserve(HIT_BLOCK_ROWS);
+            hitToT_.reserve(HIT_BLOCK_ROWS);
+            frameNumbers_.reserve(FRAME_BLOCK_ROWS);
+            frameHits_.reserve(FRAME_BLOCK_ROWS);
+            frameClusters_.reserve(FRAME_BLOCK_ROWS);
+            frameTimes_.reserve(FRAME_BLOCK_ROWS);
+            frameRunningTimes_.reserve(FRAME_BLOCK_ROWS);
+        }
+    }
+
+
+    /**
+     * @brief   The destructor for the FrameExporter class, which writes out
+     * whatever was exported if the dataset was never finished
+     * @return  Nothing
+     */
+    virtual ~FrameExporter()
+    {
+        if (!isClosed_) {
+            isClosed_ = true;
+            producer_->close();
+        }
+    }
+
+
+    /**
+     * @brief             Exports the frame and its clusters within the size
+     * range
+     * @param frame       The frame
+     * @param frameNumber The number of the frame
+     * @return            Nothing
+     */
+    virtual void consume(Frame<T> const& frame, unsigned int const frameNumber)
+    {
+        std::size_t hits = 0;
+        std::size_t clusters = 0;
+        for (std::size_t i = 0; i < frame.numberOfClusters(); ++i) {
+            std::size_t const size = frame.clusterEnd(i) - frame.clusterBegin(i);
+            if (isExported(size)) {
+                hits += size;
+                clusters++;
+            }
+        }
+
+        switch (format_) {
+        case EXPORT_HITS_CSV:
+            writeHitRows(frame, frameNumber);
+            break;
+        case EXPORT_FRAMES_CSV:
+            writeFrameRow(frame, frameNumber, hits, clusters);
+            break;
+        case EXPORT_COLUMNS:
+            addColumns(frame, frameNumber, hits, clusters);
+            break;
+        case EXPORT_CLUSTER_LOG:
+            writeClusterLog(frame, frameNumber);
+            break;
+        }
+
+        frames_++;
+        hits_ += hits;
+        clusters_ += clusters;
+    }
+
+
+    /**
+     * @brief         Writes out the rest of the export and closes its file
+     * @param summary The details of the whole dataset
+     * @return        Nothing, throws std::ifstream::failure if the file
+     * couldn't be written
+     */
+    virtual void finish(DatasetSummary const& summary)
+    {
+        if (isClosed_) {
+            return;
+        }
+
+        if (format_ == EXPORT_COLUMNS) {
+            writeHitBlock();
+            writeFrameBlock();
+        }
+        isClosed_ = true;
+        producer_->close();
+        bytes_ = log_->close();
+    }
+
+
+    /**
+     * @brief   Summarises what was exported and where
+     * @return  The number of frames, hits and clusters exported, and the
+     * file written
+     */
+    std::string const report() const
+    {
+        std::ostringstream report;
+        report << frames_ << " frames, " << hits_ << " hits in " << clusters_
+               << " clusters exported as " << formatName(format_) << " to " << path_
+               << " (" << bytes_ << " bytes)";
+
+        return report.str();
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    FrameExporter(FrameExporter const& other);
+
+
+    // Assignment operator
+    FrameExporter& operator=(FrameExporter const& other);
+
+
+    // The size of the chunks the rows are formatted into, and the most of
+    // them in flight before the exporter waits for the disk
+    static const std::size_t CHUNK_SIZE = 4 << 20;
+    static const std::size_t MAXIMUM_CHUNKS = 4;
+    // The rows of each columnar block, which must fit in a chunk
+    static const std::size_t HIT_BLOCK_ROWS = 1 << 16;
+    static const std::size_t FRAME_BLOCK_ROWS = 1 << 14;
+    // The most bytes a row or a line of text can take
+    static const std::size_t ROW_SIZE = 128;
+
+
+    // Utility Functions
+    static std::string const header(ExportFormat const format)
+    {
+        switch (format) {
+        case EXPORT_HITS_CSV:
+            return "frame,cluster,x,y,tot\n";
+        case EXPORT_FRAMES_CSV:
+            return "frame,time,running_time,hits,clusters\n";
+        case EXPORT_COLUMNS:
+            return columnarHeader();
+        default:
+            return std::string();
+        }
+    }
+
+
+    static char const* formatName(ExportFormat const format)
+    {
+        switch (format) {
+        case EXPORT_HITS_CSV:
+            return "hit CSV";
+        case EXPORT_FRAMES_CSV:
+            return "frame CSV";
+        case EXPORT_COLUMNS:
+            return "columns";
+        default:
+            return "a cluster log";
+        }
+    }
+
+
+    template <std::size_t N>
+    static char* append(char* out, char const (&text)[N])
+    {
+        std::memcpy(out, text, N - 1);
+
+        return out + N - 1;
+    }
+
+
+    static char* formatTime(char* out, double const time)
+    {
+        // Written to 7 decimals as the logs are, less any trailing zeros
+        out = FastNumber::formatFixed(out, time, 7);
+        while (out[-1] == '0' && out[-2] != '.') {
+            out--;
+        }
+
+        return out;
+    }
+
+
+    bool isExported(std::size_t const size) const
+    {
+        return size >= minimumClusterSize_ && size <= maximumClusterSize_;
+    }
+
+
+    void writeHitRows(Frame<T> const& frame, unsigned int const frameNumber)
+    {
+        Span<std::uint32_t const> const hits = frame.hits();
+        for (std::size_t i = 0; i < frame.numberOfClusters(); ++i) {
+            std::size_t const begin = frame.clusterBegin(i);
+            std::size_t const end = frame.clusterEnd(i);
+            if (!isExported(end - begin)) {
+                continue;
+            }
+
+            for (std::size_t j = begin; j < end; ++j) {
+                std::uint32_t const position = TimepixGeometry::indexOf(hits[j]);
+                char* const first = producer_->reserve(ROW_SIZE);
+                char* out = FastNumber::formatUnsigned(first, frameNumber);
+                *out++ = ',';
+                out = FastNumber::formatUnsigned(out, i + 1);
+                *out++ = ',';
+                out = FastNumber::formatUnsigned(out, TimepixGeometry::x(position));
+                *out++ = ',';
+                out = FastNumber::formatUnsigned(out, TimepixGeometry::y(position));
+                *out++ = ',';
+                out = FastNumber::formatUnsigned(out, TimepixGeometry::totOf(hits[j]));
+                *out++ = '\n';
+                producer_->commit(out - first);
+            }
+        }
+    }
+
+
+    void writeFrameRow(Frame<T> const& frame, unsigned int const frameNumber,
+                       std::size_t const hits, std::size_t const clusters)
+    {
+        char* const first = producer_->reserve(ROW_SIZE);
+        char* out = FastNumber::formatUnsigned(first, frameNumber);
+        *out++ = ',';
+        out = FastNumber::formatFixed(out, frame.getTime(), 7);
+        *out++ = ',';
+        out = FastNumber::formatFixed(out, frame.getRunningTime(), 7);
+        *out++ = ',';
+        out = FastNumber::formatUnsigned(out, hits);
+        *out++ = ',';
+        out = FastNumber::formatUnsigned(out, clusters);
+        *out++ = '\n';
+        producer_->commit(out - first);
+    }
+
+
+    void writeClusterLog(Frame<T> const& frame, unsigned int const frameNumber)
+    {
+        // 'Frame 1 (1335967757.2905033 s, 0.1 s)', a line of '[x, y, c] '
+        // triples per cluster, then a blank line ending the frame
+        char* first = producer_->reserve(ROW_SIZE);
+        char* out = append(first, "Frame ");
+        out = FastNumber::formatUnsigned(out, frameNumber);
+        out = append(out, " (");
+        out = formatTime(out, frame.getTime());
+        out = append(out, " s, ");
+        out = formatTime(out, frame.getRunningTime());
+        out = append(out, " s)\n");
+        producer_->commit(out - first);
+
+        Span<std::uint32_t const> const hits = frame.hits();
+        for (std::size_t i = 0; i < frame.numberOfClusters(); ++i) {
+            std::size_t const begin = frame.clusterBegin(i);
+            std::size_t const end = frame.clusterEnd(i);
+            if (!isExported(end - begin)) {
+                continue;
+            }
+
+            for (std::size_t j = begin; j < end; ++j) {
+                std::uint32_t const position = TimepixGeometry::indexOf(hits[j]);
+                first = producer_->reserve(ROW_SIZE);
+                out = first;
+                *out++ = '[';
+                out = FastNumber::formatUnsigned(out, TimepixGeometry::x(position));
+                out = append(out, ", ");
+                out = FastNumber::formatUnsigned(out, TimepixGeometry::y(position));
+                out = append(out, ", ");
+                out = FastNumber::formatUnsigned(out, TimepixGeometry::totOf(hits[j]));
+                out = append(out, "] ");
+                producer_->commit(out - first);
+            }
+            producer_->append("\n", 1);
+        }
+        producer_->append("\n", 1);
+    }
+
+
+    void addColumns(Frame<T> const& frame, unsigned int const frameNumber,
+                    std::size_t const hits, std::size_t const clusters)
+    {
+        Span<std::uint32_t const> const packed = frame.hits();
+        for (std::size_t i = 0; i < frame.numberOfClusters(); ++i) {
+            std::size_t const begin = frame.clusterBegin(i);
+            std::size_t const end = frame.clusterEnd(i);
+            if (!isExported(end - begin)) {
+                continue;
+            }
+
+            for (std::size_t j = begin; j < end; ++j) {
+                std::uint32_t const position = TimepixGeometry::indexOf(packed[j]);
+                hitFrames_.push_back(frameNumber);
+                hitClusters_.push_back(static_cast<std::uint32_t>(i + 1));
+                hitX_.push_back(static_cast<std::uint16_t>(TimepixGeometry::x(position)));
+                hitY_.push_back(static_cast<std::uint16_t>(TimepixGeometry::y(position)));
+                hitToT_.push_back(static_cast<std::uint16_t>(TimepixGeometry::totOf(packed[j])));
+                if (hitFrames_.size() == HIT_BLOCK_ROWS) {
+                    writeHitBlock();
+                }
+            }
+        }
+
+        frameNumbers_.push_back(frameNumber);
+        frameHits_.push_back(static_cast<std::uint32_t>(hits));
+        frameClusters_.push_back(static_cast<std::uint32_t>(clusters));
+        frameTimes_.push_back(frame.getTime());
+        frameRunningTimes_.push_back(frame.getRunningTime());
+        if (frameNumbers_.size() == FRAME_BLOCK_ROWS) {
+            writeFrameBlock();
+        }
+    }
+
+
+    template <class Value>
+    static char* appendColumn(char* out, std::vector<Value> const& column)
+    {
+        std::size_t const size = column.size() * sizeof(Value);
+        std::size_t const padded = columnarPadded(size);
+        if (size) {
+            std::memcpy(out, &column[0], size);
+        }
+        std::memset(out + size, 0, padded - size);
+
+        return out + padded;
+    }
+
+
+    template <class Value>
+    static std::size_t columnSize(std::vector<Value> const& column)
+    {
+        return columnarPadded(column.size() * sizeof(Value));
+    }
+
+
+    char* beginBlock(std::uint32_t const type, std::size_t const rows, std::size_t const size)
+    {
+        // Reserves the whole block, whose columns follow the header returned
+        ColumnarBlock block;
+        block.type = type;
+        block.rows = static_cast<std::uint32_t>(rows);
+        block.size = sizeof(block) + size;
+
+        char* const first = producer_->reserve(block.size);
+        std::memcpy(first, &block, sizeof(block));
+
+        return first;
+    }
+
+
+    void writeHitBlock()
+    {
+        if (hitFrames_.empty()) {
+            return;
+        }
+
+        std::size_t const size = columnSize(hitFrames_) + columnSize(hitClusters_)
+                + columnSize(hitX_) + columnSize(hitY_) + columnSize(hitToT_);
+        char* const first = beginBlock(COLUMNAR_HITS, hitFrames_.size(), size);
+        char* out = first + sizeof(ColumnarBlock);
+        out = appendColumn(out, hitFrames_);
+        out = appendColumn(out, hitClusters_);
+        out = appendColumn(out, hitX_);
+        out = appendColumn(out, hitY_);
+        out = appendColumn(out, hitToT_);
+        producer_->commit(out - first);
+
+        hitFrames_.clear();
+        hitClusters_.clear();
+        hitX_.clear();
+        hitY_.clear();
+        hitToT_.clear();
+    }
+
+
+    void writeFrameBlock()
+    {
+        if (frameNumbers_.empty()) {
+            return;
+        }
+
+        std::size_t const size = columnSize(frameNumbers_) + columnSize(frameHits_)
+                + columnSize(frameClusters_) + columnSize(frameTimes_) + columnSize(frameRunningTimes_);
+        char* const first = beginBlock(COLUMNAR_FRAMES, frameNumbers_.size(), size);
+        char* out = first + sizeof(ColumnarBlock);
+        out = appendColumn(out, frameNumbers_);
+        out = appendColumn(out, frameHits_);
+        out = appendColumn(out, frameClusters_);
+        out = appendColumn(out, frameTimes_);
+        out = appendColumn(out, frameRunningTimes_);
+        producer_->commit(out - first);
+
+        frameNumbers_.clear();
+        frameHits_.clear();
+        frameClusters_.clear();
+        frameTimes_.clear();
+        frameRunningTimes_.clear();
+    }
+
+    std::string path_; // The path of the export
+    ExportFormat format_; // The form exported in
+    unsigned int minimumClusterSize_; // The fewest pixels of an exported cluster
+    unsigned int maximumClusterSize_; // The most pixels of an exported cluster
+    std::unique_ptr<AsyncLog> log_; // The export's file, written by its own thread
+    AsyncLog::Producer* producer_; // The producer the rows are formatted into
+    bool isClosed_; // Whether the producer was handed back to the log
+    unsigned long long frames_; // The number of frames exported
+    unsigned long long hits_; // The number of hits exported
+    unsigned long long clusters_; // The number of clusters exported
+    unsigned long long bytes_; // The size of the export once written
+    std::vector<std::uint32_t> hitFrames_; // The frame column of the hit block being gathered
+    std::vector<std::uint32_t> hitClusters_; // The cluster column of the hit block
+    std::vector<std::uint16_t> hitX_; // The x column of the hit block
+    std::vector<std::uint16_t> hitY_; // The y column of the hit block
+    std::vector<std::uint16_t> hitToT_; // The ToT column of the hit block
+    std::vector<std::uint32_t> frameNumbers_; // The frame column of the frame block being gathered
+    std::vector<std::uint32_t> frameHits_; // The hits column of the frame block
+    std::vector<std::uint32_t> frameClusters_; // The clusters column of the frame block
+    std::vector<double> frameTimes_; // The time column of the frame block
+    std::vector<double> frameRunningTimes_; // The running time column of the frame block
+};
+
+
+#endif  /* FRAMEEXPORTER_HPP */
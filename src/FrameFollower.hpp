@@ -0,0 +1,419 @@
+/**
+ * @file        FrameFollower.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the class following a cluster log which is still being
+ * written, parsing its frames as they are appended (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef FRAMEFOLLOWER_HPP
+#define FRAMEFOLLOWER_HPP
+
+// C++ headers
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <boost/filesystem.hpp>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+// My headers
+#include <Frame.hpp>
+#include <ClusterLogParser.hpp>
+
+/**
+ * @brief This class follows a growing cluster log from a byte offset, parsing
+ * only the frames appended since it last looked <br>
+ * A frame only counts as complete once the blank line ending it has been
+ * written, so a frame the detector is still writing is held back (along with
+ * any partial line) until the next look, and is never parsed half written
+ * <br>
+ * The file is watched with inotify where it is available, so a new frame is
+ * picked up as soon as it is written; elsewhere the file's size is polled
+ * (class is non-copyable)
+ */
+template <class T>
+class FrameFollower {
+public:
+
+    /**
+     * @brief            A constructor for the FrameFollower class
+     * @param path       The path of the cluster log to follow
+     * @param offset     The byte offset to start from, which has to be the
+     * start of a frame (such as the offset of an earlier follower)
+     * @param firstLine  The line number of the line at the offset
+     * @return           A newly constructed FrameFollower object
+     */
+    explicit FrameFollower(std::string const& path,
+                           unsigned long long const offset = 0,
+                           unsigned int const firstLine = 1)
+        : path_(path), offset_(offset), lineNumber_(firstLine), frames_(0), hits_(0),
+        readSize_(1 << 22), watcher_(-1)
+    {
+        boost::filesystem::path const filePath(path);
+        detectorName_ = filePath.parent_path().parent_path().parent_path().filename().string();
+        settings_ = filePath.parent_path().filename().string();
+        parser_.setRejectedHits(&rejected_);
+    }
+
+
+    /**
+     * @brief   The destructor for the FrameFollower class, which stops
+     * watching the file
+     * @return  Nothing
+     */
+    ~FrameFollower()
+    {
+#if defined(__linux__)
+        if (watcher_ >= 0) {
+            ::close(watcher_);
+        }
+#endif
+    }
+
+
+    /**
+     * @brief   Starts watching the file for changes
+     * @return  Nothing, throws std::ifstream::failure if the file doesn't
+     * exist
+     */
+    void open()
+    {
+        boost::system::error_code error;
+        if (!boost::filesystem::is_regular_file(path_, error)) {
+            throw std::ifstream::failure("Data file '" + path_ + "' doesn't exist!");
+        }
+
+#if defined(__linux__)
+        if (watcher_ < 0) {
+            watcher_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (watcher_ >= 0
+                    && inotify_add_watch(watcher_, path_.c_str(),
+                                         IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB
+                                         | IN_MOVE_SELF | IN_DELETE_SELF) < 0) {
+                // Fall back to polling the file's size
+                ::close(watcher_);
+                watcher_ = -1;
+            }
+        }
+#endif
+    }
+
+
+    /**
+     * @brief      Sets the mask of pixels whose hits are dropped as the frames
+     * are parsed
+     * @param mask The mask, which has to outlive the follower, or null to keep
+     * every hit
+     * @return     Nothing
+     */
+    void setMask(PixelMask<> const* mask)
+    {
+        parser_.setMask(mask);
+    }
+
+
+    /**
+     * @brief          Sets whether a hit lying off the detector's matrix fails
+     * the follow as malformed data, rather than being dropped and counted
+     * @param isStrict Whether to throw on such a hit
+     * @return         Nothing
+     */
+    void setStrict(bool const isStrict)
+    {
+        rejected_.setStrict(isStrict);
+    }
+
+
+    /**
+     * @brief         Parses every complete frame appended since the last
+     * poll, handing each to the callback in file order
+     * @param onFrame A callable taking (Frame<T> const&, unsigned int
+     * frameNumber), where frames are numbered from 1 across every poll
+     * @return        The number of frames parsed, throws
+     * std::ifstream::failure if the file can't be read, has shrunk or holds
+     * malformed data
+     */
+    template <class Callback>
+    unsigned int poll(Callback onFrame)
+    {
+        boost::system::error_code error;
+        unsigned long long const size = boost::filesystem::file_size(path_, error);
+        if (error) {
+            throw std::ifstream::failure("Couldn't read the size of '" + path_ + "': " + error.message());
+        }
+
+        unsigned long long read = offset_ + pending_.size();
+        if (size < read) {
+            std::ostringstream o;
+            o << "Data file '" << path_ << "' shrank below the " << read << " bytes already read";
+            throw std::ifstream::failure(o.str());
+        }
+
+        std::ifstream in;
+        if (size > read) {
+            in.open(path_.c_str(), std::ifstream::in | std::ifstream::binary);
+            if (!in.is_open()) {
+                throw std::ifstream::failure("Couldn't open '" + path_ + "' for reading");
+            }
+            in.seekg(static_cast<std::streamoff>(read), std::ios::beg);
+        }
+
+        // Read in bounded chunks, so catching up on a large file never holds
+        // all of it in memory
+        unsigned int parsed = 0;
+        while (size > read) {
+            std::size_t const chunk = size - read < readSize_ ? static_cast<std::size_t>(size - read) : readSize_;
+            std::size_t const held = pending_.size();
+            pending_.resize(held + chunk);
+            in.read(&pending_[held], chunk);
+            std::size_t const got = static_cast<std::size_t>(in.gcount());
+            pending_.resize(held + got);
+            if (got == 0) {
+                break;
+            }
+            read += got;
+
+            parsed += parseComplete(onFrame, completeEnd());
+        }
+
+        return parsed;
+    }
+
+
+    /**
+     * @brief         Parses whatever is left once the file has stopped
+     * growing as the final frame, as the last frame of a finished file need
+     * not be followed by a blank line (a trailing partial line is dropped)
+     * @param onFrame A callable taking (Frame<T> const&, unsigned int frameNumber)
+     * @return        The number of frames parsed, throws
+     * std::ifstream::failure on malformed data
+     */
+    template <class Callback>
+    unsigned int drain(Callback onFrame)
+    {
+        std::size_t end = pending_.size();
+        while (end > 0 && pending_[end - 1] != '\n') {
+            end--;
+        }
+
+        return parseComplete(onFrame, end);
+    }
+
+
+    /**
+     * @brief              Waits for the file to change
+     * @param milliseconds The longest time to wait
+     * @return             Whether the file (may have) changed
+     */
+    bool wait(unsigned int const milliseconds)
+    {
+#if defined(__linux__)
+        if (watcher_ >= 0) {
+            struct pollfd watched = { watcher_, POLLIN, 0 };
+            int const ready = ::poll(&watched, 1, static_cast<int>(milliseconds));
+
+            // Drain the events, only their arrival matters
+            char events[4096];
+            while (::read(watcher_, events, sizeof(events)) > 0) {
+            }
+
+            return ready > 0;
+        }
+#endif
+        std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+
+        boost::system::error_code error;
+        return boost::filesystem::file_size(path_, error) != offset_ + pending_.size() || error;
+    }
+
+
+    /**
+     * @brief   Checks whether the file is watched with inotify rather than
+     * polled
+     * @return  Whether changes are notified
+     */
+    bool isNotified() const
+    {
+        return watcher_ >= 0;
+    }
+
+
+    /**
+     * @brief   A getter for the path of the followed file
+     * @return  The path
+     */
+    std::string const& path() const
+    {
+        return path_;
+    }
+
+
+    /**
+     * @brief   A getter for the detector name, taken from the path layout
+     * 'data/Detector/Data/settings/ClusterLogAll.txt'
+     * @return  The detector name
+     */
+    std::string const& detectorName() const
+    {
+        return detectorName_;
+    }
+
+
+    /**
+     * @brief   A getter for the settings string, taken from the path layout
+     * @return  The settings string
+     */
+    std::string const& settings() const
+    {
+        return settings_;
+    }
+
+
+    /**
+     * @brief   A getter for the byte offset following the last complete frame
+     * parsed, from which a later follower can carry on
+     * @return  The byte offset
+     */
+    unsigned long long offset() const
+    {
+        return offset_;
+    }
+
+
+    /**
+     * @brief   A getter for the line number at the offset
+     * @return  The line number of the next line to be parsed
+     */
+    unsigned int lineNumber() const
+    {
+        return lineNumber_;
+    }
+
+
+    /**
+     * @brief   A getter for the number of frames parsed so far
+     * @return  The number of frames
+     */
+    unsigned long long numberOfFrames() const
+    {
+        return frames_;
+    }
+
+
+    /**
+     * @brief   A getter for the number of hits in the frames parsed so far
+     * @return  The number of hits
+     */
+    unsigned long long numberOfHits() const
+    {
+        return hits_;
+    }
+
+
+    /**
+     * @brief   A getter for the number of hits dropped so far for lying off
+     * the detector's matrix
+     * @return  The number of hits
+     */
+    unsigned long long numberOfRejectedHits() const
+    {
+        return rejected_.count();
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    FrameFollower(FrameFollower const& other);
+
+
+    // Assignment operator
+    FrameFollower& operator=(FrameFollower const& other);
+
+
+    // Utility Functions
+    std::size_t completeEnd() const
+    {
+        // Finds the end of the last complete frame held, just past the blank
+        // line (holding at most whitespace) ending it, or 0 if no frame is
+        // complete yet
+
+        std::size_t lineEnd = pending_.size();
+        while (lineEnd > 0 && pending_[lineEnd - 1] != '\n') {
+            lineEnd--;
+        }
+
+        while (lineEnd > 0) {
+            std::size_t lineStart = lineEnd - 1;
+            bool isBlank = true;
+            while (lineStart > 0 && pending_[lineStart - 1] != '\n') {
+                char const c = pending_[--lineStart];
+                isBlank = isBlank && (c == ' ' || c == '\t' || c == '\r');
+            }
+            if (isBlank) {
+                return lineEnd;
+            }
+            lineEnd = lineStart;
+        }
+
+        return 0;
+    }
+
+
+    template <class Callback>
+    unsigned int parseComplete(Callback& onFrame, std::size_t const end)
+    {
+        // Parses the complete frames at the front of the held bytes and
+        // moves the offset past them
+
+        if (end == 0) {
+            return 0;
+        }
+
+        char const* begin = &pending_[0];
+        parser_.reset(begin, begin + end, lineNumber_);
+        unsigned int parsed = 0;
+        while (!parser_.atEnd()) {
+            frame_.clear();
+            parser_.parseFrame(frame_);
+            hits_ += frame_.size();
+            onFrame(frame_, static_cast<unsigned int>(++frames_));
+            parsed++;
+        }
+
+        lineNumber_ = parser_.lineNumber();
+        offset_ += end;
+        pending_.erase(pending_.begin(), pending_.begin() + end);
+
+        return parsed;
+    }
+
+    std::string path_; // The path of the followed file
+    std::string detectorName_; // The name of the detector, from the path
+    std::string settings_; // The settings string, from the path
+    unsigned long long offset_; // The byte offset following the last complete frame
+    unsigned int lineNumber_; // The line number at the offset
+    unsigned long long frames_; // The number of frames parsed
+    unsigned long long hits_; // The number of hits in those frames
+    std::size_t readSize_; // The most bytes read at once
+    std::vector<char> pending_; // The bytes read past the offset (incomplete frames)
+    RejectedHits rejected_; // The tally of hits dropped off the matrix
+    ClusterLogParser<T> parser_; // The parser of the complete frames
+    Frame<T> frame_; // The frame refilled for every frame parsed
+    int watcher_; // The inotify descriptor, or -1 when polling
+};
+
+
+#endif  /* FRAMEFOLLOWER_HPP */
@@ -0,0 +1,212 @@
+/**
+ * @file        FrameIndex.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the index of where each frame of a cluster log starts
+ * and when it was taken, for seeking by frame number or time
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef FRAMEINDEX_HPP
+#define FRAMEINDEX_HPP
+
+// C++ headers
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+// My headers
+#include <ByteScanner.hpp>
+#include <FastNumber.hpp>
+
+/**
+ * @brief A run of consecutive frames, numbered from 1 as the readers number
+ * them, covering [first, last)
+ */
+struct FrameRange {
+    unsigned long long first; // The number of the first frame in the range
+    unsigned long long last; // One past the number of the last frame in the range
+};
+
+
+/**
+ * @brief This class holds the byte offset and time of every frame of a cluster
+ * log, so any frame or acquisition window can be reached without parsing the
+ * frames before it
+ */
+class FrameIndex {
+public:
+
+    /**
+     * @brief   An empty constructor for the FrameIndex class
+     * @return  A newly constructed, empty FrameIndex object
+     */
+    FrameIndex()
+        : isSorted_(true)
+    {
+    }
+
+
+    /**
+     * @brief       Builds the index with one vectorized pass over the cluster
+     * log's bytes, reading only the frame header lines
+     * @param begin The first byte of the cluster log
+     * @param end   One past the last byte of the cluster log
+     * @return      The line and frame counts gathered by the same pass
+     */
+    ScanResult build(char const* begin, char const* end)
+    {
+        clear();
+        return ByteScanner::scan(begin, end, HeaderRecorder(*this, begin, end));
+    }
+
+
+    /**
+     * @brief       Appends a frame to the index
+     * @param offset The byte offset of the frame's header in the cluster log
+     * @param time  The frame's time in seconds
+     * @return      Nothing
+     */
+    void add(unsigned long long const offset, double const time)
+    {
+        if (!times_.empty() && time < times_.back()) {
+            isSorted_ = false;
+        }
+
+        offsets_.push_back(offset);
+        times_.push_back(time);
+    }
+
+
+    /**
+     * @brief   Empties the index
+     * @return  Nothing
+     */
+    void clear()
+    {
+        offsets_.clear();
+        times_.clear();
+        isSorted_ = true;
+    }
+
+
+    /**
+     * @brief   Retrieves the number of frames in the index
+     * @return  The number of frames
+     */
+    unsigned long long size() const
+    {
+        return offsets_.size();
+    }
+
+
+    /**
+     * @brief             Retrieves the byte offset of a frame's header
+     * @param frameNumber The number of the frame, counted from 1
+     * @return            The byte offset in the cluster log
+     */
+    unsigned long long offset(unsigned long long const frameNumber) const
+    {
+        assert(frameNumber >= 1 && frameNumber <= size());
+
+        return offsets_[frameNumber - 1];
+    }
+
+
+    /**
+     * @brief             Retrieves a frame's time
+     * @param frameNumber The number of the frame, counted from 1
+     * @return            The frame's time in seconds
+     */
+    double time(unsigned long long const frameNumber) const
+    {
+        assert(frameNumber >= 1 && frameNumber <= size());
+
+        return times_[frameNumber - 1];
+    }
+
+
+    /**
+     * @brief    Finds the frames taken within a window of time <br>
+     * Frames are logged in acquisition order, so this is a binary search; if
+     * the times turn out not to be in order, the smallest range holding every
+     * frame in the window is found by a linear search instead
+     * @param t0 The start of the window in seconds (inclusive)
+     * @param t1 The end of the window in seconds (exclusive)
+     * @return   The range of frames in the window, empty if there are none
+     */
+    FrameRange framesInTimeRange(double const t0, double const t1) const
+    {
+        FrameRange range = { 1, 1 };
+
+        if (isSorted_) {
+            range.first = (std::lower_bound(times_.begin(), times_.end(), t0) - times_.begin()) + 1;
+            range.last = (std::lower_bound(times_.begin(), times_.end(), t1) - times_.begin()) + 1;
+            if (range.last < range.first) {
+                range.last = range.first;
+            }
+        } else {
+            bool isFound = false;
+            for (std::size_t i = 0; i < times_.size(); ++i) {
+                if (times_[i] >= t0 && times_[i] < t1) {
+                    if (!isFound) {
+                        range.first = i + 1;
+                        isFound = true;
+                    }
+                    range.last = i + 2;
+                }
+            }
+        }
+
+        return range;
+    }
+
+private:
+
+    /**
+     * @brief This class adds each frame header found by the byte scanner to
+     * the index
+     */
+    class HeaderRecorder {
+    public:
+        HeaderRecorder(FrameIndex& index, char const* begin, char const* end)
+            : index_(index), begin_(begin), end_(end)
+        {
+        }
+
+        void operator()(char const* header) const
+        {
+            // The time follows the opening parenthesis of the header line
+            char const* lineEnd = static_cast<char const*>(std::memchr(header, '\n', end_ - header));
+            if (!lineEnd) {
+                lineEnd = end_;
+            }
+
+            double time = 0.0;
+            char const* pos = static_cast<char const*>(std::memchr(header, '(', lineEnd - header));
+            if (pos) {
+                pos++;
+                FastNumber::parseDecimal(pos, lineEnd, time);
+            }
+
+            index_.add(header - begin_, time);
+        }
+
+    private:
+        FrameIndex& index_; // The index being built
+        char const* begin_; // The first byte of the cluster log
+        char const* end_; // One past the last byte of the cluster log
+    };
+
+    std::vector<unsigned long long> offsets_; // The byte offsets of the frame headers
+    std::vector<double> times_; // The times of the frames
+    bool isSorted_; // Whether the times never decrease
+};
+
+
+#endif  /* FRAMEINDEX_HPP */
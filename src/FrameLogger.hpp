@@ -0,0 +1,273 @@
+/**
+ * @file        FrameLogger.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the frame consumer writing the details of every frame
+ * to an asynchronous log, as text or as a binary frame dump
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef FRAMELOGGER_HPP
+#define FRAMELOGGER_HPP
+
+// C++ headers
+#include <string>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+// My headers
+#include <FrameConsumer.hpp>
+#include <AsyncLog.hpp>
+#include <FrameDumpFormat.hpp>
+#include <FastNumber.hpp>
+
+/**
+ * @brief This class formats the details of every frame streamed through it
+ * straight into its own producer of an AsyncLog, which a background thread
+ * writes out <br>
+ * As text every pixel is written in full, and as a binary '.lolf' dump (see
+ * FrameDumpFormat.hpp) each frame is copied as is, for decoding offline with
+ * a FrameDumpReader; the consumer must be used from a single thread, as the
+ * frame pipeline does (class is non-copyable)
+ */
+template <class T>
+class FrameLogger : public FrameConsumer<T> {
+public:
+
+    /**
+     * @brief          A constructor for the FrameLogger class
+     * @param log      The log to write into, which must outlive the logger
+     * (its file must start with dumpHeader() when writing a binary dump)
+     * @param dataset  The path of the dataset being logged, which starts every
+     * block of its frames
+     * @param isBinary Whether to write a binary dump rather than text
+     * @return         A newly constructed FrameLogger object
+     */
+    FrameLogger(AsyncLog& log, std::string const& dataset, bool const isBinary)
+        : producer_(log.addProducer(isBinary ? dumpDatasetRecord(dataset)
+                                             : "Frames of: " + dataset + "\n")),
+        isBinary_(isBinary), isClosed_(false)
+    {
+    }
+
+
+    /**
+     * @brief   The destructor for the FrameLogger class, which hands whatever
+     * is left to the log
+     * @return  Nothing
+     */
+    virtual ~FrameLogger()
+    {
+        close();
+    }
+
+
+    /**
+     * @brief             Logs the details of the frame
+     * @param frame       The frame
+     * @param frameNumber The number of the frame
+     * @return            Nothing, throws std::ifstream::failure if a binary
+     * frame is too large for the log's chunks
+     */
+    virtual void consume(Frame<T> const& frame, unsigned int const frameNumber)
+    {
+        if (isBinary_) {
+            logBinary(frame, frameNumber);
+        } else {
+            logText(frame, frameNumber);
+        }
+    }
+
+
+    /**
+     * @brief         Hands the last of the frames to the log
+     * @param summary The details of the whole dataset
+     * @return        Nothing
+     */
+    virtual void finish(DatasetSummary const& summary)
+    {
+        close();
+    }
+
+
+    /**
+     * @brief       Retrieves the most bytes the text of a frame's header can
+     * take
+     * @return      The number of bytes
+     */
+    static std::size_t textHeaderSize()
+    {
+        return 128;
+    }
+
+
+    /**
+     * @brief       Retrieves the most bytes the text of one pixel can take
+     * @return      The number of bytes
+     */
+    static std::size_t textPixelSize()
+    {
+        return 128;
+    }
+
+
+    /**
+     * @brief             Formats the header of a frame as text
+     * @param out         Where to write, with room for textHeaderSize() bytes
+     * @param frame       The frame
+     * @param frameNumber The number of the frame
+     * @return            One past the last byte written
+     */
+    static char* formatHeader(char* out, Frame<T> const& frame, unsigned int const frameNumber)
+    {
+        out = append(out, "Frame no: ");
+        out = FastNumber::formatUnsigned(out, frameNumber);
+        out = append(out, "\nC Time: ");
+        out = FastNumber::formatFixed(out, frame.getTime(), 7);
+        out = append(out, "\nRunning Time: ");
+        out = FastNumber::formatFixed(out, frame.getRunningTime(), 7);
+        *out++ = '\n';
+
+        return out;
+    }
+
+
+    /**
+     * @brief       Formats one pixel of a frame as text
+     * @param out   Where to write, with room for textPixelSize() bytes
+     * @param frame The frame
+     * @param index The position of the pixel in the frame
+     * @return      One past the last byte written
+     */
+    static char* formatPixel(char* out, Frame<T> const& frame, std::size_t const index)
+    {
+        std::uint32_t const hit = frame.hits()[index];
+        std::uint32_t const position = TimepixGeometry::indexOf(hit);
+
+        out = append(out, "No. ");
+        out = FastNumber::formatUnsigned(out, index + 1);
+        out = append(out, " Pixel:\nx = ");
+        out = FastNumber::formatUnsigned(out, TimepixGeometry::x(position));
+        out = append(out, "\ny = ");
+        out = FastNumber::formatUnsigned(out, TimepixGeometry::y(position));
+        out = append(out, "\nc = ");
+        out = FastNumber::formatUnsigned(out, TimepixGeometry::totOf(hit));
+        out = append(out, "\nxy = ");
+        out = FastNumber::formatUnsigned(out, position);
+        *out++ = '\n';
+
+        return out;
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    FrameLogger(FrameLogger const& other);
+
+
+    // Assignment operator
+    FrameLogger& operator=(FrameLogger const& other);
+
+
+    // Utility Functions
+    template <std::size_t N>
+    static char* append(char* out, char const (&text)[N])
+    {
+        std::memcpy(out, text, N - 1);
+
+        return out + N - 1;
+    }
+
+
+    void close()
+    {
+        if (!isClosed_) {
+            isClosed_ = true;
+            producer_.close();
+        }
+    }
+
+
+    void logText(Frame<T> const& frame, unsigned int const frameNumber)
+    {
+        // A frame whose text fits in a chunk is written as one record, so it
+        // is never split by another producer's frames; a larger one is written
+        // a pixel at a time
+        std::size_t const size = textHeaderSize() + frame.size() * textPixelSize() + 1;
+        if (size <= producer_.capacity()) {
+            char* const first = producer_.reserve(size);
+            char* out = formatHeader(first, frame, frameNumber);
+            for (std::size_t i = 0; i < frame.size(); ++i) {
+                out = formatPixel(out, frame, i);
+            }
+            *out++ = '\n';
+            producer_.commit(out - first);
+            return;
+        }
+
+        char* first = producer_.reserve(textHeaderSize());
+        producer_.commit(formatHeader(first, frame, frameNumber) - first);
+        for (std::size_t i = 0; i < frame.size(); ++i) {
+            first = producer_.reserve(textPixelSize());
+            producer_.commit(formatPixel(first, frame, i) - first);
+        }
+        producer_.append("\n", 1);
+    }
+
+
+    void logBinary(Frame<T> const& frame, unsigned int const frameNumber)
+    {
+        Span<std::uint32_t const> const hits = frame.hits();
+        Span<unsigned int const> const offsets = frame.clusterOffsets();
+        std::size_t const hitBytes = hits.size() * sizeof(std::uint32_t);
+        std::size_t const offsetBytes = offsets.size() * sizeof(std::uint32_t);
+        std::size_t const size = dumpPadded(sizeof(DumpRecord) + sizeof(DumpFrame) + hitBytes + offsetBytes);
+        if (size > producer_.capacity()) {
+            throw std::ifstream::failure("Frame too large for the frame dump");
+        }
+
+        DumpRecord record;
+        record.type = DUMP_FRAME;
+        record.size = static_cast<std::uint32_t>(size);
+
+        DumpFrame details;
+        details.frameNumber = frameNumber;
+        details.numberOfPixels = static_cast<std::uint32_t>(hits.size());
+        details.numberOfClusters = static_cast<std::uint32_t>(frame.numberOfClusters());
+        details.reserved = 0;
+        details.time = frame.getTime();
+        details.runningTime = frame.getRunningTime();
+
+        char* const first = producer_.reserve(size);
+        char* out = first;
+        std::memcpy(out, &record, sizeof(record));
+        out += sizeof(record);
+        std::memcpy(out, &details, sizeof(details));
+        out += sizeof(details);
+        if (hitBytes) {
+            std::memcpy(out, hits.begin(), hitBytes);
+            out += hitBytes;
+        }
+        for (std::size_t i = 0; i < offsets.size(); ++i) {
+            std::uint32_t const offset = offsets[i];
+            std::memcpy(out, &offset, sizeof(offset));
+            out += sizeof(offset);
+        }
+        std::memset(out, 0, first + size - out);
+        producer_.commit(size);
+    }
+
+    AsyncLog::Producer& producer_; // The producer the frames are formatted into
+    bool isBinary_; // Whether a binary dump is written rather than text
+    bool isClosed_; // Whether the producer was handed back to the log
+};
+
+
+#endif  /* FRAMELOGGER_HPP */
@@ -0,0 +1,393 @@
+/**
+ * @file        FramePipeline.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the class streaming the frames of a dataset through a
+ * set of frame consumers
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef FRAMEPIPELINE_HPP
+#define FRAMEPIPELINE_HPP
+
+// C++ headers
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <boost/filesystem.hpp>
+// My headers
+#include <Frame.hpp>
+#include <FrameConsumer.hpp>
+#include <TextFileReader.hpp>
+#include <FrameIndex.hpp>
+#include <FrameFollower.hpp>
+#include <StageStats.hpp>
+
+/**
+ * @brief This class streams each frame of a dataset through every registered
+ * consumer and then drops it, so a run takes the same memory whatever the
+ * size of the file <br>
+ * When none of the consumers need the frames themselves, the file is only
+ * scanned and no frame is ever parsed
+ */
+template <class T>
+class FramePipeline {
+public:
+
+    /**
+     * @brief   An empty constructor for the FramePipeline class
+     * @return  A newly constructed FramePipeline object with no consumers
+     */
+    FramePipeline()
+        : isRanged_(false)
+    {
+    }
+
+
+    /**
+     * @brief       Restricts the frames streamed to a range, which is reached
+     * through the frame index without reading the frames before it
+     * @param range The range of frames to stream
+     * @return      Nothing
+     */
+    void setRange(FrameRange const& range)
+    {
+        range_ = range;
+        isRanged_ = true;
+    }
+
+
+    /**
+     * @brief          Registers a consumer to stream the frames through
+     * @param consumer The consumer, which is handed the frames in the order
+     * the consumers were added
+     * @param stage    The stage the consumer's time counts towards in the
+     * statistics
+     * @return         Nothing
+     */
+    void addConsumer(std::shared_ptr<FrameConsumer<T> > const& consumer,
+                     Stage const stage = STAGE_ANALYSIS)
+    {
+        consumers_.push_back(consumer);
+        stages_.push_back(stage);
+    }
+
+
+    /**
+     * @brief         Streams every remaining frame of the input through the
+     * consumers, then hands them the dataset summary
+     * @param input   The opened input file
+     * @param threads The number of threads to parse with
+     * @param pipelined Whether to read and parse on their own threads
+     * instead (ignoring the number of threads, and unavailable for ranges)
+     * @return        The number of frames streamed (or counted, if none of
+     * the consumers needed them)
+     */
+    unsigned long long run(TextFileReader<T>& input,
+                           unsigned int const threads,
+                           bool const pipelined = false)
+    {
+        DatasetSummary summary;
+        summary.path = input.path();
+        summary.detectorName = input.detectorName();
+        summary.settings = input.settings();
+        summary.size = input.size();
+        summary.modified = input.modified();
+
+        unsigned long long streamed = 0;
+        if (needsFrames()) {
+            // The consumers' time is measured frame by frame and taken out of
+            // the parsing stage
+            StageTimer parse(STAGE_PARSE);
+            Consumed consumed;
+            Dispatcher dispatch(consumers_, stages_, parse.isActive() ? &consumed : 0);
+
+            if (isRanged_) {
+                streamed = input.forEachFrameInRange(range_, threads, dispatch);
+                summary.numberOfFrames = input.numberOfFrames();
+            } else if (pipelined) {
+                summary.numberOfFrames = input.forEachFramePipelined(dispatch);
+            } else if (threads > 1) {
+                summary.numberOfFrames = input.forEachFrame(threads, dispatch);
+            } else {
+                // One frame is refilled for every frame of the file
+                Frame<T> frame;
+                unsigned int frameNumber = 0;
+                while (!input.endOfStream()) {
+                    input.getFrame(frame);
+                    dispatch(frame, ++frameNumber);
+                }
+                summary.numberOfFrames = frameNumber;
+            }
+            // The lines are counted after the frames, as a compressed file
+            // only has them counted as it is streamed
+            summary.numberOfLines = input.numberOfLines();
+            if (!isRanged_) {
+                streamed = summary.numberOfFrames;
+                parse.count(summary.size, summary.numberOfLines);
+            }
+            parse.reject(input.numberOfRejectedHits());
+
+            finish(summary, parse.isActive() ? &consumed : 0);
+            recordConsumed(parse, consumed);
+        } else {
+            summary.numberOfLines = input.numberOfLines();
+            summary.numberOfFrames = input.numberOfFrames();
+            streamed = summary.numberOfFrames;
+
+            finish(summary, 0);
+        }
+
+        return streamed;
+    }
+
+    /**
+     * @brief             Follows a growing cluster log, streaming each frame
+     * through the consumers as soon as it is complete, until told to stop or
+     * until the file stops growing, then hands them the dataset summary
+     * @param input       The opened follower
+     * @param idleTimeout The seconds the file may go without a new frame
+     * before it counts as finished (0 to follow until stopped)
+     * @param isStopping  A callable returning whether to stop following
+     * @param onProgress  A callable taking (FrameFollower<T> const&), called
+     * after every look at the file that found new frames
+     * @return            The number of frames streamed, throws
+     * std::ifstream::failure if the file can't be read or holds malformed
+     * data
+     */
+    template <class Stop, class Progress>
+    unsigned long long follow(FrameFollower<T>& input,
+                              double const idleTimeout,
+                              Stop isStopping,
+                              Progress onProgress)
+    {
+        // The longest wait between looks, so a stop is noticed promptly even
+        // when the file is quiet
+        static const unsigned int WAIT_MILLISECONDS = 200;
+
+        // The parsing stage leaves out the waits for the file to grow, as
+        // well as the consumers' time
+        StageTimer parse(STAGE_PARSE);
+        Consumed consumed;
+        StageTotals waited = StageStats::zero();
+        Dispatcher dispatch(consumers_, stages_, parse.isActive() ? &consumed : 0);
+
+        std::chrono::steady_clock::time_point lastFrame = std::chrono::steady_clock::now();
+        for (;;) {
+            if (input.poll(dispatch)) {
+                lastFrame = std::chrono::steady_clock::now();
+                onProgress(input);
+            }
+            if (isStopping()) {
+                break;
+            }
+            double const idle = std::chrono::duration<double>(std::chrono::steady_clock::now() - lastFrame).count();
+            if (idleTimeout > 0.0 && idle >= idleTimeout) {
+                break;
+            }
+            if (parse.isActive()) {
+                StageSample const start = StageStats::processSample();
+                input.wait(WAIT_MILLISECONDS);
+                StageStats::addElapsed(start, StageStats::processSample(), waited);
+            } else {
+                input.wait(WAIT_MILLISECONDS);
+            }
+        }
+
+        // The last frame of a finished file may lack its blank line
+        if (input.drain(dispatch)) {
+            onProgress(input);
+        }
+
+        DatasetSummary summary;
+        boost::system::error_code error;
+        summary.path = input.path();
+        summary.detectorName = input.detectorName();
+        summary.settings = input.settings();
+        summary.size = input.offset();
+        summary.modified = boost::filesystem::last_write_time(input.path(), error);
+        summary.numberOfLines = input.lineNumber() - 1;
+        summary.numberOfFrames = input.numberOfFrames();
+        parse.count(summary.size, summary.numberOfLines);
+        parse.reject(input.numberOfRejectedHits());
+        parse.exclude(waited);
+
+        finish(summary, parse.isActive() ? &consumed : 0);
+        recordConsumed(parse, consumed);
+
+        return summary.numberOfFrames;
+    }
+
+private:
+
+    // Every how many frames the consumers' CPU time is sampled, as the
+    // thread's CPU clock costs a system call to read
+    static const unsigned long long CPU_SAMPLE_INTERVAL = 16;
+
+
+    /**
+     * @brief The time the consumers' stages took while the frames were
+     * streamed
+     */
+    struct Consumed {
+        Consumed()
+            : frames(0)
+        {
+            for (int i = 0; i < NUMBER_OF_STAGES; ++i) {
+                consumed[i] = StageStats::zero();
+                finished[i] = StageStats::zero();
+                sampledWall[i] = 0.0;
+                sampledCpu[i] = 0.0;
+            }
+        }
+
+        StageTotals consumed[NUMBER_OF_STAGES]; // The totals of the consume() calls (the parsing stage's being the frames handed over)
+        StageTotals finished[NUMBER_OF_STAGES]; // The totals of the finish() calls
+        double sampledWall[NUMBER_OF_STAGES]; // The elapsed time of the sampled consume() calls
+        double sampledCpu[NUMBER_OF_STAGES]; // The CPU time of the sampled consume() calls
+        unsigned long long frames; // The number of frames handed over
+    };
+
+
+    /**
+     * @brief This class hands a frame to each of the consumers in turn <br>
+     * With the statistics on, it also times each consumer towards its stage;
+     * the consumers' CPU time is only read every CPU_SAMPLE_INTERVAL frames,
+     * and estimated from their elapsed time in between
+     */
+    class Dispatcher {
+    public:
+        Dispatcher(std::vector<std::shared_ptr<FrameConsumer<T> > > const& consumers,
+                   std::vector<Stage> const& stages,
+                   Consumed* consumed)
+            : consumers_(consumers), stages_(stages), consumed_(consumed)
+        {
+        }
+
+        void operator()(Frame<T> const& frame, unsigned int const frameNumber) const
+        {
+            if (consumed_) {
+                measure(frame, frameNumber);
+                return;
+            }
+
+            for (std::size_t i = 0; i < consumers_.size(); ++i) {
+                consumers_[i]->consume(frame, frameNumber);
+            }
+        }
+
+    private:
+        void measure(Frame<T> const& frame, unsigned int const frameNumber) const
+        {
+            bool const isSampled = consumed_->frames++ % CPU_SAMPLE_INTERVAL == 0;
+            consumed_->consumed[STAGE_PARSE].frames++;
+            consumed_->consumed[STAGE_PARSE].pixels += frame.size();
+
+            // Each stage counts the frame once, however many of its
+            // consumers see it
+            unsigned int counted = 1u << STAGE_PARSE;
+            StageSample before = StageStats::threadSample(isSampled);
+            for (std::size_t i = 0; i < consumers_.size(); ++i) {
+                consumers_[i]->consume(frame, frameNumber);
+
+                StageSample const after = StageStats::threadSample(isSampled);
+                Stage const stage = stages_[i];
+                StageTotals& totals = consumed_->consumed[stage];
+                double const wall = std::chrono::duration<double>(after.wall - before.wall).count();
+                totals.wallSeconds += wall;
+                totals.allocations += after.allocations - before.allocations;
+                totals.allocatedBytes += after.allocatedBytes - before.allocatedBytes;
+                if (isSampled) {
+                    consumed_->sampledWall[stage] += wall;
+                    consumed_->sampledCpu[stage] += after.cpuSeconds - before.cpuSeconds;
+                }
+                if (!(counted & (1u << stage))) {
+                    counted |= 1u << stage;
+                    totals.frames++;
+                    totals.pixels += frame.size();
+                }
+                before = after;
+            }
+        }
+
+        std::vector<std::shared_ptr<FrameConsumer<T> > > const& consumers_;
+        std::vector<Stage> const& stages_;
+        Consumed* consumed_;
+    };
+
+
+    void finish(DatasetSummary const& summary, Consumed* consumed)
+    {
+        // Hands every consumer the dataset summary, timing each one towards
+        // its stage if the statistics are on
+
+        for (std::size_t i = 0; i < consumers_.size(); ++i) {
+            if (!consumed) {
+                consumers_[i]->finish(summary);
+                continue;
+            }
+
+            StageSample const before = StageStats::processSample();
+            consumers_[i]->finish(summary);
+            StageStats::addElapsed(before, StageStats::processSample(), consumed->finished[stages_[i]]);
+        }
+    }
+
+
+    void recordConsumed(StageTimer& parse, Consumed const& consumed) const
+    {
+        // Records the consumers' stages, less the parsing stage they ran
+        // inside
+
+        if (!parse.isActive()) {
+            return;
+        }
+
+        parse.count(0, 0, consumed.consumed[STAGE_PARSE].frames, consumed.consumed[STAGE_PARSE].pixels);
+        for (int i = 0; i < NUMBER_OF_STAGES; ++i) {
+            if (i == STAGE_PARSE || std::find(stages_.begin(), stages_.end(), i) == stages_.end()) {
+                continue;
+            }
+
+            StageTotals totals = consumed.consumed[i];
+            if (consumed.sampledWall[i] > 0.0) {
+                totals.cpuSeconds = totals.wallSeconds * consumed.sampledCpu[i] / consumed.sampledWall[i];
+            }
+            StageStats::add(consumed.finished[i], totals);
+            totals.runs = 1;
+            parse.exclude(totals);
+            StageStats::record(static_cast<Stage>(i), totals);
+        }
+        parse.end();
+    }
+
+
+    bool needsFrames() const
+    {
+        for (std::size_t i = 0; i < consumers_.size(); ++i) {
+            if (consumers_[i]->needsFrames()) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    std::vector<std::shared_ptr<FrameConsumer<T> > > consumers_; // The consumers to stream through
+    std::vector<Stage> stages_; // The stage each consumer's time counts towards
+    FrameRange range_; // The range of frames to stream
+    bool isRanged_; // Whether only the range is streamed
+};
+
+
+template <class T>
+const unsigned long long FramePipeline<T>::CPU_SAMPLE_INTERVAL;
+
+
+#endif  /* FRAMEPIPELINE_HPP */
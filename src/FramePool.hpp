@@ -0,0 +1,151 @@
+/**
+ * @file        FramePool.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the pool recycling frames so their storage is reused
+ * rather than reallocated (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef FRAMEPOOL_HPP
+#define FRAMEPOOL_HPP
+
+// C++ headers
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cassert>
+// My headers
+#include <Frame.hpp>
+
+/**
+ * @brief This class owns a set of frames and hands them out for reuse <br>
+ * A released frame keeps the capacity of its hit array, so once the pool holds
+ * as many frames as are ever in flight, and each has grown to the largest
+ * frame seen, filling a frame allocates nothing <br>
+ * Frames may be released from any thread (class is non-copyable)
+ */
+template <class T>
+class FramePool {
+public:
+
+    /**
+     * @brief   An empty constructor for the FramePool class
+     * @return  A newly constructed FramePool object holding no frames
+     */
+    FramePool()
+    {
+    }
+
+
+    /**
+     * @brief   The destructor for the FramePool class, which frees every frame
+     * it owns (none of them may still be in use)
+     * @return  Nothing
+     */
+    ~FramePool()
+    {
+    }
+
+
+    /**
+     * @brief   Takes an empty frame out of the pool, creating one if none are
+     * free
+     * @return  A pointer to the frame, owned by the pool
+     */
+    Frame<T>* acquire()
+    {
+        Frame<T>* frame = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (free_.empty()) {
+                frames_.push_back(std::unique_ptr<Frame<T> >(new Frame<T>()));
+                free_.reserve(frames_.size());
+                return frames_.back().get();
+            }
+            frame = free_.back();
+            free_.pop_back();
+        }
+
+        // Cleared outside the lock, on the thread about to fill it
+        frame->clear();
+
+        return frame;
+    }
+
+
+    /**
+     * @brief       Hands a frame back to the pool
+     * @param frame The frame, which must have come from this pool's acquire()
+     * @return      Nothing
+     */
+    void release(Frame<T>* frame)
+    {
+        assert(frame);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(frame);
+    }
+
+
+    /**
+     * @brief        Hands several frames back to the pool at once
+     * @param frames The frames, which must have come from this pool's
+     * acquire() (emptied, keeping its capacity)
+     * @return       Nothing
+     */
+    void release(std::vector<Frame<T>*>& frames)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            free_.insert(free_.end(), frames.begin(), frames.end());
+        }
+        frames.clear();
+    }
+
+
+    /**
+     * @brief   Retrieves the number of frames the pool owns
+     * @return  The number of frames, free or in use
+     */
+    std::size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        return frames_.size();
+    }
+
+
+    /**
+     * @brief   Retrieves the number of frames free to be acquired
+     * @return  The number of free frames
+     */
+    std::size_t available() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        return free_.size();
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    FramePool(FramePool const& other);
+
+
+    // Assignment operator
+    FramePool& operator=(FramePool const& other);
+
+    mutable std::mutex mutex_; // Guards the frame lists
+    std::vector<std::unique_ptr<Frame<T> > > frames_; // Every frame the pool owns
+    std::vector<Frame<T>*> free_; // The frames free to be acquired
+};
+
+
+#endif  /* FRAMEPOOL_HPP */
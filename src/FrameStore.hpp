@@ -0,0 +1,110 @@
+/**
+ * @file        FrameStore.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the frame consumer keeping a copy of every frame, for
+ * the analyses which really do need the whole dataset in memory
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef FRAMESTORE_HPP
+#define FRAMESTORE_HPP
+
+// C++ headers
+#include <vector>
+#include <cassert>
+// My headers
+#include <FrameConsumer.hpp>
+
+/**
+ * @brief This class keeps a copy of every frame streamed through it (memory
+ * use grows with the dataset, so only add it when it is really needed) <br>
+ * The frames keep their numbers in the file, so a range of frames which
+ * doesn't start at the first is looked up by the same numbers it was read by
+ */
+template <class T>
+class FrameStore : public FrameConsumer<T> {
+public:
+
+    /**
+     * @brief   An empty constructor for the FrameStore class
+     * @return  A newly constructed, empty FrameStore object
+     */
+    FrameStore()
+        : firstFrameNumber_(0)
+    {
+    }
+
+
+    /**
+     * @brief             Keeps a copy of the frame
+     * @param frame       The frame
+     * @param frameNumber The number of the frame
+     * @return            Nothing
+     */
+    virtual void consume(Frame<T> const& frame, unsigned int const frameNumber)
+    {
+        if (frames_.empty()) {
+            firstFrameNumber_ = frameNumber;
+        }
+        assert(frameNumber == firstFrameNumber_ + frames_.size());
+
+        frames_.push_back(frame);
+    }
+
+
+    /**
+     * @brief             Retrieves a stored frame
+     * @param frameNumber The number of the frame in the file, counted from 1,
+     * from firstFrameNumber() to lastFrameNumber()
+     * @return            A reference to the frame
+     */
+    Frame<T> const& frame(unsigned int const frameNumber) const
+    {
+        assert(frameNumber >= firstFrameNumber_ && frameNumber - firstFrameNumber_ < frames_.size());
+
+        return frames_[frameNumber - firstFrameNumber_];
+    }
+
+
+    /**
+     * @brief   Retrieves the number of the first stored frame
+     * @return  The frame's number in the file, or 0 if none are stored
+     */
+    unsigned int firstFrameNumber() const
+    {
+        return firstFrameNumber_;
+    }
+
+
+    /**
+     * @brief   Retrieves the number of the last stored frame
+     * @return  The frame's number in the file, or 0 if none are stored
+     */
+    unsigned int lastFrameNumber() const
+    {
+        return frames_.empty() ? 0 : firstFrameNumber_ + static_cast<unsigned int>(frames_.size()) - 1;
+    }
+
+
+    /**
+     * @brief   Retrieves the number of stored frames
+     * @return  The number of frames
+     */
+    std::size_t size() const
+    {
+        return frames_.size();
+    }
+
+private:
+    std::vector<Frame<T> > frames_; // The stored frames, in file order
+    unsigned int firstFrameNumber_; // The number of the first stored frame
+};
+
+
+#endif  /* FRAMESTORE_HPP */
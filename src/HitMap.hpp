@@ -0,0 +1,313 @@
+/**
+ * @file        HitMap.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the integrated hit map of the pixel matrix (the hits
+ * and summed ToT of every pixel), its images and the '.lolp' file it is saved
+ * as (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef HITMAP_HPP
+#define HITMAP_HPP
+
+// C++ headers
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+// My headers
+#include <AlignedBuffer.hpp>
+#include <DetectorGeometry.hpp>
+#include <ImageWriter.hpp>
+
+/**
+ * @brief The header at the start of a '.lolp' hit map file <br>
+ * The file holds, in native byte order: <br>
+ * (1) this header <br>
+ * (2) the number of hits on each pixel (uint64, width * height of them in
+ * index order, y * width + x) <br>
+ * (3) the summed ToT of each pixel (uint64, in the same order)
+ */
+struct HitMapHeader {
+    char magic[4]; // Always "LOLP"
+    std::uint32_t byteOrder; // Always HIT_MAP_BYTE_ORDER, written in native order
+    std::uint32_t version; // The version of the layout, HIT_MAP_VERSION
+    std::uint32_t width; // The number of pixel columns
+    std::uint32_t height; // The number of pixel rows
+    std::uint32_t reserved; // Padding, always 0
+    std::uint64_t numberOfFrames; // The number of frames mapped
+};
+
+// The byte order marker, which reads differently on a foreign-endian machine
+static const std::uint32_t HIT_MAP_BYTE_ORDER = 0x01020304u;
+// The current version of the hit map layout
+static const std::uint32_t HIT_MAP_VERSION = 1;
+
+
+/**
+ * @brief What a hit map image shows
+ */
+enum HitMapQuantity {
+    HIT_MAP_HITS, // The number of hits on each pixel
+    HIT_MAP_TOT, // The summed ToT of each pixel
+    HIT_MAP_MEAN_TOT // The mean ToT of each pixel's hits
+};
+
+
+/**
+ * @brief The totals of one pixel of a hit map
+ */
+struct HitMapPixel {
+    std::uint64_t hits; // The number of hits on the pixel
+    std::uint64_t tot; // The summed ToT of the hits
+};
+
+
+/**
+ * @brief This class counts the hits and sums the ToT of every pixel of the
+ * matrix (as indexed by Pixel::xy()) <br>
+ * A pixel's totals sit side by side, so filling a hit touches one cache line,
+ * and the totals start on a cache line, so maps filled by different threads
+ * never share one (class is non-copyable)
+ */
+class HitMap {
+public:
+
+    /**
+     * @brief   An empty constructor for the HitMap class
+     * @return  A newly constructed HitMap object with every total at zero
+     */
+    HitMap()
+        : pixels_(TimepixGeometry::PIXELS), frames_(0)
+    {
+    }
+
+
+    /**
+     * @brief   The destructor for the HitMap class
+     * @return  Nothing
+     */
+    ~HitMap()
+    {
+    }
+
+
+    /**
+     * @brief       Adds packed hits to the map
+     * @param hits  The hits, as packed by TimepixGeometry::pack()
+     * @param count The number of hits
+     * @return      Nothing
+     */
+    void fill(std::uint32_t const* hits, std::size_t const count)
+    {
+        HitMapPixel* pixels = pixels_.data();
+        for (std::size_t i = 0; i < count; ++i) {
+            HitMapPixel& pixel = pixels[TimepixGeometry::indexOf(hits[i])];
+            pixel.hits++;
+            pixel.tot += TimepixGeometry::totOf(hits[i]);
+        }
+    }
+
+
+    /**
+     * @brief        Counts frames towards the total mapped
+     * @param frames The number of frames
+     * @return       Nothing
+     */
+    void addFrames(unsigned long long const frames)
+    {
+        frames_ += frames;
+    }
+
+
+    /**
+     * @brief       Adds the totals of another map to this one
+     * @param other The other map
+     * @return      Nothing
+     */
+    void merge(HitMap const& other)
+    {
+        HitMapPixel* pixels = pixels_.data();
+        HitMapPixel const* otherPixels = other.pixels_.data();
+        for (unsigned int i = 0; i < TimepixGeometry::PIXELS; ++i) {
+            pixels[i].hits += otherPixels[i].hits;
+            pixels[i].tot += otherPixels[i].tot;
+        }
+
+        frames_ += other.frames_;
+    }
+
+
+    /**
+     * @brief       Retrieves the number of hits on a pixel
+     * @param pixel The pixel's index
+     * @return      The number of hits
+     */
+    unsigned long long hits(unsigned int const pixel) const
+    {
+        assert(pixel < TimepixGeometry::PIXELS);
+
+        return pixels_[pixel].hits;
+    }
+
+
+    /**
+     * @brief       Retrieves the summed ToT of a pixel
+     * @param pixel The pixel's index
+     * @return      The summed ToT
+     */
+    unsigned long long tot(unsigned int const pixel) const
+    {
+        assert(pixel < TimepixGeometry::PIXELS);
+
+        return pixels_[pixel].tot;
+    }
+
+
+    /**
+     * @brief   Retrieves the number of frames mapped
+     * @return  The number of frames
+     */
+    unsigned long long numberOfFrames() const
+    {
+        return frames_;
+    }
+
+
+    /**
+     * @brief   Retrieves the total number of hits mapped
+     * @return  The number of hits
+     */
+    unsigned long long numberOfHits() const
+    {
+        unsigned long long total = 0;
+        for (unsigned int i = 0; i < TimepixGeometry::PIXELS; ++i) {
+            total += pixels_[i].hits;
+        }
+
+        return total;
+    }
+
+
+    /**
+     * @brief          Renders a quantity of the map as 16-bit grey levels,
+     * scaled so the largest value is white
+     * @param quantity What to render
+     * @return         The grey levels, row by row from y = 0
+     */
+    std::vector<std::uint16_t> const image(HitMapQuantity const quantity) const
+    {
+        std::vector<double> values(TimepixGeometry::PIXELS);
+        double largest = 0.0;
+        for (unsigned int i = 0; i < TimepixGeometry::PIXELS; ++i) {
+            HitMapPixel const& pixel = pixels_[i];
+            switch (quantity) {
+            case HIT_MAP_HITS:
+                values[i] = static_cast<double>(pixel.hits);
+                break;
+            case HIT_MAP_TOT:
+                values[i] = static_cast<double>(pixel.tot);
+                break;
+            case HIT_MAP_MEAN_TOT:
+                values[i] = pixel.hits ? static_cast<double>(pixel.tot) / pixel.hits : 0.0;
+                break;
+            }
+            if (values[i] > largest) {
+                largest = values[i];
+            }
+        }
+
+        std::vector<std::uint16_t> levels(TimepixGeometry::PIXELS, 0);
+        if (largest > 0.0) {
+            double const scale = 65535.0 / largest;
+            for (unsigned int i = 0; i < TimepixGeometry::PIXELS; ++i) {
+                levels[i] = static_cast<std::uint16_t>(values[i] * scale + 0.5);
+            }
+        }
+
+        return levels;
+    }
+
+
+    /**
+     * @brief          Saves a quantity of the map as an image, a PNG if the
+     * path ends in '.png' and a PGM otherwise
+     * @param path     The path of the image
+     * @param quantity What to show
+     * @return         Nothing, throws std::ifstream::failure if the image
+     * can't be written
+     */
+    void saveImage(std::string const& path, HitMapQuantity const quantity) const
+    {
+        std::vector<std::uint16_t> const levels = image(quantity);
+        if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0) {
+            ImageWriter::writePng(path, TimepixGeometry::WIDTH, TimepixGeometry::HEIGHT, levels);
+        } else {
+            ImageWriter::writePgm(path, TimepixGeometry::WIDTH, TimepixGeometry::HEIGHT, levels);
+        }
+    }
+
+
+    /**
+     * @brief      Saves the map as a '.lolp' file, with the totals in full
+     * @param path The path of the map file
+     * @return     Nothing, throws std::ifstream::failure if the map can't be
+     * written
+     */
+    void save(std::string const& path) const
+    {
+        HitMapHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "LOLP", 4);
+        header.byteOrder = HIT_MAP_BYTE_ORDER;
+        header.version = HIT_MAP_VERSION;
+        header.width = TimepixGeometry::WIDTH;
+        header.height = TimepixGeometry::HEIGHT;
+        header.numberOfFrames = frames_;
+
+        // The totals are written as two planes, which read straight into
+        // arrays elsewhere
+        std::vector<std::uint64_t> plane(TimepixGeometry::PIXELS);
+        try {
+            std::ofstream out;
+            out.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            out.open(path.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+            out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+            for (unsigned int i = 0; i < TimepixGeometry::PIXELS; ++i) {
+                plane[i] = pixels_[i].hits;
+            }
+            out.write(reinterpret_cast<char const*>(plane.data()), plane.size() * sizeof(std::uint64_t));
+            for (unsigned int i = 0; i < TimepixGeometry::PIXELS; ++i) {
+                plane[i] = pixels_[i].tot;
+            }
+            out.write(reinterpret_cast<char const*>(plane.data()), plane.size() * sizeof(std::uint64_t));
+            out.close();
+        } catch (std::ofstream::failure const&) {
+            throw std::ifstream::failure("Could not write the hit map: " + path);
+        }
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    HitMap(HitMap const& other);
+
+
+    // Assignment operator
+    HitMap& operator=(HitMap const& other);
+
+    AlignedBuffer<HitMapPixel> pixels_; // The totals of each pixel
+    unsigned long long frames_; // The number of frames mapped
+};
+
+
+#endif  /* HITMAP_HPP */
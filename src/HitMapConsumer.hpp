@@ -0,0 +1,317 @@
+/**
+ * @file        HitMapConsumer.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the consumer integrating the hit map of a dataset on a
+ * pool of threads (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef HITMAPCONSUMER_HPP
+#define HITMAPCONSUMER_HPP
+
+// C++ headers
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <string>
+#include <sstream>
+#include <cstdint>
+// My headers
+#include <Frame.hpp>
+#include <FrameConsumer.hpp>
+#include <HitMap.hpp>
+
+/**
+ * @brief This class integrates the hits and summed ToT of every pixel over a
+ * whole dataset <br>
+ * The packed hits of the frames are copied into large batches which a pool of
+ * workers add to their own private maps, so nothing is shared while the maps
+ * fill; the private maps are merged once the dataset is finished, and the
+ * result is saved as images or as a '.lolp' file (class is non-copyable)
+ */
+template <class T>
+class HitMapConsumer : public FrameConsumer<T> {
+public:
+
+    /**
+     * @brief          A constructor for the HitMapConsumer class
+     * @param threads  The number of threads to map with (each keeps a map of
+     * its own, so at most MAXIMUM_WORKERS are started)
+     * @param hitsPath The path to save the hits on each pixel to once the
+     * dataset is finished, as an image if it ends in '.png' or '.pgm' and as
+     * a '.lolp' file of both totals otherwise (or empty to not save it)
+     * @param totPath  The path to save the summed ToT of each pixel to, in
+     * the same way
+     * @return         A newly constructed HitMapConsumer object
+     */
+    HitMapConsumer(unsigned int const threads,
+                   std::string const& hitsPath,
+                   std::string const& totPath = "")
+        : hitsPath_(hitsPath), totPath_(totPath), current_(0),
+        workerCount_(threads < MAXIMUM_WORKERS ? threads : MAXIMUM_WORKERS),
+        frames_(0), isStopping_(false)
+    {
+        if (workerCount_ > 1) {
+            // Two batches per worker, so one can fill while the other is mapped
+            batches_.resize(workerCount_ * 2 + 1);
+            for (std::size_t i = 0; i < batches_.size(); ++i) {
+                batches_[i].reserve(BATCH_SIZE);
+            }
+            for (std::size_t i = 1; i < batches_.size(); ++i) {
+                free_.push_back(i);
+            }
+            full_.reserve(batches_.size());
+        }
+    }
+
+
+    /**
+     * @brief   The destructor for the HitMapConsumer class, which stops any
+     * workers still running
+     * @return  Nothing
+     */
+    virtual ~HitMapConsumer()
+    {
+        stop();
+    }
+
+
+    /**
+     * @brief             Maps the hits of a frame
+     * @param frame       The frame
+     * @param frameNumber The number of the frame
+     * @return            Nothing
+     */
+    virtual void consume(Frame<T> const& frame, unsigned int const frameNumber)
+    {
+        frames_++;
+
+        Span<std::uint32_t const> const hits = frame.hits();
+
+        if (workerCount_ <= 1) {
+            map_.fill(hits.begin(), hits.size());
+            return;
+        }
+
+        std::size_t copied = 0;
+        while (copied < hits.size()) {
+            std::vector<std::uint32_t>& batch = batches_[current_];
+            std::size_t const room = BATCH_SIZE - batch.size();
+            std::size_t const count = hits.size() - copied < room ? hits.size() - copied : room;
+            batch.insert(batch.end(), hits.begin() + copied, hits.begin() + copied + count);
+            copied += count;
+            if (batch.size() == BATCH_SIZE) {
+                submit();
+            }
+        }
+    }
+
+
+    /**
+     * @brief         Merges the workers' maps and saves the result
+     * @param summary The details of the whole dataset
+     * @return        Nothing, throws std::ifstream::failure if the map can't
+     * be written
+     */
+    virtual void finish(DatasetSummary const& summary)
+    {
+        if (workers_.empty()) {
+            // Too few hits to have started the workers
+            if (!batches_.empty()) {
+                fill(batches_[current_], map_);
+            }
+        } else {
+            if (!batches_[current_].empty()) {
+                submit();
+            }
+            stop();
+
+            for (std::size_t i = 0; i < maps_.size(); ++i) {
+                map_.merge(*maps_[i]);
+            }
+            maps_.clear();
+        }
+
+        map_.addFrames(frames_);
+        frames_ = 0;
+
+        save(hitsPath_, HIT_MAP_HITS);
+        save(totPath_, HIT_MAP_TOT);
+    }
+
+
+    /**
+     * @brief   A getter for the map, complete once the dataset has been
+     * finished
+     * @return  The hit map
+     */
+    HitMap const& map() const
+    {
+        return map_;
+    }
+
+
+    /**
+     * @brief   Summarises the map and where it was saved
+     * @return  The number of frames and hits mapped, and the files written
+     */
+    std::string const report() const
+    {
+        std::ostringstream report;
+        report << map_.numberOfFrames() << " frames, " << map_.numberOfHits() << " hits mapped";
+        if (!hitsPath_.empty()) {
+            report << ", hits saved to " << hitsPath_;
+        }
+        if (!totPath_.empty()) {
+            report << ", ToT saved to " << totPath_;
+        }
+
+        return report.str();
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    HitMapConsumer(HitMapConsumer const& other);
+
+
+    // Assignment operator
+    HitMapConsumer& operator=(HitMapConsumer const& other);
+
+
+    // The number of hits handed to a worker at once
+    static const std::size_t BATCH_SIZE = 1 << 16;
+    // The most workers started, as each one keeps a whole map
+    static const unsigned int MAXIMUM_WORKERS = 8;
+
+
+    // Utility Functions
+    static void fill(std::vector<std::uint32_t>& batch, HitMap& map)
+    {
+        map.fill(batch.data(), batch.size());
+        batch.clear();
+    }
+
+
+    void save(std::string const& path, HitMapQuantity const quantity) const
+    {
+        // Saves an image of the quantity, or the whole map when the path
+        // isn't that of an image
+
+        if (path.empty()) {
+            return;
+        }
+
+        if (isImagePath(path)) {
+            map_.saveImage(path, quantity);
+        } else {
+            map_.save(path);
+        }
+    }
+
+
+    static bool isImagePath(std::string const& path)
+    {
+        return path.size() >= 4
+               && (path.compare(path.size() - 4, 4, ".png") == 0
+                   || path.compare(path.size() - 4, 4, ".pgm") == 0);
+    }
+
+
+    void submit()
+    {
+        // Queues the current batch for the workers and takes a free one to
+        // carry on filling, waiting for the workers to free one if need be
+        // The workers are only started by the first full batch, so small
+        // datasets never pay for their maps
+
+        if (workers_.empty()) {
+            maps_.resize(workerCount_);
+            for (unsigned int i = 0; i < workerCount_; ++i) {
+                workers_.push_back(std::thread(&HitMapConsumer<T>::work, this, i));
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        full_.push_back(current_);
+        work_.notify_one();
+
+        while (free_.empty()) {
+            freed_.wait(lock);
+        }
+        current_ = free_.back();
+        free_.pop_back();
+    }
+
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            isStopping_ = true;
+            work_.notify_all();
+        }
+
+        for (std::size_t i = 0; i < workers_.size(); ++i) {
+            workers_[i].join();
+        }
+        workers_.clear();
+    }
+
+
+    void work(unsigned int const worker)
+    {
+        // Each worker allocates (and so first touches) its own map
+        maps_[worker].reset(new HitMap());
+        HitMap& map = *maps_[worker];
+
+        for (;;) {
+            std::size_t index = 0;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while (full_.empty() && !isStopping_) {
+                    work_.wait(lock);
+                }
+                if (full_.empty()) {
+                    return;
+                }
+                index = full_.back();
+                full_.pop_back();
+            }
+
+            fill(batches_[index], map);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            free_.push_back(index);
+            freed_.notify_one();
+        }
+    }
+
+    std::string hitsPath_; // The path the hits are saved to
+    std::string totPath_; // The path the summed ToT is saved to
+    HitMap map_; // The map of the whole dataset
+    std::vector<std::unique_ptr<HitMap> > maps_; // Each worker's private map
+    std::vector<std::vector<std::uint32_t> > batches_; // The batches of packed hits
+    std::vector<std::size_t> free_; // The batches free to be filled
+    std::vector<std::size_t> full_; // The batches waiting to be mapped
+    std::size_t current_; // The batch being filled
+    unsigned int workerCount_; // The number of workers to map with
+    std::vector<std::thread> workers_; // The workers mapping the batches
+    std::mutex mutex_; // Guards the batch queues and the stop flag
+    std::condition_variable work_; // Signalled when a batch is queued or on stop
+    std::condition_variable freed_; // Signalled when a batch is freed
+    unsigned long long frames_; // The number of frames consumed
+    bool isStopping_; // Whether the workers should exit once the queue is empty
+};
+
+
+#endif  /* HITMAPCONSUMER_HPP */
@@ -0,0 +1,234 @@
+/**
+ * @file        ImageWriter.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the writers of 16-bit greyscale PGM and PNG images
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef IMAGEWRITER_HPP
+#define IMAGEWRITER_HPP
+
+// C++ headers
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+
+/**
+ * @brief This class writes a 16-bit greyscale image, row by row from the top,
+ * as a binary PGM or as a PNG <br>
+ * The PNG is written with stored (uncompressed) deflate blocks, so it needs no
+ * compression library and costs no more to write than the PGM
+ */
+class ImageWriter {
+public:
+
+    /**
+     * @brief        Writes an image as a binary (P5) PGM
+     * @param path   The path of the image file
+     * @param width  The number of columns
+     * @param height The number of rows
+     * @param values The grey levels, width * height of them in row order
+     * @return       Nothing, throws std::ifstream::failure if the image
+     * can't be written
+     */
+    static void writePgm(std::string const& path,
+                         unsigned int const width,
+                         unsigned int const height,
+                         std::vector<std::uint16_t> const& values)
+    {
+        assert(values.size() == static_cast<std::size_t>(width) * height);
+
+        std::ostringstream header;
+        header << "P5\n" << width << " " << height << "\n65535\n";
+
+        std::vector<char> bytes;
+        appendBigEndian(values, bytes);
+
+        try {
+            std::ofstream out;
+            out.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            out.open(path.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+            out << header.str();
+            out.write(bytes.data(), bytes.size());
+            out.close();
+        } catch (std::ofstream::failure const&) {
+            throw std::ifstream::failure("Could not write the image: " + path);
+        }
+    }
+
+
+    /**
+     * @brief        Writes an image as a 16-bit greyscale PNG
+     * @param path   The path of the image file
+     * @param width  The number of columns
+     * @param height The number of rows
+     * @param values The grey levels, width * height of them in row order
+     * @return       Nothing, throws std::ifstream::failure if the image
+     * can't be written
+     */
+    static void writePng(std::string const& path,
+                         unsigned int const width,
+                         unsigned int const height,
+                         std::vector<std::uint16_t> const& values)
+    {
+        assert(values.size() == static_cast<std::size_t>(width) * height);
+
+        // The raw image data: each row is a filter type byte (0, none) and
+        // the row's samples, most significant byte first
+        std::vector<char> rows;
+        rows.reserve(static_cast<std::size_t>(height) * (1 + 2 * width));
+        for (unsigned int y = 0; y < height; ++y) {
+            rows.push_back(0);
+            for (unsigned int x = 0; x < width; ++x) {
+                std::uint16_t const value = values[static_cast<std::size_t>(y) * width + x];
+                rows.push_back(static_cast<char>(value >> 8));
+                rows.push_back(static_cast<char>(value & 0xff));
+            }
+        }
+
+        // A zlib stream of stored deflate blocks (at most 65535 bytes each)
+        std::vector<char> stream;
+        stream.reserve(rows.size() + rows.size() / 65535 * 5 + 16);
+        stream.push_back(0x78);
+        stream.push_back(0x01);
+        std::size_t pos = 0;
+        do {
+            std::size_t const length = rows.size() - pos < 65535 ? rows.size() - pos : 65535;
+            bool const isLast = pos + length == rows.size();
+            stream.push_back(isLast ? 1 : 0);
+            stream.push_back(static_cast<char>(length & 0xff));
+            stream.push_back(static_cast<char>(length >> 8));
+            stream.push_back(static_cast<char>(~length & 0xff));
+            stream.push_back(static_cast<char>((~length >> 8) & 0xff));
+            stream.insert(stream.end(), rows.begin() + pos, rows.begin() + pos + length);
+            pos += length;
+        } while (pos < rows.size());
+        appendUint32(adler32(rows), stream);
+
+        std::vector<char> header;
+        appendUint32(width, header);
+        appendUint32(height, header);
+        header.push_back(16); // Bit depth
+        header.push_back(0); // Greyscale
+        header.push_back(0); // Deflate
+        header.push_back(0); // Adaptive filtering
+        header.push_back(0); // No interlacing
+
+        static const char SIGNATURE[8] = { '\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n' };
+        std::vector<char> png(SIGNATURE, SIGNATURE + 8);
+        appendChunk("IHDR", header, png);
+        appendChunk("IDAT", stream, png);
+        appendChunk("IEND", std::vector<char>(), png);
+
+        try {
+            std::ofstream out;
+            out.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            out.open(path.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+            out.write(png.data(), png.size());
+            out.close();
+        } catch (std::ofstream::failure const&) {
+            throw std::ifstream::failure("Could not write the image: " + path);
+        }
+    }
+
+private:
+
+    // The CRC-32 of every byte value
+    struct CrcTable {
+        CrcTable()
+        {
+            for (std::uint32_t n = 0; n < 256; ++n) {
+                std::uint32_t c = n;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                values[n] = c;
+            }
+        }
+
+        std::uint32_t values[256];
+    };
+
+
+    // Utility Functions
+    static void appendBigEndian(std::vector<std::uint16_t> const& values, std::vector<char>& bytes)
+    {
+        bytes.reserve(bytes.size() + values.size() * 2);
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            bytes.push_back(static_cast<char>(values[i] >> 8));
+            bytes.push_back(static_cast<char>(values[i] & 0xff));
+        }
+    }
+
+
+    static void appendUint32(std::uint32_t const value, std::vector<char>& bytes)
+    {
+        // PNG integers are big endian
+        bytes.push_back(static_cast<char>(value >> 24));
+        bytes.push_back(static_cast<char>((value >> 16) & 0xff));
+        bytes.push_back(static_cast<char>((value >> 8) & 0xff));
+        bytes.push_back(static_cast<char>(value & 0xff));
+    }
+
+
+    static void appendChunk(char const* type, std::vector<char> const& data, std::vector<char>& png)
+    {
+        // A chunk is its length, type and data, then the CRC of the type and
+        // data
+
+        appendUint32(static_cast<std::uint32_t>(data.size()), png);
+        std::size_t const typeStart = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), data.begin(), data.end());
+        appendUint32(crc32(&png[typeStart], png.size() - typeStart), png);
+    }
+
+
+    static std::uint32_t crc32(char const* bytes, std::size_t const size)
+    {
+        // The CRC-32 of ISO 3309, by table (built once, thread safely)
+
+        static CrcTable const table;
+
+        std::uint32_t crc = 0xffffffffu;
+        for (std::size_t i = 0; i < size; ++i) {
+            crc = table.values[(crc ^ static_cast<unsigned char>(bytes[i])) & 0xff] ^ (crc >> 8);
+        }
+
+        return crc ^ 0xffffffffu;
+    }
+
+
+    static std::uint32_t adler32(std::vector<char> const& bytes)
+    {
+        // The zlib checksum, with the modulo taken every 5552 bytes (the most
+        // which can't overflow the sums)
+
+        std::uint32_t a = 1;
+        std::uint32_t b = 0;
+        std::size_t pos = 0;
+        while (pos < bytes.size()) {
+            std::size_t const end = bytes.size() - pos < 5552 ? bytes.size() : pos + 5552;
+            for (; pos < end; ++pos) {
+                a += static_cast<unsigned char>(bytes[pos]);
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+
+        return (b << 16) | a;
+    }
+};
+
+
+#endif  /* IMAGEWRITER_HPP */
@@ -14,35 +14,874 @@
 // C++ headers
 #include <iostream>
 #include <fstream>
-#include <map>
+#include <sstream>
 #include <memory>
 #include <cstdlib>
 #include <cstring>
+#include <string>
+#include <vector>
+#include <utility>
+#include <limits>
+#include <thread>
+#include <chrono>
+#include <csignal>
 // My headers
 #include <Pixel.hpp> // For the pixel data type
 #include <Frame.hpp> // For the frame data type
 #include <TextFileReader.hpp> // For the text file reader class
-#include <TableEntryGen.hpp> // For the class for handling Wiki table entry generation
+#include <FramePipeline.hpp> // For streaming the frames through the consumers
+#include <TableEntryConsumer.hpp> // For handling Wiki table entry generation
+#include <CalibrationConsumer.hpp> // For building the calibration histograms
+#include <PeakTable.hpp> // For finding the source peaks in the histograms
+#include <SurrogateFitter.hpp> // For fitting the per-pixel calibration
+#include <ClusterConsumer.hpp> // For optionally measuring the clusters
+#include <NoisyPixelConsumer.hpp> // For optionally finding the noisy pixels
+#include <HitMapConsumer.hpp> // For optionally integrating the hit map
+#include <PixelMask.hpp> // For optionally dropping the hits of masked pixels
+#include <FrameStore.hpp> // For optionally keeping every frame in memory
+#include <FrameLogger.hpp> // For optionally logging every frame
+#include <FrameDumpReader.hpp> // For decoding the binary frame dumps
+#include <FrameExporter.hpp> // For optionally exporting the hits and frames
+#include <FastNumber.hpp> // For converting the numeric options
+#include <DatasetBatch.hpp> // For processing a whole directory tree of datasets
+#include <ResultCache.hpp> // For reusing the results of unchanged datasets
+#include <FrameFollower.hpp> // For following a cluster log as it is written
+#include <StageStats.hpp> // For optionally measuring the stages of the run
 
 // Constant for the name of the log file
 static const char LOG_FILE_NAME[] = "log.txt";
+// Constant for the name of the file the details of every frame are logged to
+static const char FRAME_LOG_FILE_NAME[] = "frames.txt";
+
+// Set when the program is interrupted while following a file
+static volatile std::sig_atomic_t isInterrupted = 0;
+
+
+/**
+ * @brief The options the program was run with
+ */
+struct Options {
+    std::string mode; // The mode to run in
+    std::string filePath; // The path of the cluster log to read (or the directory, in batch mode)
+    unsigned int threads; // The number of threads to parse with
+    bool isBatch; // Whether to process every dataset under a directory
+    bool isFollowing; // Whether to follow the cluster log as it grows
+    double idleTimeout; // The seconds a followed file may stay unchanged before it counts as finished (0 for never)
+    bool pipelined; // Whether to read and parse on their own threads
+    std::string resultsPath; // The results cache to reuse unchanged datasets' outputs from, if any
+    bool hashContents; // Whether the results cache also checks the datasets' content hashes
+    bool useCache; // Whether to build the binary cache if it is missing
+    bool isStrict; // Whether a hit off the detector's matrix fails the read, rather than being dropped
+    bool keepFrames; // Whether to keep every frame in memory
+    bool logFrames; // Whether to log the details of every frame as text
+    std::string frameDumpPath; // The binary dump to write every frame to, if any
+    bool measureClusters; // Whether to measure and classify every cluster
+    bool relabelClusters; // Whether to rebuild the clusters by 8-connected labelling
+    std::string noisyMaskPath; // The mask file to save the noisy pixels found to, if any
+    std::string maskPath; // The mask file of the pixels whose hits are dropped, if any
+    std::string hitMapPath; // The file to save the hits on each pixel to, if any
+    std::string totMapPath; // The file to save the summed ToT of each pixel to, if any
+    std::vector<std::pair<ExportFormat, std::string> > exports; // The form and file of each export
+    unsigned int minimumClusterSize; // The fewest pixels of an exported cluster
+    unsigned int maximumClusterSize; // The most pixels of an exported cluster
+    bool isFrameRanged; // Whether only a range of frame numbers is read
+    bool isTimeRanged; // Whether only a window of time is read
+    double rangeStart; // The first frame number or time to read
+    double rangeEnd; // The last frame number (inclusive) or time (exclusive)
+    unsigned int bins; // The number of ToT bins per pixel when calibrating
+    unsigned int binWidth; // The ToT range of each bin when calibrating
+    std::string stats; // How to report the statistics of the run's stages ("text" or "json"), if at all
+    std::vector<std::pair<double, std::string> > peaks; // The energy and cluster log of each calibration source
+};
+
+
+/**
+ * @brief Parses a range argument of the form 'start:end'
+ * @param argument The argument to parse
+ * @param start The start of the range
+ * @param end The end of the range
+ * @return Whether the argument was a valid range
+ */
+bool parseRangeArgument(char const* argument, double& start, double& end)
+{
+    char const* pos = argument;
+    char const* last = argument + std::strlen(argument);
+
+    if (!FastNumber::parseDecimal(pos, last, start) || pos == last || *pos != ':') {
+        return false;
+    }
+    pos++;
+
+    return FastNumber::parseDecimal(pos, last, end) && pos == last && start <= end;
+}
+
+
+/**
+ * @brief Parses a calibration source argument of the form 'energy:path'
+ * @param argument The argument to parse
+ * @param energy The energy of the source, in keV
+ * @param path The path of the source's cluster log
+ * @return Whether the argument was a valid source
+ */
+bool parsePeakArgument(char const* argument, double& energy, std::string& path)
+{
+    char const* pos = argument;
+    char const* last = argument + std::strlen(argument);
+
+    if (!FastNumber::parseDecimal(pos, last, energy) || pos == last || *pos != ':' || energy <= 0.0) {
+        return false;
+    }
+    path.assign(pos + 1, last);
+
+    return !path.empty();
+}
+
+
+/**
+ * @brief Loads the ToT histograms of a calibration source from its '.lolh'
+ * summary (building and saving them first if the summary is missing or
+ * stale) and finds every pixel's peak in them
+ * @param energy The energy of the source, in keV
+ * @param path The path of the source's cluster log
+ * @param options The options the program was run with
+ * @param log The log file
+ * @return The peaks of the source, throws std::ifstream::failure if the
+ * source can't be read
+ */
+std::unique_ptr<PeakTable> findPeaks(double const energy,
+                                     std::string const& path,
+                                     Options const& options,
+                                     std::ofstream& log)
+{
+    TextFileReader<int> input;
+    input.setStrict(options.isStrict);
+    input.open(path);
+
+    try {
+        ToTHistogram histogram;
+        histogram.load(histogramPath(path));
+        if (histogram.sourceSize() == input.size() && histogram.sourceModified() == input.modified()) {
+            log << "Loaded the histograms of " << path << "\n";
+            return std::unique_ptr<PeakTable>(new PeakTable(energy, histogram));
+        }
+    } catch (std::ifstream::failure const&) {
+        // No usable summary, so the histograms are built below
+    }
+
+    log << "Histogramming " << path << "...\n";
+    FramePipeline<int> pipeline;
+    std::shared_ptr<CalibrationConsumer<int> > calibration = std::make_shared<CalibrationConsumer<int> >(
+            options.threads, options.bins, options.binWidth);
+    pipeline.addConsumer(calibration);
+    pipeline.run(input, options.threads, options.pipelined);
+    input.close();
+
+    return std::unique_ptr<PeakTable>(new PeakTable(energy, calibration->histogram()));
+}
+
+
+/**
+ * @brief Fits the surrogate function of every pixel to the peaks of the
+ * calibration sources and writes the coefficient table
+ * @param options The options the program was run with
+ * @param log The log file
+ * @return Nothing, throws std::ifstream::failure if a source can't be read
+ * or the table can't be written
+ */
+void fitCalibration(Options const& options, std::ofstream& log)
+{
+    std::vector<std::unique_ptr<PeakTable> > tables;
+    std::vector<PeakTable const*> sources;
+    for (std::size_t i = 0; i < options.peaks.size(); ++i) {
+        tables.push_back(findPeaks(options.peaks[i].first, options.peaks[i].second, options, log));
+        sources.push_back(tables.back().get());
+
+        log << "Found " << tables.back()->numberOfPeaks() << " pixel peaks at "
+            << options.peaks[i].first << " keV\n";
+    }
+    if (sources.size() < 4) {
+        log << "Warning: fewer than 4 sources, so no pixel can be fitted\n";
+    }
+
+    log << "Fitting the surrogate function of every pixel...\n";
+    SurrogateFitter fitter;
+    FitStatistics statistics = fitter.fit(sources, options.threads);
+    fitter.write(options.filePath);
+
+    log << "Fits converged: " << statistics.converged
+        << ", too few peaks: " << statistics.tooFewPeaks
+        << ", singular: " << statistics.singular
+        << ", at the edge of t: " << statistics.atBoundary
+        << " (" << statistics.evaluations << " solves per pixel)\n"
+        << "Mean rms residual: " << statistics.meanRms
+        << ", largest: " << statistics.maxRms << "\n"
+        << "Wrote the coefficient table to: " << options.filePath << "\n";
+
+    std::cout << statistics.converged << " converged, "
+              << statistics.tooFewPeaks << " too few peaks, "
+              << statistics.singular << " singular, "
+              << statistics.atBoundary << " at boundary; mean rms "
+              << statistics.meanRms << ", max rms " << statistics.maxRms << "\n";
+}
+
+
+/**
+ * @brief Builds the key of the options which shape a dataset's output, so a
+ * stored output is only reused for the same kind of run
+ * @param options The options the program was run with
+ * @return The key
+ */
+std::string resultsKey(Options const& options)
+{
+    std::ostringstream key;
+    key << (options.mode[0] == '-' ? options.mode.substr(1) : options.mode)
+        << " clusters=" << options.measureClusters
+        << " relabel=" << options.relabelClusters
+        << " bins=" << options.bins
+        << " bin-width=" << options.binWidth;
+    if (!options.noisyMaskPath.empty()) {
+        key << " find-noisy=" << options.noisyMaskPath;
+    }
+    if (!options.hitMapPath.empty() || !options.totMapPath.empty()) {
+        key << " hit-map=" << options.hitMapPath << " tot-map=" << options.totMapPath;
+    }
+    if (!options.maskPath.empty()) {
+        // The mask's contents, so editing the mask reruns the datasets
+        key << " mask=" << ResultCache::contentHash(options.maskPath);
+    }
+    if (options.isFrameRanged) {
+        key << " frames=" << options.rangeStart << ":" << options.rangeEnd;
+    } else if (options.isTimeRanged) {
+        key.precision(17);
+        key << " time=" << options.rangeStart << ":" << options.rangeEnd;
+    }
+
+    return key.str();
+}
+
+
+/**
+ * @brief Checks that the files a dataset's run leaves next to it are still
+ * there, since reusing its stored output would not rebuild them
+ * @param path The path of the dataset's cluster log
+ * @param options The options the program was run with
+ * @return Whether every file the run would write exists
+ */
+bool hasSideOutputs(std::string const& path, Options const& options)
+{
+    boost::system::error_code error;
+    if ((options.mode == "c" || options.mode == "-c")
+            && !boost::filesystem::exists(histogramPath(path), error)) {
+        return false;
+    }
+    if (options.useCache && !boost::filesystem::exists(cachePath(path), error)) {
+        return false;
+    }
+    if (!options.noisyMaskPath.empty() && !boost::filesystem::exists(options.noisyMaskPath, error)) {
+        return false;
+    }
+    if (!options.hitMapPath.empty() && !boost::filesystem::exists(options.hitMapPath, error)) {
+        return false;
+    }
+    if (!options.totMapPath.empty() && !boost::filesystem::exists(options.totMapPath, error)) {
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief The consumers a dataset is streamed through, each one only set when
+ * the mode or options ask for it
+ */
+struct DatasetConsumers {
+    std::shared_ptr<TableEntryConsumer<int> > tableEntry; // The Wiki table entry
+    std::shared_ptr<CalibrationConsumer<int> > calibration; // The ToT histograms
+    std::shared_ptr<ClusterConsumer<int> > clusters; // The cluster measurements
+    std::shared_ptr<NoisyPixelConsumer<int> > noisy; // The noisy pixel search
+    std::shared_ptr<HitMapConsumer<int> > hitMap; // The integrated hit map
+    std::shared_ptr<FrameStore<int> > frames; // Every frame, kept in memory
+    std::vector<std::shared_ptr<FrameExporter<int> > > exporters; // The exports of the hits and frames
+};
+
+
+/**
+ * @brief Sets up the consumers the mode and options ask for
+ * @param options The options the program was run with
+ * @param path The path of the dataset's cluster log
+ * @param threads The number of threads the dataset is processed with
+ * @param log The stream to log to
+ * @param frameLog The log to write the details of every frame to, or null
+ * for none
+ * @param pipeline The pipeline to register the consumers with
+ * @param consumers Set to the consumers registered
+ * @return Nothing
+ */
+void addConsumers(Options const& options,
+                  std::string const& path,
+                  unsigned int const threads,
+                  std::ostream& log,
+                  AsyncLog* frameLog,
+                  FramePipeline<int>& pipeline,
+                  DatasetConsumers& consumers)
+{
+    std::string const& mode = options.mode;
+
+    // Check the mode and set up the correct consumers
+    // If on table generation mode:
+    if (mode == "t" || mode == "-t")
+    {
+        // The table entry only needs the file's metadata, so unless another
+        // consumer wants the frames the file is only scanned for its line and
+        // frame counts
+        consumers.tableEntry = std::make_shared<TableEntryConsumer<int> >();
+        pipeline.addConsumer(consumers.tableEntry);
+    }
+    // If on calibration mode:
+    else if (mode == "c" || mode == "-c")
+    {
+        // Histogram every pixel's ToT values, saving them next to the
+        // dataset for the calibration fits
+        consumers.calibration = std::make_shared<CalibrationConsumer<int> >(
+                threads, options.bins, options.binWidth);
+        pipeline.addConsumer(consumers.calibration);
+    }
+
+    // Set up the opt-in consumers
+    if (options.measureClusters) {
+        consumers.clusters = std::make_shared<ClusterConsumer<int> >(options.relabelClusters);
+        pipeline.addConsumer(consumers.clusters);
+    }
+    if (!options.noisyMaskPath.empty()) {
+        consumers.noisy = std::make_shared<NoisyPixelConsumer<int> >(options.noisyMaskPath);
+        pipeline.addConsumer(consumers.noisy);
+    }
+    if (!options.hitMapPath.empty() || !options.totMapPath.empty()) {
+        consumers.hitMap = std::make_shared<HitMapConsumer<int> >(
+                threads, options.hitMapPath, options.totMapPath);
+        pipeline.addConsumer(consumers.hitMap);
+    }
+    if (options.keepFrames) {
+        consumers.frames = std::make_shared<FrameStore<int> >();
+        pipeline.addConsumer(consumers.frames, STAGE_FRAME_STORE);
+    }
+    if (frameLog) {
+        pipeline.addConsumer(std::make_shared<FrameLogger<int> >(
+                *frameLog, path, !options.frameDumpPath.empty()), STAGE_OUTPUT);
+    }
+    for (std::size_t i = 0; i < options.exports.size(); ++i) {
+        consumers.exporters.push_back(std::make_shared<FrameExporter<int> >(
+                options.exports[i].second, options.exports[i].first,
+                options.minimumClusterSize, options.maximumClusterSize));
+        pipeline.addConsumer(consumers.exporters.back(), STAGE_OUTPUT);
+    }
+}
+
+
+/**
+ * @brief Outputs the results of the consumers once the dataset is finished
+ * @param consumers The consumers the dataset was streamed through
+ * @param path The path of the dataset's cluster log
+ * @param log The stream to log to
+ * @param output The stream to write the results to
+ * @return Nothing
+ */
+void reportConsumers(DatasetConsumers const& consumers,
+                     std::string const& path,
+                     std::ostream& log,
+                     std::ostream& output)
+{
+    if (consumers.tableEntry) {
+        std::string entry = consumers.tableEntry->entry();
+
+        log << "Generated table entry:\n"
+            << entry << "\n";
+
+        output << entry << "\n";
+    }
+    if (consumers.clusters) {
+        std::string report = consumers.clusters->report();
+
+        log << "Measured the clusters:\n"
+            << report << "\n";
+
+        output << report << "\n";
+    }
+    if (consumers.noisy) {
+        std::string report = consumers.noisy->report();
+
+        log << "Searched for noisy pixels:\n"
+            << report << "\n";
+
+        output << report << "\n";
+    }
+    if (consumers.hitMap) {
+        std::string report = consumers.hitMap->report();
+
+        log << "Integrated the hit map:\n"
+            << report << "\n";
+
+        output << report << "\n";
+    }
+    for (std::size_t i = 0; i < consumers.exporters.size(); ++i) {
+        std::string report = consumers.exporters[i]->report();
+
+        log << "Exported the dataset:\n"
+            << report << "\n";
+
+        output << report << "\n";
+    }
+    if (consumers.calibration) {
+        ToTHistogram const& histogram = consumers.calibration->histogram();
+
+        log << "Histogrammed " << histogram.numberOfHits() << " hits on "
+            << histogram.numberOfPixelsHit() << " pixels\n"
+            << "Saved the histograms to: " << histogramPath(path) << "\n";
+
+        output << histogram.numberOfFrames() << " frames, "
+               << histogram.numberOfHits() << " hits on "
+               << histogram.numberOfPixelsHit() << " pixels histogrammed into "
+               << histogramPath(path) << "\n";
+    }
+}
+
+
+/**
+ * @brief Streams one dataset through the consumers its mode and options ask
+ * for
+ * @param path The path of the dataset's cluster log
+ * @param options The options the program was run with
+ * @param threads The number of threads to parse the dataset with
+ * @param log The stream to log to
+ * @param results The results cache to reuse the output from while the
+ * dataset is unchanged (and to store it in otherwise), or null for none
+ * @param mask The mask of pixels whose hits are dropped, or null for none
+ * @param frameLog The log to write the details of every frame to, or null
+ * for none
+ * @return The output of the dataset (its table entry, cluster report or
+ * histogram summary), throws std::ifstream::failure if the dataset can't be
+ * read
+ */
+std::string analyseDataset(std::string const& path,
+                           Options const& options,
+                           unsigned int const threads,
+                           std::ostream& log,
+                           ResultCache* results,
+                           PixelMask<> const* mask,
+                           AsyncLog* frameLog)
+{
+    std::ostringstream output;
+    TextFileReader<int> input;
+
+    // Reuse the stored output while the cluster log is unchanged (logging
+    // every frame, or exporting them, is a side effect a stored output can't
+    // replay)
+    std::string key;
+    std::string const sourcePath = boost::filesystem::absolute(path).string();
+    unsigned long long sourceSize = 0;
+    long long sourceModified = 0;
+    unsigned long long sourceHash = 0;
+    if (results && !frameLog && options.exports.empty()) {
+        boost::system::error_code error;
+        sourceSize = boost::filesystem::file_size(path, error);
+        sourceModified = error ? 0 : boost::filesystem::last_write_time(path, error);
+        if (error) {
+            results = 0;
+        } else {
+            if (options.hashContents) {
+                sourceHash = ResultCache::contentHash(path);
+            }
+            key = resultsKey(options);
+
+            std::string stored;
+            if (results->find(sourcePath, key, sourceSize, sourceModified, sourceHash, stored)
+                    && hasSideOutputs(path, options)) {
+                log << "Reused the stored results of: " << path << "\n";
+                return stored;
+            }
+        }
+    } else {
+        results = 0;
+    }
+
+    log << "Opening detector dataset: " << path << "\n";
+    {
+        StageTimer stage(STAGE_OPEN);
+        input.setStrict(options.isStrict);
+        input.open(path); // Open the input data file
+        input.setMask(mask);
+        stage.count(input.size());
+    }
+
+    // Count the lines up front (the pipeline would otherwise count them
+    // itself), so the count is measured on its own; a compressed file has them
+    // counted as it is decompressed instead, rather than decompressing it twice
+    if (input.isCompressed() && !input.isCached()) {
+        log << "Decompressing the " << compressionName(input.compression())
+            << " compressed cluster log as it is read\n";
+    } else {
+        StageTimer stage(STAGE_LINE_COUNT);
+        stage.count(input.size(), input.numberOfLines(), input.numberOfFrames());
+    }
+
+    if (input.isCached()) {
+        log << "Reading the frames from the binary cache\n";
+    } else if (options.useCache) {
+        log << "Writing the binary cache...\n";
+        StageTimer stage(STAGE_OUTPUT);
+        input.writeCache();
+    }
+
+    // Every analysis is a consumer the frames are streamed through, so
+    // nothing is kept in memory unless it is asked for
+    FramePipeline<int> pipeline;
+    DatasetConsumers consumers;
+    addConsumers(options, path, threads, log, frameLog, pipeline, consumers);
+
+    // Seek straight to the requested frames with the frame index
+    if (options.isFrameRanged) {
+        FrameRange range = {
+            static_cast<unsigned long long>(options.rangeStart),
+            static_cast<unsigned long long>(options.rangeEnd) + 1
+        };
+        pipeline.setRange(range);
+        log << "Reading frames " << range.first << " to " << (range.last - 1) << "\n";
+    } else if (options.isTimeRanged) {
+        FrameRange range = input.framesInTimeRange(options.rangeStart, options.rangeEnd);
+        pipeline.setRange(range);
+        log << "Reading frames " << range.first << " to " << (range.last - 1)
+            << " (taken in the time window)\n";
+    }
+
+    if (options.pipelined) {
+        log << "Streaming the frames through the reader/parser pipeline...\n";
+    } else {
+        log << "Streaming the frames on "
+            << threads << " thread(s)...\n";
+    }
+    unsigned long long numberOfFrames = pipeline.run(input, threads, options.pipelined);
+    log << "Finished reading in data\n";
+
+    log << "Number of frames is:\n "
+        << numberOfFrames
+        << " frames\n";
+    if (input.numberOfRejectedHits()) {
+        log << "Warning: dropped " << input.numberOfRejectedHits()
+            << " hits lying outside the detector's matrix\n";
+    }
+
+    {
+        StageTimer stage(STAGE_OUTPUT);
+        reportConsumers(consumers, path, log, output);
+        if (results) {
+            results->store(sourcePath, key, sourceSize, sourceModified, sourceHash, output.str());
+        }
+        stage.count(output.str().size());
+    }
+
+    log << "Closing input file\n";
+    input.close();
+
+    return output.str();
+}
+
+
+/**
+ * @brief Marks the program as interrupted, so a followed file is finished
+ * off cleanly
+ * @param signal The signal received
+ * @return Nothing
+ */
+void onInterrupt(int signal)
+{
+    isInterrupted = 1;
+}
+
+
+/**
+ * @brief Follows a cluster log while it is being written, streaming each
+ * frame through the consumers as soon as it is complete and reporting the
+ * live frame and hit rates, until interrupted or until the file stops
+ * growing for the idle timeout
+ * @param path The path of the cluster log
+ * @param options The options the program was run with
+ * @param log The stream to log to
+ * @param mask The mask of pixels whose hits are dropped, or null for none
+ * @param frameLog The log to write the details of every frame to, or null
+ * for none
+ * @return The output of the dataset once finished, throws
+ * std::ifstream::failure if the file can't be read or holds malformed data
+ */
+std::string followDataset(std::string const& path,
+                          Options const& options,
+                          std::ostream& log,
+                          PixelMask<> const* mask,
+                          AsyncLog* frameLog)
+{
+    // The fewest seconds between two rate reports
+    static const double REPORT_INTERVAL = 1.0;
+
+    std::ostringstream output;
+    FrameFollower<int> input(path);
+    input.setMask(mask);
+    input.setStrict(options.isStrict);
+    {
+        StageTimer stage(STAGE_OPEN);
+        input.open();
+    }
+    log << "Following detector dataset: " << path
+        << (input.isNotified() ? " (notified of changes)\n" : " (polling for changes)\n");
+
+    // The histograms are filled on this thread, so every frame is counted as
+    // soon as it is parsed rather than once a batch fills
+    FramePipeline<int> pipeline;
+    DatasetConsumers consumers;
+    addConsumers(options, path, 1, log, frameLog, pipeline, consumers);
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point lastReport = Clock::now();
+    unsigned long long lastFrames = 0;
+    unsigned long long lastHits = 0;
+
+    std::signal(SIGINT, onInterrupt);
+    unsigned long long numberOfFrames = pipeline.follow(input, options.idleTimeout,
+        []() {
+            return isInterrupted != 0;
+        },
+        [&](FrameFollower<int> const& follower) {
+            Clock::time_point const now = Clock::now();
+            double const elapsed = std::chrono::duration<double>(now - lastReport).count();
+            if (elapsed < REPORT_INTERVAL) {
+                return;
+            }
+
+            std::cerr << follower.numberOfFrames() << " frames, "
+                      << follower.numberOfHits() << " hits; "
+                      << (follower.numberOfFrames() - lastFrames) / elapsed << " frames/s, "
+                      << (follower.numberOfHits() - lastHits) / elapsed << " hits/s\n";
+
+            lastReport = now;
+            lastFrames = follower.numberOfFrames();
+            lastHits = follower.numberOfHits();
+        });
+    std::signal(SIGINT, SIG_DFL);
+
+    log << "Stopped following after " << numberOfFrames << " frames ("
+        << input.offset() << " bytes)\n";
+    if (input.numberOfRejectedHits()) {
+        log << "Warning: dropped " << input.numberOfRejectedHits()
+            << " hits lying outside the detector's matrix\n";
+    }
+
+    {
+        StageTimer stage(STAGE_OUTPUT);
+        reportConsumers(consumers, path, log, output);
+        stage.count(output.str().size());
+    }
+
+    return output.str();
+}
+
+
+/**
+ * @brief Writes out the rest of the frame log, if there is one
+ * @param options The options the program was run with
+ * @param frameLog The log of every frame, or null for none
+ * @param log The log file
+ * @return Nothing, throws std::ifstream::failure if the frame log couldn't be
+ * written
+ */
+void closeFrameLog(Options const& options, AsyncLog* frameLog, std::ostream& log)
+{
+    if (frameLog) {
+        StageTimer stage(STAGE_OUTPUT);
+        unsigned long long const bytes = frameLog->close();
+        stage.count(bytes);
+
+        log << "Logged " << bytes << " bytes of frame details to: "
+            << (options.frameDumpPath.empty() ? FRAME_LOG_FILE_NAME : options.frameDumpPath.c_str()) << "\n";
+    }
+}
 
 
 /**
- * @brief Outputs the details of the frame to the given ostream
- * @param log The ostream to log into
- * @param frame A reference to the frame to be logged
- * @param frameNumber The number of the frame
+ * @brief Reports the statistics of the run's stages, if they were asked for,
+ * as JSON on the standard error or as text in the log
+ * @param options The options the program was run with
+ * @param log The log file
  * @return Nothing
  */
-template <class T>
-inline void logFrameDetails(std::ostream& log,
-                            Frame<T> const& frame,
-                            int frameNumber)
+void reportStats(Options const& options, std::ostream& log)
 {
-    // Log all frame details to the given ostream
-    log << "Frame no: " << frameNumber << "\n";
-    log << frame << "\n";
+    if (options.stats == "json") {
+        StageStats::writeJson(std::cerr);
+    } else if (options.stats == "text") {
+        log << "Statistics of the stages:\n";
+        StageStats::writeText(log);
+    }
+}
+
+
+/**
+ * @brief Parses the program's arguments, which take the form <br>
+ * mode [options] input-cluster-log-name
+ * @param argc The number of arguments given to the program when run
+ * @param argv An array of strings which are the arguments given
+ * @param options The options to fill in
+ * @return Whether the arguments were valid
+ */
+bool parseArguments(int argc, char **argv, Options& options)
+{
+    if (argc < 3) {
+        return false;
+    }
+
+    options.mode = argv[1];
+    options.filePath = argv[argc - 1];
+    options.isBatch = false;
+    options.isFollowing = false;
+    options.idleTimeout = 0.0;
+    options.pipelined = false;
+    options.hashContents = false;
+    options.useCache = false;
+    options.isStrict = false;
+    options.keepFrames = false;
+    options.logFrames = false;
+    options.measureClusters = false;
+    options.relabelClusters = false;
+    options.isFrameRanged = false;
+    options.isTimeRanged = false;
+    options.rangeStart = 0.0;
+    options.rangeEnd = 0.0;
+    options.minimumClusterSize = 1;
+    options.maximumClusterSize = std::numeric_limits<unsigned int>::max();
+    options.bins = 128;
+    options.binWidth = 2;
+    options.threads = std::thread::hardware_concurrency();
+    if (options.threads == 0) {
+        options.threads = 1;
+    }
+
+    // Handle the options between the mode and the file path
+    for (int i = 2; i < argc - 1; ++i) {
+        std::string option = argv[i];
+
+        if (option == "-j" && i + 1 < argc - 1) {
+            options.threads = std::strtoul(argv[++i], 0, 10);
+            if (options.threads == 0) {
+                return false;
+            }
+        } else if (option == "--batch") {
+            options.isBatch = true;
+        } else if (option == "--follow") {
+            options.isFollowing = true;
+        } else if (option == "--idle" && i + 1 < argc - 1) {
+            char const* pos = argv[++i];
+            char const* last = pos + std::strlen(pos);
+            if (!FastNumber::parseDecimal(pos, last, options.idleTimeout) || pos != last
+                    || options.idleTimeout < 0.0) {
+                return false;
+            }
+        } else if (option == "--results" && i + 1 < argc - 1) {
+            options.resultsPath = argv[++i];
+        } else if (option == "--hash") {
+            options.hashContents = true;
+        } else if (option == "--pipeline") {
+            options.pipelined = true;
+        } else if (option == "--cache") {
+            options.useCache = true;
+        } else if (option == "--strict") {
+            options.isStrict = true;
+        } else if (option == "--stats" || option == "--stats=text") {
+            options.stats = "text";
+        } else if (option == "--stats=json") {
+            options.stats = "json";
+        } else if (option == "--keep-frames") {
+            options.keepFrames = true;
+        } else if (option == "--log-frames") {
+            options.logFrames = true;
+        } else if (option == "--dump-frames" && i + 1 < argc - 1) {
+            options.frameDumpPath = argv[++i];
+        } else if (option == "--clusters") {
+            options.measureClusters = true;
+        } else if (option == "--relabel") {
+            options.measureClusters = true;
+            options.relabelClusters = true;
+        } else if (option == "--find-noisy" && i + 1 < argc - 1) {
+            options.noisyMaskPath = argv[++i];
+        } else if (option == "--mask" && i + 1 < argc - 1) {
+            options.maskPath = argv[++i];
+        } else if (option == "--hit-map" && i + 1 < argc - 1) {
+            options.hitMapPath = argv[++i];
+        } else if (option == "--tot-map" && i + 1 < argc - 1) {
+            options.totMapPath = argv[++i];
+        } else if (option == "--export-hits" && i + 1 < argc - 1) {
+            options.exports.push_back(std::make_pair(EXPORT_HITS_CSV, std::string(argv[++i])));
+        } else if (option == "--export-frames" && i + 1 < argc - 1) {
+            options.exports.push_back(std::make_pair(EXPORT_FRAMES_CSV, std::string(argv[++i])));
+        } else if (option == "--export-columns" && i + 1 < argc - 1) {
+            options.exports.push_back(std::make_pair(EXPORT_COLUMNS, std::string(argv[++i])));
+        } else if (option == "--export-log" && i + 1 < argc - 1) {
+            options.exports.push_back(std::make_pair(EXPORT_CLUSTER_LOG, std::string(argv[++i])));
+        } else if (option == "--cluster-size" && i + 1 < argc - 1) {
+            double minimum = 0.0;
+            double maximum = 0.0;
+            if (!parseRangeArgument(argv[++i], minimum, maximum) || minimum < 1.0
+                    || maximum >= std::numeric_limits<unsigned int>::max()) {
+                return false;
+            }
+            options.minimumClusterSize = static_cast<unsigned int>(minimum);
+            options.maximumClusterSize = static_cast<unsigned int>(maximum);
+        } else if (option == "--frames" && i + 1 < argc - 1) {
+            options.isFrameRanged = true;
+            if (!parseRangeArgument(argv[++i], options.rangeStart, options.rangeEnd)) {
+                return false;
+            }
+        } else if (option == "--time" && i + 1 < argc - 1) {
+            options.isTimeRanged = true;
+            if (!parseRangeArgument(argv[++i], options.rangeStart, options.rangeEnd)) {
+                return false;
+            }
+        } else if (option == "--bins" && i + 1 < argc - 1) {
+            options.bins = std::strtoul(argv[++i], 0, 10);
+            if (options.bins == 0) {
+                return false;
+            }
+        } else if (option == "--bin-width" && i + 1 < argc - 1) {
+            options.binWidth = std::strtoul(argv[++i], 0, 10);
+            if (options.binWidth == 0) {
+                return false;
+            }
+        } else if (option == "--peak" && i + 1 < argc - 1) {
+            std::pair<double, std::string> peak;
+            if (!parsePeakArgument(argv[++i], peak.first, peak.second)) {
+                return false;
+            }
+            options.peaks.push_back(peak);
+        } else {
+            return false;
+        }
+    }
+
+    // The fit mode takes its sources one by one, only a single file can be
+    // followed, from its start, and each search for noisy pixels, hit map or
+    // export saves its own file
+    if (options.isBatch && (options.mode == "f" || options.mode == "-f"
+                            || !options.noisyMaskPath.empty()
+                            || !options.hitMapPath.empty() || !options.totMapPath.empty()
+                            || !options.exports.empty())) {
+        return false;
+    }
+    if (options.logFrames && !options.frameDumpPath.empty()) {
+        return false;
+    }
+    if (options.isFollowing && (options.isBatch || options.mode == "f" || options.mode == "-f"
+                                || options.isFrameRanged || options.isTimeRanged)) {
+        return false;
+    }
+
+    return true;
 }
 
 
@@ -60,82 +899,126 @@ inline void logFrameDetails(std::ostream& log,
 int main(int argc, char **argv)
 {
     // Variables
-    // Stores the frames
-    std::map <unsigned int, Frame<int> > frames = std::map <unsigned int, Frame<int> > ();
-    // The input stream to grab data from
-    std::shared_ptr<TextFileReader<int> > input = std::make_shared<TextFileReader<int> >();
     // The output stream for the log file
     std::ofstream log;
 
 
+    // The options the program was run with
+    Options options;
+
+
     // Handle the arguments passed into the program
-    if (argc == 3) {
+    if (parseArguments(argc, argv, options)) {
         // attempt to open and read the file specified
         try {
             // Set up the input strings for comparison later
-            std::string mode = argv[1];
-            std::string filePath = argv[2];
-            std::string settings = "";
+            std::string mode = options.mode;
+            std::string filePath = options.filePath;
 
             // Open a log file
             log.open(LOG_FILE_NAME, std::fstream::out | std::fstream::binary);
             log << "Opened log file\n";
 
+            // Measure the stages of the run, if asked to
+            StageStats::setEnabled(!options.stats.empty());
+
 
-            log << "Opening detector dataset: " << filePath << "\n";
-            input->open(filePath); // Open the input data file
+            // The decode mode writes a binary frame dump out as the text a
+            // frame log holds
+            if (mode == "d" || mode == "-d") {
+                FrameDumpReader<int> dump;
+                dump.open(filePath);
+                log << "Decoded " << dump.decode(std::cout) << " frames from: " << filePath << "\n";
 
-            unsigned int frameNumber = 1; // Stores the current number of frames read
+                log << "Closing log file\n";
+                log.close();
+
+                return 0;
+            }
 
-            log << "Starting frame retrieval loop...\n";
-            while (!input->endOfStream()) {
-                Frame<int> frame(input->getFrame());
+            // The fit mode reads its sources' histograms, and its file is the
+            // coefficient table it writes
+            if (mode == "f" || mode == "-f") {
+                fitCalibration(options, log);
 
-                //logFrameDetails(log, frame, frameNumber);
+                log << "Closing log file\n";
+                log.close();
 
-                // Store the frame in the map of frames
-                frames[frameNumber] = frame;
-                // Increase the counter for the number of frames processed
-                frameNumber++;
+                return 0;
             }
-            log << "Finished reading in data\n";
-            
-            log << "Number of frames is:\n "
-                << (frameNumber - 1)
-                << " frames\n";
 
+            // Load the outputs of earlier runs
+            std::unique_ptr<ResultCache> results;
+            if (!options.resultsPath.empty()) {
+                results.reset(new ResultCache());
+                log << "Loaded " << results->load(options.resultsPath)
+                    << " stored results from: " << options.resultsPath << "\n";
+            }
 
+            // Load the mask of the pixels to drop
+            std::unique_ptr<PixelMask<> > mask;
+            if (!options.maskPath.empty()) {
+                mask.reset(new PixelMask<>());
+                mask->load(options.maskPath);
+                log << "Masking " << mask->numberOfMasked() << " pixels from: " << options.maskPath << "\n";
+            }
 
-            // Check the mode and do the correct actions
-            // If on table generation mode:
-            if (mode == "t" || mode == "-t")
-            {
-                // Create the table entry generator
-                std::shared_ptr<TableEntryGen> tableEntryGen = std::make_shared<TableEntryGen>(
-                    input->detectorName(),    // The name of the detector
-                    input->size(),            // The size of the file in bytes
-                    input->numberOfLines(),   // The number of lines in the file
-                    frameNumber,              // The number of frames in the file
-                    input->settings()         // The settings string for the data set
-                );
+            // Open the log of every frame, written by its own thread
+            std::unique_ptr<AsyncLog> frameLog;
+            if (!options.frameDumpPath.empty()) {
+                frameLog.reset(new AsyncLog(options.frameDumpPath, dumpHeader(TimepixGeometry::INDEX_BITS)));
+            } else if (options.logFrames) {
+                frameLog.reset(new AsyncLog(FRAME_LOG_FILE_NAME));
+            }
 
-                std::string entry = tableEntryGen->generateEntry();
+            if (options.isBatch) {
+                // Every dataset under the directory, side by side
+                DatasetBatch batch(filePath);
+                log << "Found " << batch.size() << " datasets under: " << filePath << "\n";
 
-                log << "Generated table entry:\n"
-                    << entry << "\n";
+                unsigned int failed = batch.run(options.threads,
+                    [&options, &results, &mask, &frameLog](BatchDataset const& dataset, unsigned int const threads, std::ostream& datasetLog) {
+                        return analyseDataset(dataset.path, options, threads, datasetLog, results.get(), mask.get(),
+                                              frameLog.get());
+                    },
+                    [&log](BatchDataset const& dataset, BatchResult const& result) {
+                        log << result.log;
+                        if (result.isFailed) {
+                            log << "Failed on " << dataset.path << ": " << result.error << "\n";
+                            std::cerr << "An error occurred in " << dataset.path << ": " << result.error << "\n";
+                        } else {
+                            std::cout << result.output << std::flush;
+                        }
+                    });
+                log << "Finished the batch, " << failed << " of " << batch.size() << " datasets failed\n";
 
-                std::cout << entry << "\n";
+                if (results) {
+                    results->save(options.resultsPath);
+                }
+                closeFrameLog(options, frameLog.get(), log);
+                reportStats(options, log);
+
+                log << "Closing log file\n";
+                log.close();
+
+                return failed ? 1 : 0;
+            }
+
+            if (options.isFollowing) {
+                std::cout << followDataset(filePath, options, log, mask.get(), frameLog.get());
+            } else {
+                std::cout << analyseDataset(filePath, options, options.threads, log, results.get(), mask.get(),
+                                            frameLog.get());
             }
-            // If on calibration mode:
-            else if (mode == "c" || mode == "-c")
-            {
-                // TODO
+
+            if (results) {
+                results->save(options.resultsPath);
             }
+            closeFrameLog(options, frameLog.get(), log);
+            reportStats(options, log);
 
 
             // Clean-up
-            log << "Closing input file\n";
-            input->close();
             log << "Closing log file\n";
             log.close();
 
@@ -143,7 +1026,6 @@ int main(int argc, char **argv)
             std::cerr << "An error occurred: " << e.what() << "\n";
 
             // Close and exit on failure to open or read from the file
-            input->close();
             log.close();
 
             std::exit(1);
@@ -151,9 +1033,6 @@ int main(int argc, char **argv)
             log << "An unforeseen error has occurred!\n";
 
             // Close and exit on failure to open or read from the file
-            log << "Closing input file\n";
-            input->close();
-
             log << "Closing log file\n";
             log.close();
 
@@ -162,9 +1041,52 @@ int main(int argc, char **argv)
     } else { // If there are an incorrect number of arguments
         // Output an error message and a help message for usage
         std::cerr << "Error: Incorrect arguments were used!\n\n"
-                << "USAGE: " << argv[0] << " mode input-cluster-log-name\n"
+                << "USAGE: " << argv[0] << " mode [options] input-cluster-log-name\n"
+                << "A cluster log compressed with gzip or zstd is decompressed as it is read\n"
                 << "mode\tThe mode to run in: \n\t'-t' for Wiki table entry generation,"
-                << "\n\t'-c' for calibration mode\n" << std::endl;
+                << "\n\t'-c' for calibration mode (histograms every pixel's ToT),"
+                << "\n\t'-f' to fit every pixel's calibration to the '--peak' sources"
+                << " (the file is the coefficient table written),"
+                << "\n\t'-d' to decode a '--dump-frames' file into the text '--log-frames' writes\n"
+                << "options\n\t'-j threads' the number of threads to parse with"
+                << " (defaults to the number of cores)"
+                << "\n\t'--batch' to process every ClusterLogAll.txt (or .txt.zst or .txt.gz) under the directory given"
+                << " instead of one cluster log, largest first, outputting them in path order"
+                << "\n\t'--results file' to keep every dataset's output in the given results cache,"
+                << " reusing it while the dataset's size and modification time are unchanged"
+                << "\n\t'--hash' to also check the datasets' content hashes against the results cache"
+                << "\n\t'--follow' to follow the cluster log as it is written, until interrupted"
+                << "\n\t'--idle s' to stop following once the file has not grown for s seconds"
+                << "\n\t'--pipeline' to read and parse on their own threads"
+                << "\n\t'--cache' to write a binary cache next to the input"
+                << " (a fresh cache is always used)"
+                << "\n\t'--frames first:last' to only read the given frames"
+                << "\n\t'--time t0:t1' to only read the frames taken in [t0, t1) seconds"
+                << "\n\t'--bins n' the number of ToT bins per pixel when calibrating (defaults to 128)"
+                << "\n\t'--bin-width w' the ToT range of each bin when calibrating (defaults to 2)"
+                << "\n\t'--peak energy:cluster-log' a calibration source line in keV for '-f'"
+                << " (give at least 4)"
+                << "\n\t'--clusters' to measure and classify every cluster"
+                << "\n\t'--relabel' to also rebuild the clusters by 8-connected labelling"
+                << "\n\t'--find-noisy file' to flag the pixels hit far more often than the rest,"
+                << " saving their mask to the given file"
+                << "\n\t'--mask file' to drop every hit on the pixels of the given mask as it is parsed"
+                << "\n\t'--hit-map file' to save the hits on every pixel, as an image if the file"
+                << " ends in '.png' or '.pgm' and with the summed ToT in full otherwise"
+                << "\n\t'--tot-map file' to save the summed ToT of every pixel in the same way"
+                << "\n\t'--export-hits file' to export every hit as CSV (frame,cluster,x,y,tot)"
+                << "\n\t'--export-frames file' to export every frame as CSV"
+                << " (frame,time,running_time,hits,clusters)"
+                << "\n\t'--export-columns file' to export the hits and frames as binary '.lolx' columns"
+                << "\n\t'--export-log file' to re-emit the frames as a cluster log, filtered by"
+                << " '--time', '--frames', '--mask' and '--cluster-size'"
+                << "\n\t'--cluster-size min:max' to only export the clusters of min to max pixels"
+                << "\n\t'--stats' to log the time, throughput, allocations and peak memory of"
+                << " every stage of the run ('--stats=json' to report them as JSON on standard error)"
+                << "\n\t'--keep-frames' to keep every frame in memory"
+                << "\n\t'--log-frames' to log the details of every frame to '" << FRAME_LOG_FILE_NAME << "'"
+                << "\n\t'--dump-frames file' to dump every frame to the given file in a compact"
+                << " binary form, for decoding later with '-d'\n" << std::endl;
     }
 
     return 0;
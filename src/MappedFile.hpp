@@ -0,0 +1,137 @@
+/**
+ * @file        MappedFile.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines a small read-only memory mapped file wrapper used by the
+ * readers to access the raw bytes of a data file without copying them
+ * (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+// C++ headers
+#include <string>
+#include <cstddef>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+/**
+ * @brief This class maps a whole file read-only into memory and exposes its
+ * bytes as a contiguous character range (class is non-copyable)
+ */
+class MappedFile {
+public:
+
+    /**
+     * @brief   An empty constructor for the MappedFile class
+     * @return  A newly constructed MappedFile object with nothing mapped
+     */
+    MappedFile()
+    {
+    }
+
+
+    /**
+     * @brief   The destructor for the MappedFile class
+     * @return  Nothing
+     */
+    ~MappedFile()
+    {
+        this->close();
+    }
+
+
+    /**
+     * @brief      Maps the given file into memory
+     * @param name The path of the file to map
+     * @return     Nothing, throws boost::interprocess::interprocess_exception
+     * if the file can't be mapped
+     */
+    void open(std::string const& name)
+    {
+        this->close();
+
+        boost::interprocess::file_mapping mapping(name.c_str(), boost::interprocess::read_only);
+        boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+
+        // The mapping object may be dropped once the region exists
+        region_.swap(region);
+
+        // We read the file front to back, so let the kernel read ahead aggressively
+        region_.advise(boost::interprocess::mapped_region::advice_sequential);
+    }
+
+
+    /**
+     * @brief      Unmaps the file if one is mapped
+     * @return     Nothing
+     */
+    void close()
+    {
+        boost::interprocess::mapped_region empty;
+        region_.swap(empty);
+    }
+
+
+    /**
+     * @brief      Checks whether a file is currently mapped
+     * @return     A boolean stating whether a file is mapped
+     */
+    bool isOpen() const
+    {
+        return region_.get_address() != 0;
+    }
+
+
+    /**
+     * @brief      A getter for the first byte of the mapping
+     * @return     A pointer to the first mapped byte
+     */
+    char const* begin() const
+    {
+        return static_cast<char const*>(region_.get_address());
+    }
+
+
+    /**
+     * @brief      A getter for one past the last byte of the mapping
+     * @return     A pointer to one past the last mapped byte
+     */
+    char const* end() const
+    {
+        return begin() + region_.get_size();
+    }
+
+
+    /**
+     * @brief      A getter for the size of the mapping
+     * @return     The number of bytes mapped
+     */
+    std::size_t size() const
+    {
+        return region_.get_size();
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    MappedFile(MappedFile const& other);
+
+
+    // Assignment operator
+    MappedFile& operator=(MappedFile const& other);
+
+
+    boost::interprocess::mapped_region region_; // The mapped view of the file
+};
+
+
+#endif  /* MAPPEDFILE_HPP */
@@ -0,0 +1,195 @@
+/**
+ * @file        NoisyPixelConsumer.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the consumer counting every pixel's hits and flagging
+ * the noisy ones into a pixel mask
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef NOISYPIXELCONSUMER_HPP
+#define NOISYPIXELCONSUMER_HPP
+
+// C++ headers
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+// My headers
+#include <DetectorGeometry.hpp>
+#include <Frame.hpp>
+#include <FrameConsumer.hpp>
+#include <PixelMask.hpp>
+
+/**
+ * @brief This class keeps a running count of the hits on every pixel, and
+ * once the dataset is finished flags the pixels hit far more often than the
+ * rest <br>
+ * The typical count and its spread are taken from the median and the median
+ * absolute deviation of the pixels hit, which the noisy pixels themselves
+ * can't drag upwards; the spread is never taken below the Poisson spread of
+ * the median, so a flat, sparse exposure doesn't flag its own fluctuations
+ * <br>
+ * The mask of the flagged pixels is saved for later runs to drop their hits
+ */
+template <class T>
+class NoisyPixelConsumer : public FrameConsumer<T> {
+public:
+
+    /**
+     * @brief        A constructor for the NoisyPixelConsumer class
+     * @param path   The path to save the mask to once the dataset is finished
+     * (or empty to not save it)
+     * @param sigmas How many spreads above the typical count a pixel's count
+     * has to be for it to be flagged
+     * @return       A newly constructed NoisyPixelConsumer object
+     */
+    explicit NoisyPixelConsumer(std::string const& path, double const sigmas = 5.0)
+        : path_(path), sigmas_(sigmas), counts_(TimepixGeometry::PIXELS, 0), frames_(0),
+        median_(0.0), spread_(0.0), threshold_(0.0)
+    {
+    }
+
+
+    /**
+     * @brief             Counts the hits of a frame
+     * @param frame       The frame
+     * @param frameNumber The number of the frame
+     * @return            Nothing
+     */
+    virtual void consume(Frame<T> const& frame, unsigned int const frameNumber)
+    {
+        frames_++;
+
+        Span<std::uint32_t const> const hits = frame.hits();
+        for (std::size_t i = 0; i < hits.size(); ++i) {
+            counts_[TimepixGeometry::indexOf(hits[i])]++;
+        }
+    }
+
+
+    /**
+     * @brief         Flags the noisy pixels and saves their mask
+     * @param summary The details of the whole dataset
+     * @return        Nothing, throws std::ifstream::failure if the mask can't
+     * be saved
+     */
+    virtual void finish(DatasetSummary const& summary)
+    {
+        findNoisy();
+
+        if (!path_.empty()) {
+            mask_.save(path_);
+        }
+    }
+
+
+    /**
+     * @brief   A getter for the mask of the noisy pixels (empty until the
+     * dataset is finished)
+     * @return  The mask
+     */
+    PixelMask<> const& mask() const
+    {
+        return mask_;
+    }
+
+
+    /**
+     * @brief       A getter for the number of hits counted on a pixel
+     * @param index The pixel's index
+     * @return      The number of hits
+     */
+    unsigned long long count(std::uint32_t const index) const
+    {
+        return counts_[index];
+    }
+
+
+    /**
+     * @brief   Summarises the pixels flagged
+     * @return  The number of noisy pixels and the count they were flagged
+     * above
+     */
+    std::string const report() const
+    {
+        std::ostringstream report;
+        report << mask_.numberOfMasked() << " noisy pixels (hit over " << threshold_
+               << " times in " << frames_ << " frames, median " << median_
+               << ", spread " << spread_ << ")";
+        if (!path_.empty()) {
+            report << " masked into " << path_;
+        }
+
+        return report.str();
+    }
+
+private:
+
+    // Utility Functions
+    void findNoisy()
+    {
+        // Flags every pixel whose count lies more than sigmas_ spreads above
+        // the median of the pixels hit
+
+        mask_.clear();
+
+        std::vector<unsigned long long> hit;
+        hit.reserve(counts_.size());
+        for (std::size_t i = 0; i < counts_.size(); ++i) {
+            if (counts_[i]) {
+                hit.push_back(counts_[i]);
+            }
+        }
+        if (hit.empty()) {
+            median_ = spread_ = threshold_ = 0.0;
+            return;
+        }
+
+        median_ = static_cast<double>(median(hit));
+        for (std::size_t i = 0; i < hit.size(); ++i) {
+            double const deviation = std::fabs(static_cast<double>(hit[i]) - median_);
+            hit[i] = static_cast<unsigned long long>(deviation + 0.5);
+        }
+        // 1.4826 scales the median absolute deviation to a standard deviation
+        spread_ = std::max(1.4826 * static_cast<double>(median(hit)), std::sqrt(std::max(median_, 1.0)));
+        threshold_ = median_ + sigmas_ * spread_;
+
+        for (std::size_t i = 0; i < counts_.size(); ++i) {
+            if (static_cast<double>(counts_[i]) > threshold_) {
+                mask_.mask(static_cast<std::uint32_t>(i));
+            }
+        }
+    }
+
+
+    static unsigned long long median(std::vector<unsigned long long>& values)
+    {
+        // The middle value (the upper of the two for an even count), which
+        // partially reorders the values
+
+        std::vector<unsigned long long>::iterator middle = values.begin() + values.size() / 2;
+        std::nth_element(values.begin(), middle, values.end());
+
+        return *middle;
+    }
+
+    std::string path_; // The path the mask is saved to
+    double sigmas_; // The spreads above the median a noisy pixel lies
+    std::vector<unsigned long long> counts_; // The number of hits on each pixel
+    unsigned long long frames_; // The number of frames counted
+    double median_; // The median count of the pixels hit
+    double spread_; // The spread of the counts of the pixels hit
+    double threshold_; // The count a pixel is flagged above
+    PixelMask<> mask_; // The noisy pixels
+};
+
+
+#endif  /* NOISYPIXELCONSUMER_HPP */
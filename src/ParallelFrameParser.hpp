@@ -0,0 +1,427 @@
+/**
+ * @file        ParallelFrameParser.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the class for parsing a cluster log held in memory on
+ * several threads at once, while still handing the frames out in file order
+ * (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef PARALLELFRAMEPARSER_HPP
+#define PARALLELFRAMEPARSER_HPP
+
+// C++ headers
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <cstring>
+// My headers
+#include <Frame.hpp>
+#include <FramePool.hpp>
+#include <ClusterLogParser.hpp>
+#include <ByteScanner.hpp>
+
+/**
+ * @brief This class splits a cluster log's bytes into chunks starting at frame
+ * headers, parses the chunks on a pool of worker threads which steal chunks
+ * from each other when they run dry, and hands the frames back in file order
+ * <br>
+ * Each worker parses into frames drawn from a pool of its own, and the frames
+ * go back to that pool once they have been handed out <br>
+ * Workers never run more than a window of chunks ahead of the chunk being
+ * handed out, so the frames in flight (and so the pools) stay bounded and
+ * parsing stops allocating once the pools have warmed up, however large the
+ * file (class is non-copyable)
+ */
+template <class T>
+class ParallelFrameParser {
+public:
+
+    /**
+     * @brief             A constructor for the ParallelFrameParser class
+     * @param begin       The first byte of the cluster log
+     * @param end         One past the last byte of the cluster log
+     * @param threads     The number of worker threads to parse with
+     * @param origin      The first byte of the whole file, when only part of
+     * it is being parsed (used to report errors against the right line)
+     * @return            A newly constructed ParallelFrameParser object
+     */
+    ParallelFrameParser(char const* begin,
+                        char const* end,
+                        unsigned int const threads,
+                        char const* origin = 0)
+        : begin_(begin), end_(end), origin_(origin ? origin : begin), threads_(threads ? threads : 1),
+        mask_(0), rejected_(0)
+    {
+        splitChunks();
+
+        for (unsigned int i = 0; i < threads_; ++i) {
+            pools_.push_back(std::unique_ptr<FramePool<T> >(new FramePool<T>()));
+        }
+    }
+
+
+    /**
+     * @brief   The destructor for the ParallelFrameParser class
+     * @return  Nothing
+     */
+    ~ParallelFrameParser()
+    {
+    }
+
+
+    /**
+     * @brief      Sets the mask of pixels whose hits are dropped as the frames
+     * are parsed
+     * @param mask The mask, which has to outlive the parse, or null to keep
+     * every hit
+     * @return     Nothing
+     */
+    void setMask(PixelMask<> const* mask)
+    {
+        mask_ = mask;
+    }
+
+
+    /**
+     * @brief          Sets the tally of the hits dropped for lying off the
+     * detector's matrix as the frames are parsed
+     * @param rejected The tally, which has to outlive the parse, or null to drop
+     * such hits uncounted
+     * @return         Nothing
+     */
+    void setRejectedHits(RejectedHits* rejected)
+    {
+        rejected_ = rejected;
+    }
+
+
+    /**
+     * @brief         Parses every frame and hands each one to the callback in
+     * file order, on the calling thread
+     * @param onFrame A callable taking (Frame<T> const&, unsigned int frameNumber),
+     * where frames are numbered from 1
+     * @return        The number of frames parsed, re-throws the first (in file
+     * order) std::ifstream::failure raised by a worker, or whatever the
+     * callback throws, once the workers have stopped
+     */
+    template <class Callback>
+    unsigned int parse(Callback onFrame)
+    {
+        std::size_t const chunkCount = chunks_.size();
+        if (chunkCount == 0) {
+            return 0;
+        }
+
+        std::vector<Result> results(chunkCount);
+        std::vector<Queue> queues(threads_);
+
+        // Deal the chunks out to the workers in turn, so they all move
+        // through the file together and stay within the window
+        for (unsigned int i = 0; i < threads_; ++i) {
+            queues[i].next = 0;
+            queues[i].end = (chunkCount + threads_ - 1 - i) / threads_;
+        }
+
+        Window window;
+        window.limit = WINDOW_CHUNKS_PER_THREAD * threads_;
+        window.isStopping = false;
+
+        std::vector<std::thread> workers;
+        for (unsigned int i = 0; i < threads_; ++i) {
+            workers.push_back(std::thread(&ParallelFrameParser<T>::work, this, i,
+                    std::ref(queues), std::ref(results), std::ref(window)));
+        }
+
+        // Emit the chunks in order as they complete, freeing each one as we go
+        unsigned int frameNumber = 1;
+        std::exception_ptr error;
+        try {
+            for (std::size_t i = 0; i < chunkCount && !error; ++i) {
+                {
+                    std::unique_lock<std::mutex> lock(window.mutex);
+                    while (!results[i].isDone) {
+                        window.finished.wait(lock);
+                    }
+                }
+
+                if (results[i].error) {
+                    error = results[i].error;
+                    break;
+                }
+
+                for (std::size_t j = 0; j < results[i].frames.size(); ++j) {
+                    onFrame(*results[i].frames[j], frameNumber);
+                    frameNumber++;
+                }
+                results[i].pool->release(results[i].frames);
+
+                // Let the workers claim one chunk further on
+                std::lock_guard<std::mutex> lock(window.mutex);
+                window.limit++;
+                window.advanced.notify_all();
+            }
+        } catch (...) {
+            // The callback threw, so the workers have to be stopped before
+            // the exception leaves with their threads still running
+            stopWorkers(workers, results, window);
+            throw;
+        }
+
+        // Stop the workers early if we are going to throw
+        if (error) {
+            stopWorkers(workers, results, window);
+            std::rethrow_exception(error);
+        }
+        for (std::size_t i = 0; i < workers.size(); ++i) {
+            workers[i].join();
+        }
+
+        return frameNumber - 1;
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    ParallelFrameParser(ParallelFrameParser const& other);
+
+
+    // Assignment operator
+    ParallelFrameParser& operator=(ParallelFrameParser const& other);
+
+
+    struct Chunk {
+        char const* begin; // The frame header starting the chunk
+        char const* end; // The frame header starting the next chunk
+    };
+
+
+    struct Result {
+        Result() : pool(0), isDone(false) {}
+
+        std::vector<Frame<T>*> frames; // The frames parsed from the chunk
+        FramePool<T>* pool; // The pool the frames were drawn from
+        std::exception_ptr error; // The error raised parsing the chunk, if any
+        bool isDone; // Whether the chunk has been parsed (guarded by the mutex)
+    };
+
+
+    struct Queue {
+        Queue() : next(0), end(0) {}
+        Queue(Queue const& other) : next(other.next.load()), end(other.end) {}
+
+        std::atomic<std::size_t> next; // The position of the next chunk to claim
+        std::size_t end; // The number of chunks dealt to this queue
+        char padding[64]; // Keeps the queues' counters on separate cache lines
+    };
+
+
+    struct Window {
+        std::mutex mutex; // Guards the results' flags and the limit
+        std::condition_variable finished; // Signalled when a chunk is parsed
+        std::condition_variable advanced; // Signalled when the limit moves on
+        std::size_t limit; // One past the furthest chunk which may be claimed
+        bool isStopping; // Whether the workers should give up
+    };
+
+
+    // The number of chunks per thread the workers may run ahead by
+    static const std::size_t WINDOW_CHUNKS_PER_THREAD = 2;
+    // The smallest and largest chunks the file is split into
+    static const std::size_t MINIMUM_CHUNK_SIZE = 1 << 20;
+    static const std::size_t MAXIMUM_CHUNK_SIZE = 2 << 20;
+
+
+    // Utility Functions
+    char const* alignToFrame(char const* pos) const
+    {
+        // Moves pos forward to the start of the next line holding a frame
+        // header (or to the end), unless it already sits on one
+
+        if (pos <= begin_) {
+            return begin_;
+        }
+
+        while (pos < end_) {
+            if (*(pos - 1) == '\n' && end_ - pos >= 6 && std::memcmp(pos, "Frame ", 6) == 0) {
+                return pos;
+            }
+            char const* newline = static_cast<char const*>(std::memchr(pos, '\n', end_ - pos));
+            if (!newline) {
+                break;
+            }
+            pos = newline + 1;
+        }
+
+        return end_;
+    }
+
+
+    void splitChunks()
+    {
+        // Splits the bytes into several chunks per thread so that uneven frame
+        // sizes can be balanced by stealing
+
+        // Chunks are also kept small enough that the window of chunks in
+        // flight stays small whatever the size of the file
+        std::size_t const size = end_ - begin_;
+        std::size_t count = threads_ * 8;
+        if (size / count < MINIMUM_CHUNK_SIZE) {
+            count = size / MINIMUM_CHUNK_SIZE + 1;
+        } else if (size / count > MAXIMUM_CHUNK_SIZE) {
+            count = size / MAXIMUM_CHUNK_SIZE + 1;
+        }
+
+        char const* chunkBegin = begin_;
+        for (std::size_t i = 1; i <= count && chunkBegin < end_; ++i) {
+            char const* chunkEnd = (i == count) ? end_ : alignToFrame(begin_ + size * i / count);
+            if (chunkEnd > chunkBegin) {
+                Chunk chunk = { chunkBegin, chunkEnd };
+                chunks_.push_back(chunk);
+                chunkBegin = chunkEnd;
+            }
+        }
+    }
+
+
+    void stopWorkers(std::vector<std::thread>& workers, std::vector<Result>& results, Window& window)
+    {
+        // Tells the workers to give up, waits for them, then hands the frames
+        // of the chunks never emitted back to their pools
+
+        {
+            std::lock_guard<std::mutex> lock(window.mutex);
+            window.isStopping = true;
+            window.advanced.notify_all();
+        }
+        for (std::size_t i = 0; i < workers.size(); ++i) {
+            if (workers[i].joinable()) {
+                workers[i].join();
+            }
+        }
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            if (results[i].pool && !results[i].frames.empty()) {
+                results[i].pool->release(results[i].frames);
+            }
+        }
+    }
+
+
+    bool claim(std::vector<Queue>& queues, unsigned int const worker, std::size_t& chunk, Window& window)
+    {
+        // Claims the next chunk of the worker's own queue, or steals the next
+        // one from another worker's queue once its own has run dry or has
+        // run ahead of the window, waiting for the window to move on when no
+        // queue has a chunk within it
+        // Queue i holds chunks i, i + threads, i + 2 * threads...
+
+        for (;;) {
+            bool isAnyLeft = false;
+            std::size_t limit = 0;
+            {
+                std::lock_guard<std::mutex> lock(window.mutex);
+                if (window.isStopping) {
+                    return false;
+                }
+                limit = window.limit;
+            }
+
+            for (unsigned int i = 0; i < threads_; ++i) {
+                unsigned int const owner = (worker + i) % threads_;
+                Queue& queue = queues[owner];
+                std::size_t position = queue.next.load();
+                if (position >= queue.end) {
+                    continue;
+                }
+                isAnyLeft = true;
+                if (owner + position * threads_ >= limit) {
+                    continue;
+                }
+                position = queue.next.fetch_add(1);
+                if (position < queue.end) {
+                    chunk = owner + position * threads_;
+                    return true;
+                }
+            }
+
+            if (!isAnyLeft) {
+                return false;
+            }
+
+            std::unique_lock<std::mutex> lock(window.mutex);
+            while (window.limit == limit && !window.isStopping) {
+                window.advanced.wait(lock);
+            }
+        }
+    }
+
+
+    void parseChunk(Chunk const& chunk, Result& result, unsigned int const firstLine)
+    {
+        ClusterLogParser<T> parser(chunk.begin, chunk.end, firstLine);
+        parser.setMask(mask_);
+        parser.setRejectedHits(rejected_);
+        while (!parser.atEnd()) {
+            result.frames.push_back(result.pool->acquire());
+            parser.parseFrame(*result.frames.back());
+        }
+    }
+
+
+    void work(unsigned int const worker,
+              std::vector<Queue>& queues,
+              std::vector<Result>& results,
+              Window& window)
+    {
+        std::size_t chunk = 0;
+        while (claim(queues, worker, chunk, window)) {
+            Result& result = results[chunk];
+            result.pool = pools_[worker].get();
+
+            try {
+                parseChunk(chunks_[chunk], result, 1);
+            } catch (std::ifstream::failure const&) {
+                // Line numbers are only known relative to the chunk, so count
+                // the lines before it and parse it again to report the error
+                // against the right line of the file
+                result.pool->release(result.frames);
+                unsigned int const firstLine = static_cast<unsigned int>(
+                        ByteScanner::scan(origin_, chunks_[chunk].begin).lines) + 1;
+                try {
+                    parseChunk(chunks_[chunk], result, firstLine);
+                } catch (...) {
+                    result.error = std::current_exception();
+                }
+            } catch (...) {
+                result.error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(window.mutex);
+            result.isDone = true;
+            window.finished.notify_all();
+        }
+    }
+
+    char const* begin_; // The first byte of the cluster log
+    char const* end_; // One past the last byte of the cluster log
+    char const* origin_; // The first byte of the whole file
+    unsigned int threads_; // The number of worker threads
+    PixelMask<> const* mask_; // The mask of dropped pixels, or null
+    RejectedHits* rejected_; // The tally of hits dropped off the matrix, or null
+    std::vector<Chunk> chunks_; // The frame aligned chunks of the cluster log
+    std::vector<std::unique_ptr<FramePool<T> > > pools_; // Each worker's frames
+};
+
+
+#endif  /* PARALLELFRAMEPARSER_HPP */
@@ -0,0 +1,166 @@
+/**
+ * @file        PeakTable.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the table of every pixel's ToT peak for one calibration
+ * source of known energy (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef PEAKTABLE_HPP
+#define PEAKTABLE_HPP
+
+// C++ headers
+#include <cstdint>
+#include <cassert>
+// My headers
+#include <Span.hpp>
+#include <AlignedBuffer.hpp>
+#include <ToTHistogram.hpp>
+
+/**
+ * @brief This class locates the peak of every pixel's ToT spectrum for a
+ * source line of known energy, so the spectra themselves can be dropped
+ * before the next source is loaded <br>
+ * A peak is the centroid of the bins around the fullest bin of the spectrum
+ * (leaving out the overflow bin), and is only kept when those bins hold
+ * enough hits (class is non-copyable)
+ */
+class PeakTable {
+public:
+
+    /**
+     * @brief           A constructor for the PeakTable class
+     * @param energy    The energy of the source line, in keV
+     * @param histogram The per-pixel ToT spectra taken with the source
+     * @param minimumHits The fewest hits around a peak for it to be kept
+     * @return          A newly constructed PeakTable object
+     */
+    PeakTable(double const energy,
+              ToTHistogram const& histogram,
+              unsigned long long const minimumHits = 10)
+        : energy_(energy), peaks_(MATRIX_PIXELS), weights_(MATRIX_PIXELS), found_(0)
+    {
+        for (unsigned int pixel = 0; pixel < MATRIX_PIXELS; ++pixel) {
+            double peak = 0.0;
+            if (findPeak(histogram.counts(pixel), histogram.binWidth(), minimumHits, peak)) {
+                peaks_[pixel] = peak;
+                weights_[pixel] = 1.0;
+                found_++;
+            }
+        }
+    }
+
+
+    /**
+     * @brief   The destructor for the PeakTable class
+     * @return  Nothing
+     */
+    ~PeakTable()
+    {
+    }
+
+
+    /**
+     * @brief   Retrieves the energy of the source line
+     * @return  The energy, in keV
+     */
+    double energy() const
+    {
+        return energy_;
+    }
+
+
+    /**
+     * @brief   Retrieves every pixel's peak ToT, in Pixel::xy() order
+     * @return  The peaks (0 where no peak was found)
+     */
+    double const* peaks() const
+    {
+        return peaks_.data();
+    }
+
+
+    /**
+     * @brief   Retrieves the weight of every pixel's peak, in Pixel::xy() order
+     * @return  The weights (1 where a peak was found, 0 where none was)
+     */
+    double const* weights() const
+    {
+        return weights_.data();
+    }
+
+
+    /**
+     * @brief   Retrieves the number of pixels a peak was found for
+     * @return  The number of pixels
+     */
+    unsigned int numberOfPeaks() const
+    {
+        return found_;
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    PeakTable(PeakTable const& other);
+
+
+    // Assignment operator
+    PeakTable& operator=(PeakTable const& other);
+
+
+    // Utility Functions
+    static bool findPeak(Span<std::uint32_t const> const counts,
+                         unsigned int const binWidth,
+                         unsigned long long const minimumHits,
+                         double& peak)
+    {
+        // The half width, in bins, of the window the centroid is taken over
+        static const std::size_t HALF_WINDOW = 2;
+
+        if (counts.size() < 2) {
+            return false;
+        }
+
+        // The last bin collects every ToT past the range, so it is no peak
+        std::size_t const last = counts.size() - 1;
+        std::size_t fullest = 0;
+        for (std::size_t i = 1; i < last; ++i) {
+            if (counts[i] > counts[fullest]) {
+                fullest = i;
+            }
+        }
+
+        std::size_t const first = fullest > HALF_WINDOW ? fullest - HALF_WINDOW : 0;
+        std::size_t const end = fullest + HALF_WINDOW + 1 < last ? fullest + HALF_WINDOW + 1 : last;
+        unsigned long long hits = 0;
+        double weighted = 0.0;
+        for (std::size_t i = first; i < end; ++i) {
+            hits += counts[i];
+            weighted += counts[i] * (i + 0.5);
+        }
+
+        if (hits < minimumHits || hits == 0) {
+            return false;
+        }
+
+        peak = weighted / hits * binWidth;
+
+        return true;
+    }
+
+    double energy_; // The energy of the source line, in keV
+    AlignedBuffer<double> peaks_; // Every pixel's peak ToT
+    AlignedBuffer<double> weights_; // Every pixel's peak weight
+    unsigned int found_; // The number of pixels a peak was found for
+};
+
+
+#endif  /* PEAKTABLE_HPP */
@@ -0,0 +1,443 @@
+/**
+ * @file        PipelinedFrameReader.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the class reading and parsing a cluster log on separate
+ * threads, so the disk and the parser are kept busy at the same time
+ * (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef PIPELINEDFRAMEREADER_HPP
+#define PIPELINEDFRAMEREADER_HPP
+
+// C++ headers
+#include <fstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <cstring>
+// My headers
+#include <Frame.hpp>
+#include <ClusterLogParser.hpp>
+#include <SpscRing.hpp>
+#include <CompressedStream.hpp>
+
+/**
+ * @brief This class runs a three stage pipeline over a cluster log: a reader
+ * thread fills large buffers from the file (or from a CompressedStream, whose
+ * own threads decompress it), a parser thread turns them into frames, and the
+ * calling thread consumes the frames <br>
+ * The stages hand buffers and frames to each other through lock-free
+ * single-producer/single-consumer rings, and both are recycled once used,
+ * so the pipeline allocates nothing once it is warm (class is non-copyable)
+ */
+template <class T>
+class PipelinedFrameReader {
+public:
+
+    /**
+     * @brief            A constructor for the PipelinedFrameReader class
+     * @param path       The path of the cluster log to read
+     * @param offset     The byte offset to start reading from, which has to
+     * be the start of a frame
+     * @param bufferSize The size of each read buffer in bytes
+     * @param buffers    The number of read buffers in flight
+     * @param frames     The number of frames in flight
+     * @return           A newly constructed PipelinedFrameReader object
+     */
+    PipelinedFrameReader(std::string const& path,
+                         unsigned long long const offset = 0,
+                         std::size_t const bufferSize = 4 << 20,
+                         std::size_t const buffers = 4,
+                         std::size_t const frames = 64)
+        : path_(path), offset_(offset), stream_(0),
+        buffers_(buffers, std::vector<char>(bufferSize)),
+        frames_(frames), textOffsets_(frames),
+        emptyBuffers_(buffers), filledBuffers_(buffers),
+        freeFrames_(frames), parsedFrames_(frames),
+        isStopping_(false), mask_(0), rejected_(0), numberOfLines_(0)
+    {
+    }
+
+
+    /**
+     * @brief            A constructor for the PipelinedFrameReader class,
+     * reading the text of a compressed cluster log
+     * @param stream     The decompressed text, read from its start, which has
+     * to outlive the reader
+     * @param bufferSize The size of each read buffer in bytes
+     * @param buffers    The number of read buffers in flight
+     * @param frames     The number of frames in flight
+     * @return           A newly constructed PipelinedFrameReader object
+     */
+    PipelinedFrameReader(CompressedStream& stream,
+                         std::size_t const bufferSize = 4 << 20,
+                         std::size_t const buffers = 4,
+                         std::size_t const frames = 64)
+        : offset_(0), stream_(&stream),
+        buffers_(buffers, std::vector<char>(bufferSize)),
+        frames_(frames), textOffsets_(frames),
+        emptyBuffers_(buffers), filledBuffers_(buffers),
+        freeFrames_(frames), parsedFrames_(frames),
+        isStopping_(false), mask_(0), rejected_(0), numberOfLines_(0)
+    {
+    }
+
+
+    /**
+     * @brief   The destructor for the PipelinedFrameReader class
+     * @return  Nothing
+     */
+    ~PipelinedFrameReader()
+    {
+    }
+
+
+    /**
+     * @brief      Sets the mask of pixels whose hits are dropped as the frames
+     * are parsed
+     * @param mask The mask, which has to outlive the run, or null to keep
+     * every hit
+     * @return     Nothing
+     */
+    void setMask(PixelMask<> const* mask)
+    {
+        mask_ = mask;
+    }
+
+
+    /**
+     * @brief          Sets the tally of the hits dropped for lying off the
+     * detector's matrix as the frames are parsed
+     * @param rejected The tally, which has to outlive the run, or null to drop
+     * such hits uncounted
+     * @return         Nothing
+     */
+    void setRejectedHits(RejectedHits* rejected)
+    {
+        rejected_ = rejected;
+    }
+
+
+    /**
+     * @brief         Streams every frame of the file through the callback in
+     * file order, on the calling thread
+     * @param onFrame A callable taking (Frame<T> const&, unsigned int frameNumber),
+     * where frames are numbered from 1
+     * @return        The number of frames read, re-throws any error raised by
+     * the reader or parser threads
+     */
+    template <class Callback>
+    unsigned int run(Callback onFrame)
+    {
+        isStopping_ = false;
+        readError_ = std::exception_ptr();
+        parseError_ = std::exception_ptr();
+
+        for (std::size_t i = 0; i < buffers_.size(); ++i) {
+            emptyBuffers_.push(i);
+        }
+        for (std::size_t i = 0; i < frames_.size(); ++i) {
+            freeFrames_.push(&frames_[i]);
+        }
+
+        std::thread reader(&PipelinedFrameReader<T>::read, this);
+        std::thread parser(&PipelinedFrameReader<T>::parse, this);
+
+        // The consumer stage
+        unsigned int frameNumber = 0;
+        std::exception_ptr error;
+        for (;;) {
+            Frame<T>* frame = parsedFrames_.pop();
+            if (!frame) {
+                break;
+            }
+
+            if (!error) {
+                try {
+                    onFrame(*frame, ++frameNumber);
+                } catch (...) {
+                    // Keep draining so the other stages can finish
+                    error = std::current_exception();
+                    isStopping_ = true;
+                }
+            }
+            freeFrames_.push(frame);
+        }
+
+        reader.join();
+        parser.join();
+
+        // Drain the rings so the pipeline can be run again
+        std::size_t index = 0;
+        while (emptyBuffers_.tryPop(index)) {}
+        Block block;
+        while (filledBuffers_.tryPop(block)) {}
+        Frame<T>* frame = 0;
+        while (freeFrames_.tryPop(frame)) {}
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        if (readError_) {
+            std::rethrow_exception(readError_);
+        }
+        if (parseError_) {
+            std::rethrow_exception(parseError_);
+        }
+
+        return frameNumber;
+    }
+
+
+    /**
+     * @brief       Retrieves where a frame starts in the text
+     * @param frame A frame handed to the callback, during the callback
+     * @return      The byte offset of the frame's header in the text
+     */
+    unsigned long long textOffset(Frame<T> const& frame) const
+    {
+        return textOffsets_[&frame - &frames_[0]];
+    }
+
+
+    /**
+     * @brief   Retrieves the number of lines read by the last run
+     * @return  The number of lines
+     */
+    unsigned long long numberOfLines() const
+    {
+        return numberOfLines_;
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    PipelinedFrameReader(PipelinedFrameReader const& other);
+
+
+    // Assignment operator
+    PipelinedFrameReader& operator=(PipelinedFrameReader const& other);
+
+
+    // A filled buffer handed from the reader to the parser; a buffer with no
+    // bytes marks the end of the file
+    struct Block {
+        std::size_t buffer; // The index of the buffer
+        std::size_t size; // The number of bytes read into it
+    };
+
+
+    // The reader stage
+    void read()
+    {
+        try {
+            std::ifstream in;
+            if (!stream_) {
+                in.exceptions(std::ifstream::badbit);
+                in.open(path_.c_str(), std::ifstream::in | std::ifstream::binary);
+                if (!in.is_open()) {
+                    throw std::ifstream::failure("Couldn't open '" + path_ + "' for reading");
+                }
+                in.seekg(offset_, std::ios::beg);
+            }
+
+            while (!isStopping_) {
+                std::size_t index = emptyBuffers_.pop();
+                std::vector<char>& buffer = buffers_[index];
+
+                Block block = { index, 0 };
+                if (stream_) {
+                    block.size = stream_->read(&buffer[0], buffer.size());
+                } else {
+                    in.read(&buffer[0], buffer.size());
+                    block.size = static_cast<std::size_t>(in.gcount());
+                }
+                if (block.size == 0) {
+                    emptyBuffers_.push(index);
+                    break;
+                }
+                filledBuffers_.push(block);
+            }
+        } catch (...) {
+            readError_ = std::current_exception();
+            isStopping_ = true;
+        }
+
+        // Tell the parser that the file has ended
+        Block end = { 0, 0 };
+        filledBuffers_.push(end);
+    }
+
+
+    // The parser stage
+    void parse()
+    {
+        unsigned int lineNumber = 1;
+        bool atLineStart = true; // Whether the next buffer starts a line
+        std::vector<char> pending; // The incomplete frame carried between buffers
+        unsigned long long pendingOffset = offset_; // The text offset of the carried frame
+        unsigned long long bufferOffset = offset_; // The text offset of the buffer
+        bool isFileRead = false; // Whether the reader's end of file was taken
+
+        try {
+            for (;;) {
+                Block block = filledBuffers_.pop();
+                if (block.size == 0) {
+                    isFileRead = true;
+                    break;
+                }
+                if (isStopping_) {
+                    emptyBuffers_.push(block.buffer);
+                    continue;
+                }
+
+                char const* begin = &buffers_[block.buffer][0];
+                char const* end = begin + block.size;
+
+                // Only whole frames can be parsed, so the bytes before the
+                // buffer's first frame header complete the carried frame, and
+                // the bytes from its last frame header on are carried over
+                char const* firstFrame = findFirstFrame(begin, end, atLineStart);
+                pending.insert(pending.end(), begin, firstFrame);
+                if (firstFrame < end) {
+                    char const* lastFrame = findLastFrame(firstFrame, end);
+
+                    if (!pending.empty()) {
+                        lineNumber = parseRange(&pending[0], &pending[0] + pending.size(), lineNumber,
+                                                pendingOffset);
+                        pending.clear();
+                    }
+                    lineNumber = parseRange(firstFrame, lastFrame, lineNumber, bufferOffset + (firstFrame - begin));
+                    pending.insert(pending.end(), lastFrame, end);
+                    pendingOffset = bufferOffset + (lastFrame - begin);
+                }
+
+                atLineStart = *(end - 1) == '\n';
+                bufferOffset += block.size;
+                emptyBuffers_.push(block.buffer);
+            }
+
+            // Whatever is left is the final frame
+            if (!pending.empty() && !isStopping_) {
+                lineNumber = parseRange(&pending[0], &pending[0] + pending.size(), lineNumber, pendingOffset);
+            }
+            numberOfLines_ = lineNumber - 1;
+        } catch (...) {
+            parseError_ = std::current_exception();
+            isStopping_ = true;
+
+            // Let the reader run to the end of the file (unless the error was
+            // in the final frame, after it had already got there)
+            while (!isFileRead) {
+                Block block = filledBuffers_.pop();
+                if (block.size == 0) {
+                    isFileRead = true;
+                } else {
+                    emptyBuffers_.push(block.buffer);
+                }
+            }
+        }
+
+        // Tell the consumer that there are no more frames
+        parsedFrames_.push(0);
+    }
+
+
+    unsigned int parseRange(char const* begin, char const* end, unsigned int const firstLine,
+                            unsigned long long const textOffset)
+    {
+        // Parses the whole frames in the range into recycled frames and hands
+        // them to the consumer, returning the line number following the range
+
+        ClusterLogParser<T> parser(begin, end, firstLine);
+        parser.setMask(mask_);
+        parser.setRejectedHits(rejected_);
+        while (!parser.atEnd() && !isStopping_) {
+            Frame<T>* frame = freeFrames_.pop();
+            textOffsets_[frame - &frames_[0]] = textOffset + (parser.position() - begin);
+            frame->clear();
+            parser.parseFrame(*frame);
+            parsedFrames_.push(frame);
+        }
+
+        return parser.lineNumber();
+    }
+
+
+    static bool isHeader(char const* pos, char const* end)
+    {
+        // Checks whether the bytes at pos are a frame header
+
+        return end - pos >= 6 && std::memcmp(pos, "Frame ", 6) == 0;
+    }
+
+
+    static char const* findFirstFrame(char const* begin, char const* end, bool const atLineStart)
+    {
+        // Finds the first line of the range holding a frame header, or
+        // returns the range's end if there is none
+
+        if (atLineStart && isHeader(begin, end)) {
+            return begin;
+        }
+
+        char const* pos = begin;
+        while (pos < end) {
+            char const* newline = static_cast<char const*>(std::memchr(pos, '\n', end - pos));
+            if (!newline) {
+                break;
+            }
+            pos = newline + 1;
+            if (isHeader(pos, end)) {
+                return pos;
+            }
+        }
+
+        return end;
+    }
+
+
+    static char const* findLastFrame(char const* firstFrame, char const* end)
+    {
+        // Finds the last line of the range holding a frame header by walking
+        // backwards from its end, given the first one
+
+        for (char const* pos = end - 1; pos > firstFrame; --pos) {
+            if (*(pos - 1) == '\n' && isHeader(pos, end)) {
+                return pos;
+            }
+        }
+
+        return firstFrame;
+    }
+
+    std::string path_; // The path of the cluster log
+    unsigned long long offset_; // The byte offset to start reading from
+    CompressedStream* stream_; // The decompressed text to read instead of the file, or null
+    std::vector<std::vector<char> > buffers_; // The recycled read buffers
+    std::vector<Frame<T> > frames_; // The recycled frames
+    std::vector<unsigned long long> textOffsets_; // The text offset of each recycled frame
+    SpscRing<std::size_t> emptyBuffers_; // Buffers handed back to the reader
+    SpscRing<Block> filledBuffers_; // Buffers handed to the parser
+    SpscRing<Frame<T>*> freeFrames_; // Frames handed back to the parser
+    SpscRing<Frame<T>*> parsedFrames_; // Frames handed to the consumer
+    std::atomic<bool> isStopping_; // Whether a stage has failed
+    std::exception_ptr readError_; // The error raised by the reader, if any
+    std::exception_ptr parseError_; // The error raised by the parser, if any
+    PixelMask<> const* mask_; // The mask of dropped pixels, or null
+    RejectedHits* rejected_; // The tally of hits dropped off the matrix, or null
+    unsigned long long numberOfLines_; // The number of lines read by the last run
+};
+
+
+#endif  /* PIPELINEDFRAMEREADER_HPP */
@@ -17,11 +17,16 @@
 // C++ headers
 #include <ostream>
 #include <cassert>
+#include <cstdint>
+// My headers
+#include <DetectorGeometry.hpp>
 
 /**
- * @brief This class defines the pixel datatype used to store each pixel
+ * @brief This class defines the pixel datatype used to store each pixel <br>
+ * The pixel is held as a single hit word packed by the detector geometry, so
+ * it takes 4 bytes whatever T is; the positions and count are handed back as T
  */
-template <class T>
+template <class T, class Geometry = TimepixGeometry>
 class Pixel {
 public:
 
@@ -30,19 +35,31 @@ public:
      * @return  A newly constructed Pixel object defaulted to 0 values
      */
     Pixel()
-    : x_(0), y_(0), c_(0)
+    : hit_(0)
     {
     }
 
     /**
      * @brief   A constructor for the Pixel class
-     * @param x The pixel's x position
-     * @param y The pixel's y position
-     * @param c The pixel's count value
+     * @param x The pixel's x position, which must lie on the detector
+     * @param y The pixel's y position, which must lie on the detector
+     * @param c The pixel's count value (saturated into Geometry::TOT_BITS)
      * @return  A newly constructed Pixel object
      */
     Pixel(T const x, T const y, T const c)
-    : x_(x), y_(y), c_(c)
+    : hit_(Geometry::pack(Geometry::index(static_cast<unsigned int>(x), static_cast<unsigned int>(y)),
+                          saturate(c)))
+    {
+        assert(Geometry::contains(static_cast<long long>(x), static_cast<long long>(y)));
+    }
+
+    /**
+     * @brief     A constructor for the Pixel class
+     * @param hit The pixel's hit word, as packed by Geometry::pack()
+     * @return    A newly constructed Pixel object
+     */
+    explicit Pixel(std::uint32_t const hit)
+    : hit_(hit)
     {
     }
 
@@ -51,8 +68,8 @@ public:
      * @param other The other pixel object to be copied from
      * @return      A new copy constructed Pixel object
      */
-    Pixel(Pixel<T> const& other)
-    : x_(other.x_), y_(other.y_), c_(other.c_)
+    Pixel(Pixel<T, Geometry> const& other)
+    : hit_(other.hit_)
     {
     }
 
@@ -69,7 +86,7 @@ public:
      * @param other The other pixel object to be assigned from
      * @return      A pointer to this object
      */
-    Pixel<T>& operator=(Pixel<T> other)
+    Pixel<T, Geometry>& operator=(Pixel<T, Geometry> other)
     {
         swap(*this, other);
 
@@ -81,12 +98,10 @@ public:
      * @param other The other Pixel object being compared against
      * @return      The result of the compare
      */
-    bool operator==(Pixel<T> const& other)
+    bool operator==(Pixel<T, Geometry> const& other)
     {
         // Compare the internal data
-        if (other.x() == this->x_
-                && other.y() == this->y_
-                && other.c() == this->c_) {
+        if (other.hit_ == this->hit_) {
             return true;
         } else {
             return false;
@@ -98,10 +113,10 @@ public:
      * @param other The other Pixel object being compared against
      * @return      The result of the compare
      */
-    bool operator!=(Pixel<T> const& other)
+    bool operator!=(Pixel<T, Geometry> const& other)
     {
         // Check if they aren't the same using the equality operator already defined
-        if (!(this == other)) {
+        if (!(*this == other)) {
             return true;
         } else {
             return false;
@@ -114,7 +129,7 @@ public:
      */
     T const x() const
     {
-        return x_;
+        return static_cast<T>(Geometry::x(Geometry::indexOf(hit_)));
     }
 
     /**
@@ -123,7 +138,7 @@ public:
      */
     T const y() const
     {
-        return y_;
+        return static_cast<T>(Geometry::y(Geometry::indexOf(hit_)));
     }
 
     /**
@@ -132,24 +147,48 @@ public:
      */
     T const c() const
     {
-        return c_;
+        return static_cast<T>(Geometry::totOf(hit_));
     }
 
     /**
-     * @brief   Retrieves ---
-     * @return  A number for ---
+     * @brief   Retrieves the linear index of the pixel on the detector
+     * @return  A number for the index, y * Geometry::WIDTH + x
      */
     T const xy() const
     {
 
-        return static_cast<T> ((256 * y_) + x_);
+        return static_cast<T>(Geometry::indexOf(hit_));
+    }
+
+    /**
+     * @brief   Retrieves the packed hit word of the pixel
+     * @return  The hit, as packed by Geometry::pack()
+     */
+    std::uint32_t hit() const
+    {
+        return hit_;
+    }
+
+    /**
+     * @brief   Clamps a count value into the bits a hit holds it in
+     * @param c The count value
+     * @return  The count, saturated to [0, Geometry::MAXIMUM_TOT]
+     */
+    static std::uint32_t saturate(T const c)
+    {
+        if (!(c > 0)) {
+            return 0;
+        }
+
+        return c < static_cast<T>(Geometry::MAXIMUM_TOT)
+            ? static_cast<std::uint32_t>(c) : Geometry::MAXIMUM_TOT;
     }
 
-    template<class T2>
-    friend void swap(Pixel<T2>&, Pixel<T2>&);
+    template<class T2, class Geometry2>
+    friend void swap(Pixel<T2, Geometry2>&, Pixel<T2, Geometry2>&);
 
 private:
-    T x_, y_, c_;
+    std::uint32_t hit_; // The pixel's index and count, packed by the geometry
 };
 
 /**
@@ -158,13 +197,11 @@ private:
  * @param second The second object to swap
  * @return       Nothing
  */
-template <class T>
-void swap(Pixel<T>& first, Pixel<T>& second) // no-throw
+template <class T, class Geometry>
+void swap(Pixel<T, Geometry>& first, Pixel<T, Geometry>& second) // no-throw
 {
     using std::swap;
-    swap(first.x_, second.x_);
-    swap(first.y_, second.y_);
-    swap(first.c_, second.c_);
+    swap(first.hit_, second.hit_);
 }
 
 /**
@@ -173,8 +210,8 @@ void swap(Pixel<T>& first, Pixel<T>& second) // no-throw
  * @param pixel  The pixel being output
  * @return       A reference to the output stream
  */
-template <class T>
-std::ostream& operator<<(std::ostream& stream, Pixel <T> const& pixel)
+template <class T, class Geometry>
+std::ostream& operator<<(std::ostream& stream, Pixel <T, Geometry> const& pixel)
 {
     stream << "x = " << pixel.x() << std::endl
             << "y = " << pixel.y() << std::endl
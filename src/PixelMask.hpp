@@ -0,0 +1,284 @@
+/**
+ * @file        PixelMask.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the bitmap of masked (noisy) pixels, which the parsers
+ * drop hits on, and the '.lolm' file it is saved as
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef PIXELMASK_HPP
+#define PIXELMASK_HPP
+
+// C++ headers
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+// My headers
+#include <DetectorGeometry.hpp>
+
+/**
+ * @brief The header at the start of a '.lolm' mask file <br>
+ * The file holds, in native byte order: <br>
+ * (1) this header <br>
+ * (2) the mask bits, one per pixel in index order, packed 32 to a uint32 word
+ * (the lowest bit first)
+ */
+struct MaskHeader {
+    char magic[4]; // Always "LOLM"
+    std::uint32_t byteOrder; // Always MASK_BYTE_ORDER, written in native order
+    std::uint32_t version; // The version of the layout, MASK_VERSION
+    std::uint32_t width; // The number of pixel columns of the detector
+    std::uint32_t height; // The number of pixel rows of the detector
+    std::uint32_t numberOfMasked; // The number of pixels masked
+};
+
+// The byte order marker, which reads differently on a foreign-endian machine
+static const std::uint32_t MASK_BYTE_ORDER = 0x01020304u;
+// The current version of the mask layout
+static const std::uint32_t MASK_VERSION = 1;
+
+
+/**
+ * @brief This class holds one bit per pixel of the detector, set for the
+ * pixels whose hits are to be thrown away <br>
+ * The whole bitmap of a Timepix chip is 8 KiB, so it stays in the L1 cache
+ * while a parser tests every hit against it
+ */
+template <class Geometry = TimepixGeometry>
+class PixelMask {
+public:
+
+    /**
+     * @brief   An empty constructor for the PixelMask class
+     * @return  A newly constructed PixelMask object masking no pixels
+     */
+    PixelMask()
+        : words_(WORDS, 0), masked_(0)
+    {
+    }
+
+
+    /**
+     * @brief   The destructor for the PixelMask class
+     * @return  Nothing
+     */
+    ~PixelMask()
+    {
+    }
+
+
+    /**
+     * @brief       Masks a pixel
+     * @param index The pixel's index
+     * @return      Nothing
+     */
+    void mask(std::uint32_t const index)
+    {
+        if (!isMasked(index)) {
+            words_[index >> 5] |= 1u << (index & 31);
+            masked_++;
+        }
+    }
+
+
+    /**
+     * @brief       Unmasks a pixel
+     * @param index The pixel's index
+     * @return      Nothing
+     */
+    void unmask(std::uint32_t const index)
+    {
+        if (isMasked(index)) {
+            words_[index >> 5] &= ~(1u << (index & 31));
+            masked_--;
+        }
+    }
+
+
+    /**
+     * @brief       Checks whether a pixel is masked
+     * @param index The pixel's index
+     * @return      Whether the pixel's hits are thrown away
+     */
+    bool isMasked(std::uint32_t const index) const
+    {
+        return (words_[index >> 5] >> (index & 31)) & 1u;
+    }
+
+
+    /**
+     * @brief   Retrieves the number of masked pixels
+     * @return  The number of pixels masked
+     */
+    std::size_t numberOfMasked() const
+    {
+        return masked_;
+    }
+
+
+    /**
+     * @brief   Unmasks every pixel
+     * @return  Nothing
+     */
+    void clear()
+    {
+        words_.assign(WORDS, 0);
+        masked_ = 0;
+    }
+
+
+    /**
+     * @brief       Drops the hits on masked pixels from an array of packed
+     * hits, keeping the order of the rest <br>
+     * With AVX2 the mask words of eight hits are gathered at once and tested
+     * with a variable shift, and a block with nothing masked is kept without
+     * touching its hits one by one
+     * @param hits  The packed hits, compacted in place
+     * @param count The number of hits
+     * @return      The number of hits kept, at the front of the array
+     */
+    std::size_t filter(std::uint32_t* hits, std::size_t const count) const
+    {
+        if (masked_ == 0) {
+            return count;
+        }
+
+        std::size_t kept = 0;
+        std::size_t i = 0;
+
+#if defined(__AVX2__)
+        __m256i const indexMask = _mm256_set1_epi32(static_cast<int>(Geometry::INDEX_MASK));
+        __m256i const bitMask = _mm256_set1_epi32(31);
+        __m256i const one = _mm256_set1_epi32(1);
+        int const* words = reinterpret_cast<int const*>(&words_[0]);
+        for (; count - i >= 8; i += 8) {
+            __m256i const block = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(hits + i));
+            __m256i const index = _mm256_and_si256(block, indexMask);
+            __m256i const word = _mm256_i32gather_epi32(words, _mm256_srli_epi32(index, 5), 4);
+            __m256i const bit = _mm256_and_si256(_mm256_srlv_epi32(word, _mm256_and_si256(index, bitMask)), one);
+            unsigned int const masked = static_cast<unsigned int>(
+                    _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(bit, one))));
+
+            if (masked == 0) {
+                if (kept != i) {
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(hits + kept), block);
+                }
+                kept += 8;
+                continue;
+            }
+
+            std::uint32_t lanes[8];
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), block);
+            for (unsigned int lane = 0; lane < 8; ++lane) {
+                if (!((masked >> lane) & 1u)) {
+                    hits[kept++] = lanes[lane];
+                }
+            }
+        }
+#endif
+
+        // Scalar tail (or every hit without AVX2, which has no gather)
+        for (; i < count; ++i) {
+            if (!isMasked(Geometry::indexOf(hits[i]))) {
+                hits[kept++] = hits[i];
+            }
+        }
+
+        return kept;
+    }
+
+
+    /**
+     * @brief      Saves the mask as a '.lolm' file
+     * @param path The path of the mask file
+     * @return     Nothing, throws std::ifstream::failure if the mask can't be
+     * written
+     */
+    void save(std::string const& path) const
+    {
+        MaskHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "LOLM", 4);
+        header.byteOrder = MASK_BYTE_ORDER;
+        header.version = MASK_VERSION;
+        header.width = Geometry::WIDTH;
+        header.height = Geometry::HEIGHT;
+        header.numberOfMasked = static_cast<std::uint32_t>(masked_);
+
+        try {
+            std::ofstream out;
+            out.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            out.open(path.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+            out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+            out.write(reinterpret_cast<char const*>(&words_[0]), words_.size() * sizeof(std::uint32_t));
+            out.close();
+        } catch (std::ofstream::failure const&) {
+            throw std::ifstream::failure("Could not write the pixel mask: " + path);
+        }
+    }
+
+
+    /**
+     * @brief      Replaces the mask with that of a '.lolm' file
+     * @param path The path of the mask file
+     * @return     Nothing, throws std::ifstream::failure if the mask can't be
+     * read, isn't a valid mask or is for another detector
+     */
+    void load(std::string const& path)
+    {
+        std::ifstream in(path.c_str(), std::ifstream::in | std::ifstream::binary);
+        MaskHeader header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+                || std::memcmp(header.magic, "LOLM", 4) != 0
+                || header.byteOrder != MASK_BYTE_ORDER
+                || header.version != MASK_VERSION) {
+            throw std::ifstream::failure("Invalid pixel mask: " + path);
+        }
+        if (header.width != Geometry::WIDTH || header.height != Geometry::HEIGHT) {
+            throw std::ifstream::failure("The pixel mask is for another detector: " + path);
+        }
+
+        std::vector<std::uint32_t> words(WORDS);
+        if (!in.read(reinterpret_cast<char*>(&words[0]), words.size() * sizeof(std::uint32_t))) {
+            throw std::ifstream::failure("Truncated pixel mask: " + path);
+        }
+
+        // Count the bits rather than trust the header
+        std::size_t masked = 0;
+        for (std::size_t i = 0; i < words.size(); ++i) {
+            for (std::uint32_t word = words[i]; word; word &= word - 1) {
+                masked++;
+            }
+        }
+
+        words_.swap(words);
+        masked_ = masked;
+    }
+
+private:
+
+    // The number of 32-bit words holding the mask bits
+    static const std::size_t WORDS = (Geometry::PIXELS + 31) / 32;
+
+    std::vector<std::uint32_t> words_; // The mask bits, 32 pixels to a word
+    std::size_t masked_; // The number of pixels masked
+};
+
+
+template <class Geometry>
+const std::size_t PixelMask<Geometry>::WORDS;
+
+
+#endif  /* PIXELMASK_HPP */
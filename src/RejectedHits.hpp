@@ -0,0 +1,108 @@
+/**
+ * @file        RejectedHits.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the tally of the hits dropped for lying off the
+ * detector's matrix (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef REJECTEDHITS_HPP
+#define REJECTEDHITS_HPP
+
+// C++ headers
+#include <atomic>
+
+/**
+ * @brief This class counts the hits the parsers of a file dropped because
+ * their pixel lies off the detector's matrix, and says whether such a hit
+ * should fail the read as malformed data instead <br>
+ * One tally is shared by every parser of a file, whichever thread it runs on,
+ * and is only touched when a line had such a hit, so a clean file never pays
+ * for the shared count (class is non-copyable)
+ */
+class RejectedHits {
+public:
+
+    /**
+     * @brief   An empty constructor for the RejectedHits class
+     * @return  A newly constructed RejectedHits object, counting none and not
+     * strict
+     */
+    RejectedHits()
+        : count_(0), isStrict_(false)
+    {
+    }
+
+
+    /**
+     * @brief          Sets whether a hit off the matrix fails the read
+     * @param isStrict Whether to throw on such a hit rather than drop it
+     * @return         Nothing
+     */
+    void setStrict(bool const isStrict)
+    {
+        isStrict_ = isStrict;
+    }
+
+
+    /**
+     * @brief   Checks whether a hit off the matrix fails the read
+     * @return  Whether such a hit is thrown on rather than dropped
+     */
+    bool isStrict() const
+    {
+        return isStrict_;
+    }
+
+
+    /**
+     * @brief       Counts dropped hits
+     * @param count The number of hits dropped
+     * @return      Nothing
+     */
+    void add(unsigned long long const count)
+    {
+        count_ += count;
+    }
+
+
+    /**
+     * @brief   Retrieves the number of hits dropped
+     * @return  The number of hits
+     */
+    unsigned long long count() const
+    {
+        return count_;
+    }
+
+
+    /**
+     * @brief   Starts the count again from zero
+     * @return  Nothing
+     */
+    void reset()
+    {
+        count_ = 0;
+    }
+
+private:
+    std::atomic<unsigned long long> count_; // The hits dropped so far
+    bool isStrict_; // Whether a hit off the matrix fails the read instead
+
+    // Non-copyable
+    // Copy constructor
+    RejectedHits(RejectedHits const& other);
+
+
+    // Assignment operator
+    RejectedHits& operator=(RejectedHits const& other);
+};
+
+
+#endif  /* REJECTEDHITS_HPP */
@@ -0,0 +1,355 @@
+/**
+ * @file        ResultCache.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the persistent cache of per-dataset results, which lets
+ * a re-run skip every dataset that hasn't changed (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef RESULTCACHE_HPP
+#define RESULTCACHE_HPP
+
+// C++ headers
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <mutex>
+#include <cstring>
+#include <cstdint>
+#include <boost/filesystem.hpp>
+// My headers
+#include <MappedFile.hpp>
+
+/**
+ * @brief The header at the start of a results cache file <br>
+ * The file holds, in native byte order: <br>
+ * (1) this header <br>
+ * (2) numberOfEntries entries, each a ResultEntryHeader followed by the
+ * dataset's path, the options key and the output (unterminated, of the
+ * lengths given in the entry header)
+ */
+struct ResultCacheHeader {
+    char magic[4]; // Always "LOLR"
+    std::uint32_t byteOrder; // Always RESULT_CACHE_BYTE_ORDER, written in native order
+    std::uint32_t version; // The version of the layout, RESULT_CACHE_VERSION
+    std::uint32_t reserved; // Padding, always 0
+    std::uint64_t numberOfEntries; // The number of entries following
+};
+
+
+/**
+ * @brief The fixed part of an entry of a results cache file
+ */
+struct ResultEntryHeader {
+    std::uint64_t sourceSize; // The size of the cluster log when the result was made
+    std::int64_t sourceModified; // The modification time of the cluster log
+    std::uint64_t sourceHash; // The content hash of the cluster log, or 0 if not hashed
+    std::uint32_t pathLength; // The length of the cluster log's path
+    std::uint32_t optionsLength; // The length of the options key
+    std::uint32_t outputLength; // The length of the output
+    std::uint32_t reserved; // Padding, always 0
+};
+
+// The byte order marker, which reads differently on a foreign-endian machine
+static const std::uint32_t RESULT_CACHE_BYTE_ORDER = 0x01020304u;
+// The current version of the results cache layout (and of the outputs held)
+static const std::uint32_t RESULT_CACHE_VERSION = 1;
+
+
+/**
+ * @brief This class keeps the output of every dataset run, keyed on the
+ * dataset's path and the options which shape its output, and stamped with
+ * the size, modification time and (optionally) content hash of the cluster
+ * log it came from <br>
+ * A stored output is only handed back while all of those still match, so a
+ * re-run over a tree only reprocesses new and modified datasets <br>
+ * Lookups and stores may come from any thread (class is non-copyable)
+ */
+class ResultCache {
+public:
+
+    /**
+     * @brief   An empty constructor for the ResultCache class
+     * @return  A newly constructed ResultCache object holding no results
+     */
+    ResultCache()
+        : isModified_(false)
+    {
+    }
+
+
+    /**
+     * @brief   The destructor for the ResultCache class
+     * @return  Nothing
+     */
+    ~ResultCache()
+    {
+    }
+
+
+    /**
+     * @brief      Loads the results saved in a cache file; a missing file, or
+     * one of another layout, simply leaves the cache empty
+     * @param path The path of the cache file
+     * @return     The number of results loaded
+     */
+    std::size_t load(std::string const& path)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        isModified_ = false;
+
+        std::ifstream in(path.c_str(), std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
+        std::streamoff const fileSize = in ? static_cast<std::streamoff>(in.tellg()) : 0;
+        in.seekg(0, std::ios::beg);
+
+        ResultCacheHeader header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+                || std::memcmp(header.magic, "LOLR", 4) != 0
+                || header.byteOrder != RESULT_CACHE_BYTE_ORDER
+                || header.version != RESULT_CACHE_VERSION) {
+            return 0;
+        }
+
+        std::vector<char> text;
+        for (std::uint64_t i = 0; i < header.numberOfEntries; ++i) {
+            ResultEntryHeader entryHeader;
+            if (!in.read(reinterpret_cast<char*>(&entryHeader), sizeof(entryHeader))) {
+                break;
+            }
+
+            std::size_t const length = static_cast<std::size_t>(entryHeader.pathLength)
+                                       + entryHeader.optionsLength + entryHeader.outputLength;
+            // A damaged entry can't claim more than the file holds
+            if (static_cast<std::streamoff>(length) > fileSize - static_cast<std::streamoff>(in.tellg())) {
+                break;
+            }
+            text.resize(length + 1);
+            if (!in.read(&text[0], length)) {
+                break;
+            }
+
+            char const* pos = &text[0];
+            Key key(std::string(pos, entryHeader.pathLength),
+                    std::string(pos + entryHeader.pathLength, entryHeader.optionsLength));
+            pos += entryHeader.pathLength + entryHeader.optionsLength;
+
+            Entry& entry = entries_[key];
+            entry.sourceSize = entryHeader.sourceSize;
+            entry.sourceModified = entryHeader.sourceModified;
+            entry.sourceHash = entryHeader.sourceHash;
+            entry.output.assign(pos, entryHeader.outputLength);
+        }
+
+        return entries_.size();
+    }
+
+
+    /**
+     * @brief      Saves the results to a cache file, if any changed since it
+     * was loaded <br>
+     * The file is written aside and then moved into place, so an interrupted
+     * save never leaves a half written cache
+     * @param path The path of the cache file
+     * @return     Nothing, throws std::ifstream::failure if the cache can't be
+     * written
+     */
+    void save(std::string const& path)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!isModified_) {
+            return;
+        }
+
+        std::string const temporaryPath = path + ".tmp";
+        try {
+            std::ofstream out;
+            out.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            out.open(temporaryPath.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+
+            ResultCacheHeader header;
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, "LOLR", 4);
+            header.byteOrder = RESULT_CACHE_BYTE_ORDER;
+            header.version = RESULT_CACHE_VERSION;
+            header.numberOfEntries = entries_.size();
+            out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+            for (std::map<Key, Entry>::const_iterator it = entries_.begin(); it != entries_.end(); ++it) {
+                ResultEntryHeader entryHeader;
+                std::memset(&entryHeader, 0, sizeof(entryHeader));
+                entryHeader.sourceSize = it->second.sourceSize;
+                entryHeader.sourceModified = it->second.sourceModified;
+                entryHeader.sourceHash = it->second.sourceHash;
+                entryHeader.pathLength = static_cast<std::uint32_t>(it->first.first.size());
+                entryHeader.optionsLength = static_cast<std::uint32_t>(it->first.second.size());
+                entryHeader.outputLength = static_cast<std::uint32_t>(it->second.output.size());
+
+                out.write(reinterpret_cast<char const*>(&entryHeader), sizeof(entryHeader));
+                out.write(it->first.first.data(), it->first.first.size());
+                out.write(it->first.second.data(), it->first.second.size());
+                out.write(it->second.output.data(), it->second.output.size());
+            }
+            out.close();
+
+            boost::filesystem::rename(temporaryPath, path);
+        } catch (std::ofstream::failure const&) {
+            throw std::ifstream::failure("Could not write the results cache: " + path);
+        } catch (boost::filesystem::filesystem_error const&) {
+            throw std::ifstream::failure("Could not move the results cache into place: " + path);
+        }
+
+        isModified_ = false;
+    }
+
+
+    /**
+     * @brief                Looks up the stored output of a dataset
+     * @param sourcePath     The path of the cluster log
+     * @param options        The key of the options the output depends on
+     * @param sourceSize     The current size of the cluster log
+     * @param sourceModified The current modification time of the cluster log
+     * @param sourceHash     The current content hash of the cluster log, or 0
+     * to not check it
+     * @param output         Set to the stored output if it is still fresh
+     * @return               Whether a fresh output was found
+     */
+    bool find(std::string const& sourcePath,
+              std::string const& options,
+              unsigned long long const sourceSize,
+              long long const sourceModified,
+              unsigned long long const sourceHash,
+              std::string& output) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        std::map<Key, Entry>::const_iterator it = entries_.find(Key(sourcePath, options));
+        if (it == entries_.end()
+                || it->second.sourceSize != sourceSize
+                || it->second.sourceModified != sourceModified
+                || it->second.sourceHash != sourceHash) {
+            return false;
+        }
+
+        output = it->second.output;
+
+        return true;
+    }
+
+
+    /**
+     * @brief                Stores the output of a dataset, replacing any
+     * older output of the same dataset and options
+     * @param sourcePath     The path of the cluster log
+     * @param options        The key of the options the output depends on
+     * @param sourceSize     The size of the cluster log the output came from
+     * @param sourceModified The modification time of the cluster log
+     * @param sourceHash     The content hash of the cluster log, or 0 if it
+     * wasn't hashed
+     * @param output         The output
+     * @return               Nothing
+     */
+    void store(std::string const& sourcePath,
+               std::string const& options,
+               unsigned long long const sourceSize,
+               long long const sourceModified,
+               unsigned long long const sourceHash,
+               std::string const& output)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        Entry& entry = entries_[Key(sourcePath, options)];
+        entry.sourceSize = sourceSize;
+        entry.sourceModified = sourceModified;
+        entry.sourceHash = sourceHash;
+        entry.output = output;
+        isModified_ = true;
+    }
+
+
+    /**
+     * @brief   Retrieves the number of results held
+     * @return  The number of results
+     */
+    std::size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        return entries_.size();
+    }
+
+
+    /**
+     * @brief      Hashes the contents of a file with a 64-bit FNV-1a variant
+     * <br>
+     * Eight bytes are folded in per step rather than one, so the hash runs at
+     * close to memory speed
+     * @param path The path of the file
+     * @return     The hash (never 0, which stands for no hash), throws
+     * std::ifstream::failure if the file can't be mapped
+     */
+    static unsigned long long contentHash(std::string const& path)
+    {
+        static const std::uint64_t OFFSET_BASIS = 14695981039346656037ULL;
+        static const std::uint64_t PRIME = 1099511628211ULL;
+
+        MappedFile file;
+        try {
+            file.open(path);
+        } catch (boost::interprocess::interprocess_exception const& e) {
+            throw std::ifstream::failure(e.what());
+        }
+
+        char const* pos = file.begin();
+        char const* const end = file.end();
+        std::uint64_t hash = OFFSET_BASIS;
+        for (; end - pos >= 8; pos += 8) {
+            std::uint64_t word;
+            std::memcpy(&word, pos, sizeof(word));
+            hash = (hash ^ word) * PRIME;
+        }
+        for (; pos < end; ++pos) {
+            hash = (hash ^ static_cast<unsigned char>(*pos)) * PRIME;
+        }
+        file.close();
+
+        return hash ? hash : 1;
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    ResultCache(ResultCache const& other);
+
+
+    // Assignment operator
+    ResultCache& operator=(ResultCache const& other);
+
+
+    // A result is keyed on the cluster log's path and the options key
+    typedef std::pair<std::string, std::string> Key;
+
+
+    struct Entry {
+        unsigned long long sourceSize; // The size of the cluster log
+        long long sourceModified; // The modification time of the cluster log
+        unsigned long long sourceHash; // The content hash of the cluster log, or 0
+        std::string output; // The output of the dataset
+    };
+
+    mutable std::mutex mutex_; // Guards the entries
+    std::map<Key, Entry> entries_; // The results, by path and options
+    bool isModified_; // Whether a result was stored since the cache was loaded
+};
+
+
+#endif  /* RESULTCACHE_HPP */
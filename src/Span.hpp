@@ -0,0 +1,122 @@
+/**
+ * @file        Span.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines a non-owning view over a contiguous array of values
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef SPAN_HPP
+#define SPAN_HPP
+
+// C++ headers
+#include <cstddef>
+#include <cassert>
+
+/**
+ * @brief This class is a lightweight, non-owning view of a contiguous run of
+ * values (a pointer and a length), which is cheap to pass around by value
+ */
+template <class T>
+class Span {
+public:
+
+    typedef T value_type;
+    typedef T* iterator;
+
+    /**
+     * @brief   An empty constructor for the Span class
+     * @return  A newly constructed Span object viewing nothing
+     */
+    Span()
+        : data_(0), size_(0)
+    {
+    }
+
+
+    /**
+     * @brief      A constructor for the Span class
+     * @param data The first value of the view
+     * @param size The number of values in the view
+     * @return     A newly constructed Span object
+     */
+    Span(T* data, std::size_t const size)
+        : data_(data), size_(size)
+    {
+    }
+
+
+    /**
+     * @brief       Retrieves the value at the given position of the view
+     * @param index The position of the value
+     * @return      A reference to the value
+     */
+    T& operator[](std::size_t const index) const
+    {
+        assert(index < size_);
+
+        return data_[index];
+    }
+
+
+    /**
+     * @brief   Retrieves the first value of the view
+     * @return  A pointer to the first value
+     */
+    T* data() const
+    {
+        return data_;
+    }
+
+
+    /**
+     * @brief   Retrieves the number of values in the view
+     * @return  The number of values
+     */
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+
+    /**
+     * @brief   Checks whether the view is empty
+     * @return  Whether the view holds no values
+     */
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+
+    /**
+     * @brief   Retrieves an iterator to the first value of the view
+     * @return  A pointer to the first value
+     */
+    T* begin() const
+    {
+        return data_;
+    }
+
+
+    /**
+     * @brief   Retrieves an iterator to one past the last value of the view
+     * @return  A pointer to one past the last value
+     */
+    T* end() const
+    {
+        return data_ + size_;
+    }
+
+private:
+    T* data_; // The first value of the view
+    std::size_t size_; // The number of values in the view
+};
+
+
+#endif  /* SPAN_HPP */
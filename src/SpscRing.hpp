@@ -0,0 +1,150 @@
+/**
+ * @file        SpscRing.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines a bounded, lock-free single-producer/single-consumer
+ * ring buffer for handing work between two threads (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef SPSCRING_HPP
+#define SPSCRING_HPP
+
+// C++ headers
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <cstddef>
+
+/**
+ * @brief This class is a fixed capacity ring buffer which exactly one thread
+ * pushes into and exactly one other thread pops from, without any locks <br>
+ * The head and tail counters live on separate cache lines so the two threads
+ * don't keep stealing the line from each other (class is non-copyable)
+ */
+template <class T>
+class SpscRing {
+public:
+
+    /**
+     * @brief          A constructor for the SpscRing class
+     * @param capacity The number of values the ring can hold, rounded up to
+     * a power of two
+     * @return         A newly constructed, empty SpscRing object
+     */
+    explicit SpscRing(std::size_t const capacity)
+        : head_(0), tail_(0)
+    {
+        std::size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        values_.resize(size);
+        mask_ = size - 1;
+    }
+
+
+    /**
+     * @brief       Pushes a value if there is room (producer thread only)
+     * @param value The value to push
+     * @return      Whether the value was pushed
+     */
+    bool tryPush(T const& value)
+    {
+        std::size_t const tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) > mask_) {
+            return false;
+        }
+
+        values_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+
+    /**
+     * @brief       Pops a value if there is one (consumer thread only)
+     * @param value The popped value
+     * @return      Whether a value was popped
+     */
+    bool tryPop(T& value)
+    {
+        std::size_t const head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        value = values_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+
+    /**
+     * @brief       Pushes a value, waiting for room if the ring is full
+     * (producer thread only)
+     * @param value The value to push
+     * @return      Nothing
+     */
+    void push(T const& value)
+    {
+        while (!tryPush(value)) {
+            std::this_thread::yield();
+        }
+    }
+
+
+    /**
+     * @brief       Pops a value, waiting for one if the ring is empty
+     * (consumer thread only)
+     * @return      The popped value
+     */
+    T pop()
+    {
+        T value;
+        while (!tryPop(value)) {
+            std::this_thread::yield();
+        }
+
+        return value;
+    }
+
+
+    /**
+     * @brief   Retrieves the number of values the ring can hold
+     * @return  The capacity of the ring
+     */
+    std::size_t capacity() const
+    {
+        return mask_ + 1;
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    SpscRing(SpscRing const& other);
+
+
+    // Assignment operator
+    SpscRing& operator=(SpscRing const& other);
+
+
+    std::vector<T> values_; // The slots of the ring
+    std::size_t mask_; // The capacity less one, for wrapping the counters
+    char padding0_[64]; // Keeps the counters off the slots' cache line
+    std::atomic<std::size_t> head_; // The number of values popped so far
+    char padding1_[64]; // Keeps the counters on separate cache lines
+    std::atomic<std::size_t> tail_; // The number of values pushed so far
+    char padding2_[64]; // Keeps the tail off whatever follows the ring
+};
+
+
+#endif  /* SPSCRING_HPP */
@@ -0,0 +1,101 @@
+/**
+ * @file        StageStats.cpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the allocation counts of the stage statistics, and the
+ * replacements of the global operator new and delete which keep them
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef STAGESTATS_CPP
+#define STAGESTATS_CPP
+
+// C++ headers
+#include <new>
+#include <cstdlib>
+// My headers
+#include <StageStats.hpp>
+
+
+std::atomic<bool> AllocationCounter::isCounting_(false);
+std::atomic<unsigned long long> AllocationCounter::allocations_(0);
+std::atomic<unsigned long long> AllocationCounter::bytes_(0);
+
+
+// The global allocation functions, which behave as the standard ones but
+// count every allocation while the statistics are on
+void* operator new(std::size_t size)
+{
+    AllocationCounter::count(size);
+
+    for (;;) {
+        void* memory = std::malloc(size ? size : 1);
+        if (memory) {
+            return memory;
+        }
+
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+
+void* operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept
+{
+    try {
+        return ::operator new(size);
+    } catch (std::bad_alloc const&) {
+        return 0;
+    }
+}
+
+
+void* operator new[](std::size_t size, std::nothrow_t const&) noexcept
+{
+    try {
+        return ::operator new(size);
+    } catch (std::bad_alloc const&) {
+        return 0;
+    }
+}
+
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+
+void operator delete[](void* memory) noexcept
+{
+    std::free(memory);
+}
+
+
+void operator delete(void* memory, std::nothrow_t const&) noexcept
+{
+    std::free(memory);
+}
+
+
+void operator delete[](void* memory, std::nothrow_t const&) noexcept
+{
+    std::free(memory);
+}
+
+
+#endif  /* STAGESTATS_CPP */
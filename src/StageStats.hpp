@@ -0,0 +1,571 @@
+/**
+ * @file        StageStats.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the run-time switchable instrumentation of the stages
+ * of a run (their time, throughput, allocations and memory) and its reports
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef STAGESTATS_HPP
+#define STAGESTATS_HPP
+
+// C++ headers
+#include <ostream>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <ctime>
+#include <cstddef>
+#if defined(__unix__) || defined(__APPLE__)
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+/**
+ * @brief The stages of a run, as the statistics are broken down
+ */
+enum Stage {
+    STAGE_OPEN, // Opening (mapping) the input
+    STAGE_LINE_COUNT, // Counting the lines and frames of the input
+    STAGE_PARSE, // Parsing the frames (less the time the consumers take)
+    STAGE_FRAME_STORE, // Keeping the frames in memory
+    STAGE_ANALYSIS, // The consumers analysing the frames
+    STAGE_OUTPUT, // Writing the results and caches
+    NUMBER_OF_STAGES
+};
+
+
+/**
+ * @brief The totals of a stage, summed over every time it ran
+ */
+struct StageTotals {
+    unsigned long long runs; // The number of times the stage ran
+    double wallSeconds; // The elapsed time
+    double cpuSeconds; // The CPU time (of every thread, for the scoped stages)
+    unsigned long long bytes; // The bytes of input or output handled
+    unsigned long long lines; // The lines of input handled
+    unsigned long long frames; // The frames handled
+    unsigned long long pixels; // The pixels (hits) of the frames handled
+    unsigned long long rejectedPixels; // The hits dropped for lying off the detector's matrix
+    unsigned long long allocations; // The number of operator new calls
+    unsigned long long allocatedBytes; // The bytes asked of operator new
+    long peakRssKiB; // The peak resident set of the process when the stage last ended, in KiB
+};
+
+
+/**
+ * @brief This class counts the calls to the global operator new (which is
+ * replaced in StageStats.cpp), while counting is switched on <br>
+ * The counts are shared by every thread, so they are only touched when
+ * counting
+ */
+class AllocationCounter {
+public:
+
+    /**
+     * @brief            Switches the counting on or off
+     * @param isCounting Whether to count
+     * @return           Nothing
+     */
+    static void setCounting(bool const isCounting)
+    {
+        isCounting_.store(isCounting, std::memory_order_relaxed);
+    }
+
+
+    /**
+     * @brief      Counts an allocation, if counting
+     * @param size The number of bytes allocated
+     * @return     Nothing
+     */
+    static void count(std::size_t const size)
+    {
+        if (isCounting_.load(std::memory_order_relaxed)) {
+            allocations_.fetch_add(1, std::memory_order_relaxed);
+            bytes_.fetch_add(size, std::memory_order_relaxed);
+        }
+    }
+
+
+    /**
+     * @brief   Retrieves the number of allocations counted
+     * @return  The number of operator new calls
+     */
+    static unsigned long long allocations()
+    {
+        return allocations_.load(std::memory_order_relaxed);
+    }
+
+
+    /**
+     * @brief   Retrieves the bytes of the allocations counted
+     * @return  The bytes asked of operator new
+     */
+    static unsigned long long bytes()
+    {
+        return bytes_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static std::atomic<bool> isCounting_; // Whether allocations are counted
+    static std::atomic<unsigned long long> allocations_; // The allocations counted
+    static std::atomic<unsigned long long> bytes_; // The bytes allocated
+};
+
+
+/**
+ * @brief A reading of the clocks and counters a stage is measured by
+ */
+struct StageSample {
+    std::chrono::steady_clock::time_point wall; // The elapsed time
+    double cpuSeconds; // The CPU time (of the process or of the thread)
+    unsigned long long allocations; // The allocations counted
+    unsigned long long allocatedBytes; // The bytes allocated
+};
+
+
+/**
+ * @brief This class gathers the totals of every stage of the run <br>
+ * The instrumentation is always compiled in but off until enabled, when it
+ * costs a branch at each stage and each frame handed to the consumers; once
+ * enabled, the stages read their clocks at their ends, and the consumers'
+ * stages read the wall clock around every frame <br>
+ * The totals are shared by the datasets of a batch, so they sum their stages
+ */
+class StageStats {
+public:
+
+    /**
+     * @brief           Switches the instrumentation on or off
+     * @param isEnabled Whether to gather the statistics
+     * @return          Nothing
+     */
+    static void setEnabled(bool const isEnabled)
+    {
+        state().isEnabled.store(isEnabled, std::memory_order_relaxed);
+        AllocationCounter::setCounting(isEnabled);
+    }
+
+
+    /**
+     * @brief   Checks whether the statistics are being gathered
+     * @return  Whether the instrumentation is on
+     */
+    static bool isEnabled()
+    {
+        return state().isEnabled.load(std::memory_order_relaxed);
+    }
+
+
+    /**
+     * @brief        Adds a run of a stage to its totals
+     * @param stage  The stage
+     * @param totals The totals of the run
+     * @return       Nothing
+     */
+    static void record(Stage const stage, StageTotals const& totals)
+    {
+        State& shared = state();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+
+        StageTotals& sum = shared.totals[stage];
+        add(totals, sum);
+        sum.peakRssKiB = peakRssKiB();
+    }
+
+
+    /**
+     * @brief       Retrieves the totals of a stage
+     * @param stage The stage
+     * @return      The totals
+     */
+    static StageTotals const totals(Stage const stage)
+    {
+        State& shared = state();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+
+        return shared.totals[stage];
+    }
+
+
+    /**
+     * @brief       Retrieves the name of a stage, as the reports give it
+     * @param stage The stage
+     * @return      The name
+     */
+    static char const* name(Stage const stage)
+    {
+        static char const* const NAMES[NUMBER_OF_STAGES] = {
+            "open", "line_count", "parse", "frame_store", "analysis", "output"
+        };
+
+        return NAMES[stage];
+    }
+
+
+    /**
+     * @brief   Reads the wall clock, the process's CPU time and the
+     * allocation counts
+     * @return  The reading
+     */
+    static StageSample const processSample()
+    {
+        StageSample sample;
+        sample.wall = std::chrono::steady_clock::now();
+        sample.cpuSeconds = processCpuSeconds();
+        sample.allocations = AllocationCounter::allocations();
+        sample.allocatedBytes = AllocationCounter::bytes();
+
+        return sample;
+    }
+
+
+    /**
+     * @brief         Reads the wall clock, the calling thread's CPU time and
+     * the allocation counts
+     * @param readCpu Whether to read the CPU time (left at 0 otherwise)
+     * @return        The reading
+     */
+    static StageSample const threadSample(bool const readCpu = true)
+    {
+        StageSample sample;
+        sample.wall = std::chrono::steady_clock::now();
+        sample.cpuSeconds = readCpu ? threadCpuSeconds() : 0.0;
+        sample.allocations = AllocationCounter::allocations();
+        sample.allocatedBytes = AllocationCounter::bytes();
+
+        return sample;
+    }
+
+
+    /**
+     * @brief        Adds the difference between two readings to totals
+     * @param start  The earlier reading
+     * @param end    The later reading
+     * @param totals The totals to add to
+     * @return       Nothing
+     */
+    static void addElapsed(StageSample const& start, StageSample const& end, StageTotals& totals)
+    {
+        totals.wallSeconds += std::chrono::duration<double>(end.wall - start.wall).count();
+        totals.cpuSeconds += end.cpuSeconds - start.cpuSeconds;
+        totals.allocations += end.allocations - start.allocations;
+        totals.allocatedBytes += end.allocatedBytes - start.allocatedBytes;
+    }
+
+
+    /**
+     * @brief        Adds totals to others
+     * @param totals The totals to add
+     * @param sum    The totals to add to
+     * @return       Nothing
+     */
+    static void add(StageTotals const& totals, StageTotals& sum)
+    {
+        sum.runs += totals.runs;
+        sum.wallSeconds += totals.wallSeconds;
+        sum.cpuSeconds += totals.cpuSeconds;
+        sum.bytes += totals.bytes;
+        sum.lines += totals.lines;
+        sum.frames += totals.frames;
+        sum.pixels += totals.pixels;
+        sum.rejectedPixels += totals.rejectedPixels;
+        sum.allocations += totals.allocations;
+        sum.allocatedBytes += totals.allocatedBytes;
+    }
+
+
+    /**
+     * @brief   Creates totals with everything at zero
+     * @return  The totals
+     */
+    static StageTotals const zero()
+    {
+        StageTotals totals = { 0, 0.0, 0.0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+        return totals;
+    }
+
+
+    /**
+     * @brief   Reads the CPU time of the process, over every thread
+     * @return  The CPU time in seconds
+     */
+    static double processCpuSeconds()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+               + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#else
+        return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#endif
+    }
+
+
+    /**
+     * @brief   Reads the CPU time of the calling thread
+     * @return  The CPU time in seconds (always 0 where there's no thread
+     * clock)
+     */
+    static double threadCpuSeconds()
+    {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+        struct timespec now;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+
+        return now.tv_sec + now.tv_nsec * 1e-9;
+#else
+        return 0.0;
+#endif
+    }
+
+
+    /**
+     * @brief   Reads the peak resident set size of the process so far
+     * @return  The peak in KiB (0 where it can't be read)
+     */
+    static long peakRssKiB()
+    {
+#if defined(__APPLE__)
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+
+        return static_cast<long>(usage.ru_maxrss / 1024); // In bytes
+#elif defined(__unix__)
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+
+        return usage.ru_maxrss;
+#else
+        return 0;
+#endif
+    }
+
+
+    /**
+     * @brief     Writes the totals of every stage as a JSON object
+     * @param out The stream to write to
+     * @return    Nothing
+     */
+    static void writeJson(std::ostream& out)
+    {
+        std::streamsize const precision = out.precision(9);
+
+        out << "{\n  \"stages\": [\n";
+        for (int i = 0; i < NUMBER_OF_STAGES; ++i) {
+            Stage const stage = static_cast<Stage>(i);
+            StageTotals const sum = totals(stage);
+            out << "    {\"name\": \"" << name(stage) << "\""
+                << ", \"runs\": " << sum.runs
+                << ", \"wall_seconds\": " << sum.wallSeconds
+                << ", \"cpu_seconds\": " << sum.cpuSeconds
+                << ", \"bytes\": " << sum.bytes
+                << ", \"lines\": " << sum.lines
+                << ", \"frames\": " << sum.frames
+                << ", \"pixels\": " << sum.pixels
+                << ", \"rejected_pixels\": " << sum.rejectedPixels
+                << ", \"allocations\": " << sum.allocations
+                << ", \"allocated_bytes\": " << sum.allocatedBytes
+                << ", \"peak_rss_kib\": " << sum.peakRssKiB
+                << (i + 1 < NUMBER_OF_STAGES ? "},\n" : "}\n");
+        }
+        out << "  ],\n  \"peak_rss_kib\": " << peakRssKiB() << "\n}\n";
+
+        out.precision(precision);
+    }
+
+
+    /**
+     * @brief     Writes the totals of every stage that ran as lines of text
+     * @param out The stream to write to
+     * @return    Nothing
+     */
+    static void writeText(std::ostream& out)
+    {
+        for (int i = 0; i < NUMBER_OF_STAGES; ++i) {
+            Stage const stage = static_cast<Stage>(i);
+            StageTotals const sum = totals(stage);
+            if (sum.runs == 0) {
+                continue;
+            }
+
+            out << "Stage " << name(stage) << ": " << sum.wallSeconds << " s wall, "
+                << sum.cpuSeconds << " s CPU, " << sum.bytes << " bytes, "
+                << sum.lines << " lines, " << sum.frames << " frames, "
+                << sum.pixels << " pixels (" << sum.rejectedPixels << " rejected), "
+                << sum.allocations << " allocations ("
+                << sum.allocatedBytes << " bytes), peak RSS " << sum.peakRssKiB << " KiB\n";
+        }
+    }
+
+private:
+
+    // The statistics shared by every thread
+    struct State {
+        State()
+            : isEnabled(false)
+        {
+            for (int i = 0; i < NUMBER_OF_STAGES; ++i) {
+                totals[i] = zero();
+            }
+        }
+
+        std::atomic<bool> isEnabled; // Whether the statistics are gathered
+        std::mutex mutex; // Guards the totals
+        StageTotals totals[NUMBER_OF_STAGES]; // The totals of each stage
+    };
+
+
+    // Utility Functions
+    static State& state()
+    {
+        // Built once, thread safely, on first use
+        static State shared;
+
+        return shared;
+    }
+};
+
+
+/**
+ * @brief This class measures a stage from its construction to its end (or
+ * its destruction), recording it with StageStats if the statistics were on
+ * when it started <br>
+ * The time of stages nested inside it and measured on their own can be
+ * excluded, so no time is counted twice
+ */
+class StageTimer {
+public:
+
+    /**
+     * @brief       A constructor for the StageTimer class, which starts the
+     * measurement
+     * @param stage The stage being measured
+     * @return      A newly constructed StageTimer object
+     */
+    explicit StageTimer(Stage const stage)
+        : stage_(stage), totals_(StageStats::zero()), excluded_(StageStats::zero()),
+        isActive_(StageStats::isEnabled())
+    {
+        if (isActive_) {
+            start_ = StageStats::processSample();
+        }
+    }
+
+
+    /**
+     * @brief   The destructor for the StageTimer class, which ends the
+     * measurement if it's still running
+     * @return  Nothing
+     */
+    ~StageTimer()
+    {
+        end();
+    }
+
+
+    /**
+     * @brief   Checks whether the stage is being measured
+     * @return  Whether the statistics were on when the stage started
+     */
+    bool isActive() const
+    {
+        return isActive_;
+    }
+
+
+    /**
+     * @brief        Counts what the stage handled towards its totals
+     * @param bytes  The bytes handled
+     * @param lines  The lines handled
+     * @param frames The frames handled
+     * @param pixels The pixels handled
+     * @return       Nothing
+     */
+    void count(unsigned long long const bytes,
+               unsigned long long const lines = 0,
+               unsigned long long const frames = 0,
+               unsigned long long const pixels = 0)
+    {
+        totals_.bytes += bytes;
+        totals_.lines += lines;
+        totals_.frames += frames;
+        totals_.pixels += pixels;
+    }
+
+
+    /**
+     * @brief      Counts the hits the stage dropped for lying off the
+     * detector's matrix towards its totals
+     * @param hits The hits dropped
+     * @return     Nothing
+     */
+    void reject(unsigned long long const hits)
+    {
+        totals_.rejectedPixels += hits;
+    }
+
+
+    /**
+     * @brief        Excludes the time and allocations of a nested stage
+     * @param nested The totals of the nested stage
+     * @return       Nothing
+     */
+    void exclude(StageTotals const& nested)
+    {
+        excluded_.wallSeconds += nested.wallSeconds;
+        excluded_.cpuSeconds += nested.cpuSeconds;
+        excluded_.allocations += nested.allocations;
+        excluded_.allocatedBytes += nested.allocatedBytes;
+    }
+
+
+    /**
+     * @brief   Ends the measurement and records it
+     * @return  Nothing
+     */
+    void end()
+    {
+        if (!isActive_) {
+            return;
+        }
+        isActive_ = false;
+
+        StageStats::addElapsed(start_, StageStats::processSample(), totals_);
+        totals_.runs = 1;
+        totals_.wallSeconds -= excluded_.wallSeconds;
+        totals_.cpuSeconds -= excluded_.cpuSeconds;
+        totals_.allocations -= excluded_.allocations;
+        totals_.allocatedBytes -= excluded_.allocatedBytes;
+        StageStats::record(stage_, totals_);
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    StageTimer(StageTimer const& other);
+
+
+    // Assignment operator
+    StageTimer& operator=(StageTimer const& other);
+
+    Stage stage_; // The stage being measured
+    StageSample start_; // The reading at the start of the stage
+    StageTotals totals_; // The totals of the stage so far
+    StageTotals excluded_; // The totals of the nested stages to exclude
+    bool isActive_; // Whether the stage is being measured
+};
+
+
+#endif  /* STAGESTATS_HPP */
@@ -0,0 +1,442 @@
+/**
+ * @file        SurrogateFitter.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the class fitting the Timepix surrogate function to the
+ * source peaks of every pixel at once (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef SURROGATEFITTER_HPP
+#define SURROGATEFITTER_HPP
+
+// C++ headers
+#include <vector>
+#include <string>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+// My headers
+#include <AlignedBuffer.hpp>
+#include <ToTHistogram.hpp>
+#include <PeakTable.hpp>
+
+/**
+ * @brief The outcome of fitting a pixel
+ */
+enum FitStatus {
+    FIT_CONVERGED = 0, // The fit found a minimum inside the allowed range of t
+    FIT_TOO_FEW_PEAKS = 1, // The pixel had fewer peaks than the 4 parameters
+    FIT_SINGULAR = 2, // The peaks did not pin down a, b and c
+    FIT_AT_BOUNDARY = 3 // The best t lay on the edge of its allowed range
+};
+
+
+/**
+ * @brief The surrogate function coefficients of one pixel, along with how
+ * well they fit its peaks
+ */
+struct SurrogateCoefficients {
+    double a; // The slope of the linear part, in ToT per keV
+    double b; // The offset of the linear part, in ToT
+    double c; // The strength of the threshold curvature, in ToT keV
+    double t; // The energy the curvature diverges at, in keV
+    double rms; // The root mean square residual of the fitted peaks, in ToT
+    std::uint32_t peaks; // The number of peaks fitted
+    std::uint32_t status; // The FitStatus of the fit
+};
+
+
+/**
+ * @brief The convergence statistics of a run of fits
+ */
+struct FitStatistics {
+    unsigned int converged; // The number of pixels whose fit converged
+    unsigned int tooFewPeaks; // The number of pixels with too few peaks to fit
+    unsigned int singular; // The number of pixels whose fit was singular
+    unsigned int atBoundary; // The number of pixels whose t hit its range's edge
+    unsigned int evaluations; // The number of least squares solves per pixel
+    double meanRms; // The mean rms residual of the converged fits
+    double maxRms; // The largest rms residual of the converged fits
+};
+
+
+/**
+ * @brief This class fits the surrogate function ToT = a*E + b - c/(E - t) to
+ * the source peaks of every pixel <br>
+ * For a fixed t the function is linear in a, b and c, so each pixel's fit is
+ * a search over t alone, solving the small linear least squares problem at
+ * every step: a coarse scan brackets the best t, then a golden section search
+ * closes in on it <br>
+ * Every pixel takes the same steps, so LANES neighbouring pixels are fitted
+ * together with each step written as a loop over the lanes (which the
+ * compiler turns into vector instructions), and the batches of lanes are
+ * spread over a pool of threads (class is non-copyable)
+ */
+class SurrogateFitter {
+public:
+
+    // The number of pixels fitted side by side
+    static const unsigned int LANES = 8;
+
+
+    /**
+     * @brief   An empty constructor for the SurrogateFitter class
+     * @return  A newly constructed SurrogateFitter object with no fits
+     */
+    SurrogateFitter()
+        : coefficients_(MATRIX_PIXELS)
+    {
+    }
+
+
+    /**
+     * @brief   The destructor for the SurrogateFitter class
+     * @return  Nothing
+     */
+    ~SurrogateFitter()
+    {
+    }
+
+
+    /**
+     * @brief         Fits every pixel to its peaks
+     * @param sources The peaks of each calibration source, which need at
+     * least 4 distinct energies between them for any pixel to be fitted
+     * @param threads The number of threads to fit with
+     * @return        The convergence statistics of the fits
+     */
+    FitStatistics fit(std::vector<PeakTable const*> const& sources, unsigned int const threads)
+    {
+        sources_ = sources;
+        coefficients_.clear();
+
+        // t lies below the lowest energy, where the function diverges
+        double lowest = 0.0;
+        for (std::size_t i = 0; i < sources_.size(); ++i) {
+            if (i == 0 || sources_[i]->energy() < lowest) {
+                lowest = sources_[i]->energy();
+            }
+        }
+        minimumT_ = 0.0;
+        maximumT_ = lowest * (1.0 - 1e-3);
+
+        unsigned int const workers = threads ? threads : 1;
+        std::vector<FitStatistics> statistics(workers);
+        std::atomic<unsigned int> next(0);
+
+        std::vector<std::thread> pool;
+        for (unsigned int i = 1; i < workers; ++i) {
+            pool.push_back(std::thread(&SurrogateFitter::work, this, std::ref(next), std::ref(statistics[i])));
+        }
+        work(next, statistics[0]);
+        for (std::size_t i = 0; i < pool.size(); ++i) {
+            pool[i].join();
+        }
+
+        FitStatistics total = statistics[0];
+        double rmsSum = total.meanRms * total.converged;
+        for (unsigned int i = 1; i < workers; ++i) {
+            total.converged += statistics[i].converged;
+            total.tooFewPeaks += statistics[i].tooFewPeaks;
+            total.singular += statistics[i].singular;
+            total.atBoundary += statistics[i].atBoundary;
+            total.maxRms = std::max(total.maxRms, statistics[i].maxRms);
+            rmsSum += statistics[i].meanRms * statistics[i].converged;
+        }
+        total.meanRms = total.converged ? rmsSum / total.converged : 0.0;
+        total.evaluations = EVALUATIONS;
+
+        return total;
+    }
+
+
+    /**
+     * @brief       Retrieves the fit of a pixel
+     * @param pixel The index of the pixel, as given by Pixel::xy()
+     * @return      The pixel's coefficients
+     */
+    SurrogateCoefficients const& coefficients(unsigned int const pixel) const
+    {
+        return coefficients_[pixel];
+    }
+
+
+    /**
+     * @brief      Writes the coefficient table, one line per pixel
+     * @param path The path of the table
+     * @return     Nothing, throws std::ifstream::failure if the table can't be
+     * written
+     */
+    void write(std::string const& path) const
+    {
+        static char const* const statusNames[] = { "converged", "too-few-peaks", "singular", "at-boundary" };
+
+        try {
+            std::vector<char> buffer(1 << 20);
+            std::ofstream out;
+            out.rdbuf()->pubsetbuf(&buffer[0], buffer.size());
+            out.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            out.open(path.c_str(), std::ofstream::out | std::ofstream::trunc);
+
+            out << "# ToT = a*E + b - c/(E - t), with E in keV\n"
+                << "# x y a b c t peaks rms status\n";
+
+            char line[256];
+            for (unsigned int pixel = 0; pixel < MATRIX_PIXELS; ++pixel) {
+                SurrogateCoefficients const& fit = coefficients_[pixel];
+                int const length = std::snprintf(line, sizeof(line), "%u %u %.9g %.9g %.9g %.9g %u %.6g %s\n",
+                        pixel % MATRIX_WIDTH, pixel / MATRIX_WIDTH,
+                        fit.a, fit.b, fit.c, fit.t, fit.peaks, fit.rms,
+                        statusNames[fit.status]);
+                out.write(line, length);
+            }
+            out.close();
+        } catch (std::ofstream::failure const&) {
+            throw std::ifstream::failure("Could not write the coefficient table: " + path);
+        }
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    SurrogateFitter(SurrogateFitter const& other);
+
+
+    // Assignment operator
+    SurrogateFitter& operator=(SurrogateFitter const& other);
+
+
+    // The number of points the allowed range of t is first scanned at
+    static const unsigned int SCAN_POINTS = 16;
+    // The number of golden section steps (narrowing the bracket by ~1e-8)
+    static const unsigned int GOLDEN_STEPS = 40;
+    // The number of least squares solves made for each pixel
+    static const unsigned int EVALUATIONS = SCAN_POINTS + 2 + GOLDEN_STEPS + 1;
+    // The number of batches of lanes a worker claims at once
+    static const unsigned int BATCHES_PER_CLAIM = 32;
+
+
+    struct Lanes {
+        double t[LANES]; // The t each lane is solved at
+        double a[LANES]; // The best a for that t
+        double b[LANES]; // The best b for that t
+        double c[LANES]; // The best c for that t
+        double ssr[LANES]; // The weighted sum of squared residuals
+        double points[LANES]; // The number of peaks (total weight)
+        bool isSingular[LANES]; // Whether a, b and c could not be solved for
+    };
+
+
+    // Utility Functions
+    void solve(unsigned int const pixel, Lanes& lanes) const
+    {
+        // Solves the linear least squares problem of a, b and c at each lane's
+        // t, through the 3x3 normal equations and Cramer's rule
+
+        double s11[LANES], s12[LANES], s13[LANES], s22[LANES], s23[LANES], s33[LANES];
+        double r1[LANES], r2[LANES], r3[LANES];
+        for (unsigned int l = 0; l < LANES; ++l) {
+            s11[l] = s12[l] = s13[l] = s22[l] = s23[l] = s33[l] = 0.0;
+            r1[l] = r2[l] = r3[l] = 0.0;
+        }
+
+        for (std::size_t i = 0; i < sources_.size(); ++i) {
+            double const e = sources_[i]->energy();
+            double const* y = sources_[i]->peaks() + pixel;
+            double const* w = sources_[i]->weights() + pixel;
+            for (unsigned int l = 0; l < LANES; ++l) {
+                double const g = -1.0 / (e - lanes.t[l]);
+                s11[l] += w[l] * e * e;
+                s12[l] += w[l] * e;
+                s13[l] += w[l] * e * g;
+                s22[l] += w[l];
+                s23[l] += w[l] * g;
+                s33[l] += w[l] * g * g;
+                r1[l] += w[l] * e * y[l];
+                r2[l] += w[l] * y[l];
+                r3[l] += w[l] * g * y[l];
+            }
+        }
+
+        for (unsigned int l = 0; l < LANES; ++l) {
+            double const m11 = s22[l] * s33[l] - s23[l] * s23[l];
+            double const m12 = s12[l] * s33[l] - s23[l] * s13[l];
+            double const m13 = s12[l] * s23[l] - s22[l] * s13[l];
+            double const det = s11[l] * m11 - s12[l] * m12 + s13[l] * m13;
+            double const scale = s11[l] * s22[l] * s33[l];
+
+            lanes.isSingular[l] = !(std::fabs(det) > 1e-12 * scale);
+            double const inverse = lanes.isSingular[l] ? 0.0 : 1.0 / det;
+
+            lanes.a[l] = (r1[l] * m11 - s12[l] * (r2[l] * s33[l] - s23[l] * r3[l])
+                          + s13[l] * (r2[l] * s23[l] - s22[l] * r3[l])) * inverse;
+            lanes.b[l] = (s11[l] * (r2[l] * s33[l] - s23[l] * r3[l]) - r1[l] * m12
+                          + s13[l] * (s12[l] * r3[l] - r2[l] * s13[l])) * inverse;
+            lanes.c[l] = (s11[l] * (s22[l] * r3[l] - r2[l] * s23[l])
+                          - s12[l] * (s12[l] * r3[l] - r2[l] * s13[l]) + r1[l] * m13) * inverse;
+            lanes.points[l] = s22[l];
+            lanes.ssr[l] = 0.0;
+        }
+
+        // The residuals are summed directly rather than expanded, which would
+        // lose the small differences the search over t depends on
+        for (std::size_t i = 0; i < sources_.size(); ++i) {
+            double const e = sources_[i]->energy();
+            double const* y = sources_[i]->peaks() + pixel;
+            double const* w = sources_[i]->weights() + pixel;
+            for (unsigned int l = 0; l < LANES; ++l) {
+                double const residual = y[l] - (lanes.a[l] * e + lanes.b[l] - lanes.c[l] / (e - lanes.t[l]));
+                lanes.ssr[l] += w[l] * residual * residual;
+            }
+        }
+    }
+
+
+    void fitBatch(unsigned int const pixel, FitStatistics& statistics)
+    {
+        // Fits LANES neighbouring pixels, starting at the given one
+
+        static const double GOLDEN = 0.6180339887498949;
+        double const range = maximumT_ - minimumT_;
+
+        Lanes lanes;
+        double best[LANES], bestT[LANES];
+
+        // Scan the whole range of t for the neighbourhood of the best fit
+        for (unsigned int k = 0; k < SCAN_POINTS; ++k) {
+            double const t = minimumT_ + range * k / (SCAN_POINTS - 1);
+            for (unsigned int l = 0; l < LANES; ++l) {
+                lanes.t[l] = t;
+            }
+            solve(pixel, lanes);
+            for (unsigned int l = 0; l < LANES; ++l) {
+                bool const isBetter = (k == 0) || lanes.ssr[l] < best[l];
+                best[l] = isBetter ? lanes.ssr[l] : best[l];
+                bestT[l] = isBetter ? t : bestT[l];
+            }
+        }
+
+        // Close in on it with a golden section search in each lane
+        double const step = range / (SCAN_POINTS - 1);
+        double low[LANES], high[LANES], x1[LANES], x2[LANES], f1[LANES], f2[LANES];
+        for (unsigned int l = 0; l < LANES; ++l) {
+            low[l] = std::max(minimumT_, bestT[l] - step);
+            high[l] = std::min(maximumT_, bestT[l] + step);
+            x1[l] = high[l] - GOLDEN * (high[l] - low[l]);
+            x2[l] = low[l] + GOLDEN * (high[l] - low[l]);
+            lanes.t[l] = x1[l];
+        }
+        solve(pixel, lanes);
+        for (unsigned int l = 0; l < LANES; ++l) {
+            f1[l] = lanes.ssr[l];
+            lanes.t[l] = x2[l];
+        }
+        solve(pixel, lanes);
+        for (unsigned int l = 0; l < LANES; ++l) {
+            f2[l] = lanes.ssr[l];
+        }
+
+        bool keepsLow[LANES];
+        for (unsigned int i = 0; i < GOLDEN_STEPS; ++i) {
+            for (unsigned int l = 0; l < LANES; ++l) {
+                keepsLow[l] = f1[l] < f2[l];
+                if (keepsLow[l]) {
+                    high[l] = x2[l];
+                    x2[l] = x1[l];
+                    f2[l] = f1[l];
+                    x1[l] = high[l] - GOLDEN * (high[l] - low[l]);
+                    lanes.t[l] = x1[l];
+                } else {
+                    low[l] = x1[l];
+                    x1[l] = x2[l];
+                    f1[l] = f2[l];
+                    x2[l] = low[l] + GOLDEN * (high[l] - low[l]);
+                    lanes.t[l] = x2[l];
+                }
+            }
+            solve(pixel, lanes);
+            for (unsigned int l = 0; l < LANES; ++l) {
+                f1[l] = keepsLow[l] ? lanes.ssr[l] : f1[l];
+                f2[l] = keepsLow[l] ? f2[l] : lanes.ssr[l];
+            }
+        }
+
+        // Solve once more at the centre of the final bracket
+        for (unsigned int l = 0; l < LANES; ++l) {
+            lanes.t[l] = 0.5 * (low[l] + high[l]);
+        }
+        solve(pixel, lanes);
+
+        for (unsigned int l = 0; l < LANES; ++l) {
+            SurrogateCoefficients& fit = coefficients_[pixel + l];
+            fit.a = lanes.a[l];
+            fit.b = lanes.b[l];
+            fit.c = lanes.c[l];
+            fit.t = lanes.t[l];
+            fit.peaks = static_cast<std::uint32_t>(lanes.points[l] + 0.5);
+            fit.rms = fit.peaks ? std::sqrt(lanes.ssr[l] / fit.peaks) : 0.0;
+
+            double const edge = range * 1e-4;
+            if (fit.peaks < 4) {
+                fit.status = FIT_TOO_FEW_PEAKS;
+                statistics.tooFewPeaks++;
+            } else if (lanes.isSingular[l] || !std::isfinite(fit.rms)) {
+                fit.status = FIT_SINGULAR;
+                statistics.singular++;
+            } else if (fit.t - minimumT_ < edge || maximumT_ - fit.t < edge) {
+                fit.status = FIT_AT_BOUNDARY;
+                statistics.atBoundary++;
+            } else {
+                fit.status = FIT_CONVERGED;
+                statistics.converged++;
+                statistics.meanRms += fit.rms;
+                statistics.maxRms = std::max(statistics.maxRms, fit.rms);
+            }
+        }
+    }
+
+
+    void work(std::atomic<unsigned int>& next, FitStatistics& statistics)
+    {
+        statistics.converged = statistics.tooFewPeaks = 0;
+        statistics.singular = statistics.atBoundary = 0;
+        statistics.evaluations = EVALUATIONS;
+        statistics.meanRms = statistics.maxRms = 0.0;
+
+        unsigned int const batches = MATRIX_PIXELS / LANES;
+        for (;;) {
+            unsigned int const first = next.fetch_add(BATCHES_PER_CLAIM);
+            if (first >= batches) {
+                break;
+            }
+            unsigned int const last = std::min(first + BATCHES_PER_CLAIM, batches);
+            for (unsigned int batch = first; batch < last; ++batch) {
+                fitBatch(batch * LANES, statistics);
+            }
+        }
+
+        // Turn the sum of the rms residuals into their mean
+        if (statistics.converged) {
+            statistics.meanRms /= statistics.converged;
+        }
+    }
+
+    std::vector<PeakTable const*> sources_; // The peaks being fitted
+    AlignedBuffer<SurrogateCoefficients> coefficients_; // Every pixel's fit
+    double minimumT_; // The lowest t allowed
+    double maximumT_; // The highest t allowed
+};
+
+
+#endif  /* SURROGATEFITTER_HPP */
@@ -0,0 +1,95 @@
+/**
+ * @file        TableEntryConsumer.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the frame consumer generating the Wiki table entry for
+ * a dataset
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef TABLEENTRYCONSUMER_HPP
+#define TABLEENTRYCONSUMER_HPP
+
+// C++ headers
+#include <string>
+// My headers
+#include <FrameConsumer.hpp>
+#include <TableEntryGen.hpp>
+
+/**
+ * @brief This class generates the Wiki table entry of a dataset from its
+ * summary, so it never needs the frames themselves
+ */
+template <class T>
+class TableEntryConsumer : public FrameConsumer<T> {
+public:
+
+    /**
+     * @brief   An empty constructor for the TableEntryConsumer class
+     * @return  A newly constructed TableEntryConsumer object
+     */
+    TableEntryConsumer()
+    {
+    }
+
+
+    /**
+     * @brief   The table entry only needs the dataset summary
+     * @return  False
+     */
+    virtual bool needsFrames() const
+    {
+        return false;
+    }
+
+
+    /**
+     * @brief             Ignores the frame
+     * @param frame       The frame
+     * @param frameNumber The number of the frame
+     * @return            Nothing
+     */
+    virtual void consume(Frame<T> const& frame, unsigned int const frameNumber)
+    {
+    }
+
+
+    /**
+     * @brief         Generates the table entry for the dataset
+     * @param summary The details of the whole dataset
+     * @return        Nothing
+     */
+    virtual void finish(DatasetSummary const& summary)
+    {
+        TableEntryGen tableEntryGen(
+            summary.detectorName,    // The name of the detector
+            summary.size,            // The size of the file in bytes
+            summary.numberOfLines,   // The number of lines in the file
+            summary.numberOfFrames,  // The number of frames in the file
+            summary.settings         // The settings string for the data set
+        );
+
+        entry_ = tableEntryGen.generateEntry();
+    }
+
+
+    /**
+     * @brief   A getter for the generated table entry
+     * @return  The table entry, empty until the dataset has been finished
+     */
+    std::string const entry() const
+    {
+        return entry_;
+    }
+
+private:
+    std::string entry_; // The generated table entry
+};
+
+
+#endif  /* TABLEENTRYCONSUMER_HPP */
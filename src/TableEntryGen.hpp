@@ -38,9 +38,9 @@ public:
      */
     TableEntryGen(
         std::string const& detectorName,
-        unsigned int const fileSize,
-        unsigned int const fileNumberOfLines,
-        unsigned int const fileNumberOfFrames,
+        unsigned long long const fileSize,
+        unsigned long long const fileNumberOfLines,
+        unsigned long long const fileNumberOfFrames,
         std::string chipSettings
     )
         : detectorName_(detectorName), size_(fileSize), numberOfLines_(fileNumberOfLines),
@@ -81,9 +81,9 @@ private:
     // The storage variables for the metadata of the data file
     std::string detectorName_;
     std::string settings_;
-    unsigned int size_;
-    unsigned int numberOfLines_;
-    unsigned int numberOfFrames_;
+    unsigned long long size_;
+    unsigned long long numberOfLines_;
+    unsigned long long numberOfFrames_;
 };
 
 
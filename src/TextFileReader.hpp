@@ -20,18 +20,42 @@
 // C++ headers
 #include <iostream>
 #include <fstream>
-#include <cassert>
-#include <string>
 #include <sstream>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
 #include <boost/filesystem.hpp>
+#include <boost/interprocess/exceptions.hpp>
 // My headers
 #include <Frame.hpp>
+#include <MappedFile.hpp>
+#include <ClusterLogParser.hpp>
+#include <ByteScanner.hpp>
+#include <ParallelFrameParser.hpp>
+#include <PipelinedFrameReader.hpp>
+#include <BinaryCacheReader.hpp>
+#include <BinaryCacheWriter.hpp>
+#include <RejectedHits.hpp>
+#include <FrameIndex.hpp>
+#include <CompressedStream.hpp>
 
 using namespace boost;
 
 /**
  * @brief This class defines the class for handling reading of a text encoded data file
- * for pixel data (class is non-copyable)
+ * for pixel data (class is non-copyable) <br>
+ * The file is memory mapped and frames are parsed directly out of the mapped
+ * bytes, so no lines are ever copied into strings <br>
+ * If a fresh binary '.lolc' cache of the file sits next to it, the frames are
+ * read from the cache instead and no text is parsed at all <br>
+ * A gzip or zstd compressed file is recognised by its first bytes and
+ * decompressed on background threads as it is parsed, so it never has to be
+ * decompressed to disk; as its text is never all in memory, it can only be
+ * read front to back (and its line and frame counts are gathered as it is),
+ * unless it has a binary cache
  */
 template <class T>
 class TextFileReader {
@@ -42,7 +66,10 @@ public:
      * @return  A newly constructed TextFileReader object defaulted to null values
      */
     TextFileReader()
-        : lineNumber_(1), currentPixelNumber_(1), detectorName_(""), fileSize_(0), numberOfLines_(0)
+        : detectorName_(""), numberOfLines_(0), numberOfFrames_(0), fileSize_(0),
+        modified_(0), cachedFrame_(0), mask_(0), isScanned_(false), isIndexed_(false),
+        compression_(COMPRESSION_NONE), windowBegin_(0), streamLine_(1), streamedFrames_(0),
+        isStreamStarted_(false), isStreamEnded_(false)
     {
     }
 
@@ -53,7 +80,10 @@ public:
      * @return     A newly constructed TextFileReader object
      */
     TextFileReader(std::string const& name)
-        : lineNumber_(1), currentPixelNumber_(1), detectorName_(""), fileSize_(0), numberOfLines_(0)
+        : detectorName_(""), numberOfLines_(0), numberOfFrames_(0), fileSize_(0),
+        modified_(0), cachedFrame_(0), mask_(0), isScanned_(false), isIndexed_(false),
+        compression_(COMPRESSION_NONE), windowBegin_(0), streamLine_(1), streamedFrames_(0),
+        isStreamStarted_(false), isStreamEnded_(false)
     {
         this->open(name);
     }
@@ -65,27 +95,31 @@ public:
      */
     ~TextFileReader()
     {
-        if (in_.is_open()) {
+        if (file_.isOpen()) {
             this->close();
         }
     }
 
 
     /**
-     * @brief      A function to open the file stream
+     * @brief      A function to open (map) the data file
      * @param name The path of the data file to open
      * @return     Nothing
      */
     void open(std::string const& name)
     {
-        if (!in_.is_open()) {
+        if (!file_.isOpen()) {
             filesystem::path filePath (name);
 
             if (filesystem::exists(filePath)) {
                 if (filesystem::is_regular_file(filePath) && !filesystem::is_empty(filePath)) {
-                    
+
+                    // Remember where the file is
+                    path_ = filePath.string();
+
                     // Grab the file size
                     fileSize_ = filesystem::file_size(filePath);
+                    modified_ = filesystem::last_write_time(filePath);
 
                     // Grab the detector name
                     detectorName_ = filePath.parent_path().parent_path().parent_path().leaf().string();
@@ -93,39 +127,42 @@ public:
                     // Grab the settings string
                     settings_ = filePath.parent_path().leaf().string();
 
-                    // Open the cluster log
+                    // Map the cluster log
                     try {
-                        // Set the input file stream's exceptions flags
-                        in_.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
-                        // Try to open the file
-                        in_.open(filePath.string(), std::ifstream::in | std::ifstream::binary);
-                        lineNumber_ = 1;
+                        file_.open(filePath.string());
                     }
-                    catch (std::ifstream::failure& e) {
-                        // Catch an error when attempting to open a file
+                    catch (interprocess::interprocess_exception& e) {
+                        // Catch an error when attempting to map a file
 
                         std::cerr << "An error occurred when opening the file!\n"
                             << e.what() << std::endl;
-                        throw;
+                        throw std::ifstream::failure(e.what());
                     }
 
-                    // Reset the exception flags to allow the getline loop
-                    in_.exceptions(std::ifstream::goodbit);
+                    parser_.reset(file_.begin(), file_.end());
+                    parser_.setMask(mask_);
+                    parser_.setRejectedHits(&rejected_);
+                    rejected_.reset();
 
-                    std::string throwaway;
-                    // Get the number of lines in the file
-                    // NOTE: if reading from disk is a bottleneck, we could cache every line here to memory
-                    while (std::getline(in_, throwaway)) {
-                        ++numberOfLines_;
+                    // A compressed file is only ever streamed
+                    compression_ = detectCompression(file_.begin(), file_.end());
+                    if (compression_ != COMPRESSION_NONE) {
+                        parser_.reset(0, 0);
+                        resetStream();
                     }
-                    // Reset the file state
-                    in_.clear();
-                    in_.seekg(0, std::ios::beg);
 
-                    // Reset the exception flags to allow exceptions from now on
-                    in_.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-                    
+                    // The line and frame counts and the frame index are only
+                    // gathered on demand
+                    isScanned_ = false;
+                    isIndexed_ = false;
+
+                    // Read from the binary cache if it is up to date (unless
+                    // the read is strict, as a cache doesn't keep the hits
+                    // dropped from it off the matrix)
+                    cachedFrame_ = 0;
+                    if (!rejected_.isStrict()) {
+                        cache_.open(path_, fileSize_, modified_);
+                    }
                 }
                 else {
                     std::cerr << "An error occurred when opening the file!\n"
@@ -143,18 +180,63 @@ public:
 
 
     /**
-     * @brief      A function to close the file stream
+     * @brief      A function to close (unmap) the data file
      * @return     Nothing
      */
     void close()
     {
-        if (in_.is_open()) {
+        if (file_.isOpen()) {
             detectorName_ = "";
-            in_.close();
+            parser_.reset(0, 0);
+            resetStream();
+            compression_ = COMPRESSION_NONE;
+            cache_.close();
+            file_.close();
         }
     }
 
 
+    /**
+     * @brief      Sets the mask of pixels whose hits are dropped from every
+     * frame read, whether parsed or read from the binary cache
+     * @param mask The mask, which has to outlive the reader's use of it, or
+     * null to keep every hit
+     * @return     Nothing
+     */
+    void setMask(PixelMask<> const* mask)
+    {
+        mask_ = mask;
+        parser_.setMask(mask);
+    }
+
+
+    /**
+     * @brief          Sets whether a hit lying off the detector's matrix fails
+     * the read as malformed data, rather than being dropped and counted (a
+     * strict read is set before the file is opened, and parses the text even
+     * when it has a binary cache)
+     * @param isStrict Whether to throw on such a hit
+     * @return         Nothing
+     */
+    void setStrict(bool const isStrict)
+    {
+        rejected_.setStrict(isStrict);
+    }
+
+
+    /**
+     * @brief   Retrieves the number of hits dropped for lying off the
+     * detector's matrix by the frames parsed since the file was opened (the
+     * frames read from a binary cache lost theirs when it was written, so
+     * count none)
+     * @return  The number of hits
+     */
+    unsigned long long numberOfRejectedHits() const
+    {
+        return rejected_.count();
+    }
+
+
     /**
      * @brief      A function to check whether the end of the stream has been
      * reached
@@ -162,70 +244,264 @@ public:
      */
     bool endOfStream()
     {
-        in_.peek(); // Peek to force the EOF flag to be set
-        if (!in_.eof()) {
-
-            return false;
+        if (cache_.isOpen()) {
+            return cachedFrame_ >= cache_.numberOfFrames();
+        }
+        if (isCompressed()) {
+            return streamedFrameEnd() == windowBegin_;
         }
 
-        return true;
+        return parser_.atEnd();
     }
 
 
     /**
-     * @brief      A function to close the file stream
+     * @brief      A function to read the next frame from the file
      * @return     Returns a Frame object with the data from the frame being
      * read.
      */
     Frame<T> const getFrame()
     {
-        try {
-            Frame<T> frame = Frame<T> (); // Construct a new frame
-            // Reset the current pixel counter to 0
-            currentPixelNumber_ = 0;
-            // Flag as to whether the data section of a frame has begun to be read
-            bool isInFrame = false;
-            // Flags for checking the result of an attempted parse on a line
-            bool isMetadata = false;
-            bool isClusterdata = false;
-
-
-            // While it isn't the end of the file yet
-            while (!endOfStream()) {
-                // Parse the data
-
-                // If a frame hasn't been begun
-                if (!isInFrame) {
-                    // Try to read the meta-data string from the file
-                    // isMetadata will be false if the string is not a meta-data string
-                    isMetadata = parseMetadataString(frame);
-                    if (!isMetadata) {
-                        // If there was no meta-data for the first line of the frame
-                        // then report an error
-                        std::ostringstream o;
-                        o << "Malformed data file: Missing meta-data string at line: "
-                          << lineNumber_;
-                        throw std::ifstream::failure(o.str());
-                    }
+        Frame<T> frame = Frame<T> (); // Construct a new frame
+        getFrame(frame);
 
-                    // Flag that a frame has been begun
-                    isInFrame = true;
+        return frame;
+    }
+
+
+    /**
+     * @brief       A function to read the next frame from the file into an
+     * existing frame, reusing its storage (so a loop handing the same frame
+     * back each time allocates nothing once the frame has grown)
+     * @param frame The frame to fill, emptied first
+     * @return      Nothing
+     */
+    void getFrame(Frame<T>& frame)
+    {
+        try {
+            if (cache_.isOpen()) {
+                if (!endOfStream()) {
+                    cache_.readFrame(cachedFrame_++, frame, mask_);
                 } else {
-                    // If the meta-data of the frame has already been read
-                    // then read the cluster data into pixel storage
-
-                    // First try to read a line of cluster data
-                    isClusterdata = parseClusterString(frame);
-                    // If it isn't cluster data then use the empty line
-                    if (!isClusterdata) {
-                        eatLine();
-                        // then end operations for this frame
-                        break;
-                    }
+                    frame.clear();
+                }
+            } else if (isCompressed()) {
+                frame.clear();
+                if (!endOfStream()) {
+                    parseStreamedFrame(frame);
+                }
+            } else {
+                frame.clear();
+                if (!endOfStream()) {
+                    parser_.parseFrame(frame);
+                }
+            }
+        } catch (std::ifstream::failure const& e) {
+
+            std::cerr << "An error occurred when reading a line from the file!\n"
+                    << e.what() << std::endl;
+            throw; // Re-throw the exception up the stack
+        }
+    }
+
+
+    /**
+     * @brief         Parses every remaining frame of the file on several
+     * threads, handing each one to the callback in file order
+     * @param threads The number of worker threads to parse with
+     * @param onFrame A callable taking (Frame<T> const&, unsigned int frameNumber),
+     * where the frames are numbered from 1 as getFrame() would return them
+     * @return        The number of frames parsed
+     */
+    template <class Callback>
+    unsigned int forEachFrame(unsigned int const threads, Callback onFrame)
+    {
+        if (cache_.isOpen()) {
+            return forEachCachedFrame(onFrame);
+        }
+        if (isCompressed()) {
+            // The text is only parsed on one thread, while the independent
+            // frames of a zstd file are decompressed on the others
+            return forEachStreamedFrame(threads, onFrame);
+        }
+
+        try {
+            ParallelFrameParser<T> parser(parser_.position(), file_.end(), threads);
+            parser.setMask(mask_);
+            parser.setRejectedHits(&rejected_);
+            unsigned int const frames = parser.parse(onFrame);
+
+            // Everything has been consumed now
+            parser_.reset(file_.end(), file_.end());
+
+            return frames;
+        } catch (std::ifstream::failure const& e) {
+
+            std::cerr << "An error occurred when reading a line from the file!\n"
+                    << e.what() << std::endl;
+            throw; // Re-throw the exception up the stack
+        }
+    }
+
+
+    /**
+     * @brief         Reads and parses every remaining frame of the file on
+     * their own threads (overlapping the disk reads with the parsing), handing
+     * each frame to the callback in file order
+     * @param onFrame A callable taking (Frame<T> const&, unsigned int frameNumber),
+     * where the frames are numbered from 1 as getFrame() would return them
+     * @return        The number of frames read
+     */
+    template <class Callback>
+    unsigned int forEachFramePipelined(Callback onFrame)
+    {
+        if (cache_.isOpen()) {
+            return forEachCachedFrame(onFrame);
+        }
+        if (isCompressed()) {
+            return forEachStreamedFrame(std::max(std::thread::hardware_concurrency(), 1u), onFrame);
+        }
+
+        try {
+            PipelinedFrameReader<T> reader(path_, parser_.position() - file_.begin());
+            reader.setMask(mask_);
+            reader.setRejectedHits(&rejected_);
+            unsigned int const frames = reader.run(onFrame);
+
+            // Everything has been consumed now
+            parser_.reset(file_.end(), file_.end());
+
+            return frames;
+        } catch (std::ifstream::failure const& e) {
+
+            std::cerr << "An error occurred when reading a line from the file!\n"
+                    << e.what() << std::endl;
+            throw; // Re-throw the exception up the stack
+        }
+    }
+
+
+    /**
+     * @brief             Reads any frame of the file, without reading the
+     * frames before it (and without moving the stream read by getFrame())
+     * @param frameNumber The number of the frame, counted from 1
+     * @return            Returns a Frame object with the data from the frame,
+     * throws std::ifstream::failure if there is no such frame
+     */
+    Frame<T> const getFrame(unsigned long long const frameNumber)
+    {
+        Frame<T> frame = Frame<T> ();
+        getFrame(frameNumber, frame);
+
+        return frame;
+    }
+
+
+    /**
+     * @brief             Reads any frame of the file into an existing frame,
+     * reusing its storage (without moving the stream read by getFrame())
+     * @param frameNumber The number of the frame, counted from 1
+     * @param frame       The frame to fill, emptied first
+     * @return            Nothing, throws std::ifstream::failure if there is
+     * no such frame
+     */
+    void getFrame(unsigned long long const frameNumber, Frame<T>& frame)
+    {
+        FrameIndex const& index = frameIndex();
+        if (frameNumber < 1 || frameNumber > index.size()) {
+            std::ostringstream o;
+            o << "There is no frame " << frameNumber << " in the file (it has "
+              << index.size() << " frames)";
+            throw std::ifstream::failure(o.str());
+        }
+
+        if (cache_.isOpen()) {
+            cache_.readFrame(frameNumber - 1, frame, mask_);
+        } else {
+            try {
+                parseRange(file_.begin() + index.offset(frameNumber), file_.end(), frame);
+            } catch (std::ifstream::failure const& e) {
+
+                std::cerr << "An error occurred when reading a line from the file!\n"
+                        << e.what() << std::endl;
+                throw; // Re-throw the exception up the stack
+            }
+        }
+    }
+
+
+    /**
+     * @brief    Finds the frames taken within a window of time, using the
+     * frame index
+     * @param t0 The start of the window in seconds (inclusive)
+     * @param t1 The end of the window in seconds (exclusive)
+     * @return   The range of frames in the window
+     */
+    FrameRange const framesInTimeRange(double const t0, double const t1)
+    {
+        return frameIndex().framesInTimeRange(t0, t1);
+    }
+
+
+    /**
+     * @brief         Reads a range of frames, seeking straight to the first
+     * one with the frame index, and hands each one to the callback in order
+     * @param range   The range of frames to read (clamped to the file)
+     * @param threads The number of worker threads to parse with
+     * @param onFrame A callable taking (Frame<T> const&, unsigned int frameNumber),
+     * where the frames keep their numbers within the whole file
+     * @return        The number of frames read
+     */
+    template <class Callback>
+    unsigned int forEachFrameInRange(FrameRange range, unsigned int const threads, Callback onFrame)
+    {
+        FrameIndex const& index = frameIndex();
+        range.first = std::max(range.first, 1ULL);
+        range.last = std::min(range.last, index.size() + 1);
+        if (range.first >= range.last) {
+            return 0;
+        }
+
+        if (cache_.isOpen()) {
+            Frame<T> frame;
+            for (unsigned long long i = range.first; i < range.last; ++i) {
+                cache_.readFrame(i - 1, frame, mask_);
+                onFrame(frame, static_cast<unsigned int>(i));
+            }
+
+            return static_cast<unsigned int>(range.last - range.first);
+        }
+
+        char const* begin = file_.begin() + index.offset(range.first);
+        char const* end = (range.last <= index.size()) ? file_.begin() + index.offset(range.last) : file_.end();
+        Renumber<Callback> renumbered(onFrame, static_cast<unsigned int>(range.first - 1));
+
+        try {
+            if (threads > 1) {
+                ParallelFrameParser<T> parser(begin, end, threads, file_.begin());
+                parser.setMask(mask_);
+                parser.setRejectedHits(&rejected_);
+                return parser.parse(renumbered);
+            }
+
+            Frame<T> frame;
+            unsigned int frameNumber = 0;
+            ClusterLogParser<T> parser(begin, end);
+            parser.setMask(mask_);
+            parser.setRejectedHits(&rejected_);
+            while (!parser.atEnd()) {
+                frame.clear();
+                char const* frameBegin = parser.position();
+                try {
+                    parser.parseFrame(frame);
+                } catch (std::ifstream::failure const&) {
+                    // Report the error against the right line of the file
+                    parseRange(frameBegin, end, frame);
                 }
+                renumbered(frame, ++frameNumber);
             }
 
-            return frame;
+            return frameNumber;
         } catch (std::ifstream::failure const& e) {
 
             std::cerr << "An error occurred when reading a line from the file!\n"
@@ -235,6 +511,130 @@ public:
     }
 
 
+    /**
+     * @brief      Retrieves the index of frame offsets and times, building it
+     * with a single scan of the file (or loading it from the binary cache) on
+     * first use
+     * @return     A reference to the frame index, throws std::ifstream::failure
+     * for a compressed file without a binary cache
+     */
+    FrameIndex const& frameIndex()
+    {
+        if (!isIndexed_ && file_.isOpen()) {
+            if (isCompressed() && !cache_.isOpen()) {
+                throw std::ifstream::failure("Seeking to frames of the compressed '" + path_
+                                             + "' needs its binary cache (see --cache)");
+            }
+            if (cache_.isOpen()) {
+                index_.clear();
+                for (unsigned long long i = 0; i < cache_.numberOfFrames(); ++i) {
+                    index_.add(cache_.textOffset(i), cache_.time(i));
+                }
+            } else {
+                // The same pass gathers the line and frame counts
+                ScanResult result = index_.build(file_.begin(), file_.end());
+                numberOfLines_ = result.lines;
+                numberOfFrames_ = result.frames;
+                isScanned_ = true;
+            }
+            isIndexed_ = true;
+        }
+
+        return index_;
+    }
+
+
+    /**
+     * @brief      Writes a binary '.lolc' cache of the file next to it, with a
+     * single pass over the text, and switches to reading from it <br>
+     * Must be called before any frame has been read
+     * @return     Nothing, throws std::ifstream::failure if the file is
+     * malformed or the cache can't be written
+     */
+    void writeCache()
+    {
+        assert(file_.isOpen());
+
+        try {
+            BinaryCacheWriter<T> writer(path_, fileSize_, modified_);
+
+            // The cache mirrors the text, so it is written without the mask
+            // (which is applied as the cache is read)
+            if (isCompressed()) {
+                // The text offsets are those within the decompressed text
+                CompressedStream stream(file_.begin(), file_.end(), compression_,
+                                        std::max(std::thread::hardware_concurrency(), 1u));
+                PipelinedFrameReader<T> reader(stream);
+                reader.setRejectedHits(&rejected_);
+                numberOfFrames_ = reader.run([&writer, &reader](Frame<T> const& frame, unsigned int const frameNumber) {
+                    writer.writeFrame(frame, reader.textOffset(frame));
+                });
+                numberOfLines_ = reader.numberOfLines();
+                isScanned_ = true;
+            } else {
+                ClusterLogParser<T> parser(file_.begin(), file_.end());
+                parser.setRejectedHits(&rejected_);
+                Frame<T> frame;
+                while (!parser.atEnd()) {
+                    unsigned long long const textOffset = parser.position() - file_.begin();
+                    frame.clear();
+                    parser.parseFrame(frame);
+                    writer.writeFrame(frame, textOffset);
+                }
+            }
+
+            scan();
+            writer.finish(numberOfLines_);
+        } catch (std::ifstream::failure const& e) {
+
+            std::cerr << "An error occurred when writing the cache of the file!\n"
+                    << e.what() << std::endl;
+            throw; // Re-throw the exception up the stack
+        } catch (filesystem::filesystem_error const& e) {
+
+            std::cerr << "An error occurred when writing the cache of the file!\n"
+                    << e.what() << std::endl;
+            throw std::ifstream::failure(e.what());
+        }
+
+        cachedFrame_ = 0;
+        cache_.open(path_, fileSize_, modified_);
+        isIndexed_ = false;
+    }
+
+
+    /**
+    * @brief      A getter for whether the frames are being read from the
+    * binary cache rather than the text
+    * @return     Returns whether a fresh cache is in use
+    */
+    bool const isCached()
+    {
+        return cache_.isOpen();
+    }
+
+
+    /**
+    * @brief      A getter for whether the file is compressed, and so is
+    * decompressed as it is read
+    * @return     Returns whether the file is gzip or zstd compressed
+    */
+    bool const isCompressed() const
+    {
+        return compression_ != COMPRESSION_NONE;
+    }
+
+
+    /**
+    * @brief      A getter for the compression of the file
+    * @return     Returns the compression the file is stored in
+    */
+    Compression const compression() const
+    {
+        return compression_;
+    }
+
+
     /**
     * @brief      A getter for the detector used to generate the data's name
     * @return     Returns a string containing the detector's name
@@ -256,24 +656,68 @@ public:
 
 
     /**
-    * @brief      A getter for the number of lines in the file
+    * @brief      A getter for the number of lines in the file (scans the file
+    * on first use, which for a compressed file means decompressing it, unless
+    * it has already been streamed)
     * @return     Returns a an integer for the number of lines in the file
     */
-    unsigned int const numberOfLines()
+    unsigned long long const numberOfLines()
     {
+        if (cache_.isOpen()) {
+            return cache_.numberOfLines();
+        }
+
+        scan();
         return numberOfLines_;
     }
 
 
+    /**
+    * @brief      A getter for the number of frames in the file, counted from
+    * the frame headers without parsing any frames (scans the file on first use)
+    * @return     Returns a an integer for the number of frames in the file
+    */
+    unsigned long long const numberOfFrames()
+    {
+        if (cache_.isOpen()) {
+            return cache_.numberOfFrames();
+        }
+
+        scan();
+        return numberOfFrames_;
+    }
+
+
     /**
     * @brief      A getter for the file size
-    * @return     Returns a an integer for the size of the file in bytes
+    * @return     Returns a an integer for the size of the file in bytes (as
+    * stored, so compressed for a compressed file)
     */
-    unsigned int const size()
+    unsigned long long const size()
     {
         return fileSize_;
     }
 
+
+    /**
+    * @brief      A getter for the file's modification time
+    * @return     Returns the time the file was last written to
+    */
+    long long const modified() const
+    {
+        return modified_;
+    }
+
+
+    /**
+    * @brief      A getter for the path of the file
+    * @return     Returns the path the file was opened from
+    */
+    std::string const path() const
+    {
+        return path_;
+    }
+
 private:
 
     // Non-copyable
@@ -291,182 +735,290 @@ private:
 
 
     // Utility Functions
-    void eatLine()
-    {
-        assert(in_.is_open());
+    template <class Callback>
+    class Renumber {
+    public:
+        // Shifts the frame numbers handed to a callback by an offset
+
+        Renumber(Callback& onFrame, unsigned int const offset)
+            : onFrame_(onFrame), offset_(offset)
+        {
+        }
 
-        // Simply eats up the current line without doing anything
+        void operator()(Frame<T> const& frame, unsigned int const frameNumber) const
+        {
+            onFrame_(frame, frameNumber + offset_);
+        }
 
-        if (!endOfStream()) {
+    private:
+        Callback& onFrame_;
+        unsigned int offset_;
+    };
 
-            std::string line; //A temporary for lines
 
-            // Read in a line
-            std::getline(in_, line);
+    void parseRange(char const* begin, char const* end, Frame<T>& frame)
+    {
+        // Parses the frame at the start of the range; the lines before the
+        // range are only counted if the frame turns out to be malformed, so
+        // the error names the right line of the file
 
-            lineNumber_++;
+        try {
+            ClusterLogParser<T> parser(begin, end);
+            parser.setMask(mask_);
+            parser.setRejectedHits(&rejected_);
+            frame.clear();
+            parser.parseFrame(frame);
+        } catch (std::ifstream::failure const&) {
+            if (begin == file_.begin()) {
+                throw;
+            }
+            unsigned int const firstLine = static_cast<unsigned int>(
+                    ByteScanner::scan(file_.begin(), begin).lines) + 1;
+
+            ClusterLogParser<T> parser(begin, end, firstLine);
+            parser.setMask(mask_);
+            parser.setRejectedHits(&rejected_);
+            frame.clear();
+            parser.parseFrame(frame);
         }
     }
 
 
-   std::string const extractSubstring(
-        std::string const& input,
-        size_t& currentPosition,
-        char const delimeter
-    ) const
+    template <class Callback>
+    unsigned int forEachCachedFrame(Callback onFrame)
     {
-        // Iterates the given string from currentPosition until delimeter is found,
-        // and returns the string from the given position up to the position to the
-        // delimeter (which is excluded)), also changes the value of the
-        // currentPosition variable
-
-        std::string temp = "";
-        while (currentPosition < input.length() && input[currentPosition] != ' ') {
-
-            temp += input[currentPosition]; // Add the characters to the temporary
-            currentPosition++; // Increment the input position
+        // Decoding from the cache is little more than a copy, so it isn't
+        // worth spreading over threads
+
+        Frame<T> frame;
+        unsigned int frameNumber = 0;
+        while (!endOfStream()) {
+            cache_.readFrame(cachedFrame_++, frame, mask_);
+            onFrame(frame, ++frameNumber);
         }
 
-        return temp;
+        return frameNumber;
     }
 
 
-    // Parsing routines
-    bool const parseMetadataString(Frame<T>& frame)
+    template <class Callback>
+    unsigned int forEachStreamedFrame(unsigned int const threads, Callback onFrame)
     {
-        assert(in_.is_open());
-
-        // Attempts to parse and extract the fields into the frame object's data
-        // fields from a meta-data string of this format - e.g.
-        // 'Frame 1 (1335967757.2905033 s, 0.1 s)'
-        // Returns false if the string is not meta-data, and thus resets the
-        // file pointer
-
-        if (!endOfStream()) {
-            // Store the state of the file pointer
-            size_t originalFilePosition = in_.tellg();
-
-            //--------------------------------
-            // Get to the beginning of the parentheses
-            std::string line; //A temporary for lines
+        // Streams the rest of a compressed file through the pipelined reader,
+        // or frame by frame if getFrame() has already started on it
 
-            // Read in a line
-            std::getline(in_, line);
+        try {
+            if (isStreamStarted_) {
+                Frame<T> frame;
+                unsigned int frameNumber = 0;
+                while (!endOfStream()) {
+                    frame.clear();
+                    parseStreamedFrame(frame);
+                    onFrame(frame, ++frameNumber);
+                }
 
-            // find the opening parenthesis position in the string
-            size_t pos = line.find("(");
-            // If the opening parenthesis is not present, then this is not a
-            // meta-data string
-            if (pos == std::string::npos) {
-                // Reset the state of the file pointer
-                in_.seekg(originalFilePosition);
-                // And return a false value to state that this isn't meta-data
-                return false;
+                return frameNumber;
             }
 
-            //--------------------------------
-            // Get the time meta-data
-            // Move to the first digit of the C-time
-            pos++;
-
-            // Grab and store the real time in the current frame object
-            frame.setTime(atof(extractSubstring(line, pos, ' ').c_str()));
-            // Skip the number of characters necessary to reach the position
-            // of the beginning of the running time string
-            pos += std::string(" s, ").length();
+            CompressedStream stream(file_.begin(), file_.end(), compression_, threads);
+            PipelinedFrameReader<T> reader(stream);
+            reader.setMask(mask_);
+            reader.setRejectedHits(&rejected_);
+            unsigned int const frames = reader.run(onFrame);
 
-            // Extract the running time string
-            frame.setRunningTime(atof(extractSubstring(line, pos, ' ').c_str()));
+            // Everything has been consumed now, and counted on the way
+            isStreamStarted_ = true;
+            isStreamEnded_ = true;
+            numberOfLines_ = reader.numberOfLines();
+            numberOfFrames_ = frames;
+            isScanned_ = true;
 
-            lineNumber_++; // Keep track of the current line number
-
-            return true;
-        } else { // If the file has ended
+            return frames;
+        } catch (std::ifstream::failure const& e) {
 
-            return false;
+            std::cerr << "An error occurred when reading a line from the file!\n"
+                    << e.what() << std::endl;
+            throw; // Re-throw the exception up the stack
         }
     }
 
 
-    bool const parseClusterString(Frame<T>& frame)
+    void resetStream()
     {
-        assert(in_.is_open());
+        // Forgets the decompressed text read so far by getFrame()
+
+        stream_.reset();
+        window_.clear();
+        windowBegin_ = 0;
+        streamLine_ = 1;
+        streamedFrames_ = 0;
+        isStreamStarted_ = false;
+        isStreamEnded_ = false;
+    }
 
-        // Attempts to parse and extract the fields into the frame object's data
-        // fields from a meta-data string of this format - e.g.
-        // '[19, 0, 55]' where x = 19, y = 0, c = 55
-        // Returns false if the string is not a cluster string, and thus resets
-        // the file pointer
 
-        if (!endOfStream()) {
-            // Store the state of the file pointer
-            size_t originalFilePosition = in_.tellg();
+    std::size_t streamedFrameEnd()
+    {
+        // Decompresses until the window holds the whole of the next frame,
+        // returning where it ends in the window (windowBegin_ at the end of
+        // the text); the frame ends where the next frame header starts
 
-            //--------------------------------
-            // Get to the beginning of the parentheses
-            std::string line; //A temporary for lines
+        static const std::size_t BLOCK_SIZE = 4 << 20;
 
-            // Read in a line
-            std::getline(in_, line);
+        if (!isStreamStarted_) {
+            stream_.reset(new CompressedStream(file_.begin(), file_.end(), compression_));
+            isStreamStarted_ = true;
+        }
 
-            // find the opening square bracket position in the string
-            size_t pos = line.find("[");
-            // If the opening parenthesis is not present, then this is not a
-            // cluster data string
-            if (pos == std::string::npos) {
-                // Reset the state of the file pointer
-                in_.seekg(originalFilePosition);
-                // And return a false value to state this isn't cluster data
-                return false;
+        std::size_t searched = windowBegin_ + 1;
+        for (;;) {
+            for (std::size_t pos = searched; pos < window_.size(); ) {
+                char const* newline = static_cast<char const*>(
+                        std::memchr(&window_[pos], '\n', window_.size() - pos));
+                if (!newline) {
+                    break;
+                }
+                pos = newline - &window_[0] + 1;
+                if (window_.size() - pos < 6) {
+                    break;
+                }
+                if (std::memcmp(&window_[pos], "Frame ", 6) == 0) {
+                    return pos;
+                }
+                searched = pos;
+            }
+            if (isStreamEnded_) {
+                return window_.size();
             }
 
-            //--------------------------------
-            // Get the cluster data
-            // Create the data field variables
-            T x = 0;
-            T y = 0;
-            T c = 0;
+            // Drop the frames already parsed and decompress another block
+            window_.erase(window_.begin(), window_.begin() + windowBegin_);
+            searched = searched > windowBegin_ ? searched - windowBegin_ : 1;
+            windowBegin_ = 0;
+
+            std::size_t const used = window_.size();
+            window_.resize(used + BLOCK_SIZE);
+            std::size_t const read = stream_->read(&window_[used], BLOCK_SIZE);
+            window_.resize(used + read);
+            if (read < BLOCK_SIZE) {
+                isStreamEnded_ = true;
+                stream_.reset();
+            }
+        }
+    }
 
-            // Move to the first digit of the x value
-            pos++;
 
-            // Grab and store the x position value
-            x = atoi(extractSubstring(line, pos, ',').c_str());
-            // Skip the number of characters necessary to reach the position
-            // of the beginning of the y value string
-            pos += std::string(", ").length();
+    void parseStreamedFrame(Frame<T>& frame)
+    {
+        // Parses the next frame out of the decompressed window, gathering the
+        // line and frame counts once the text ends
+
+        std::size_t const end = streamedFrameEnd();
+        ClusterLogParser<T> parser(&window_[0] + windowBegin_, &window_[0] + end, streamLine_);
+        parser.setMask(mask_);
+        parser.setRejectedHits(&rejected_);
+        parser.parseFrame(frame);
+        windowBegin_ = parser.position() - &window_[0];
+        streamLine_ = parser.lineNumber();
+        streamedFrames_++;
+
+        if (isStreamEnded_ && windowBegin_ == window_.size()) {
+            numberOfLines_ = streamLine_ - 1;
+            numberOfFrames_ = streamedFrames_;
+            isScanned_ = true;
+        }
+    }
+
 
-            // Grab and store the y position value
-            y = atoi(extractSubstring(line, pos, ',').c_str());
-            // Skip the number of characters necessary to reach the position
-            // of the beginning of the c value string
-            pos += std::string(", ").length();
+    void scan()
+    {
+        // Gathers the file's line and frame counts with a single vectorized
+        // pass over the mapped bytes, which never builds any frames
+
+        if (!isScanned_ && file_.isOpen()) {
+            if (isCompressed()) {
+                scanCompressed();
+                return;
+            }
 
-            // Grab and store the count value
-            c = atoi(extractSubstring(line, pos, ',').c_str());
+            ScanResult result = ByteScanner::scan(file_.begin(), file_.end());
+            numberOfLines_ = result.lines;
+            numberOfFrames_ = result.frames;
+            isScanned_ = true;
+        }
+    }
 
-            // Construct a pixel object with this data and add it to the frame
-            frame.setPixel(
-                    ++currentPixelNumber_,
-                    Pixel<T>(x, y, c)
-                    );
 
+    void scanCompressed()
+    {
+        // Counts the lines and frame headers as the file is decompressed,
+        // scanning whole lines at a time so none is split between two scans
+
+        static const std::size_t BLOCK_SIZE = 4 << 20;
+
+        CompressedStream stream(file_.begin(), file_.end(), compression_,
+                                std::max(std::thread::hardware_concurrency(), 1u));
+        std::vector<char> buffer(BLOCK_SIZE);
+        std::size_t carried = 0;
+        ScanResult total = { 0, 0 };
+        for (;;) {
+            std::size_t const read = stream.read(&buffer[carried], buffer.size() - carried);
+            std::size_t const size = carried + read;
+            if (read == 0) {
+                ScanResult const result = ByteScanner::scan(&buffer[0], &buffer[0] + size);
+                total.lines += result.lines;
+                total.frames += result.frames;
+                break;
+            }
 
-            lineNumber_++;
-            return true;
-        } else { // If the file has ended
+            char const* begin = &buffer[0];
+            char const* last = begin + size;
+            while (last > begin && *(last - 1) != '\n') {
+                last--;
+            }
+            if (last == begin) {
+                // A single line longer than the buffer
+                buffer.resize(buffer.size() * 2);
+                carried = size;
+                continue;
+            }
 
-            return false;
+            ScanResult const result = ByteScanner::scan(begin, last);
+            total.lines += result.lines;
+            total.frames += result.frames;
+            carried = begin + size - last;
+            std::memmove(&buffer[0], last, carried);
         }
+
+        numberOfLines_ = total.lines;
+        numberOfFrames_ = total.frames;
+        isScanned_ = true;
     }
 
-    std::ifstream in_; // The input stream for data
+    MappedFile file_; // The mapped data file
+    std::string path_; // The path of the data file
+    ClusterLogParser<T> parser_; // The parser walking the mapped bytes
+    BinaryCacheReader<T> cache_; // The binary cache, when it is fresh
     std::string detectorName_; // The input's file name
     std::string settings_; // The settings used when generating the data
-    unsigned int currentPixelNumber_; // The number of the next pixel to be stored
-    unsigned int lineNumber_; // The current line number in the file
-    unsigned int numberOfLines_; // The total number of lines in the file
-    unsigned int fileSize_; // The size of the file in bytes
+    unsigned long long numberOfLines_; // The total number of lines in the file
+    unsigned long long numberOfFrames_; // The total number of frames in the file
+    unsigned long long fileSize_; // The size of the file in bytes
+    long long modified_; // The modification time of the file
+    unsigned long long cachedFrame_; // The next frame to read from the cache
+    PixelMask<> const* mask_; // The mask of dropped pixels, or null
+    RejectedHits rejected_; // The tally of hits dropped off the matrix
+    FrameIndex index_; // The byte offsets and times of the frames
+    bool isScanned_; // Whether the line and frame counts have been gathered
+    bool isIndexed_; // Whether the frame index has been built
+    Compression compression_; // The compression of the file
+    std::unique_ptr<CompressedStream> stream_; // The text being decompressed for getFrame()
+    std::vector<char> window_; // The decompressed text not yet parsed by getFrame()
+    std::size_t windowBegin_; // The next byte of the window to parse
+    unsigned int streamLine_; // The line number of the next line to parse from the window
+    unsigned long long streamedFrames_; // The number of frames parsed from the window
+    bool isStreamStarted_; // Whether the compressed text has started being read
+    bool isStreamEnded_; // Whether the compressed text has all been decompressed
 };
 
 
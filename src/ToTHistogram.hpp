@@ -0,0 +1,455 @@
+/**
+ * @file        ToTHistogram.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the per-pixel time-over-threshold (ToT) histograms of
+ * the whole pixel matrix, and the '.lolh' summary file they are saved as
+ * (class is non-copyable)
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef TOTHISTOGRAM_HPP
+#define TOTHISTOGRAM_HPP
+
+// C++ headers
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <cassert>
+// My headers
+#include <Span.hpp>
+#include <AlignedBuffer.hpp>
+#include <DetectorGeometry.hpp>
+
+// The width and height of the pixel matrix
+static const unsigned int MATRIX_WIDTH = TimepixGeometry::WIDTH;
+// The number of pixels in the matrix, as indexed by Pixel::xy()
+static const unsigned int MATRIX_PIXELS = TimepixGeometry::PIXELS;
+
+
+/**
+ * @brief The running totals of one pixel's ToT values, from which its mean
+ * and spread are taken without going through its histogram
+ */
+struct PixelMoments {
+    std::uint64_t hits; // The number of hits on the pixel
+    std::uint64_t sum; // The sum of the hits' ToT values
+    std::uint64_t sumOfSquares; // The sum of the squares of the ToT values
+    std::uint64_t reserved; // Padding to keep two pixels per cache line, always 0
+};
+
+
+/**
+ * @brief The header at the start of a '.lolh' summary file <br>
+ * The file holds, in native byte order: <br>
+ * (1) this header <br>
+ * (2) the histograms: MATRIX_PIXELS * bins counts (uint32), one pixel's bins
+ * after another in Pixel::xy() order <br>
+ * (3) the moments: MATRIX_PIXELS PixelMoments in Pixel::xy() order
+ */
+struct HistogramHeader {
+    char magic[4]; // Always "LOLH"
+    std::uint32_t byteOrder; // Always HISTOGRAM_BYTE_ORDER, written in native order
+    std::uint32_t version; // The version of the layout, HISTOGRAM_VERSION
+    std::uint32_t pixels; // The number of pixels, always MATRIX_PIXELS
+    std::uint32_t bins; // The number of bins per pixel
+    std::uint32_t binWidth; // The ToT range covered by each bin
+    std::uint64_t sourceSize; // The size of the cluster log the histograms came from
+    std::int64_t sourceModified; // The modification time of the cluster log
+    std::uint64_t numberOfFrames; // The number of frames histogrammed
+    std::uint64_t rejectedHits; // The number of hits outside the matrix
+};
+
+// The byte order marker, which reads differently on a foreign-endian machine
+static const std::uint32_t HISTOGRAM_BYTE_ORDER = 0x01020304u;
+// The current version of the summary layout
+static const std::uint32_t HISTOGRAM_VERSION = 1;
+// The suffix appended to the cluster log's path to name its summary
+static const char HISTOGRAM_SUFFIX[] = ".lolh";
+
+
+/**
+ * @brief            Retrieves the path of the histogram summary of a cluster log
+ * @param sourcePath The path of the cluster log
+ * @return           The path of its summary
+ */
+inline std::string const histogramPath(std::string const& sourcePath)
+{
+    return sourcePath + HISTOGRAM_SUFFIX;
+}
+
+
+/**
+ * @brief This class holds a ToT histogram for every pixel of the matrix in one
+ * flat, cache line aligned array (each pixel's bins side by side), along with
+ * each pixel's running moments <br>
+ * ToT values past the last bin are counted in the last bin, but still count
+ * at their true value towards the moments (class is non-copyable)
+ */
+class ToTHistogram {
+public:
+
+    /**
+     * @brief          A constructor for the ToTHistogram class
+     * @param bins     The number of bins per pixel
+     * @param binWidth The ToT range covered by each bin
+     * @return         A newly constructed, empty ToTHistogram object
+     */
+    explicit ToTHistogram(unsigned int const bins = 128, unsigned int const binWidth = 2)
+        : bins_(bins ? bins : 1), binWidth_(binWidth ? binWidth : 1),
+        counts_(static_cast<std::size_t>(MATRIX_PIXELS) * (bins ? bins : 1)),
+        moments_(MATRIX_PIXELS), frames_(0), rejected_(0), sourceSize_(0), sourceModified_(0)
+    {
+    }
+
+
+    /**
+     * @brief   The destructor for the ToTHistogram class
+     * @return  Nothing
+     */
+    ~ToTHistogram()
+    {
+    }
+
+
+    /**
+     * @brief       Counts a hit
+     * @param pixel The index of the pixel hit, as given by Pixel::xy()
+     * @param tot   The ToT value of the hit
+     * @return      Nothing
+     */
+    void fill(unsigned int const pixel, unsigned int const tot)
+    {
+        assert(pixel < MATRIX_PIXELS);
+
+        unsigned int bin = tot / binWidth_;
+        if (bin >= bins_) {
+            bin = bins_ - 1;
+        }
+        counts_[static_cast<std::size_t>(pixel) * bins_ + bin]++;
+
+        PixelMoments& moments = moments_[pixel];
+        moments.hits++;
+        moments.sum += tot;
+        moments.sumOfSquares += static_cast<std::uint64_t>(tot) * tot;
+    }
+
+
+    /**
+     * @brief        Counts frames towards the total histogrammed
+     * @param frames The number of frames
+     * @return       Nothing
+     */
+    void addFrames(unsigned long long const frames)
+    {
+        frames_ += frames;
+    }
+
+
+    /**
+     * @brief        Counts hits which fell outside the matrix
+     * @param hits   The number of hits
+     * @return       Nothing
+     */
+    void addRejected(unsigned long long const hits)
+    {
+        rejected_ += hits;
+    }
+
+
+    /**
+     * @brief       Adds another set of histograms with the same binning to
+     * this one
+     * @param other The histograms to add
+     * @return      Nothing
+     */
+    void merge(ToTHistogram const& other)
+    {
+        assert(other.bins_ == bins_ && other.binWidth_ == binWidth_);
+
+        std::uint32_t* counts = counts_.data();
+        std::uint32_t const* otherCounts = other.counts_.data();
+        std::size_t const size = counts_.size();
+        for (std::size_t i = 0; i < size; ++i) {
+            counts[i] += otherCounts[i];
+        }
+
+        for (unsigned int i = 0; i < MATRIX_PIXELS; ++i) {
+            moments_[i].hits += other.moments_[i].hits;
+            moments_[i].sum += other.moments_[i].sum;
+            moments_[i].sumOfSquares += other.moments_[i].sumOfSquares;
+        }
+
+        frames_ += other.frames_;
+        rejected_ += other.rejected_;
+    }
+
+
+    /**
+     * @brief   Empties every histogram
+     * @return  Nothing
+     */
+    void clear()
+    {
+        counts_.clear();
+        moments_.clear();
+        frames_ = 0;
+        rejected_ = 0;
+    }
+
+
+    /**
+     * @brief       Retrieves the histogram of a pixel
+     * @param pixel The index of the pixel, as given by Pixel::xy()
+     * @return      A view of the pixel's bins
+     */
+    Span<std::uint32_t const> counts(unsigned int const pixel) const
+    {
+        assert(pixel < MATRIX_PIXELS);
+
+        return Span<std::uint32_t const>(counts_.data() + static_cast<std::size_t>(pixel) * bins_, bins_);
+    }
+
+
+    /**
+     * @brief       Retrieves the number of hits on a pixel
+     * @param pixel The index of the pixel, as given by Pixel::xy()
+     * @return      The number of hits
+     */
+    unsigned long long hits(unsigned int const pixel) const
+    {
+        return moments_[pixel].hits;
+    }
+
+
+    /**
+     * @brief       Retrieves the mean ToT of a pixel's hits
+     * @param pixel The index of the pixel, as given by Pixel::xy()
+     * @return      The mean ToT, or 0 if the pixel was never hit
+     */
+    double mean(unsigned int const pixel) const
+    {
+        PixelMoments const& moments = moments_[pixel];
+
+        return moments.hits ? static_cast<double>(moments.sum) / moments.hits : 0.0;
+    }
+
+
+    /**
+     * @brief       Retrieves the standard deviation of a pixel's ToT values
+     * @param pixel The index of the pixel, as given by Pixel::xy()
+     * @return      The standard deviation, or 0 if the pixel was never hit
+     */
+    double standardDeviation(unsigned int const pixel) const
+    {
+        PixelMoments const& moments = moments_[pixel];
+        if (!moments.hits) {
+            return 0.0;
+        }
+
+        double const mean = static_cast<double>(moments.sum) / moments.hits;
+        double const variance = static_cast<double>(moments.sumOfSquares) / moments.hits - mean * mean;
+
+        return variance > 0.0 ? std::sqrt(variance) : 0.0;
+    }
+
+
+    /**
+     * @brief   Retrieves the number of bins per pixel
+     * @return  The number of bins
+     */
+    unsigned int bins() const
+    {
+        return bins_;
+    }
+
+
+    /**
+     * @brief   Retrieves the ToT range covered by each bin
+     * @return  The bin width
+     */
+    unsigned int binWidth() const
+    {
+        return binWidth_;
+    }
+
+
+    /**
+     * @brief   Retrieves the number of frames histogrammed
+     * @return  The number of frames
+     */
+    unsigned long long numberOfFrames() const
+    {
+        return frames_;
+    }
+
+
+    /**
+     * @brief   Retrieves the number of hits counted over the whole matrix
+     * @return  The number of hits
+     */
+    unsigned long long numberOfHits() const
+    {
+        unsigned long long hits = 0;
+        for (unsigned int i = 0; i < MATRIX_PIXELS; ++i) {
+            hits += moments_[i].hits;
+        }
+
+        return hits;
+    }
+
+
+    /**
+     * @brief   Retrieves the number of pixels hit at least once
+     * @return  The number of pixels
+     */
+    unsigned int numberOfPixelsHit() const
+    {
+        unsigned int pixels = 0;
+        for (unsigned int i = 0; i < MATRIX_PIXELS; ++i) {
+            if (moments_[i].hits) {
+                pixels++;
+            }
+        }
+
+        return pixels;
+    }
+
+
+    /**
+     * @brief   Retrieves the number of hits which fell outside the matrix
+     * @return  The number of hits
+     */
+    unsigned long long rejectedHits() const
+    {
+        return rejected_;
+    }
+
+
+    /**
+     * @brief   Retrieves the size of the cluster log the loaded summary came
+     * from (0 unless loaded)
+     * @return  The size in bytes
+     */
+    unsigned long long sourceSize() const
+    {
+        return sourceSize_;
+    }
+
+
+    /**
+     * @brief   Retrieves the modification time of the cluster log the loaded
+     * summary came from (0 unless loaded)
+     * @return  The modification time
+     */
+    long long sourceModified() const
+    {
+        return sourceModified_;
+    }
+
+
+    /**
+     * @brief                Saves the histograms as a '.lolh' summary file
+     * @param path           The path of the summary file
+     * @param sourceSize     The size of the cluster log histogrammed
+     * @param sourceModified The modification time of the cluster log
+     * @return               Nothing, throws std::ifstream::failure if the
+     * summary can't be written
+     */
+    void save(std::string const& path,
+              unsigned long long const sourceSize,
+              long long const sourceModified)
+    {
+        HistogramHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "LOLH", 4);
+        header.byteOrder = HISTOGRAM_BYTE_ORDER;
+        header.version = HISTOGRAM_VERSION;
+        header.pixels = MATRIX_PIXELS;
+        header.bins = bins_;
+        header.binWidth = binWidth_;
+        header.sourceSize = sourceSize;
+        header.sourceModified = sourceModified;
+        header.numberOfFrames = frames_;
+        header.rejectedHits = rejected_;
+
+        try {
+            std::ofstream out;
+            out.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            out.open(path.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+            out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+            out.write(reinterpret_cast<char const*>(counts_.data()), counts_.size() * sizeof(std::uint32_t));
+            out.write(reinterpret_cast<char const*>(moments_.data()), moments_.size() * sizeof(PixelMoments));
+            out.close();
+        } catch (std::ofstream::failure const&) {
+            throw std::ifstream::failure("Could not write the histogram summary: " + path);
+        }
+
+        sourceSize_ = sourceSize;
+        sourceModified_ = sourceModified;
+    }
+
+
+    /**
+     * @brief      Replaces the histograms with those of a '.lolh' summary file
+     * @param path The path of the summary file
+     * @return     Nothing, throws std::ifstream::failure if the summary can't
+     * be read or isn't a valid summary
+     */
+    void load(std::string const& path)
+    {
+        std::ifstream in(path.c_str(), std::ifstream::in | std::ifstream::binary);
+        HistogramHeader header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+                || std::memcmp(header.magic, "LOLH", 4) != 0
+                || header.byteOrder != HISTOGRAM_BYTE_ORDER
+                || header.version != HISTOGRAM_VERSION
+                || header.pixels != MATRIX_PIXELS
+                || header.bins == 0 || header.binWidth == 0) {
+            throw std::ifstream::failure("Invalid histogram summary: " + path);
+        }
+
+        bins_ = header.bins;
+        binWidth_ = header.binWidth;
+        counts_.resize(static_cast<std::size_t>(MATRIX_PIXELS) * bins_);
+        moments_.clear();
+        if (!in.read(reinterpret_cast<char*>(counts_.data()), counts_.size() * sizeof(std::uint32_t))
+                || !in.read(reinterpret_cast<char*>(moments_.data()), moments_.size() * sizeof(PixelMoments))) {
+            throw std::ifstream::failure("Truncated histogram summary: " + path);
+        }
+
+        frames_ = header.numberOfFrames;
+        rejected_ = header.rejectedHits;
+        sourceSize_ = header.sourceSize;
+        sourceModified_ = header.sourceModified;
+    }
+
+private:
+
+    // Non-copyable
+    // Copy constructor
+    ToTHistogram(ToTHistogram const& other);
+
+
+    // Assignment operator
+    ToTHistogram& operator=(ToTHistogram const& other);
+
+    unsigned int bins_; // The number of bins per pixel
+    unsigned int binWidth_; // The ToT range covered by each bin
+    AlignedBuffer<std::uint32_t> counts_; // Every pixel's bins, pixel after pixel
+    AlignedBuffer<PixelMoments> moments_; // Every pixel's moments
+    unsigned long long frames_; // The number of frames histogrammed
+    unsigned long long rejected_; // The number of hits outside the matrix
+    unsigned long long sourceSize_; // The size of the cluster log the summary came from
+    long long sourceModified_; // The modification time of that cluster log
+};
+
+
+#endif  /* TOTHISTOGRAM_HPP */
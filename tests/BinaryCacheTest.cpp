@@ -0,0 +1,252 @@
+/**
+ * @file        BinaryCacheTest.cpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Checks that frames read back from the binary cache are those
+ * parsed from the text, and that a truncated or corrupted cache is passed over
+ * for the text
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+// C++ headers
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <boost/filesystem.hpp>
+// My headers
+#include <Frame.hpp>
+#include <TextFileReader.hpp>
+#include <BinaryCacheFormat.hpp>
+#include <TestDataset.hpp>
+
+
+/**
+ * @brief A callback checking every frame it sees against the reference frames
+ */
+struct CheckingCallback {
+    std::vector<Frame<int> > const* reference; // Every frame of the file
+    unsigned int* matched; // The number of frames which matched
+
+    void operator()(Frame<int> const& frame, unsigned int const frameNumber) const
+    {
+        if (frameNumber <= reference->size() && isSameFrame(frame, (*reference)[frameNumber - 1])) {
+            (*matched)++;
+        }
+    }
+};
+
+
+/**
+ * @brief           Reads the whole file front to back, a frame at a time
+ * @param path      The path of the cluster log
+ * @param isCached  Set to whether the frames came from the binary cache
+ * @return          Every frame of the file
+ */
+std::vector<Frame<int> > const readFrames(std::string const& path, bool& isCached)
+{
+    TextFileReader<int> input(path);
+    isCached = input.isCached();
+
+    std::vector<Frame<int> > frames;
+    while (!input.endOfStream()) {
+        frames.push_back(input.getFrame());
+    }
+
+    return frames;
+}
+
+
+/**
+ * @brief           Checks that the file reads the same whichever way it is
+ * read
+ * @param path      The path of the cluster log
+ * @param reference Every frame of the file, parsed from the text
+ * @param isCached  Whether the frames should come from the binary cache
+ * @return          Whether every read matched the reference
+ */
+bool readsAsReference(std::string const& path, std::vector<Frame<int> > const& reference,
+                      bool const isCached)
+{
+    bool wasCached = !isCached;
+    std::vector<Frame<int> > const frames = readFrames(path, wasCached);
+    if (wasCached != isCached || frames.size() != reference.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+        if (!isSameFrame(frames[i], reference[i])) {
+            return false;
+        }
+    }
+
+    TextFileReader<int> input(path);
+    if (input.numberOfFrames() != reference.size()) {
+        return false;
+    }
+
+    // Read on several threads, and by seeking
+    unsigned int matched = 0;
+    CheckingCallback callback = { &reference, &matched };
+    if (input.forEachFrame(4, callback) != reference.size() || matched != reference.size()) {
+        return false;
+    }
+    unsigned long long const frameNumbers[] = { 1, reference.size() / 2, reference.size() };
+    for (std::size_t i = 0; i < sizeof(frameNumbers) / sizeof(frameNumbers[0]); ++i) {
+        if (!isSameFrame(input.getFrame(frameNumbers[i]), reference[frameNumbers[i] - 1])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief       Replaces a file's contents
+ * @param path  The path of the file
+ * @param bytes The new contents
+ * @return      Nothing
+ */
+void writeBytes(std::string const& path, std::vector<char> const& bytes)
+{
+    std::ofstream out(path.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    if (!bytes.empty()) {
+        out.write(&bytes[0], bytes.size());
+    }
+}
+
+
+/**
+ * @brief       Reads a native integer out of a byte buffer
+ * @param bytes The buffer
+ * @param at    The byte offset of the integer
+ * @return      The integer
+ */
+template <class U>
+U readAt(std::vector<char> const& bytes, std::size_t const at)
+{
+    U value;
+    std::memcpy(&value, &bytes[at], sizeof(value));
+
+    return value;
+}
+
+
+/**
+ * @brief       Writes a native integer into a byte buffer
+ * @param bytes The buffer
+ * @param at    The byte offset of the integer
+ * @param value The integer
+ * @return      Nothing
+ */
+template <class U>
+void writeAt(std::vector<char>& bytes, std::size_t const at, U const value)
+{
+    std::memcpy(&bytes[at], &value, sizeof(value));
+}
+
+
+/**
+ * @brief       Runs the tests
+ * @param argc  The number of arguments given to the program when run
+ * @param argv  An array of strings which are the arguments given
+ * @return      0 if every test passed, 1 otherwise
+ */
+int main(int argc, char **argv)
+{
+    GeneratorSettings settings;
+    settings.numberOfFrames = 1500;
+    TestDataset dataset(settings);
+
+    int failures = 0;
+
+    // The frames parsed from the text, before there is a cache
+    bool isCached = true;
+    std::vector<Frame<int> > const reference = readFrames(dataset.path(), isCached);
+    if (isCached || reference.size() != settings.numberOfFrames) {
+        std::cerr << "FAILED: reading the text (read " << reference.size() << " frames)\n";
+        return 1;
+    }
+
+    // Writing the cache, then reading it back
+    {
+        TextFileReader<int> input(dataset.path());
+        input.writeCache();
+        if (!input.isCached()) {
+            std::cerr << "FAILED: opening the cache once written\n";
+            failures++;
+        }
+    }
+    if (!readsAsReference(dataset.path(), reference, true)) {
+        std::cerr << "FAILED: reading the frames back from the cache\n";
+        failures++;
+    }
+
+    std::string const path = cachePath(dataset.path());
+    std::vector<char> cache(static_cast<std::size_t>(boost::filesystem::file_size(path)));
+    {
+        std::ifstream in(path.c_str(), std::ifstream::in | std::ifstream::binary);
+        in.read(&cache[0], cache.size());
+    }
+
+    // A cache cut short anywhere, from within the header to its last byte,
+    // is passed over for the text
+    std::size_t const lengths[] = {
+        0, sizeof(CacheHeader) - 1, sizeof(CacheHeader), cache.size() / 2,
+        cache.size() - 8, cache.size() - 1
+    };
+    for (std::size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i) {
+        writeBytes(path, std::vector<char>(cache.begin(), cache.begin() + lengths[i]));
+        if (!readsAsReference(dataset.path(), reference, false)) {
+            std::cerr << "FAILED: passing over a cache cut to " << lengths[i] << " of "
+                      << cache.size() << " bytes\n";
+            failures++;
+        }
+    }
+
+    // A cache of the right length whose records point outside it, or hold
+    // more hits or clusters than fit, is passed over too
+    std::uint64_t const frames = readAt<std::uint64_t>(cache, offsetof(CacheHeader, numberOfFrames));
+    std::uint64_t const indexOffset = readAt<std::uint64_t>(cache, offsetof(CacheHeader, indexOffset));
+    std::size_t const recordOffsets = static_cast<std::size_t>(indexOffset + 3 * 8 * frames);
+    std::size_t const lastRecord = static_cast<std::size_t>(
+            readAt<std::uint64_t>(cache, recordOffsets + 8 * (frames - 1)));
+
+    std::vector<std::vector<char> > corrupted(4, cache);
+    writeAt<std::uint64_t>(corrupted[0], recordOffsets + 8 * (frames - 1), cache.size() - 4);
+    writeAt<std::uint64_t>(corrupted[1], recordOffsets + 8 * (frames / 2), 6);
+    writeAt<std::uint32_t>(corrupted[2], lastRecord, 0x7fffffffu);
+    writeAt<std::uint32_t>(corrupted[3], lastRecord + 4, 0x7fffffffu);
+    char const* const corruptions[] = {
+        "a record past the end", "a record inside the header", "too many hits", "too many clusters"
+    };
+    for (std::size_t i = 0; i < corrupted.size(); ++i) {
+        writeBytes(path, corrupted[i]);
+        if (!readsAsReference(dataset.path(), reference, false)) {
+            std::cerr << "FAILED: passing over a cache with " << corruptions[i] << "\n";
+            failures++;
+        }
+    }
+
+    // The untouched cache is still read
+    writeBytes(path, cache);
+    if (!readsAsReference(dataset.path(), reference, true)) {
+        std::cerr << "FAILED: reading the restored cache\n";
+        failures++;
+    }
+
+    if (failures) {
+        return 1;
+    }
+    std::cout << "All binary cache tests passed\n";
+
+    return 0;
+}
@@ -0,0 +1,213 @@
+/**
+ * @file        ClusterTokenizerTest.cpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Checks that every triple of a cluster line is decoded, whatever
+ * its length and alignment, and that each line's pixels make up one cluster of
+ * the parsed frame
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+// C++ headers
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+// My headers
+#include <Frame.hpp>
+#include <ClusterTokenizer.hpp>
+#include <ClusterLogParser.hpp>
+
+// The separators a cluster line may be written with, the first as the
+// detector's software writes them
+static char const* const SEPARATORS[][3] = {
+    { "[", ", ", "] " },
+    { "[", ",", "]" },
+    { "[ ", " ,  ", " ]  " },
+    { "[", ",\t", "]\t" }
+};
+
+
+/**
+ * @brief A pixel as it is written in a cluster line
+ */
+struct Triple {
+    int x; // The column
+    int y; // The row
+    int c; // The ToT
+};
+
+
+/**
+ * @brief           Writes the triples as a cluster line
+ * @param triples   The triples
+ * @param separator The separators to write them with
+ * @return          The line, without its newline
+ */
+std::string const writeLine(std::vector<Triple> const& triples, std::size_t const separator)
+{
+    std::ostringstream line;
+    for (std::size_t i = 0; i < triples.size(); ++i) {
+        line << SEPARATORS[separator][0] << triples[i].x << SEPARATORS[separator][1]
+             << triples[i].y << SEPARATORS[separator][1] << triples[i].c
+             << SEPARATORS[separator][2];
+    }
+
+    return line.str();
+}
+
+
+/**
+ * @brief         Checks that a range of the frame's pixels holds the triples
+ * @param frame   The frame
+ * @param first   The first pixel of the range
+ * @param triples The triples expected there, in order
+ * @return        Whether every pixel matches its triple
+ */
+bool holdsTriples(Frame<int> const& frame, std::size_t const first, std::vector<Triple> const& triples)
+{
+    for (std::size_t i = 0; i < triples.size(); ++i) {
+        if (frame.x(first + i) != triples[i].x || frame.y(first + i) != triples[i].y
+                || frame.c(first + i) != triples[i].c) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief       Draws the triples of a cluster, with coordinates and ToTs of
+ * every number of digits
+ * @param size  The number of triples
+ * @param rng   The random number generator
+ * @return      The triples
+ */
+std::vector<Triple> const drawCluster(std::size_t const size, std::mt19937& rng)
+{
+    // The largest ToT of each number of digits, up to the 14 bits a hit holds
+    static int const LIMITS[] = { 0, 9, 99, 999, 9999, 16383 };
+
+    std::uniform_int_distribution<int> coordinate(0, 255);
+    std::uniform_int_distribution<int> digits(1, 5);
+    std::vector<Triple> triples(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        triples[i].x = coordinate(rng);
+        triples[i].y = coordinate(rng);
+        triples[i].c = std::uniform_int_distribution<int>(0, LIMITS[digits(rng)])(rng);
+    }
+
+    return triples;
+}
+
+
+/**
+ * @brief       Runs the tests
+ * @param argc  The number of arguments given to the program when run
+ * @param argv  An array of strings which are the arguments given
+ * @return      0 if every test passed, 1 otherwise
+ */
+int main(int argc, char **argv)
+{
+    int failures = 0;
+    std::mt19937 rng(5);
+
+    // Lines of up to 40 triples, so they run past several vector registers,
+    // decoded from every alignment within a register
+    for (std::size_t size = 1; size <= 40; ++size) {
+        for (std::size_t separator = 0; separator < sizeof(SEPARATORS) / sizeof(SEPARATORS[0]); ++separator) {
+            std::vector<Triple> const triples = drawCluster(size, rng);
+            std::string const line = writeLine(triples, separator);
+
+            for (std::size_t alignment = 0; alignment < 32; ++alignment) {
+                std::vector<char> buffer(alignment + line.size());
+                line.copy(&buffer[alignment], line.size());
+                char const* begin = &buffer[alignment];
+
+                Frame<int> frame;
+                frame.beginCluster();
+                std::size_t rejected = 0;
+                std::size_t const pixels = ClusterTokenizer<int>::decode(
+                        begin, begin + line.size(), frame, rejected);
+                if (pixels != size || rejected != 0 || frame.size() != size
+                        || frame.numberOfClusters() != 1 || !holdsTriples(frame, 0, triples)) {
+                    std::cerr << "FAILED: decoding '" << line << "' at alignment "
+                              << alignment << "\n";
+                    failures++;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Triples off the matrix are counted rather than added, and the rest of
+    // the line is still decoded
+    {
+        std::string const line = "[12, 40, 7] [256, 3, 9] [13, 40, 100] [0, 300, 1] [14, 41, 2] ";
+        Frame<int> frame;
+        frame.beginCluster();
+        std::size_t rejected = 0;
+        std::size_t const pixels = ClusterTokenizer<int>::decode(
+                line.data(), line.data() + line.size(), frame, rejected);
+        Triple const kept[] = { { 12, 40, 7 }, { 13, 40, 100 }, { 14, 41, 2 } };
+        if (pixels != 3 || rejected != 2
+                || !holdsTriples(frame, 0, std::vector<Triple>(kept, kept + 3))) {
+            std::cerr << "FAILED: decoding a line with pixels off the matrix\n";
+            failures++;
+        }
+    }
+
+    // Frames of several clusters, each line becoming its own cluster in the
+    // order it was written
+    std::string log;
+    std::vector<std::vector<std::vector<Triple> > > frames(3);
+    for (std::size_t f = 0; f < frames.size(); ++f) {
+        std::ostringstream header;
+        header.precision(15);
+        header << "Frame " << (f + 1) << " (" << (1335967757.25 + f) << " s, 0.1 s)\n";
+        log += header.str();
+        for (std::size_t i = 0; i < 4 + f * 3; ++i) {
+            frames[f].push_back(drawCluster(1 + rng() % 12, rng));
+            log += writeLine(frames[f].back(), 0) + "\n";
+        }
+        log += "\n";
+    }
+
+    ClusterLogParser<int> parser(log.data(), log.data() + log.size());
+    for (std::size_t f = 0; f < frames.size(); ++f) {
+        Frame<int> frame;
+        parser.parseFrame(frame);
+
+        bool isSame = frame.getTime() == 1335967757.25 + f && frame.getRunningTime() == 0.1
+            && frame.numberOfClusters() == frames[f].size();
+        std::size_t first = 0;
+        for (std::size_t i = 0; isSame && i < frames[f].size(); ++i) {
+            isSame = frame.clusterBegin(i) == first
+                && frame.clusterEnd(i) == first + frames[f][i].size()
+                && holdsTriples(frame, first, frames[f][i]);
+            first += frames[f][i].size();
+        }
+        if (!isSame || frame.size() != first) {
+            std::cerr << "FAILED: parsing the clusters of frame " << (f + 1) << "\n";
+            failures++;
+        }
+    }
+    if (!parser.atEnd()) {
+        std::cerr << "FAILED: parsing every frame of the log\n";
+        failures++;
+    }
+
+    if (failures) {
+        return 1;
+    }
+    std::cout << "All cluster tokenizer tests passed\n";
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+/**
+ * @file        FastNumberTest.cpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Checks that decimals are parsed to the nearest double, and that
+ * epoch timestamps survive being written out and parsed back
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+// C++ headers
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+// My headers
+#include <FastNumber.hpp>
+
+
+/**
+ * @brief      Parses a whole string as a decimal, checking it against the C
+ * library's correctly rounded conversion
+ * @param text The text of the number
+ * @return     Whether the whole text was parsed to the same double
+ */
+bool parsesExactly(std::string const& text)
+{
+    char const* pos = text.c_str();
+    char const* end = pos + text.size();
+    double value = 0.0;
+    if (!FastNumber::parseDecimal(pos, end, value) || pos != end) {
+        return false;
+    }
+
+    return value == std::strtod(text.c_str(), 0);
+}
+
+
+/**
+ * @brief          Writes a time out with a number of decimals, checking it is
+ * written as the C library would, and parses it back
+ * @param time     The time
+ * @param decimals The number of decimals to write
+ * @return         Whether the time was written as the C library would, parsed
+ * back to the double nearest the text, and written again as the same text
+ */
+bool roundTrips(double const time, unsigned int const decimals)
+{
+    char buffer[32];
+    std::string const text(buffer, FastNumber::formatFixed(buffer, time, decimals));
+
+    char expected[64];
+    std::snprintf(expected, sizeof(expected), "%.*f", static_cast<int>(decimals), time);
+    if (text != expected || !parsesExactly(text)) {
+        return false;
+    }
+
+    double parsed = 0.0;
+    char const* pos = text.c_str();
+    FastNumber::parseDecimal(pos, pos + text.size(), parsed);
+
+    return std::string(buffer, FastNumber::formatFixed(buffer, parsed, decimals)) == text;
+}
+
+
+/**
+ * @brief       Runs the tests
+ * @param argc  The number of arguments given to the program when run
+ * @param argv  An array of strings which are the arguments given
+ * @return      0 if every test passed, 1 otherwise
+ */
+int main(int argc, char **argv)
+{
+    int failures = 0;
+
+    // Numbers taking every route through the conversion: short mantissas,
+    // the 17 digits of a logged timestamp, halfway points between doubles,
+    // digits beyond the mantissa, and exponents beyond the exact powers
+    char const* const numbers[] = {
+        "0", "-0", "1", "0.1", "0.14", "-2.5", "+7", ".5", "5.", "1e22", "1e23", "1e-30",
+        "1335967757.2905033", "1335967757.0", "0.1000000", "1343225139.8906524",
+        "9007199254740993", "9007199254740995", "90071992547409930e-1",
+        "9007199254740993.0000001", "4503599627370497.5",
+        "123456789012345678901234567890", "1335967757.29050330000000000001",
+        "2.2250738585072011e-308", "1.7976931348623157e308", "1e-400"
+    };
+    for (std::size_t i = 0; i < sizeof(numbers) / sizeof(numbers[0]); ++i) {
+        if (!parsesExactly(numbers[i])) {
+            std::cerr << "FAILED: parsing " << numbers[i] << "\n";
+            failures++;
+        }
+    }
+
+    // Text which isn't a number leaves the position where it was
+    char const* const notNumbers[] = { "", "-", ".", "s", "(1" };
+    for (std::size_t i = 0; i < sizeof(notNumbers) / sizeof(notNumbers[0]); ++i) {
+        char const* pos = notNumbers[i];
+        double value = 42.0;
+        if (FastNumber::parseDecimal(pos, pos + std::strlen(pos), value)
+                || pos != notNumbers[i] || value != 42.0) {
+            std::cerr << "FAILED: parsing '" << notNumbers[i] << "' as no number\n";
+            failures++;
+        }
+    }
+
+    // The timestamps of a day of frames taken 0.14 s apart, as logged (to 7
+    // decimals) and as exported at every other precision
+    double const startTime = 1335967757.2905033;
+    unsigned int numberOfMismatches = 0;
+    for (unsigned int frame = 0; frame < 600000; ++frame) {
+        double const time = startTime + frame * 0.14;
+        unsigned int const decimals = (frame % 2) ? 7 : frame % 10;
+        if (!roundTrips(time, decimals)) {
+            if (numberOfMismatches++ < 5) {
+                char expected[64];
+                std::snprintf(expected, sizeof(expected), "%.17g", time);
+                std::cerr << "FAILED: writing and parsing back " << expected << " to "
+                          << decimals << " decimals\n";
+            }
+        }
+
+        // The 17 digits of the time, which no double holds exactly
+        char text[64];
+        std::snprintf(text, sizeof(text), "%.7f", time + 0.00000003 * (frame % 7));
+        if (!parsesExactly(text) && numberOfMismatches++ < 5) {
+            std::cerr << "FAILED: parsing " << text << "\n";
+        }
+    }
+    if (numberOfMismatches) {
+        std::cerr << "FAILED: " << numberOfMismatches << " timestamps didn't round trip\n";
+        failures++;
+    }
+
+    if (failures) {
+        return 1;
+    }
+    std::cout << "All fast number tests passed\n";
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+/**
+ * @file        FrameRangeTest.cpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Checks that frames are found by their number and by their time,
+ * and that a range of frames streamed into a frame store keeps their numbers
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+// C++ headers
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <memory>
+// My headers
+#include <Frame.hpp>
+#include <TextFileReader.hpp>
+#include <FramePipeline.hpp>
+#include <FrameStore.hpp>
+#include <TestDataset.hpp>
+
+
+/**
+ * @brief           Streams a range of frames into a frame store, and checks
+ * it holds exactly those frames under their numbers in the file
+ * @param path      The path of the cluster log
+ * @param range     The range of frames to stream
+ * @param threads   The number of threads to parse with
+ * @param reference Every frame of the file, read front to back
+ * @return          Whether the store held the expected frames
+ */
+bool storeRange(std::string const& path, FrameRange const& range, unsigned int const threads,
+                std::vector<Frame<int> > const& reference)
+{
+    TextFileReader<int> input(path);
+    std::shared_ptr<FrameStore<int> > store(new FrameStore<int>());
+    FramePipeline<int> pipeline;
+    pipeline.addConsumer(store);
+    pipeline.setRange(range);
+
+    unsigned long long const last = std::min<unsigned long long>(range.last, reference.size() + 1);
+    unsigned long long const streamed = pipeline.run(input, threads);
+    if (streamed != last - range.first || store->size() != streamed
+        || store->firstFrameNumber() != range.first || store->lastFrameNumber() != last - 1) {
+        return false;
+    }
+    for (unsigned int n = store->firstFrameNumber(); n <= store->lastFrameNumber(); ++n) {
+        if (!isSameFrame(store->frame(n), reference[n - 1])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief       Runs the tests
+ * @param argc  The number of arguments given to the program when run
+ * @param argv  An array of strings which are the arguments given
+ * @return      0 if every test passed, 1 otherwise
+ */
+int main(int argc, char **argv)
+{
+    GeneratorSettings settings;
+    settings.numberOfFrames = 2000;
+    TestDataset dataset(settings);
+
+    int failures = 0;
+
+    // Every frame, read front to back, to compare the seeks against
+    std::vector<Frame<int> > reference;
+    {
+        TextFileReader<int> input(dataset.path());
+        while (!input.endOfStream()) {
+            reference.push_back(input.getFrame());
+        }
+    }
+    if (reference.size() != settings.numberOfFrames) {
+        std::cerr << "FAILED: reading the whole file (read " << reference.size() << " frames)\n";
+        return 1;
+    }
+
+    // Seeking straight to a frame by its number
+    TextFileReader<int> input(dataset.path());
+    unsigned long long const frameNumbers[] = { 1, 2, 3, 999, 1000, 1999, 2000 };
+    for (std::size_t i = 0; i < sizeof(frameNumbers) / sizeof(frameNumbers[0]); ++i) {
+        if (!isSameFrame(input.getFrame(frameNumbers[i]), reference[frameNumbers[i] - 1])) {
+            std::cerr << "FAILED: seeking to frame " << frameNumbers[i] << "\n";
+            failures++;
+        }
+    }
+
+    // There are no frames before the first or after the last
+    unsigned long long const missingNumbers[] = { 0, 2001 };
+    for (std::size_t i = 0; i < sizeof(missingNumbers) / sizeof(missingNumbers[0]); ++i) {
+        try {
+            input.getFrame(missingNumbers[i]);
+            std::cerr << "FAILED: seeking to missing frame " << missingNumbers[i] << "\n";
+            failures++;
+        } catch (std::ifstream::failure const&) {
+        }
+    }
+
+    // Seeking by time, with frame n taken at startTime + (n - 1) * framePeriod
+    FrameRange const inTime = input.framesInTimeRange(settings.startTime + 0.27, settings.startTime + 0.65);
+    if (inTime.first != 3 || inTime.last != 6) {
+        std::cerr << "FAILED: seeking by time (found frames " << inTime.first << " to "
+                  << inTime.last << ")\n";
+        failures++;
+    }
+    FrameRange const beforeStart = input.framesInTimeRange(settings.startTime - 10.0, settings.startTime - 5.0);
+    if (beforeStart.first != beforeStart.last) {
+        std::cerr << "FAILED: seeking by time before the first frame\n";
+        failures++;
+    }
+
+    // Ranges streamed into a store, starting at the first frame, in the
+    // middle of the file, and running past its end
+    FrameRange const ranges[] = { { 3, 6 }, { 1, 4 }, { 1500, 1750 }, { 1990, 2100 } };
+    unsigned int const threads[] = { 1, 4 };
+    for (std::size_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); ++i) {
+        for (std::size_t j = 0; j < sizeof(threads) / sizeof(threads[0]); ++j) {
+            if (!storeRange(dataset.path(), ranges[i], threads[j], reference)) {
+                std::cerr << "FAILED: storing frames " << ranges[i].first << " to "
+                          << ranges[i].last << " with " << threads[j] << " threads\n";
+                failures++;
+            }
+        }
+    }
+
+    if (failures) {
+        return 1;
+    }
+    std::cout << "All frame range tests passed\n";
+
+    return 0;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file        ParallelFrameParserTest.cpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Checks that the parallel frame parser hands every frame over in
+ * order, and stops its workers cleanly when the callback throws
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+// C++ headers
+#include <iostream>
+#include <fstream>
+#include <string>
+// My headers
+#include <Frame.hpp>
+#include <ParallelFrameParser.hpp>
+#include <ClusterLogGenerator.hpp>
+
+// The number of threads to parse with, enough to run several workers at once
+static const unsigned int THREADS = 4;
+
+
+/**
+ * @brief A callback counting the frames it sees, checking they arrive in
+ * order, and throwing at a given frame
+ */
+struct ThrowingCallback {
+    unsigned int throwAt; // The frame to throw at, or 0 for never
+    unsigned int* seen; // The number of frames seen
+    bool* isOrdered; // Whether every frame arrived in order
+
+    void operator()(Frame<int> const& frame, unsigned int const frameNumber) const
+    {
+        if (frameNumber != *seen + 1) {
+            *isOrdered = false;
+        }
+        *seen = frameNumber;
+        if (frameNumber == throwAt) {
+            throw std::ifstream::failure("Thrown by the callback");
+        }
+    }
+};
+
+
+/**
+ * @brief         Parses the log, throwing from the callback at a given frame
+ * @param log     The text of the cluster log
+ * @param throwAt The frame to throw at, or 0 for never
+ * @param seen    Set to the number of frames the callback saw
+ * @return        Whether the callback's exception (if any) reached the caller
+ * and every frame arrived in order
+ */
+bool parseThrowingAt(std::string const& log, unsigned int const throwAt, unsigned int& seen)
+{
+    bool isOrdered = true;
+    seen = 0;
+    ThrowingCallback callback = { throwAt, &seen, &isOrdered };
+
+    ParallelFrameParser<int> parser(log.data(), log.data() + log.size(), THREADS);
+    try {
+        parser.parse(callback);
+    } catch (std::ifstream::failure const&) {
+        return throwAt != 0 && seen == throwAt && isOrdered;
+    }
+
+    return throwAt == 0 && isOrdered;
+}
+
+
+/**
+ * @brief       Runs the tests
+ * @param argc  The number of arguments given to the program when run
+ * @param argv  An array of strings which are the arguments given
+ * @return      0 if every test passed, 1 otherwise
+ */
+int main(int argc, char **argv)
+{
+    // A few megabytes of log, so it is split into chunks for every worker
+    GeneratorSettings settings;
+    settings.numberOfFrames = 5000;
+    ClusterLogGenerator<> generator(settings);
+    std::string const log = generator.generate();
+
+    int failures = 0;
+    unsigned int seen = 0;
+
+    // Throwing from the first chunk, with the workers still running ahead,
+    // from the middle of the file, and from the very last frame
+    unsigned int const throwAts[] = { 1, 100, 2500, 5000 };
+    for (std::size_t i = 0; i < sizeof(throwAts) / sizeof(throwAts[0]); ++i) {
+        if (!parseThrowingAt(log, throwAts[i], seen)) {
+            std::cerr << "FAILED: throwing at frame " << throwAts[i]
+                      << " (saw " << seen << " frames)\n";
+            failures++;
+        }
+    }
+
+    // The parser still reads the whole file when nothing throws
+    if (!parseThrowingAt(log, 0, seen) || seen != settings.numberOfFrames) {
+        std::cerr << "FAILED: parsing without throwing (saw " << seen << " frames)\n";
+        failures++;
+    }
+
+    if (failures) {
+        return 1;
+    }
+    std::cout << "All parallel frame parser tests passed\n";
+
+    return 0;
+}
@@ -0,0 +1,178 @@
+/**
+ * @file        PipelinedFrameReaderTest.cpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Checks that the pipelined frame reader hands every frame over in
+ * order, and stops with the parser's error (rather than hanging) when a frame
+ * is malformed, even when it is the last frame of the file
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+// C++ headers
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <boost/filesystem.hpp>
+// My headers
+#include <Frame.hpp>
+#include <PipelinedFrameReader.hpp>
+#include <ClusterLogGenerator.hpp>
+
+// The seconds any one run may take before the reader counts as hung
+static const int TIMEOUT = 60;
+
+// A frame whose header has lost its times, which the parser rejects
+static const char MALFORMED_FRAME[] = "Frame 0 1335967757.0 s, 0.1 s\n[1, 2, 3] \n\n";
+
+
+/**
+ * @brief A callback counting the frames it sees and checking they arrive in
+ * order
+ */
+struct CountingCallback {
+    unsigned int* seen; // The number of frames seen
+    bool* isOrdered; // Whether every frame arrived in order
+
+    void operator()(Frame<int> const& frame, unsigned int const frameNumber) const
+    {
+        if (frameNumber != *seen + 1) {
+            *isOrdered = false;
+        }
+        *seen = frameNumber;
+    }
+};
+
+
+/**
+ * @brief            Reads a log with the pipeline, giving up on the whole
+ * program if the run doesn't finish in time
+ * @param path       The path of the cluster log
+ * @param bufferSize The size of each read buffer in bytes
+ * @param seen       Set to the number of frames the callback saw
+ * @return           Whether the reader threw the parser's error
+ */
+bool readLog(std::string const& path, std::size_t const bufferSize, unsigned int& seen)
+{
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool isFinished = false;
+    bool isThrown = false;
+    bool isOrdered = true;
+    seen = 0;
+
+    std::thread run([&]() {
+        CountingCallback callback = { &seen, &isOrdered };
+        try {
+            PipelinedFrameReader<int> reader(path, 0, bufferSize, 2);
+            reader.run(callback);
+        } catch (std::ifstream::failure const&) {
+            isThrown = true;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        isFinished = true;
+        finished.notify_one();
+    });
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!finished.wait_for(lock, std::chrono::seconds(TIMEOUT), [&]() { return isFinished; })) {
+            std::cerr << "FAILED: reading '" << path << "' with " << bufferSize
+                      << " byte buffers hung\n";
+            std::_Exit(1);
+        }
+    }
+    run.join();
+
+    if (!isOrdered) {
+        seen = 0;
+    }
+
+    return isThrown;
+}
+
+
+/**
+ * @brief      Writes a log to a file
+ * @param path The path of the file
+ * @param log  The text of the log
+ * @return     Nothing
+ */
+void writeLog(std::string const& path, std::string const& log)
+{
+    std::ofstream out(path.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    out.write(log.data(), log.size());
+}
+
+
+/**
+ * @brief       Runs the tests
+ * @param argc  The number of arguments given to the program when run
+ * @param argv  An array of strings which are the arguments given
+ * @return      0 if every test passed, 1 otherwise
+ */
+int main(int argc, char **argv)
+{
+    GeneratorSettings settings;
+    settings.numberOfFrames = 2000;
+    ClusterLogGenerator<> generator(settings);
+    std::string const log = generator.generate();
+
+    boost::filesystem::path const root = boost::filesystem::temp_directory_path()
+        / boost::filesystem::unique_path("lolcat-test-%%%%-%%%%-%%%%");
+    boost::filesystem::create_directories(root);
+    std::string const wellFormed = (root / "WellFormed.txt").string();
+    std::string const malformedLast = (root / "MalformedLast.txt").string();
+    std::string const malformedMiddle = (root / "MalformedMiddle.txt").string();
+
+    writeLog(wellFormed, log);
+    writeLog(malformedLast, log + MALFORMED_FRAME);
+    std::size_t const middle = log.find("\n\n", log.size() / 2) + 2;
+    writeLog(malformedMiddle, log.substr(0, middle) + MALFORMED_FRAME + log.substr(middle));
+
+    int failures = 0;
+    unsigned int seen = 0;
+
+    // Buffers holding the whole file, a good part of it, and a few frames
+    std::size_t const bufferSizes[] = { 4 << 20, 64 << 10, 4 << 10 };
+    for (std::size_t i = 0; i < sizeof(bufferSizes) / sizeof(bufferSizes[0]); ++i) {
+        if (readLog(wellFormed, bufferSizes[i], seen) || seen != settings.numberOfFrames) {
+            std::cerr << "FAILED: reading the well formed log with " << bufferSizes[i]
+                      << " byte buffers (saw " << seen << " frames)\n";
+            failures++;
+        }
+
+        // The final frame is only parsed once the reader has reached the end
+        // of the file, so nothing is left to drain when it fails
+        if (!readLog(malformedLast, bufferSizes[i], seen) || seen != settings.numberOfFrames) {
+            std::cerr << "FAILED: reading the log with a malformed final frame with "
+                      << bufferSizes[i] << " byte buffers (saw " << seen << " frames)\n";
+            failures++;
+        }
+
+        if (!readLog(malformedMiddle, bufferSizes[i], seen) || seen >= settings.numberOfFrames) {
+            std::cerr << "FAILED: reading the log with a malformed middle frame with "
+                      << bufferSizes[i] << " byte buffers (saw " << seen << " frames)\n";
+            failures++;
+        }
+    }
+
+    boost::system::error_code error;
+    boost::filesystem::remove_all(root, error);
+
+    if (failures) {
+        return 1;
+    }
+    std::cout << "All pipelined frame reader tests passed\n";
+
+    return 0;
+}
@@ -0,0 +1,266 @@
+/**
+ * @file        PixelMaskTest.cpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Checks that the hits on masked pixels are dropped however the
+ * frames are read, and that a mask saved by the noisy pixel search is loaded
+ * back unchanged
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+// C++ headers
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <iterator>
+#include <cstdint>
+// My headers
+#include <Frame.hpp>
+#include <PixelMask.hpp>
+#include <TextFileReader.hpp>
+#include <NoisyPixelConsumer.hpp>
+#include <TestDataset.hpp>
+
+
+/**
+ * @brief       Rebuilds a frame without the hits on masked pixels, dropping
+ * any cluster left without pixels
+ * @param frame The frame
+ * @param mask  The mask
+ * @return      The frame as a masked read should return it
+ */
+Frame<int> const withoutMasked(Frame<int> const& frame, PixelMask<> const& mask)
+{
+    Frame<int> masked(frame.getTime(), frame.getRunningTime());
+    for (std::size_t i = 0; i < frame.numberOfClusters(); ++i) {
+        masked.beginCluster();
+        for (std::size_t j = frame.clusterBegin(i); j < frame.clusterEnd(i); ++j) {
+            if (!mask.isMasked(frame.index(j))) {
+                masked.addHit(frame.hits()[j]);
+            }
+        }
+    }
+    masked.dropEmptyCluster();
+
+    return masked;
+}
+
+
+/**
+ * @brief A callback checking every frame it sees against the expected frames
+ */
+struct CheckingCallback {
+    std::vector<Frame<int> > const* expected; // Every frame of the file, masked
+    unsigned int* matched; // The number of frames which matched
+
+    void operator()(Frame<int> const& frame, unsigned int const frameNumber) const
+    {
+        if (frameNumber <= expected->size() && isSameFrame(frame, (*expected)[frameNumber - 1])) {
+            (*matched)++;
+        }
+    }
+};
+
+
+/**
+ * @brief          Reads the file with the mask every way it can be read
+ * @param path     The path of the cluster log
+ * @param mask     The mask
+ * @param expected Every frame of the file, masked
+ * @return         Whether every read returned the expected frames
+ */
+bool readsMasked(std::string const& path, PixelMask<> const& mask,
+                 std::vector<Frame<int> > const& expected)
+{
+    {
+        TextFileReader<int> input(path);
+        input.setMask(&mask);
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            if (input.endOfStream() || !isSameFrame(input.getFrame(), expected[i])) {
+                return false;
+            }
+        }
+        if (!input.endOfStream()
+                || !isSameFrame(input.getFrame(expected.size() / 2), expected[expected.size() / 2 - 1])) {
+            return false;
+        }
+    }
+
+    for (int way = 0; way < 2; ++way) {
+        TextFileReader<int> input(path);
+        input.setMask(&mask);
+        unsigned int matched = 0;
+        CheckingCallback callback = { &expected, &matched };
+        unsigned int const frames = (way == 0) ? input.forEachFrame(4, callback)
+                                               : input.forEachFramePipelined(callback);
+        if (frames != expected.size() || matched != expected.size()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief       Runs the tests
+ * @param argc  The number of arguments given to the program when run
+ * @param argv  An array of strings which are the arguments given
+ * @return      0 if every test passed, 1 otherwise
+ */
+int main(int argc, char **argv)
+{
+    GeneratorSettings settings;
+    settings.numberOfFrames = 1000;
+    settings.occupancy = 0.01;
+    TestDataset dataset(settings);
+    std::string const maskPath = dataset.path() + ".lolm";
+
+    int failures = 0;
+    std::mt19937 rng(3);
+
+    // Filtering arrays of hits of every length around the vector width, with
+    // a few and with most of their pixels masked, keeps the others in order
+    for (int density = 1; density <= 2; ++density) {
+        PixelMask<> mask;
+        for (std::uint32_t i = 0; i < TimepixGeometry::PIXELS; ++i) {
+            if (rng() % 8 < static_cast<unsigned int>(density * density * 2 - 1)) {
+                mask.mask(i);
+            }
+        }
+        for (std::size_t count = 0; count <= 40; ++count) {
+            std::vector<std::uint32_t> hits(count);
+            std::vector<std::uint32_t> kept;
+            for (std::size_t i = 0; i < count; ++i) {
+                hits[i] = TimepixGeometry::pack(rng() % TimepixGeometry::PIXELS, rng() % 1000);
+                if (!mask.isMasked(TimepixGeometry::indexOf(hits[i]))) {
+                    kept.push_back(hits[i]);
+                }
+            }
+            std::size_t const numberKept = mask.filter(count ? &hits[0] : 0, count);
+            if (numberKept != kept.size() || !std::equal(kept.begin(), kept.end(), hits.begin())) {
+                std::cerr << "FAILED: filtering " << count << " hits\n";
+                failures++;
+            }
+        }
+    }
+
+    // Every frame, unmasked
+    std::vector<Frame<int> > reference;
+    {
+        TextFileReader<int> input(dataset.path());
+        while (!input.endOfStream()) {
+            reference.push_back(input.getFrame());
+        }
+    }
+
+    // Masking every pixel of the first frame (so whole clusters and the
+    // whole frame go), along with every fifth pixel of the detector (so some
+    // clusters lose only some of their pixels)
+    PixelMask<> mask;
+    for (std::size_t i = 0; i < reference[0].size(); ++i) {
+        mask.mask(reference[0].index(i));
+    }
+    for (std::uint32_t i = 0; i < TimepixGeometry::PIXELS; i += 5) {
+        mask.mask(i);
+    }
+    std::vector<Frame<int> > expected;
+    std::size_t hits = 0;
+    std::size_t keptHits = 0;
+    for (std::size_t i = 0; i < reference.size(); ++i) {
+        expected.push_back(withoutMasked(reference[i], mask));
+        hits += reference[i].size();
+        keptHits += expected[i].size();
+    }
+    if (!expected[0].empty() || expected[0].numberOfClusters() != 0
+            || keptHits < hits / 2 || keptHits > hits - hits / 10) {
+        std::cerr << "FAILED: masking the first frame and every fifth pixel (kept "
+                  << keptHits << " of " << hits << " hits)\n";
+        failures++;
+    }
+
+    // The masked hits are dropped whether the frames are parsed or read from
+    // the binary cache, which keeps every hit
+    if (!readsMasked(dataset.path(), mask, expected)) {
+        std::cerr << "FAILED: dropping the masked hits from the parsed frames\n";
+        failures++;
+    }
+    {
+        TextFileReader<int> input(dataset.path());
+        input.writeCache();
+    }
+    if (!readsMasked(dataset.path(), mask, expected)) {
+        std::cerr << "FAILED: dropping the masked hits from the cached frames\n";
+        failures++;
+    }
+
+    // A mask saved and loaded back masks the same pixels
+    mask.save(maskPath);
+    PixelMask<> loaded;
+    loaded.load(maskPath);
+    bool isSame = loaded.numberOfMasked() == mask.numberOfMasked();
+    for (std::uint32_t i = 0; isSame && i < TimepixGeometry::PIXELS; ++i) {
+        isSame = loaded.isMasked(i) == mask.isMasked(i);
+    }
+    if (!isSame || !readsMasked(dataset.path(), loaded, expected)) {
+        std::cerr << "FAILED: saving and loading the mask\n";
+        failures++;
+    }
+
+    // The noisy pixel search saves the mask of a pixel hit in every frame
+    {
+        std::uint32_t const noisy = 200 * TimepixGeometry::WIDTH + 17;
+        NoisyPixelConsumer<int> search(maskPath);
+        for (std::size_t i = 0; i < reference.size(); ++i) {
+            Frame<int> frame = reference[i];
+            frame.beginCluster();
+            frame.addPixel(17, 200, 30);
+            search.consume(frame, static_cast<unsigned int>(i + 1));
+        }
+        search.finish(DatasetSummary());
+
+        PixelMask<> found;
+        found.load(maskPath);
+        if (!found.isMasked(noisy) || found.numberOfMasked() != search.mask().numberOfMasked()) {
+            std::cerr << "FAILED: saving the mask of the noisy pixels\n";
+            failures++;
+        }
+    }
+
+    // A mask cut short, or which isn't a mask at all, isn't loaded
+    {
+        std::ifstream in(maskPath.c_str(), std::ifstream::in | std::ifstream::binary);
+        std::string const bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        in.close();
+
+        std::string const damaged[] = { bytes.substr(0, bytes.size() - 1), "LOLC" + bytes.substr(4) };
+        for (std::size_t i = 0; i < sizeof(damaged) / sizeof(damaged[0]); ++i) {
+            {
+                std::ofstream out(maskPath.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+                out.write(damaged[i].data(), damaged[i].size());
+            }
+            PixelMask<> rejected;
+            try {
+                rejected.load(maskPath);
+                std::cerr << "FAILED: rejecting a damaged mask\n";
+                failures++;
+            } catch (std::ifstream::failure const&) {
+            }
+        }
+    }
+
+    if (failures) {
+        return 1;
+    }
+    std::cout << "All pixel mask tests passed\n";
+
+    return 0;
+}
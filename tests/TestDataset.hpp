@@ -0,0 +1,102 @@
+/**
+ * @file        TestDataset.hpp
+ * @author      Hector Stalker <hstalker0@gmail.com>
+ * @version     0.1
+ *
+ * @brief       Defines the helpers the tests share, for writing synthetic
+ * datasets laid out as the readers expect and comparing the frames read back
+ *
+ * @copyright   This file is under the BSD 2-Clause license <br>
+ * For conditions of distribution and use, see: <br>
+ * http://opensource.org/licenses/BSD-2-Clause <br>
+ * or read the 'LICENSE' file distributed with this code <br>
+ */
+
+#ifndef TESTDATASET_HPP
+#define TESTDATASET_HPP
+
+// C++ headers
+#include <string>
+#include <algorithm>
+#include <boost/filesystem.hpp>
+// My headers
+#include <Frame.hpp>
+#include <ClusterLogGenerator.hpp>
+
+/**
+ * @brief This class writes a synthetic cluster log into a fresh temporary
+ * directory, laid out as '<detector>/Data/<settings>/ClusterLogAll.txt', and
+ * removes the directory (and any cache written next to the log) again when it
+ * goes out of scope (class is non-copyable)
+ */
+class TestDataset {
+public:
+
+    /**
+     * @brief          A constructor for the TestDataset class
+     * @param settings The settings to generate the log with
+     * @return         A newly constructed TestDataset object, throws
+     * std::ifstream::failure if the log can't be written
+     */
+    explicit TestDataset(GeneratorSettings const& settings)
+        : root_(boost::filesystem::temp_directory_path()
+                / boost::filesystem::unique_path("lolcat-test-%%%%-%%%%-%%%%"))
+    {
+        boost::filesystem::path const directory = root_ / "Det" / "Data" / "S1";
+        boost::filesystem::create_directories(directory);
+        path_ = (directory / "ClusterLogAll.txt").string();
+
+        ClusterLogGenerator<> generator(settings);
+        generator.write(path_);
+    }
+
+
+    /**
+     * @brief   A destructor for the TestDataset class, removing the directory
+     * @return  Nothing
+     */
+    ~TestDataset()
+    {
+        boost::system::error_code error;
+        boost::filesystem::remove_all(root_, error);
+    }
+
+
+    /**
+     * @brief   Retrieves the path of the cluster log
+     * @return  The path of the cluster log
+     */
+    std::string const& path() const
+    {
+        return path_;
+    }
+
+private:
+    boost::filesystem::path root_; // The temporary directory holding the dataset
+    std::string path_; // The path of the cluster log
+
+    // Non-copyable
+    TestDataset(TestDataset const&);
+    TestDataset& operator=(TestDataset const&);
+};
+
+
+/**
+ * @brief   Checks whether two frames hold the same times, hits and clusters
+ * @param a The first frame
+ * @param b The second frame
+ * @return  Whether the frames are the same
+ */
+template <class T>
+bool isSameFrame(Frame<T> const& a, Frame<T> const& b)
+{
+    return a.getTime() == b.getTime() && a.getRunningTime() == b.getRunningTime()
+        && a.hits().size() == b.hits().size()
+        && std::equal(a.hits().begin(), a.hits().end(), b.hits().begin())
+        && a.clusterOffsets().size() == b.clusterOffsets().size()
+        && std::equal(a.clusterOffsets().begin(), a.clusterOffsets().end(),
+                      b.clusterOffsets().begin());
+}
+
+
+#endif  /* TESTDATASET_HPP */